@@ -0,0 +1,203 @@
+/*
+ ===============================================================================
+ Name        : main.c
+ Description :
+
+   Checks fft_q15 from UMD_LPC1769 against a double precision DFT of
+   the same Q15 input, at 256, 512 and 1024 points, with these
+   signals:
+
+     tone     a Hann windowed sine, between bins, with some noise, as
+              fft_window gives for a hum picked up by the mic
+     tones    three sines of different levels, unwindowed
+     noise    white noise, at the level fft_window leaves full scale
+              ADC noise
+     impulse  a single sample, which spreads over every bin
+
+   For each, the signal to noise ratio of the result (the DFT's power
+   over the power of the difference from it) is printed, and the test
+   fails if it is under MIN_SNR_DB. fft_window is checked the same
+   way against a double precision Hann window, and fft_q15 is checked
+   to refuse sizes which aren't powers of 2 in range.
+
+   Usage: ffttest
+
+ ===============================================================================
+ */
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "UMDLPC/util/fft.h"
+
+// The least signal to noise ratio allowed, in dB. Each pass rounds
+// and scales its output, so the error grows about 3dB a radix-2 pass
+// against a result which shrinks with n: an impulse at 1024 points,
+// at 32 a bin, comes closest.
+#define MIN_SNR_DB 35.0
+
+// Q15 full scale, less the 3 bits of headroom fft_window leaves
+#define WINDOWED_PEAK (32767 >> 3)
+
+static Q15Complex data[FFT_MAX_POINTS];
+static double input_re[FFT_MAX_POINTS], input_im[FFT_MAX_POINTS];
+static uint32_t samples[FFT_MAX_POINTS];
+static uint_fast8_t failures;
+
+// Uniform in [-1, 1), from a fixed seed so runs are repeatable
+static uint32_t seed = 1;
+
+double static noise(void) {
+  seed = seed * 1664525 + 1013904223;
+  return (int32_t) seed / 2147483648.0;
+}
+
+int16_t static q15(double x) {
+  const long v = lround(x);
+
+  return (v > 32767) ? 32767 : (v < -32768) ? -32768 : v;
+}
+
+// Transforms data, as filled in for n points, and compares it with
+// the DFT of the same input, divided by n as fft_q15's is
+double static snr_db(uint16_t n) {
+  double signal = 0, error = 0;
+  uint32_t i, k;
+
+  for (i = 0; i < n; ++i) {
+    input_re[i] = data[i].re;
+    input_im[i] = data[i].im;
+  }
+
+  if (!fft_q15(data, n)) {
+    return 0;
+  }
+
+  for (k = 0; k < n; ++k) {
+    double re = 0, im = 0;
+
+    for (i = 0; i < n; ++i) {
+      const double a = -2 * M_PI * ((i * k) % n) / n;
+
+      re += input_re[i] * cos(a) - input_im[i] * sin(a);
+      im += input_re[i] * sin(a) + input_im[i] * cos(a);
+    }
+    re /= n;
+    im /= n;
+
+    signal += re * re + im * im;
+    error += (data[k].re - re) * (data[k].re - re)
+           + (data[k].im - im) * (data[k].im - im);
+  }
+
+  return error ? 10 * log10(signal / error) : INFINITY;
+}
+
+void static check(const char *signal, uint16_t n, double snr) {
+  const char failed = !(snr >= MIN_SNR_DB);
+
+  printf("  %-8s %5u  %6.1fdB%s\n", signal, n, snr, failed ? "  FAIL" : "");
+  failures += failed;
+}
+
+void static tone(uint16_t n) {
+  uint32_t i;
+
+  for (i = 0; i < n; ++i) {
+    const double hann = (1 - cos(2 * M_PI * i / n)) / 2;
+
+    data[i].re = q15(hann * (WINDOWED_PEAK * 0.9 * sin(2 * M_PI * 10.3 * i / n)
+                             + 16 * noise()));
+    data[i].im = 0;
+  }
+  check("tone", n, snr_db(n));
+}
+
+void static tones(uint16_t n) {
+  uint32_t i;
+
+  for (i = 0; i < n; ++i) {
+    data[i].re = q15(8000 * sin(2 * M_PI * 3 * i / n)
+                     + 800 * sin(2 * M_PI * 37.5 * i / n)
+                     + 80 * cos(2 * M_PI * (n / 3) * i / n));
+    data[i].im = 0;
+  }
+  check("tones", n, snr_db(n));
+}
+
+void static white(uint16_t n) {
+  uint32_t i;
+
+  for (i = 0; i < n; ++i) {
+    data[i].re = q15(WINDOWED_PEAK * noise());
+    data[i].im = q15(WINDOWED_PEAK * noise());
+  }
+  check("noise", n, snr_db(n));
+}
+
+void static impulse(uint16_t n) {
+  uint32_t i;
+
+  for (i = 0; i < n; ++i) {
+    data[i].re = data[i].im = 0;
+  }
+  data[n / 4 + 1].re = 32767;
+  check("impulse", n, snr_db(n));
+}
+
+// fft_window against a double precision window, on ADC data register
+// values holding a sine about mid scale
+void static window(uint16_t n) {
+  double mean = 0, signal = 0, error = 0;
+  uint32_t i;
+
+  for (i = 0; i < n; ++i) {
+    const uint32_t adc = lround(2048 + 1500 * sin(2 * M_PI * 7.7 * i / n)
+                                + 20 * noise());
+
+    samples[i] = (adc << 4) | 0x80000000;
+    mean += adc;
+  }
+  mean = floor(mean / n);
+
+  fft_window(samples, data, n);
+
+  for (i = 0; i < n; ++i) {
+    const double hann = (1 - cos(2 * M_PI * i / n)) / 2;
+    const double x = (((samples[i] >> 4) & 0xfff) - mean) * 8 * hann;
+
+    signal += x * x;
+    error += (data[i].re - x) * (data[i].re - x) + data[i].im * data[i].im;
+  }
+  check("window", n, error ? 10 * log10(signal / error) : INFINITY);
+}
+
+int main(void) {
+  static const uint16_t sizes[] = { 256, 512, 1024 };
+  static const uint16_t refused[] = { 0, 2, 3, 100, 768, 2048 };
+  uint_fast8_t i;
+
+  printf("  signal   points  SNR (at least %.0fdB)\n", MIN_SNR_DB);
+  for (i = 0; i < sizeof sizes / sizeof sizes[0]; ++i) {
+    tone(sizes[i]);
+    tones(sizes[i]);
+    white(sizes[i]);
+    impulse(sizes[i]);
+    window(sizes[i]);
+  }
+
+  for (i = 0; i < sizeof refused / sizeof refused[0]; ++i) {
+    if (fft_q15(data, refused[i])) {
+      printf("  %u points were taken\n", refused[i]);
+      ++failures;
+    }
+  }
+
+  if (failures) {
+    printf("%u failed\n", failures);
+    return 1;
+  }
+  printf("all passed\n");
+  return 0;
+}
@@ -1,78 +1,198 @@
 #include "hd44780.h"
+#include "UMDLPC/system/sleep.h"
+#include "UMDLPC/system/delay.h"
+#include "UMDLPC/system/pconp.h"
 
-#define CLOCK_DELAY 100
+/* Bus timings, in ns, from the HD44780U datasheet's figures for a 2.7V
+ * to 4.5V supply: RS and RW set up 60ns before E rises, E high for at
+ * least 450ns (which also covers read data becoming valid, 360ns after
+ * E rises) in an enable cycle of at least 1000ns.
+ */
+#define T_SETUP_NS 60
+#define T_E_HIGH_NS 450
+#define T_E_LOW_NS 550
 
-__attribute__((always_inline))
-void static _delay_loop_2(uint16_t __count) {
-  while (__count--) {
-    __asm__ volatile (
-       "nop" "\n"
-       "nop"
-       ::
-      );
-  }
-}
+// Execution times from the datasheet (at fosc = 270kHz), with some
+// margin for slower controllers, for when the busy flag isn't read
+#define LCD_EXEC_US 50
+#define LCD_CLEAR_US 1600
 
-__attribute__ ((always_inline))
-void static _delay_ms(uint_fast16_t __ms) {
-  uint16_t __ticks;
-  double __tmp;
-  __tmp = ((SystemCoreClock) / 4e3) * __ms;
-  if (__tmp < 1.0)
-    __ticks = 1;
-  else if (__tmp > 65535)
-  {
-    //      __ticks = requested delay in 1/10 ms
-    __ticks = (uint16_t) (__ms * 10.0);
-    while(__ticks)
-    {
-      // wait 1/10 ms
-      _delay_loop_2(((SystemCoreClock) / 4e3) / 10);
-      __ticks --;
-    }
-    return;
-  }
-  else
-    __ticks = (uint16_t)__tmp;
-  _delay_loop_2(__ticks);
+// The busy flag is given up on after this long, so that a missing
+// display can't hang the driver
+#define LCD_BUSY_TIMEOUT_US 5000
+
+// How often the shadow buffer's refresh runs: just over an
+// instruction's execution time, so the controller is usually ready
+#ifdef LCD_NO_BUSY_FLAG
+#define LCD_REFRESH_US LCD_EXEC_US
+#else
+#define LCD_REFRESH_US 45
+#endif
+
+#define BUSY_FLAG 0x80
+
+#define TCR_ENABLE (1 << 0)
+#define TCR_RESET  (1 << 1)
+
+#define LCD_CELLS (LCD_COLUMNS * LCD_ROWS)
+
+// Where the address counter is known to point, as a cell, if anywhere
+#define NO_CELL LCD_CELLS
+
+#ifdef LCD_BUS_4BIT
+#define BUS_MASK (0xF0 << LCD_DATA_SHIFT)
+#else
+#define BUS_MASK (0xFF << LCD_DATA_SHIFT)
+#endif
+
+// The timings above as cycles, at the current clock
+static uint32_t setup_cycles, e_high_cycles, e_low_cycles, timeout_cycles;
+
+// The bus timings are spun out with delay_cycles, rather than with
+// sleep_delay_cycles, as the refresh uses them from an interrupt
+void static timing_init(void) {
+  setup_cycles = delay_ns_to_cycles(T_SETUP_NS);
+  e_high_cycles = delay_ns_to_cycles(T_E_HIGH_NS);
+  e_low_cycles = delay_ns_to_cycles(T_E_LOW_NS);
+  timeout_cycles = LCD_BUSY_TIMEOUT_US * (SystemCoreClock / 1000000);
 }
 
-void LCD_write_command(uint_fast8_t command) {
-  LPC_GPIO1->FIOPIN = command << 18;
+// Drives value onto the bus and strobes E; the controller latches it
+// as E falls. In 4 bit mode only the upper nibble is wired.
+void static write_cycle(uint_fast8_t value) {
+  LCD_DATA_PORT->FIOCLR = BUS_MASK & ~((uint32_t) value << LCD_DATA_SHIFT);
+  LCD_DATA_PORT->FIOSET = BUS_MASK & ((uint32_t) value << LCD_DATA_SHIFT);
 
+  delay_cycles(setup_cycles);
+  LCD_CLK_ON();
+  delay_cycles(e_high_cycles);
   LCD_CLK_OFF();
-  _delay_loop_2(CLOCK_DELAY);
+  delay_cycles(e_low_cycles);
+}
+
+#ifndef LCD_NO_BUSY_FLAG
+
+// Strobes E with RW high, and returns what the controller drove onto
+// the bus while E was high
+uint_fast8_t static read_cycle(void) {
+  uint32_t pins;
+
+  delay_cycles(setup_cycles);
   LCD_CLK_ON();
-  _delay_loop_2(CLOCK_DELAY);
+  delay_cycles(e_high_cycles);
+  pins = LCD_DATA_PORT->FIOPIN;
   LCD_CLK_OFF();
-  _delay_loop_2(CLOCK_DELAY * 37);
+  delay_cycles(e_low_cycles);
+
+  return (pins & BUS_MASK) >> LCD_DATA_SHIFT;
+}
+
+// Reads the busy flag and address counter
+uint_fast8_t static read_status(void) {
+  uint_fast8_t status;
+
+  LCD_RS_OFF();
+  LCD_DATA_PORT->FIODIR &= ~BUS_MASK;
+  LCD_RW_ON();
+
+#ifdef LCD_BUS_4BIT
+  // Both nibbles have to be read, to stay in step
+  status = read_cycle() & 0xF0;
+  status |= read_cycle() >> 4;
+#else
+  status = read_cycle();
+#endif
+
+  // Only drive the bus again once the controller has let go of it
+  LCD_RW_OFF();
+  LCD_DATA_PORT->FIODIR |= BUS_MASK;
+
+  return status;
+}
+
+// Waits until the controller has finished the last command
+void static wait_ready(void) {
+  const uint32_t start = delay_counter();
+
+  while ((read_status() & BUSY_FLAG)
+         && delay_counter() - start < timeout_cycles)
+    ;
+}
+
+#endif
+
+// Writes an instruction (rs 0) or data (rs 1), without waiting
+void static write_byte(uint_fast8_t rs, uint_fast8_t value) {
+  if (rs) {
+    LCD_RS_ON();
+  } else {
+    LCD_RS_OFF();
+  }
+
+#ifdef LCD_BUS_4BIT
+  write_cycle(value);
+  write_cycle(value << 4);
+#else
+  write_cycle(value);
+#endif
+}
+
+// Sends an instruction or data, which takes the controller up to
+// exec_us to carry out
+void static send(uint_fast8_t rs, uint_fast8_t value, uint32_t exec_us) {
+#ifndef LCD_NO_BUSY_FLAG
+  wait_ready();
+#endif
+
+  write_byte(rs, value);
+
+#ifdef LCD_NO_BUSY_FLAG
+  sleep_delay_us(exec_us);
+#endif
+}
+
+void LCD_write_command(uint_fast8_t command) {
+  send(0, command, LCD_EXEC_US);
 }
 
 void LCD_init(void) {
+  sleep_init();
+  delay_init();
+  timing_init();
+
   LCD_RS_OUTPUT();
   LCD_RW_OUTPUT();
   LCD_CLK_OUTPUT();
 
   // Set all data bus pins output, off
-  LPC_GPIO1->FIODIR |= 0xff << 18;
-  LPC_GPIO1->FIOCLR |= 0xff << 18;
+  LCD_DATA_PORT->FIODIR |= BUS_MASK;
+  LCD_DATA_PORT->FIOCLR = BUS_MASK;
 
-  _delay_ms(100);
+  sleep_delay_ms(100);
 
   LCD_RS_OFF();
   LCD_RW_OFF();
   LCD_CLK_OFF();
 
-  _delay_loop_2(CLOCK_DELAY);
-
-  LCD_function_set(BUS_WIDTH_8, LINE_COUNT_2, FONT_5_8);
-  _delay_ms(5);
+  // Initialization by instruction, from the datasheet: the busy flag
+  // can't be read until the interface is known to be 8 bits wide, so
+  // these use fixed delays, long enough for slow controllers. In 4
+  // bit mode each is a single cycle, which the controller (still 8 bits
+  // wide) takes as a whole byte.
+  write_cycle(0x30);
+  sleep_delay_us(4100);
+  write_cycle(0x30);
+  sleep_delay_us(100);
+  write_cycle(0x30);
+  sleep_delay_us(100);
 
-  LCD_function_set(BUS_WIDTH_8, LINE_COUNT_2, FONT_5_8);
-  _delay_ms(1);
+#ifdef LCD_BUS_4BIT
+  // Switch to 4 bits, again with a single cycle
+  write_cycle(0x20);
+  sleep_delay_us(100);
+#endif
 
-  LCD_function_set(BUS_WIDTH_8, LINE_COUNT_2, FONT_5_8);
-  LCD_function_set(BUS_WIDTH_8, LINE_COUNT_2, FONT_5_8);
+  LCD_function_set(LCD_BUS_WIDTH, LINE_COUNT_2, FONT_5_8);
 
   LCD_display_settings(DISPLAY_ON, CURSOR_ON, CURSOR_BLINK_ON);
 
@@ -81,8 +201,13 @@ void LCD_init(void) {
   LCD_mode(RIGHT_TO_LEFT, DISPLAY_NO_SHIFT);
 }
 
-void LCD_clear() { LCD_write_command(1); }
-void LCD_cursor_home() { LCD_write_command(2); }
+void LCD_clear() {
+  send(0, 1, LCD_CLEAR_US);
+}
+
+void LCD_cursor_home() {
+  send(0, 2, LCD_CLEAR_US);
+}
 
 void LCD_move_cursor(uint_fast8_t x, uint_fast8_t y) {
   LCD_set_DDRAM(x + (0x40 * y));
@@ -116,7 +241,116 @@ void LCD_set_DDRAM(uint_fast8_t addr) {
 }
 
 void LCD_write(uint_fast8_t data) {
-  LCD_RS_ON();
-  LCD_write_command(data);
-  LCD_RS_OFF();
+  send(1, data, LCD_EXEC_US);
+}
+
+// The shadow buffer: what should be shown, and what the controller was
+// last sent, a cell per character, row by row
+static volatile char shadow[LCD_CELLS];
+static char shown[LCD_CELLS];
+static uint_fast8_t next_cell;
+
+uint_fast8_t static cell_address(uint_fast8_t cell) {
+  return (cell / LCD_COLUMNS) * 0x40 + cell % LCD_COLUMNS;
+}
+
+// Sends at most one instruction or character per tick, so that the
+// interrupt never waits on the controller
+void TIMER0_IRQHandler(void) {
+  uint_fast8_t i, cell = 0;
+  char c;
+
+  // Clear the MR0 interrupt
+  LPC_TIM0->IR = 1;
+
+#ifndef LCD_NO_BUSY_FLAG
+  if (read_status() & BUSY_FLAG) {
+    return;
+  }
+#endif
+
+  // Look for a changed cell from where the address counter points, so
+  // that runs of changed cells don't need it moved
+  for (i = 0; i < LCD_CELLS; ++i) {
+    cell = (next_cell + i) % LCD_CELLS;
+    if (shadow[cell] != shown[cell]) {
+      break;
+    }
+  }
+
+  if (i == LCD_CELLS) {
+    // Everything is shown; stop until the next change
+    LPC_TIM0->TCR = TCR_RESET;
+    return;
+  }
+
+  if (cell != next_cell) {
+    write_byte(0, (1 << 7) | cell_address(cell));
+    next_cell = cell;
+    return;
+  }
+
+  c = shadow[cell];
+  write_byte(1, c);
+  shown[cell] = c;
+
+  // The address counter runs on past the end of the row
+  next_cell = (cell % LCD_COLUMNS == LCD_COLUMNS - 1) ? NO_CELL : cell + 1;
+}
+
+void LCD_buffer_init(void) {
+  uint_fast8_t i;
+
+  LCD_clear();
+  for (i = 0; i < LCD_CELLS; ++i) {
+    shadow[i] = shown[i] = ' ';
+  }
+  next_cell = 0;
+
+  LPC_SC->PCONP |= PC_TIM0;
+
+  // Undivided peripheral clock for TIMER0 (1 at bits 3:2)
+  LPC_SC->PCLKSEL0 &= ~(3 << 2);
+  LPC_SC->PCLKSEL0 |= (1 << 2);
+
+  // Count microseconds, and interrupt and restart every tick; the timer
+  // only runs while there are changes to send
+  LPC_TIM0->TCR = TCR_RESET;
+  LPC_TIM0->PR = SystemCoreClock / 1000000 - 1;
+  LPC_TIM0->MR0 = LCD_REFRESH_US - 1;
+  LPC_TIM0->MCR = (1 << 0) | (1 << 1);
+  LPC_TIM0->IR = 0x3F;
+
+  NVIC_EnableIRQ(TIMER0_IRQn);
+}
+
+void LCD_buffer_put(uint_fast8_t x, uint_fast8_t y, char c) {
+  const uint_fast8_t cell = y * LCD_COLUMNS + x;
+
+  if (x >= LCD_COLUMNS || y >= LCD_ROWS || shadow[cell] == c) {
+    return;
+  }
+
+  shadow[cell] = c;
+  LPC_TIM0->TCR = TCR_ENABLE;
+}
+
+void LCD_buffer_string(uint_fast8_t x, uint_fast8_t y, const char *s) {
+  while (*s && x < LCD_COLUMNS) {
+    LCD_buffer_put(x++, y, *s++);
+  }
+}
+
+void LCD_buffer_clear(void) {
+  uint_fast8_t x, y;
+
+  for (y = 0; y < LCD_ROWS; ++y) {
+    for (x = 0; x < LCD_COLUMNS; ++x) {
+      LCD_buffer_put(x, y, ' ');
+    }
+  }
+}
+
+uint_fast8_t LCD_buffer_idle(void) {
+  return !(LPC_TIM0->TCR & TCR_ENABLE);
 }
@@ -1,3 +1,17 @@
+/* hd44780.h
+ *
+ * Declares a driver for HD44780 character LCDs, over an 8 bit data bus
+ * or its upper 4 lines (LCD_BUS_4BIT, see pins.h). Before each write
+ * the driver reads the busy flag until the controller is ready, so
+ * that commands take only as long as the controller needs, unless
+ * LCD_NO_BUSY_FLAG is defined.
+ *
+ * Alternatively, the display can be written through a shadow buffer
+ * (LCD_buffer_*), which only costs a store per character: TIMER0's
+ * interrupt then sends the cells which changed in the background, one
+ * instruction or character per tick.
+ */
+
 #ifndef __HD44780_h_
 #define __HD44780_h_
 
@@ -6,6 +20,14 @@
 
 #include "pins.h"
 
+/* The size of the display, for the shadow buffer */
+#ifndef LCD_COLUMNS
+#define LCD_COLUMNS 16
+#endif
+#ifndef LCD_ROWS
+#define LCD_ROWS 2
+#endif
+
 /* Parameter enums */
 typedef enum {
   LEFT_TO_RIGHT = 0,
@@ -57,6 +79,15 @@ typedef enum {
   FONT_5_10 = 1 << 2
 } LCDFont;
 
+/* The bus width the driver was built for, to be given to
+ * LCD_function_set
+ */
+#ifdef LCD_BUS_4BIT
+#define LCD_BUS_WIDTH BUS_WIDTH_4
+#else
+#define LCD_BUS_WIDTH BUS_WIDTH_8
+#endif
+
 void LCD_init(void);
 void LCD_write_command(uint_fast8_t command);
 void LCD_clear();
@@ -74,4 +105,28 @@ void LCD_set_DDRAM(uint_fast8_t addr);
 
 void LCD_write(uint_fast8_t data);
 
+/* LCD_buffer_init()
+ * Clears the display, and hands it over to the shadow buffer: from
+ * then on, only the LCD_buffer_* functions may be used, and TIMER0 is
+ * taken. The entry mode must move the cursor right (the default).
+ */
+void LCD_buffer_init(void);
+
+/* LCD_buffer_put(x, y, c), LCD_buffer_string(x, y, s)
+ * Write to the shadow buffer, without waiting for the display. Strings
+ * are cut off at the end of the row.
+ */
+void LCD_buffer_put(uint_fast8_t x, uint_fast8_t y, char c);
+void LCD_buffer_string(uint_fast8_t x, uint_fast8_t y, const char *s);
+
+/* LCD_buffer_clear()
+ * Fills the shadow buffer with spaces.
+ */
+void LCD_buffer_clear(void);
+
+/* LCD_buffer_idle()
+ * Returns 1 once everything written to the shadow buffer is shown.
+ */
+uint_fast8_t LCD_buffer_idle(void);
+
 #endif
@@ -29,20 +29,19 @@ int main(void) {
   while (i < (1 << 23)) { ++i; }
 
   LCD_init();
-  LCD_function_set(BUS_WIDTH_8, LINE_COUNT_2, FONT_5_8);
+  LCD_function_set(LCD_BUS_WIDTH, LINE_COUNT_2, FONT_5_8);
 
   i = 1;
   while (i < (1 << 23)) { ++i; }
 
-  LCD_write('a');
-  LCD_write('b');
-  LCD_write('c');
-  LCD_write('d');
+  // From here on the display is refreshed in the background
+  LCD_buffer_init();
+  LCD_buffer_string(0, 0, "abcd");
 
   char c = 'e';
-  uint_fast8_t x = 0, y = 0;
+  uint_fast8_t x = 4, y = 0;
   while(1) {
-    LCD_write(c);
+    LCD_buffer_put(x, y, c);
     ++c;
 
     ++x;
@@ -51,8 +50,6 @@ int main(void) {
       y ^= 1;
     }
 
-    LCD_move_cursor(x, y);
-
     i = 1;
     while (i < (1 << 23)) { ++i; }
   }
@@ -11,4 +11,15 @@ DEFINE_PIN(LCD_RS, 0, 9);
 DEFINE_PIN(LCD_RW, 0, 8);
 DEFINE_PIN(LCD_CLK, 0, 7);
 
+// The data bus: D0-D7 on P1.18-P1.25
+#define LCD_DATA_PORT LPC_GPIO1
+#define LCD_DATA_SHIFT 18
+
+// Uncomment to only wire D4-D7 (P1.22-P1.25), leaving P1.18-P1.21 free
+// #define LCD_BUS_4BIT
+
+// Uncomment if RW is tied low, so that the busy flag can't be read: each
+// command is then given its datasheet execution time instead
+// #define LCD_NO_BUSY_FLAG
+
 #endif
@@ -0,0 +1,344 @@
+#include "hd44780sim.h"
+
+#include <string.h>
+
+typedef enum {
+  SIG_NONE = 0,
+  SIG_RS,
+  SIG_RW,
+  SIG_E,
+  SIGNALS
+} Signal;
+
+static const char * const SIGNAL_NAMES[SIGNALS] = {
+  [SIG_RS] = "LCD_RS",
+  [SIG_RW] = "LCD_RW",
+  [SIG_E] = "LCD_CLK",
+};
+
+// Bus timings from the datasheet, in ns (see hd44780.c)
+#define T_SETUP_NS 60
+#define T_E_HIGH_NS 450
+#define T_E_CYCLE_NS 1000
+
+// Execution times at SIM_FOSC_HZ, in ns, and how long the controller
+// takes to reset itself at power on
+#define EXEC_NS 37000
+#define EXEC_CLEAR_NS 1520000
+#define RESET_NS 15000000
+
+// CPU time taken by each pin write
+#define PIN_WRITE_NS 10
+
+#define BUSY_FLAG 0x80
+
+// Function set and entry mode bits
+#define FUNCTION_DL (1 << 4)
+#define FUNCTION_N (1 << 3)
+#define ENTRY_ID (1 << 1)
+#define ENTRY_S (1 << 0)
+
+// Characters in a DDRAM line, with two lines
+#define LINE_LENGTH 40
+
+static uint8_t levels[SIGNALS];
+static uint64_t changed[SIGNALS];
+
+static LPC_GPIO_TypeDef *port;
+static uint8_t shift, lines;
+
+// What the LPC is driving onto the port, from FIOSET and FIOCLR
+static uint32_t latch;
+
+static uint32_t fosc;
+static uint64_t now, busy_until, e_rose;
+
+// Interface state: 8 bits wide, or 4 with the nibble of the current
+// transfer (0 for the upper nibble) and the upper nibble written
+static uint_fast8_t eight_bits, nibble;
+static uint8_t upper;
+
+static uint8_t function, entry;
+static uint8_t ddram[0x80], cgram[0x40];
+static uint8_t address, display_shift;
+static uint_fast8_t in_cgram;
+
+static SimStats stats;
+static uint64_t stats_start;
+
+void sim_reset(uint32_t fosc_hz) {
+  fosc = fosc_hz;
+
+  memset(ddram, ' ', sizeof(ddram));
+  memset(cgram, 0, sizeof(cgram));
+  address = display_shift = 0;
+  in_cgram = 0;
+
+  // The state after the internal reset, from the datasheet
+  function = FUNCTION_DL;
+  entry = ENTRY_ID;
+  eight_bits = 1;
+  nibble = 0;
+
+  busy_until = now + RESET_NS;
+}
+
+void sim_bus(LPC_GPIO_TypeDef *new_port, uint8_t new_shift, uint8_t new_lines) {
+  port = new_port;
+  shift = new_shift;
+  lines = new_lines;
+}
+
+int sim_signal(const char *name) {
+  int i;
+
+  for (i = SIG_NONE + 1; i < SIGNALS; ++i) {
+    if (!strcmp(name, SIGNAL_NAMES[i])) {
+      return i;
+    }
+  }
+
+  return SIG_NONE;
+}
+
+// Execution time, for the oscillator in use
+uint64_t static exec_ns(uint64_t ns) {
+  return ns * SIM_FOSC_HZ / fosc;
+}
+
+// Moves the address counter on by one, as after a read or write
+void static step_address(void) {
+  const uint_fast8_t increment = entry & ENTRY_ID;
+
+  if (in_cgram) {
+    address = (address + (increment ? 1 : -1)) & 0x3F;
+  } else if (function & FUNCTION_N) {
+    // Two lines, at 0x00-0x27 and 0x40-0x67
+    if (increment) {
+      address = (address == 0x27) ? 0x40
+              : (address == 0x67) ? 0x00 : address + 1;
+    } else {
+      address = (address == 0x40) ? 0x27
+              : (address == 0x00) ? 0x67 : address - 1;
+    }
+  } else {
+    address = (address + (increment ? 1 : 2 * LINE_LENGTH - 1))
+              % (2 * LINE_LENGTH);
+  }
+}
+
+void static shift_display(uint_fast8_t left) {
+  const uint8_t length = (function & FUNCTION_N) ? LINE_LENGTH
+                                                 : 2 * LINE_LENGTH;
+  display_shift = (display_shift + (left ? 1 : length - 1)) % length;
+}
+
+void static execute(uint_fast8_t rs, uint8_t value) {
+  uint64_t ns = EXEC_NS;
+
+  if (now < busy_until) {
+    ++stats.busy_writes;
+    return;
+  }
+
+  if (rs) {
+    ++stats.data_writes;
+    if (in_cgram) {
+      cgram[address] = value;
+    } else {
+      ddram[address] = value;
+      if (entry & ENTRY_S) {
+        shift_display(entry & ENTRY_ID);
+      }
+    }
+    step_address();
+    busy_until = now + exec_ns(ns);
+    return;
+  }
+
+  ++stats.instructions;
+
+  if (value & 0x80) {
+    in_cgram = 0;
+    address = value & 0x7F;
+  } else if (value & 0x40) {
+    in_cgram = 1;
+    address = value & 0x3F;
+  } else if (value & 0x20) {
+    function = value;
+    if (eight_bits != !!(value & FUNCTION_DL)) {
+      eight_bits = !!(value & FUNCTION_DL);
+      nibble = 0;
+    }
+  } else if (value & 0x10) {
+    // Bit 3 shifts the display instead of moving the cursor, and bit 2
+    // is to the right
+    if (value & 0x08) {
+      shift_display(!(value & 0x04));
+    } else {
+      const uint8_t saved = entry;
+      entry = (value & 0x04) ? ENTRY_ID : 0;
+      step_address();
+      entry = saved;
+    }
+  } else if (value & 0x08) {
+    // Display on/off control has no effect on what is stored
+  } else if (value & 0x04) {
+    entry = value & 0x03;
+  } else if (value & 0x02) {
+    in_cgram = 0;
+    address = display_shift = 0;
+    ns = EXEC_CLEAR_NS;
+  } else if (value & 0x01) {
+    memset(ddram, ' ', sizeof(ddram));
+    in_cgram = 0;
+    address = display_shift = 0;
+    entry |= ENTRY_ID;
+    ns = EXEC_CLEAR_NS;
+  }
+
+  busy_until = now + exec_ns(ns);
+}
+
+// Takes up writes to FIOSET and FIOCLR since the last pin write
+void static update_latch(void) {
+  if (!port) {
+    return;
+  }
+
+  latch = (latch & ~port->FIOCLR) | port->FIOSET;
+  port->FIOSET = port->FIOCLR = 0;
+}
+
+// The controller drives the bus while E is high with RW high
+void static read_cycle(void) {
+  const uint32_t bus = (uint32_t) lines << shift;
+  uint8_t value;
+
+  if (levels[SIG_RS]) {
+    value = in_cgram ? cgram[address] : ddram[address];
+  } else {
+    ++stats.status_reads;
+    value = (now < busy_until ? BUSY_FLAG : 0) | address;
+  }
+
+  if (!eight_bits && nibble) {
+    value <<= 4;
+  }
+
+  if (port->FIODIR & bus) {
+    ++stats.contentions;
+  }
+  port->FIOPIN = (port->FIOPIN & ~bus) | (((uint32_t) value << shift) & bus);
+}
+
+// ...and latches it as E falls with RW low. In 4 bit mode, an
+// instruction or character is carried out once both halves are in.
+void static write_cycle(uint_fast8_t upper_half) {
+  const uint8_t value = (latch >> shift) & lines;
+
+  if (upper_half) {
+    upper = value & 0xF0;
+  } else {
+    execute(levels[SIG_RS], eight_bits ? value : upper | (value >> 4));
+  }
+}
+
+void static e_rising(void) {
+  if (now - e_rose < T_E_CYCLE_NS
+      || now - changed[SIG_RS] < T_SETUP_NS
+      || now - changed[SIG_RW] < T_SETUP_NS) {
+    ++stats.timing_violations;
+  }
+  e_rose = now;
+
+  if (levels[SIG_RW]) {
+    read_cycle();
+  }
+}
+
+void static e_falling(void) {
+  const uint_fast8_t upper_half = !eight_bits && !nibble;
+
+  if (now - e_rose < T_E_HIGH_NS) {
+    ++stats.timing_violations;
+  }
+
+  // Move on to the other half first, so that a function set changing
+  // the interface width starts it afresh
+  if (!eight_bits) {
+    nibble ^= 1;
+  }
+
+  if (!levels[SIG_RW]) {
+    write_cycle(upper_half);
+  } else if (levels[SIG_RS] && !upper_half) {
+    // A data read moves the address counter on, like a write
+    step_address();
+  }
+}
+
+void sim_pin_write(int signal, uint_fast8_t level) {
+  ++stats.pin_writes;
+  now += PIN_WRITE_NS;
+  update_latch();
+
+  if (signal == SIG_NONE) {
+    return;
+  }
+
+  level = !!level;
+  if (level == levels[signal]) {
+    return;
+  }
+  levels[signal] = level;
+  changed[signal] = now;
+
+  if (signal == SIG_E) {
+    if (level) {
+      e_rising();
+    } else {
+      e_falling();
+    }
+  }
+}
+
+uint_fast8_t sim_pin_read(int signal) {
+  return levels[signal];
+}
+
+void sim_delay_ns(uint64_t ns) {
+  update_latch();
+  stats.delay_ns += ns;
+  now += ns;
+}
+
+uint64_t sim_time_ns(void) {
+  return now;
+}
+
+void sim_line(uint8_t row, char *out) {
+  uint_fast8_t i;
+
+  for (i = 0; i < SIM_COLUMNS; ++i) {
+    uint8_t c;
+
+    if (function & FUNCTION_N) {
+      c = ddram[row * 0x40 + (display_shift + i) % LINE_LENGTH];
+    } else {
+      c = row ? ' ' : ddram[(display_shift + i) % (2 * LINE_LENGTH)];
+    }
+    out[i] = (c < ' ' || c > '~') ? '?' : c;
+  }
+  out[i] = '\0';
+}
+
+void sim_stats(SimStats *out) {
+  *out = stats;
+  out->elapsed_ns = now - stats_start;
+}
+
+void sim_stats_reset(void) {
+  memset(&stats, 0, sizeof(stats));
+  stats_start = now;
+}
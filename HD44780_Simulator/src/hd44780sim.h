@@ -0,0 +1,80 @@
+/* hd44780sim.h
+ *
+ * Declares a simulated HD44780 character LCD, wired up as in
+ * HD44780_Example: RS, RW and E (LCD_CLK) on their own pins and the
+ * data bus on a GPIO port. The simulator is driven through the pin
+ * functions made by DEFINE_PIN, and keeps its own clock, which the
+ * driver's delays (see host.c) and pin writes move on.
+ *
+ * The controller models the 8 and 4 bit interfaces, the busy flag and
+ * address counter, the execution time of each instruction (scaled to
+ * the oscillator frequency), DDRAM, CGRAM, the entry mode and display
+ * shift. It counts instructions sent while the busy flag was set,
+ * which the real controller would ignore, and E pulses which break
+ * the datasheet's bus timings.
+ */
+
+#ifndef __HD44780SIM_h_
+#define __HD44780SIM_h_
+
+#include <stdint.h>
+
+#include "LPC17xx.h"
+
+/* The nominal oscillator frequency the datasheet's execution times
+ * are given for
+ */
+#define SIM_FOSC_HZ 270000
+
+#define SIM_COLUMNS 16
+#define SIM_ROWS 2
+
+typedef struct {
+  uint64_t instructions;      /* instructions carried out */
+  uint64_t data_writes;       /* characters written to DDRAM or CGRAM */
+  uint64_t status_reads;      /* reads of the busy flag */
+  uint64_t busy_writes;       /* writes ignored as the controller was busy */
+  uint64_t timing_violations; /* E pulses too short or too close together */
+  uint64_t contentions;       /* reads with the LPC still driving the bus */
+  uint64_t pin_writes;        /* all pin writes, as a measure of CPU cost */
+  uint64_t delay_ns;          /* time spent in sleep_delay_* */
+  uint64_t elapsed_ns;        /* simulated time */
+} SimStats;
+
+/* sim_reset(fosc_hz)
+ * Powers the controller up (as 8 bits wide, and busy for its internal
+ * reset), running from an oscillator of fosc_hz.
+ */
+void sim_reset(uint32_t fosc_hz);
+
+/* sim_bus(port, shift, lines)
+ * Connects D0-D7 to port's pins shift to shift + 7, or only the lines
+ * set in lines (e.g. 0xF0 for D4-D7); others read as 0.
+ */
+void sim_bus(LPC_GPIO_TypeDef *port, uint8_t shift, uint8_t lines);
+
+/* sim_signal(name)
+ * Returns the signal for a pin name from pins.h (e.g. "LCD_RS"), or
+ * an unconnected signal for pins which aren't the display's.
+ */
+int sim_signal(const char *name);
+
+void sim_pin_write(int signal, uint_fast8_t level);
+uint_fast8_t sim_pin_read(int signal);
+
+/* sim_delay_ns(ns), sim_time_ns()
+ * Account for a delay asked for by the driver, and read the clock.
+ */
+void sim_delay_ns(uint64_t ns);
+uint64_t sim_time_ns(void);
+
+/* sim_line(row, out)
+ * Copies the SIM_COLUMNS characters shown on row into out, followed by
+ * a '\0'.
+ */
+void sim_line(uint8_t row, char *out);
+
+void sim_stats(SimStats *stats);
+void sim_stats_reset(void);
+
+#endif
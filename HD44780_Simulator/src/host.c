@@ -0,0 +1,107 @@
+/* Host stand-ins for the parts of the UMDLPC library used by the
+ * simulated driver. Delays return at once, and only move the
+ * simulator's clock on; the cycle counter is read from that clock,
+ * and each read of it takes a bus access.
+ */
+
+#include "LPC17xx.h"
+#include "UMDLPC/system/sleep.h"
+#include "UMDLPC/system/delay.h"
+#include "hd44780sim.h"
+#include "host.h"
+
+// The clock HD44780_Example runs at
+uint32_t SystemCoreClock = 100000000;
+
+// CPU time taken by each read of the cycle counter
+#define COUNTER_READ_NS 10
+
+LPC_GPIO_TypeDef host_gpio1;
+LPC_SC_TypeDef host_sc;
+LPC_TIM_TypeDef host_tim0;
+
+static uint_fast8_t timer0_enabled;
+uint64_t host_idle_ns;
+
+void TIMER0_IRQHandler(void);
+
+void NVIC_EnableIRQ(IRQn_Type irq) {
+  if (irq == TIMER0_IRQn) {
+    timer0_enabled = 1;
+  }
+}
+
+void NVIC_DisableIRQ(IRQn_Type irq) {
+  if (irq == TIMER0_IRQn) {
+    timer0_enabled = 0;
+  }
+}
+
+void sleep_init(void) {
+}
+
+void sleep_delay_cycles(uint32_t cycles) {
+  sim_delay_ns((uint64_t) cycles * 1000 / (SystemCoreClock / 1000000));
+}
+
+void sleep_delay_us(uint32_t us) {
+  sim_delay_ns((uint64_t) us * 1000);
+}
+
+void sleep_delay_ms(uint32_t ms) {
+  sim_delay_ns((uint64_t) ms * 1000000);
+}
+
+void delay_init(void) {
+}
+
+uint32_t delay_counter(void) {
+  sim_delay_ns(COUNTER_READ_NS);
+  return (uint32_t) (sim_time_ns() * (SystemCoreClock / 1000000) / 1000);
+}
+
+void delay_cycles(uint32_t cycles) {
+  const uint32_t start = delay_counter();
+
+  while (delay_counter() - start < cycles)
+    ;
+}
+
+uint32_t delay_ns_to_cycles(uint32_t ns) {
+  const uint32_t mhz = (SystemCoreClock + 999999) / 1000000;
+
+  return (ns * mhz + 999) / 1000;
+}
+
+// TIMER0 is taken to count microseconds (PR), and to match and restart
+// on MR0, as the driver sets it up. It keeps counting while its
+// interrupt is handled, and starts counting when time next passes.
+void host_run_us(uint32_t us) {
+  const uint64_t end = sim_time_ns() + (uint64_t) us * 1000;
+  static uint64_t due;
+
+  for (;;) {
+    if (host_tim0.TCR != 1 || !timer0_enabled) {
+      due = 0;
+    } else if (!due) {
+      due = sim_time_ns() + ((uint64_t) host_tim0.MR0 + 1) * 1000;
+    }
+
+    if (!due || due > end) {
+      break;
+    }
+
+    if (due > sim_time_ns()) {
+      host_idle_ns += due - sim_time_ns();
+      sim_delay_ns(due - sim_time_ns());
+    }
+    due += ((uint64_t) host_tim0.MR0 + 1) * 1000;
+
+    TIMER0_IRQHandler();
+  }
+
+  if (end > sim_time_ns()) {
+    host_idle_ns += end - sim_time_ns();
+    sim_delay_ns(end - sim_time_ns());
+  }
+}
@@ -0,0 +1,22 @@
+/* host.h
+ *
+ * Declares the host side of the stand-ins in host.c.
+ */
+
+#ifndef __HOST_h_
+#define __HOST_h_
+
+#include <stdint.h>
+
+/* host_run_us(us)
+ * Lets us of simulated time pass, taking TIMER0's interrupts as they
+ * come due while it runs and is enabled in the NVIC.
+ */
+void host_run_us(uint32_t us);
+
+/* Simulated time spent in host_run_us outside of interrupt handlers,
+ * when the CPU would be free for the application
+ */
+extern uint64_t host_idle_ns;
+
+#endif
@@ -0,0 +1,55 @@
+/* LPC17xx.h
+ *
+ * Stands in for the CMSIS device header in host builds. Only what the
+ * simulated driver refers to is declared. The data bus port is plain
+ * memory, which the simulator reads and writes around each pin write:
+ * FIOSET and FIOCLR are taken up (and cleared) then, and FIOPIN holds
+ * what the display drives onto the bus during a read. TIMER0 is run
+ * by host_run_us (see host.h).
+ */
+
+#ifndef __LPC17xx_H__
+#define __LPC17xx_H__
+
+#include <stdint.h>
+
+extern uint32_t SystemCoreClock;
+
+typedef struct {
+  volatile uint32_t FIODIR;
+  volatile uint32_t FIOMASK;
+  volatile uint32_t FIOPIN;
+  volatile uint32_t FIOSET;
+  volatile uint32_t FIOCLR;
+} LPC_GPIO_TypeDef;
+
+typedef struct {
+  volatile uint32_t PCONP;
+  volatile uint32_t PCLKSEL0;
+} LPC_SC_TypeDef;
+
+typedef struct {
+  volatile uint32_t IR;
+  volatile uint32_t TCR;
+  volatile uint32_t TC;
+  volatile uint32_t PR;
+  volatile uint32_t PC;
+  volatile uint32_t MCR;
+  volatile uint32_t MR0;
+} LPC_TIM_TypeDef;
+
+typedef enum {
+  TIMER0_IRQn = 1
+} IRQn_Type;
+
+extern LPC_GPIO_TypeDef host_gpio1;
+extern LPC_SC_TypeDef host_sc;
+extern LPC_TIM_TypeDef host_tim0;
+#define LPC_GPIO1 (&host_gpio1)
+#define LPC_SC (&host_sc)
+#define LPC_TIM0 (&host_tim0)
+
+void NVIC_EnableIRQ(IRQn_Type irq);
+void NVIC_DisableIRQ(IRQn_Type irq);
+
+#endif
@@ -0,0 +1,182 @@
+/*
+ ===============================================================================
+ Name        : main.c
+ Description :
+
+   Runs the HD44780 driver against the simulated display, through a
+   set of typical scenes, and reports the bus traffic and simulated
+   time each one took, with the characters per second it reached and
+   the CPU time spent in the driver (including its interrupts).
+
+   The status scenes update a two line display 100 times, 10ms apart,
+   once by writing straight to the display and once through the
+   shadow buffer.
+
+   Usage: hd44780sim [oscillator Hz]
+
+   The oscillator defaults to the datasheet's nominal 270kHz; slower
+   controllers take longer over each instruction, which the driver has
+   to wait out.
+
+ ===============================================================================
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "hd44780.h"
+#include "hd44780sim.h"
+#include "host.h"
+
+static const char TEXT[] = "The quick brown fox jumps over the lazy dog. ";
+
+void static scene_init(void) {
+  LCD_init();
+}
+
+void static scene_screen(void) {
+  uint_fast8_t x, y;
+
+  for (y = 0; y < SIM_ROWS; ++y) {
+    LCD_move_cursor(0, y);
+    for (x = 0; x < SIM_COLUMNS; ++x) {
+      LCD_write(TEXT[y * SIM_COLUMNS + x]);
+    }
+  }
+}
+
+void static scene_clear(void) {
+  LCD_clear();
+  LCD_cursor_home();
+}
+
+void static scene_stream(void) {
+  uint16_t i;
+
+  for (i = 0; i < 1024; ++i) {
+    if (!(i % SIM_COLUMNS)) {
+      LCD_move_cursor(0, (i / SIM_COLUMNS) % SIM_ROWS);
+    }
+    LCD_write(TEXT[i % (sizeof(TEXT) - 1)]);
+  }
+}
+
+// Time between status updates
+#define FRAME_US 10000
+
+void static status_line(char *line, uint16_t frame) {
+  snprintf(line, SIM_COLUMNS + 1, "Samples %8u", frame * 441u);
+}
+
+void static scene_status(void) {
+  char line[SIM_COLUMNS + 1];
+  uint16_t frame;
+  uint_fast8_t x;
+
+  for (frame = 0; frame < 100; ++frame) {
+    status_line(line, frame);
+    LCD_move_cursor(0, 0);
+    for (x = 0; x < SIM_COLUMNS; ++x) {
+      LCD_write(line[x]);
+    }
+    LCD_move_cursor(0, 1);
+    for (x = 0; x < SIM_COLUMNS; ++x) {
+      LCD_write(TEXT[x]);
+    }
+    host_run_us(FRAME_US);
+  }
+}
+
+void static scene_buffer_init(void) {
+  LCD_buffer_init();
+}
+
+void static scene_buffer_status(void) {
+  char line[SIM_COLUMNS + 1];
+  uint16_t frame;
+
+  for (frame = 0; frame < 100; ++frame) {
+    status_line(line, frame);
+    LCD_buffer_string(0, 0, line);
+    LCD_buffer_string(0, 1, TEXT);
+    host_run_us(FRAME_US);
+  }
+}
+
+// How long a whole new screen takes to be shown
+void static scene_buffer_screen(void) {
+  LCD_buffer_string(0, 0, TEXT + SIM_COLUMNS);
+  LCD_buffer_string(0, 1, TEXT + 2 * SIM_COLUMNS);
+  while (!LCD_buffer_idle()) {
+    host_run_us(10);
+  }
+}
+
+typedef struct {
+  const char *name;
+  void (*run)(void);
+} Scene;
+
+static const Scene SCENES[] = {
+  { "init", scene_init },
+  { "screen", scene_screen },
+  { "clear", scene_clear },
+  { "stream", scene_stream },
+  { "status", scene_status },
+  { "buf_init", scene_buffer_init },
+  { "buf_stat", scene_buffer_status },
+  { "buf_scrn", scene_buffer_screen },
+};
+
+int main(int argc, char **argv) {
+  const uint32_t fosc = (argc > 1) ? strtoul(argv[1], 0, 10) : SIM_FOSC_HZ;
+  char line[SIM_COLUMNS + 1];
+  SimStats stats;
+  unsigned i;
+
+  if (!fosc) {
+    fprintf(stderr, "Usage: %s [oscillator Hz]\n", argv[0]);
+    return 1;
+  }
+
+  sim_bus(LCD_DATA_PORT, LCD_DATA_SHIFT,
+          (LCD_BUS_WIDTH == BUS_WIDTH_4) ? 0xF0 : 0xFF);
+  sim_reset(fosc);
+
+  printf("%-8s %6s %6s %7s %6s %7s %10s %10s %8s %8s\n", "scene",
+         "instrs", "data", "polls", "busy", "timing", "pin_writes",
+         "time_us", "cpu_us", "chars/s");
+
+  for (i = 0; i < sizeof(SCENES) / sizeof(SCENES[0]); ++i) {
+    sim_stats_reset();
+    host_idle_ns = 0;
+    SCENES[i].run();
+    sim_stats(&stats);
+
+    printf("%-8s %6llu %6llu %7llu %6llu %7llu %10llu %10llu %8llu %8llu\n",
+           SCENES[i].name,
+           (unsigned long long) stats.instructions,
+           (unsigned long long) stats.data_writes,
+           (unsigned long long) stats.status_reads,
+           (unsigned long long) stats.busy_writes,
+           (unsigned long long) stats.timing_violations,
+           (unsigned long long) stats.pin_writes,
+           (unsigned long long) stats.elapsed_ns / 1000,
+           (unsigned long long) (stats.elapsed_ns - host_idle_ns) / 1000,
+           (unsigned long long) (stats.elapsed_ns
+                                 ? stats.data_writes * 1000000000
+                                   / stats.elapsed_ns : 0));
+
+    if (stats.contentions) {
+      fprintf(stderr, "%s: %llu reads with the bus still driven\n",
+              SCENES[i].name, (unsigned long long) stats.contentions);
+    }
+  }
+
+  for (i = 0; i < SIM_ROWS; ++i) {
+    sim_line(i, line);
+    printf("|%s|\n", line);
+  }
+
+  return 0;
+}
@@ -0,0 +1,27 @@
+/* clocking.h
+ *
+ * Host version of UMDLPC/system/clocking.h, shared by the host
+ * projects: only the clock change handlers, which the drivers register,
+ * and host_clock_switch calls (see Host/src/clocking.c). A project
+ * which never calls it leaves the simulated clock as it starts.
+ */
+
+#ifndef __UMDLPC_system_clocking_h_
+#define __UMDLPC_system_clocking_h_
+
+#include <stdint.h>
+
+/* The handlers clock_on_change holds */
+#define CLOCK_HANDLERS_MAX 8
+
+typedef void (*ClockChangeHandler)(uint32_t cclk_hz);
+
+uint_fast8_t clock_on_change(ClockChangeHandler handler);
+
+/* host_clock_switch(cclk_hz)
+ * Switches the CPU clock, calling the clock change handlers with
+ * interrupts masked, as clock_set_divider does.
+ */
+void host_clock_switch(uint32_t cclk_hz);
+
+#endif
@@ -0,0 +1,22 @@
+/* delay.h
+ *
+ * Host version of UMDLPC/system/delay.h, shared by the host projects.
+ * Each project's host.c defines the delays its drivers use, to suit
+ * its simulator: some move the simulated time on, and let the
+ * simulated bus follow the pins meanwhile, while others return at once
+ * where bus timings aren't modelled.
+ */
+
+#ifndef __UMDLPC_system_delay_h_
+#define __UMDLPC_system_delay_h_
+
+#include "LPC17xx.h"
+#include <stdint.h>
+
+void delay_init(void);
+uint32_t delay_counter(void);
+void delay_cycles(uint32_t cycles);
+uint32_t delay_ns_to_cycles(uint32_t ns);
+void delay_us(uint32_t us);
+
+#endif
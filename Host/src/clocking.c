@@ -0,0 +1,38 @@
+/* Host stand-in for the clock change handlers of UMDLPC's clocking.c,
+ * which the drivers register when they start, and host_clock_switch
+ * calls in the order registered.
+ */
+
+#include "LPC17xx.h"
+#include "UMDLPC/system/clocking.h"
+
+static ClockChangeHandler clock_handlers[CLOCK_HANDLERS_MAX];
+static uint_fast8_t clock_handler_count;
+
+uint_fast8_t clock_on_change(ClockChangeHandler handler) {
+  uint_fast8_t i;
+
+  for (i = 0; i < clock_handler_count; ++i) {
+    if (clock_handlers[i] == handler) {
+      return 1;
+    }
+  }
+  if (clock_handler_count == CLOCK_HANDLERS_MAX) {
+    return 0;
+  }
+
+  clock_handlers[clock_handler_count++] = handler;
+  return 1;
+}
+
+void host_clock_switch(uint32_t cclk_hz) {
+  const uint32_t mask = __get_PRIMASK();
+  uint_fast8_t i;
+
+  __disable_irq();
+  SystemCoreClock = cclk_hz;
+  for (i = 0; i < clock_handler_count; ++i) {
+    clock_handlers[i](cclk_hz);
+  }
+  __set_PRIMASK(mask);
+}
@@ -0,0 +1,24 @@
+/* Host stand-in for interrupt masking, for the host projects whose
+ * simulators only move on when the driver waits, so that nothing can
+ * interrupt it: the mask is only kept, for __get_PRIMASK.
+ */
+
+#include "LPC17xx.h"
+
+static uint32_t primask;
+
+uint32_t __get_PRIMASK(void) {
+  return primask;
+}
+
+void __set_PRIMASK(uint32_t value) {
+  primask = value;
+}
+
+void __disable_irq(void) {
+  primask = 1;
+}
+
+void __enable_irq(void) {
+  primask = 0;
+}
@@ -0,0 +1,104 @@
+/* Host stand-ins for the parts of the Cortex-M3 and UMDLPC library
+ * used by the I2C driver. Nothing runs behind the driver's back: the
+ * simulator only moves on when stepped, which sleep_wfi does, and
+ * interrupts are taken as the mask is lifted, or after a step.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "LPC17xx.h"
+#include "UMDLPC/system/delay.h"
+#include "UMDLPC/system/sleep.h"
+#include "i2csim.h"
+#include "host.h"
+
+uint32_t SystemCoreClock = 100000000;
+
+uint32_t host_nvic_enabled;
+
+static uint32_t primask;
+static uint_fast8_t in_irq;
+
+void I2C0_IRQHandler(void);
+void I2C1_IRQHandler(void);
+void I2C2_IRQHandler(void);
+
+static void (* const handlers[3])(void) = {
+  I2C0_IRQHandler, I2C1_IRQHandler, I2C2_IRQHandler
+};
+
+void host_dispatch(void) {
+  uint_fast8_t i;
+
+  if (primask || in_irq) {
+    return;
+  }
+
+  for (i = 0; i < 3; ++i) {
+    if ((host_nvic_enabled & (1 << i)) && sim_irq_pending(i)) {
+      in_irq = 1;
+      ++sim_stats(i)->irqs;
+      handlers[i]();
+      in_irq = 0;
+
+      sim_apply();
+      if (sim_irq_pending(i)) {
+        printf("I2C%u: the handler left SI set in state %02x\n", i,
+               sim_i2c[i].I2STAT);
+        exit(1);
+      }
+    }
+  }
+}
+
+uint32_t __get_PRIMASK(void) {
+  return primask;
+}
+
+void __set_PRIMASK(uint32_t value) {
+  if (value) {
+    __disable_irq();
+  } else {
+    __enable_irq();
+  }
+}
+
+void __disable_irq(void) {
+  primask = 1;
+}
+
+void __enable_irq(void) {
+  primask = 0;
+  sim_apply();
+  host_dispatch();
+}
+
+void NVIC_EnableIRQ(IRQn_Type irq) {
+  host_nvic_enabled |= 1 << (irq - I2C0_IRQn);
+  sim_apply();
+}
+
+// Called with interrupts masked, like WFI with PRIMASK set: steps the
+// simulator until an interrupt is pending, or for SIM_WFI_STEPS
+void sleep_wfi(void) {
+  uint_fast16_t steps;
+  uint_fast8_t i;
+
+  for (steps = 0; steps < SIM_WFI_STEPS; ++steps) {
+    sim_step();
+    for (i = 0; i < 3; ++i) {
+      if ((host_nvic_enabled & (1 << i)) && sim_irq_pending(i)) {
+        return;
+      }
+    }
+  }
+}
+
+void delay_init(void) {
+}
+
+void delay_us(uint32_t us) {
+  sim_advance_ns(us * 1000ULL);
+  sim_apply();
+}
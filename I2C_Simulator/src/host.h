@@ -0,0 +1,23 @@
+/* host.h
+ *
+ * Declares the host side of the stand-ins in host.c. Interrupts are
+ * the I2C handlers, called by host_dispatch whenever the simulator (see
+ * i2csim.h) has SI set on a port and interrupts aren't masked, as the
+ * NVIC would take them.
+ */
+
+#ifndef __HOST_h_
+#define __HOST_h_
+
+#include <stdint.h>
+
+/* host_dispatch()
+ * Calls the handler of each port with its interrupt pending and
+ * enabled, unless interrupts are masked or a handler is running.
+ */
+void host_dispatch(void);
+
+/* The interrupts enabled in the NVIC, a bit per I2C port */
+extern uint32_t host_nvic_enabled;
+
+#endif
@@ -0,0 +1,59 @@
+/* LPC17xx.h
+ *
+ * Stands in for the CMSIS device header in host builds. Only what the
+ * I2C driver refers to is declared, with its registers in plain memory
+ * which the simulator (see i2csim.h) watches and updates. I2CONSET and
+ * I2CONCLR, and FIOSET and FIOCLR, hold what was last written to them
+ * until the simulator takes it, as the driver never reads them.
+ */
+
+#ifndef __LPC17xx_H__
+#define __LPC17xx_H__
+
+#include <stdint.h>
+
+extern uint32_t SystemCoreClock;
+
+typedef enum {
+  I2C0_IRQn = 10,
+  I2C1_IRQn = 11,
+  I2C2_IRQn = 12
+} IRQn_Type;
+
+typedef struct {
+  volatile uint32_t I2CONSET, I2STAT, I2DAT, I2ADR0, I2SCLH, I2SCLL;
+  volatile uint32_t I2CONCLR;
+} LPC_I2C_TypeDef;
+
+typedef struct {
+  volatile uint32_t PCONP, PCLKSEL0, PCLKSEL1;
+} LPC_SC_TypeDef;
+
+typedef struct {
+  volatile uint32_t PINSEL0, PINSEL1, PINMODE0, PINMODE1, PINMODE_OD0;
+} LPC_PINCON_TypeDef;
+
+typedef struct {
+  volatile uint32_t FIODIR, FIOPIN, FIOSET, FIOCLR;
+} LPC_GPIO_TypeDef;
+
+extern LPC_I2C_TypeDef sim_i2c[3];
+extern LPC_SC_TypeDef sim_sc;
+extern LPC_PINCON_TypeDef sim_pincon;
+extern LPC_GPIO_TypeDef sim_gpio0;
+
+#define LPC_I2C0 (&sim_i2c[0])
+#define LPC_I2C1 (&sim_i2c[1])
+#define LPC_I2C2 (&sim_i2c[2])
+#define LPC_SC (&sim_sc)
+#define LPC_PINCON (&sim_pincon)
+#define LPC_GPIO0 (&sim_gpio0)
+
+void NVIC_EnableIRQ(IRQn_Type irq);
+
+uint32_t __get_PRIMASK(void);
+void __set_PRIMASK(uint32_t primask);
+void __disable_irq(void);
+void __enable_irq(void);
+
+#endif
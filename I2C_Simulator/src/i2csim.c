@@ -0,0 +1,463 @@
+#include <string.h>
+
+#include "i2csim.h"
+#include "host.h"
+
+#define PORTS 3
+#define SLAVES_MAX 8
+
+#define CON_AA (1 << 2)
+#define CON_SI (1 << 3)
+#define CON_STO (1 << 4)
+#define CON_STA (1 << 5)
+#define CON_I2EN (1 << 6)
+
+#define STAT_IDLE 0xF8
+
+// Bits on the bus for a start or stop, and for a byte and its
+// acknowledge
+#define CONDITION_BITS 1
+#define BYTE_BITS 9
+
+LPC_I2C_TypeDef sim_i2c[PORTS];
+LPC_SC_TypeDef sim_sc;
+LPC_PINCON_TypeDef sim_pincon;
+LPC_GPIO_TypeDef sim_gpio0;
+
+const uint8_t sim_states[SIM_STATES] = {
+  0x00, 0x08, 0x10, 0x18, 0x20, 0x28, 0x30, 0x38, 0x40, 0x48, 0x50, 0x58,
+  STAT_IDLE
+};
+
+typedef struct {
+  uint8_t sda, scl;              // pins on port 0
+  volatile uint32_t *pinsel;
+} Pins;
+
+static const Pins pins[PORTS] = {
+  { 27, 28, &sim_pincon.PINSEL1 },
+  { 19, 20, &sim_pincon.PINSEL1 },
+  { 10, 11, &sim_pincon.PINSEL0 }
+};
+
+typedef struct {
+  uint32_t con;                  // I2CON
+  uint8_t master;                // holding the bus
+  uint8_t byte;                  // of the attempt at a transfer
+  SimSlave *slave;               // addressed
+  SimSlave *slaves[SLAVES_MAX];
+  uint8_t slave_count;
+
+  enum SimFault fault;
+  uint8_t fault_byte, fault_times, fault_hold;
+  uint8_t stuck;                 // SCL pulses until SDA is let go
+  uint8_t other_master;          // steps until it lets the bus go
+
+  uint8_t sda_high, scl_high;
+  SimStats stats;
+} Port;
+
+static Port ports[PORTS];
+static uint32_t gpio_latch;
+static uint32_t transitions[SIM_STATES][SIM_STATES];
+static uint64_t sim_ns;
+
+int_fast8_t static state_index(uint8_t stat) {
+  uint_fast8_t i;
+
+  for (i = 0; i < SIM_STATES; ++i) {
+    if (sim_states[i] == stat) {
+      return i;
+    }
+  }
+  return -1;
+}
+
+// Shows stat in I2STAT, counting the transition, with SI set for any
+// state but idle
+void static show(uint_fast8_t i, uint8_t stat) {
+  const int_fast8_t from = state_index(sim_i2c[i].I2STAT);
+  const int_fast8_t to = state_index(stat);
+
+  if (from >= 0 && to >= 0 && !(stat == STAT_IDLE && from == to)) {
+    ++transitions[from][to];
+  }
+  sim_i2c[i].I2STAT = stat;
+  if (stat != STAT_IDLE) {
+    ports[i].con |= CON_SI;
+  }
+}
+
+void static bus_time(uint_fast8_t i, uint32_t bits) {
+  const uint64_t cycles = sim_i2c[i].I2SCLH + sim_i2c[i].I2SCLL;
+  const uint64_t ns = bits * cycles * 1000000000ULL / SystemCoreClock;
+
+  ports[i].stats.bus_ns += ns;
+  sim_ns += ns;
+}
+
+// The slaves forget about any transfer, as on a stop
+void static release_slaves(Port *p) {
+  uint_fast8_t i;
+
+  for (i = 0; i < p->slave_count; ++i) {
+    p->slaves[i]->addressed = 0;
+  }
+  p->slave = 0;
+  p->master = 0;
+}
+
+uint_fast8_t static bus_busy(const Port *p) {
+  return p->stuck || p->other_master;
+}
+
+// The fault due at this byte, if any, used up as it happens
+enum SimFault static fault_now(Port *p) {
+  const enum SimFault fault = p->fault;
+
+  if (fault == SIM_FAULT_NONE || p->byte != p->fault_byte) {
+    return SIM_FAULT_NONE;
+  }
+  if (!--p->fault_times) {
+    p->fault = SIM_FAULT_NONE;
+  }
+  return fault;
+}
+
+void static start(uint_fast8_t i) {
+  Port * const p = &ports[i];
+
+  bus_time(i, CONDITION_BITS);
+  ++p->stats.starts;
+  p->master = 1;
+  p->byte = 0;
+  show(i, 0x08);
+}
+
+void static lose_arbitration(uint_fast8_t i) {
+  Port * const p = &ports[i];
+
+  release_slaves(p);
+  p->other_master = SIM_OTHER_MASTER_STEPS;
+  show(i, 0x38);
+}
+
+void static bus_error(uint_fast8_t i) {
+  Port * const p = &ports[i];
+
+  release_slaves(p);
+  p->stuck = p->fault_hold;
+  show(i, 0x00);
+}
+
+SimSlave static *find_slave(Port *p, uint8_t address) {
+  uint_fast8_t i;
+
+  for (i = 0; i < p->slave_count; ++i) {
+    if (p->slaves[i]->address == address) {
+      return p->slaves[i];
+    }
+  }
+  return 0;
+}
+
+void static send_address(uint_fast8_t i) {
+  Port * const p = &ports[i];
+  const uint8_t byte = sim_i2c[i].I2DAT;
+  const enum SimFault fault = fault_now(p);
+  const uint8_t reading = byte & 1;
+  SimSlave * const slave = find_slave(p, byte >> 1);
+
+  bus_time(i, BYTE_BITS);
+  ++p->stats.bytes_sent;
+  ++p->byte;
+
+  if (fault == SIM_FAULT_ARBITRATION) {
+    lose_arbitration(i);
+    return;
+  }
+  if (fault == SIM_FAULT_BUS_ERROR) {
+    bus_error(i);
+    return;
+  }
+
+  if (slave && !(reading && slave->write_only) && fault != SIM_FAULT_NACK) {
+    slave->addressed = 1;
+    slave->reading = reading;
+    slave->written = 0;
+    p->slave = slave;
+    show(i, reading ? 0x40 : 0x18);
+  } else {
+    p->slave = 0;
+    show(i, reading ? 0x48 : 0x20);
+  }
+}
+
+void static send_data(uint_fast8_t i) {
+  Port * const p = &ports[i];
+  const uint8_t byte = sim_i2c[i].I2DAT;
+  const enum SimFault fault = fault_now(p);
+  SimSlave * const slave = p->slave;
+
+  bus_time(i, BYTE_BITS);
+  ++p->stats.bytes_sent;
+  ++p->byte;
+
+  if (fault == SIM_FAULT_ARBITRATION) {
+    lose_arbitration(i);
+    return;
+  }
+  if (fault == SIM_FAULT_BUS_ERROR) {
+    bus_error(i);
+    return;
+  }
+
+  if (slave && (!slave->accept || slave->written < slave->accept)
+      && fault != SIM_FAULT_NACK) {
+    if (slave->written++) {
+      slave->memory[slave->pointer++] = byte;
+    } else {
+      slave->pointer = byte;
+    }
+    show(i, 0x28);
+  } else {
+    show(i, 0x30);
+  }
+}
+
+void static receive(uint_fast8_t i) {
+  Port * const p = &ports[i];
+  SimSlave * const slave = p->slave;
+  const enum SimFault fault = fault_now(p);
+
+  bus_time(i, BYTE_BITS);
+  ++p->byte;
+  if (fault == SIM_FAULT_BUS_ERROR) {
+    bus_error(i);
+    return;
+  }
+
+  ++p->stats.bytes_received;
+  sim_i2c[i].I2DAT = slave ? slave->memory[slave->pointer++] : 0xFF;
+  show(i, (p->con & CON_AA) ? 0x50 : 0x58);
+}
+
+// Carries out what the controller was told to, once SI is cleared
+void static step(uint_fast8_t i) {
+  Port * const p = &ports[i];
+  const uint8_t stat = sim_i2c[i].I2STAT;
+
+  if (p->other_master) {
+    --p->other_master;
+  }
+  if (!(p->con & CON_I2EN) || (p->con & CON_SI)) {
+    return;
+  }
+
+  if (!p->master) {
+    if (stat == 0x00) {
+      // Only a stop, or turning the controller off, gets out of here
+      if (p->con & CON_STO) {
+        p->con &= ~CON_STO;
+        show(i, STAT_IDLE);
+      }
+      return;
+    }
+
+    p->con &= ~CON_STO;
+    if (p->con & CON_STA) {
+      if (bus_busy(p)) {
+        ++p->stats.busy_steps;
+      } else {
+        start(i);
+      }
+    } else if (stat != STAT_IDLE) {
+      show(i, STAT_IDLE);
+    }
+    return;
+  }
+
+  if (p->con & CON_STO) {
+    p->con &= ~CON_STO;
+    bus_time(i, CONDITION_BITS);
+    ++p->stats.stops;
+    release_slaves(p);
+    if ((p->con & CON_STA) && !bus_busy(p)) {
+      start(i);
+    } else {
+      show(i, STAT_IDLE);
+    }
+    return;
+  }
+
+  if (p->con & CON_STA) {
+    bus_time(i, CONDITION_BITS);
+    ++p->stats.restarts;
+    if (p->slave) {
+      p->slave->addressed = 0;
+      p->slave = 0;
+    }
+    show(i, 0x10);
+    return;
+  }
+
+  switch (stat) {
+    case 0x08:
+    case 0x10:
+      send_address(i);
+      break;
+
+    case 0x18:
+    case 0x28:
+      send_data(i);
+      break;
+
+    case 0x40:
+    case 0x50:
+      receive(i);
+      break;
+
+    default:
+      // After a not acknowledge, only a stop or a start goes on
+      ++p->stats.hangs;
+      break;
+  }
+}
+
+// The pins' levels, with edges made by GPIO seen by the slaves
+void static wires(uint_fast8_t i) {
+  Port * const p = &ports[i];
+  const Pins * const pin = &pins[i];
+  const uint32_t sda = 1 << pin->sda, scl = 1 << pin->scl;
+  const uint_fast8_t sda_gpio = !((*pin->pinsel >> (pin->sda % 16) * 2) & 3);
+  const uint_fast8_t scl_gpio = !((*pin->pinsel >> (pin->scl % 16) * 2) & 3);
+  const uint32_t driven_low = sim_gpio0.FIODIR & ~gpio_latch;
+  uint_fast8_t sda_high, scl_high;
+
+  scl_high = !(scl_gpio && (driven_low & scl));
+  if (scl_gpio && scl_high && !p->scl_high) {
+    ++p->stats.pulses;
+    if (p->stuck) {
+      --p->stuck;
+    }
+  }
+  sda_high = !(sda_gpio && (driven_low & sda)) && !p->stuck;
+  if (sda_gpio && scl_high && p->scl_high && sda_high && !p->sda_high) {
+    ++p->stats.gpio_stops;
+    release_slaves(p);
+  }
+
+  p->sda_high = sda_high;
+  p->scl_high = scl_high;
+  sim_gpio0.FIOPIN = (sim_gpio0.FIOPIN & ~(sda | scl))
+                     | (sda_high ? sda : 0) | (scl_high ? scl : 0);
+}
+
+void sim_apply(void) {
+  uint_fast8_t i;
+
+  for (i = 0; i < PORTS; ++i) {
+    Port * const p = &ports[i];
+    const uint_fast8_t enabled = (p->con & CON_I2EN) != 0;
+
+    p->con |= sim_i2c[i].I2CONSET;
+    p->con &= ~sim_i2c[i].I2CONCLR;
+    sim_i2c[i].I2CONSET = sim_i2c[i].I2CONCLR = 0;
+
+    // Turning the controller off resets it, whatever it was doing
+    if (enabled && !(p->con & CON_I2EN)) {
+      p->con = 0;
+      p->master = 0;
+      p->slave = 0;
+      show(i, STAT_IDLE);
+    }
+  }
+
+  gpio_latch |= sim_gpio0.FIOSET;
+  gpio_latch &= ~sim_gpio0.FIOCLR;
+  sim_gpio0.FIOSET = sim_gpio0.FIOCLR = 0;
+  for (i = 0; i < PORTS; ++i) {
+    wires(i);
+  }
+}
+
+void sim_step(void) {
+  uint_fast8_t i;
+
+  sim_apply();
+  for (i = 0; i < PORTS; ++i) {
+    step(i);
+  }
+  host_dispatch();
+}
+
+uint_fast8_t sim_irq_pending(uint8_t port) {
+  return (ports[port].con & (CON_I2EN | CON_SI)) == (CON_I2EN | CON_SI);
+}
+
+void sim_reset(void) {
+  uint_fast8_t i;
+
+  memset(sim_i2c, 0, sizeof sim_i2c);
+  memset(&sim_sc, 0, sizeof sim_sc);
+  memset(&sim_pincon, 0, sizeof sim_pincon);
+  memset(&sim_gpio0, 0, sizeof sim_gpio0);
+  memset(ports, 0, sizeof ports);
+  memset(transitions, 0, sizeof transitions);
+  gpio_latch = 0;
+
+  for (i = 0; i < PORTS; ++i) {
+    sim_i2c[i].I2STAT = STAT_IDLE;
+    sim_i2c[i].I2SCLH = sim_i2c[i].I2SCLL = 4;
+    ports[i].sda_high = ports[i].scl_high = 1;
+    wires(i);
+  }
+}
+
+void sim_attach(uint8_t port, SimSlave *slave) {
+  Port * const p = &ports[port];
+
+  if (p->slave_count < SLAVES_MAX) {
+    slave->addressed = 0;
+    p->slaves[p->slave_count++] = slave;
+  }
+}
+
+void sim_fault(uint8_t port, enum SimFault fault, uint8_t at_byte,
+               uint8_t times, uint8_t hold) {
+  Port * const p = &ports[port];
+
+  p->fault = times ? fault : SIM_FAULT_NONE;
+  p->fault_byte = at_byte;
+  p->fault_times = times;
+  p->fault_hold = hold;
+}
+
+void sim_stick_sda(uint8_t port, uint8_t pulses) {
+  ports[port].stuck = pulses;
+  wires(port);
+}
+
+uint64_t sim_time_ns(void) {
+  return sim_ns;
+}
+
+void sim_advance_ns(uint64_t ns) {
+  sim_ns += ns;
+}
+
+SimStats *sim_stats(uint8_t port) {
+  return &ports[port].stats;
+}
+
+void sim_stats_reset(void) {
+  uint_fast8_t i;
+
+  for (i = 0; i < PORTS; ++i) {
+    memset(&ports[i].stats, 0, sizeof ports[i].stats);
+  }
+}
+
+uint32_t sim_transitions(uint_fast8_t from, uint_fast8_t to) {
+  return transitions[from][to];
+}
@@ -0,0 +1,137 @@
+/* i2csim.h
+ *
+ * Declares a simulation of I2C0-2 in master mode, following the states
+ * in I2STAT (tables 399 and 400) as the driver sets and clears the bits
+ * of I2CON, and of the slaves on their buses. It's stepped, rather than
+ * timed: each step carries out whatever the controller was told to do
+ * when the driver last cleared SI (a start, a stop, a byte sent or
+ * received) and shows the state that follows, with SI set. The bus
+ * time each step would take at the driver's SCL rate is added up, for
+ * the stats.
+ *
+ * Faults may be set up on a port: another master winning arbitration,
+ * a bus error, or a byte not acknowledged, at a given byte of the next
+ * transfers. A slave may also be stuck holding SDA low, so that no
+ * start can be sent, until SCL is clocked enough times by GPIO, as bus
+ * recovery does. The pins' levels show in FIOPIN.
+ *
+ * Every change of I2STAT is counted, from one state to the next, so
+ * that the transitions the driver has been through can be listed.
+ */
+
+#ifndef __I2CSIM_h_
+#define __I2CSIM_h_
+
+#include <stdint.h>
+
+#include "LPC17xx.h"
+
+/* The most steps sleep_wfi (see host.c) takes waiting for an interrupt,
+ * so that the code sleeping gets to look around now and then
+ */
+#define SIM_WFI_STEPS 1000
+
+/* The steps another master holds the bus after winning arbitration */
+#define SIM_OTHER_MASTER_STEPS 3
+
+/* The I2STAT codes, in the order sim_transitions counts them */
+#define SIM_STATES 13
+extern const uint8_t sim_states[SIM_STATES];
+
+typedef struct {
+  uint8_t address;          /* 7 bit */
+  uint8_t write_only;       /* doesn't answer its address for reads */
+  uint8_t accept;           /* bytes taken per write, or 0 for any */
+  uint8_t memory[256];
+
+  // The simulator's own: a write's first byte sets pointer
+  uint8_t pointer, written, addressed, reading;
+} SimSlave;
+
+enum SimFault {
+  SIM_FAULT_NONE,
+  SIM_FAULT_ARBITRATION,    /* lost, at a byte sent */
+  SIM_FAULT_BUS_ERROR,      /* at any byte */
+  SIM_FAULT_NACK            /* at a byte sent, whatever the slave says */
+};
+
+typedef struct {
+  uint64_t starts;          /* from idle */
+  uint64_t restarts;
+  uint64_t stops;
+  uint64_t bytes_sent;      /* addresses included */
+  uint64_t bytes_received;
+  uint64_t irqs;            /* handler calls */
+  uint64_t busy_steps;      /* steps a start waited for the bus */
+  uint64_t hangs;           /* SI cleared with nothing to do next */
+  uint64_t pulses;          /* SCL pulses clocked by GPIO */
+  uint64_t gpio_stops;      /* stops made by GPIO */
+  uint64_t bus_ns;          /* bus time */
+} SimStats;
+
+/* sim_reset()
+ * Puts every register back to its reset value, detaches the slaves,
+ * clears the faults and zeroes the stats and transitions.
+ */
+void sim_reset(void);
+
+/* sim_attach(port, slave)
+ * Puts slave on port's bus.
+ */
+void sim_attach(uint8_t port, SimSlave *slave);
+
+/* sim_fault(port, fault, at_byte, times, hold)
+ * Has fault happen at byte at_byte (the address being 0, and counting
+ * on across repeated starts) of the next times attempts at a transfer
+ * on port. After a bus error, SDA is left stuck low for hold SCL
+ * pulses.
+ */
+void sim_fault(uint8_t port, enum SimFault fault, uint8_t at_byte,
+               uint8_t times, uint8_t hold);
+
+/* sim_stick_sda(port, pulses)
+ * Has a slave on port hold SDA low until SCL has been clocked pulses
+ * times.
+ */
+void sim_stick_sda(uint8_t port, uint8_t pulses);
+
+/* sim_apply()
+ * Takes what the driver has written to I2CONSET, I2CONCLR, FIOSET and
+ * FIOCLR, and updates the pins' levels in FIOPIN.
+ */
+void sim_apply(void);
+
+/* sim_step()
+ * Applies the driver's writes, then moves each port on a step, and
+ * takes any interrupt pending if interrupts aren't masked.
+ */
+void sim_step(void);
+
+/* sim_irq_pending(port)
+ * Returns whether port's SI is set, with the controller enabled.
+ */
+uint_fast8_t sim_irq_pending(uint8_t port);
+
+/* sim_time_ns()
+ * Returns the simulated time, made of bus time and delays.
+ */
+uint64_t sim_time_ns(void);
+
+/* sim_advance_ns(ns)
+ * Moves the simulated time on, for delays.
+ */
+void sim_advance_ns(uint64_t ns);
+
+/* sim_stats(port), sim_stats_reset()
+ * Return port's stats, or zero them all.
+ */
+SimStats *sim_stats(uint8_t port);
+void sim_stats_reset(void);
+
+/* sim_transitions(from, to)
+ * Returns how many times I2STAT has gone from sim_states[from] to
+ * sim_states[to], on any port.
+ */
+uint32_t sim_transitions(uint_fast8_t from, uint_fast8_t to);
+
+#endif
@@ -0,0 +1,527 @@
+/*
+ ===============================================================================
+ Name        : main.c
+ Description :
+
+   Runs the I2C driver from UMD_LPC1769 against the simulated I2C
+   controllers (see i2csim.h), with a memory at 0x50 (the first byte
+   written sets the address the rest go to, or are read from) and a
+   write only codec at 0x1A, taking 3 bytes a write, on I2C0, through
+   these scenes:
+
+     rates        the SCL dividers chosen, at 100 and 120MHz
+     memory       writes and reads, with repeated starts, checked back
+     refusals     absent slaves, reads from the codec, bytes refused,
+                  and transfers the driver won't take
+     queue        transfers submitted at once, one queued from another's
+                  done handler, completed in order
+     arbitration  another master winning at the address, data or
+                  repeated start, until the driver gives up
+     bus errors   during writes and reads, with SDA left stuck low for
+                  the recovery to clock free
+     stuck bus    a transfer held up by SDA stuck low until aborted, and
+                  I2C1 initialized with SDA stuck
+
+   Then the I2STAT transitions seen are listed, and checked against all
+   those a master can go through.
+
+   Usage: i2csim
+
+ ===============================================================================
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "UMDLPC/system/i2c.h"
+#include "UMDLPC/system/pconp.h"
+#include "UMDLPC/system/sleep.h"
+#include "UMDLPC/system/clocking.h"
+#include "i2csim.h"
+#include "host.h"
+
+#define RATE 400000
+#define MEMORY 0x50
+#define CODEC 0x1A
+#define ABSENT 0x33
+#define STUCK_STEPS 200
+
+static I2CBus bus = I2C_BUS(0);
+static SimSlave memory = { MEMORY };
+static SimSlave codec = { CODEC, 1, 3 };
+
+static const char * const status_names[] = {
+  "ok", "pending", "address refused", "data refused", "arbitration lost",
+  "bus error", "aborted"
+};
+
+// The transitions a master can go through, from and to
+static const uint8_t expected[][2] = {
+  { 0xF8, 0x08 },
+  { 0x08, 0x18 }, { 0x08, 0x20 }, { 0x08, 0x38 }, { 0x08, 0x40 },
+  { 0x08, 0x48 },
+  { 0x10, 0x18 }, { 0x10, 0x20 }, { 0x10, 0x38 }, { 0x10, 0x40 },
+  { 0x10, 0x48 },
+  { 0x18, 0x28 }, { 0x18, 0x30 }, { 0x18, 0x38 }, { 0x18, 0x10 },
+  { 0x18, 0xF8 }, { 0x18, 0x08 }, { 0x18, 0x00 },
+  { 0x20, 0xF8 }, { 0x20, 0x08 },
+  { 0x28, 0x28 }, { 0x28, 0x30 }, { 0x28, 0x38 }, { 0x28, 0x10 },
+  { 0x28, 0xF8 }, { 0x28, 0x08 }, { 0x28, 0x00 },
+  { 0x30, 0xF8 }, { 0x30, 0x08 },
+  { 0x38, 0x08 }, { 0x38, 0xF8 },
+  { 0x40, 0x50 }, { 0x40, 0x58 },
+  { 0x48, 0xF8 }, { 0x48, 0x08 },
+  { 0x50, 0x50 }, { 0x50, 0x58 }, { 0x50, 0x00 },
+  { 0x58, 0x10 }, { 0x58, 0xF8 }, { 0x58, 0x08 },
+  { 0x00, 0xF8 }
+};
+
+void static fail(const char *scene, const char *what) {
+  printf("%s: %s\n", scene, what);
+  exit(1);
+}
+
+void static expect(const char *scene, const char *what, uint8_t status,
+                   uint8_t wanted) {
+  if (status != wanted) {
+    printf("%s: %s was %s, not %s\n", scene, what, status_names[status],
+           status_names[wanted]);
+    exit(1);
+  }
+}
+
+#define SETTLE_STEPS 4
+
+// Steps on until a transfer's stop has gone out. Its status is set by
+// then, but a transfer submitted before the stop is sent would have its
+// start follow the stop at once, without the bus going idle.
+void static settle(void) {
+  uint_fast8_t i;
+
+  for (i = 0; i < SETTLE_STEPS; ++i) {
+    sim_step();
+  }
+}
+
+// Carries out a transfer, letting the bus go idle after
+uint8_t static transfer_idle(I2CTransfer *transfer) {
+  const uint8_t status = i2c_transfer(&bus, transfer);
+
+  settle();
+  return status;
+}
+
+void static report(const char *scene, uint32_t transfers) {
+  const SimStats * const stats = sim_stats(0);
+  uint64_t bytes;
+
+  settle();
+  bytes = stats->bytes_sent + stats->bytes_received;
+
+  printf("%s: %u transfers, %llu bytes (%llu sent, %llu received) in"
+         " %.1fus of bus time\n", scene, transfers,
+         (unsigned long long) bytes, (unsigned long long) stats->bytes_sent,
+         (unsigned long long) stats->bytes_received, stats->bus_ns / 1e3);
+  printf("  starts %llu restarts %llu stops %llu; IRQs %llu (%.2f a byte);"
+         " recoveries %u, %llu pulses\n", (unsigned long long) stats->starts,
+         (unsigned long long) stats->restarts,
+         (unsigned long long) stats->stops,
+         (unsigned long long) stats->irqs,
+         bytes ? (double) stats->irqs / bytes : 0.0, bus.recoveries,
+         (unsigned long long) stats->pulses);
+
+  if (stats->hangs) {
+    fail(scene, "the bus was left hanging after a byte was refused");
+  }
+  sim_stats_reset();
+  bus.recoveries = 0;
+}
+
+void static rates(void) {
+  static const uint32_t wanted[] = { 100000, 400000, 1000000 };
+  uint_fast8_t i;
+
+  printf("CCLK %uMHz   SCLH   SCLL  rate\n", SystemCoreClock / 1000000);
+  for (i = 0; i < sizeof wanted / sizeof wanted[0]; ++i) {
+    const uint32_t rate = i2c_init(&bus, wanted[i]);
+
+    if (rate) {
+      printf("  %7u  %5u  %5u  %u\n", wanted[i], sim_i2c[0].I2SCLH,
+             sim_i2c[0].I2SCLL, rate);
+    } else {
+      printf("  %7u  out of reach\n", wanted[i]);
+    }
+  }
+
+  // The dividers follow a clock switch
+  i2c_init(&bus, RATE);
+  host_clock_switch(120000000);
+  printf("switched to %uMHz: %u at SCLH %u, SCLL %u, %u\n",
+         SystemCoreClock / 1000000, RATE, sim_i2c[0].I2SCLH,
+         sim_i2c[0].I2SCLL, SystemCoreClock
+         / (sim_i2c[0].I2SCLH + sim_i2c[0].I2SCLL));
+
+  sim_stats_reset();
+  bus.recoveries = 0;
+}
+
+void static fill(uint8_t *data, uint32_t length, uint8_t seed) {
+  uint32_t i;
+
+  for (i = 0; i < length; ++i) {
+    data[i] = seed + 37 * i;
+  }
+}
+
+// Writes length bytes of data to the memory from address
+uint8_t static memory_write(uint8_t address, const uint8_t *data,
+                            uint16_t length) {
+  const I2CSegment segments[] = {
+    I2C_WRITE(&address, 1), I2C_WRITE_ON(data, length)
+  };
+  I2CTransfer transfer = { MEMORY, segments, 2 };
+
+  return i2c_transfer(&bus, &transfer);
+}
+
+// Reads length bytes from the memory at address into data
+uint8_t static memory_read(uint8_t address, uint8_t *data, uint16_t length) {
+  const I2CSegment segments[] = {
+    I2C_WRITE(&address, 1), I2C_READ_INTO(data, length)
+  };
+  I2CTransfer transfer = { MEMORY, segments, 2 };
+
+  return i2c_transfer(&bus, &transfer);
+}
+
+void static memory_scene(void) {
+  const char * const scene = "memory";
+  uint8_t data[64], back[64];
+
+  fill(data, sizeof data, 1);
+  expect(scene, "writing", memory_write(0x10, data, sizeof data), I2C_OK);
+  if (memcmp(&memory.memory[0x10], data, sizeof data)) {
+    fail(scene, "the memory doesn't hold what was written");
+  }
+
+  expect(scene, "reading", memory_read(0x10, back, sizeof back), I2C_OK);
+  if (memcmp(back, data, sizeof data)) {
+    fail(scene, "what was read back isn't what was written");
+  }
+
+  expect(scene, "reading a byte", memory_read(0x15, back, 1), I2C_OK);
+  if (back[0] != data[5]) {
+    fail(scene, "the byte read isn't what was written");
+  }
+
+  report(scene, 3);
+}
+
+void static refusals_scene(void) {
+  const char * const scene = "refusals";
+  static const uint8_t setup[] = { 0x02, 0x17, 0x79, 0x30, 0x01 };
+  uint8_t byte = 0, back[2];
+  const I2CSegment probe = I2C_WRITE(0, 0);
+  const I2CSegment read = I2C_READ_INTO(back, 1);
+  const I2CSegment setup_short = I2C_WRITE(setup, 2);
+  const I2CSegment setup_long = I2C_WRITE(setup, sizeof setup);
+  const I2CSegment write_read[] = {
+    I2C_WRITE(&byte, 1), I2C_READ_INTO(back, 1)
+  };
+  const I2CSegment read_write[] = {
+    I2C_READ_INTO(back, 1), I2C_WRITE(&byte, 1)
+  };
+  const I2CSegment bad_read = I2C_READ_INTO(back, 0);
+  const I2CSegment bad_start = I2C_WRITE_ON(&byte, 1);
+  const I2CSegment bad_after_read[] = {
+    I2C_READ_INTO(back, 1), I2C_WRITE_ON(&byte, 1)
+  };
+  I2CTransfer transfer = { MEMORY, &probe, 1 };
+
+  expect(scene, "probing the memory", transfer_idle(&transfer), I2C_OK);
+  transfer.address = ABSENT;
+  expect(scene, "probing an absent slave", transfer_idle(&transfer),
+         I2C_NACK_ADDRESS);
+  transfer.segments = &read;
+  expect(scene, "reading an absent slave", transfer_idle(&transfer),
+         I2C_NACK_ADDRESS);
+
+  transfer.address = CODEC;
+  transfer.segments = &setup_short;
+  expect(scene, "writing 2 bytes to the codec",
+         transfer_idle(&transfer), I2C_OK);
+  transfer.segments = &setup_long;
+  expect(scene, "writing 5 bytes to the codec",
+         transfer_idle(&transfer), I2C_NACK_DATA);
+  transfer.segments = write_read;
+  transfer.count = 2;
+  expect(scene, "reading the codec", transfer_idle(&transfer),
+         I2C_NACK_ADDRESS);
+
+  // The memory refusing the first byte, and its address after a
+  // repeated start, as it might while busy
+  transfer.address = MEMORY;
+  transfer.segments = &setup_short;
+  transfer.count = 1;
+  sim_fault(0, SIM_FAULT_NACK, 1, 1, 0);
+  expect(scene, "a first byte refused", transfer_idle(&transfer),
+         I2C_NACK_DATA);
+  transfer.segments = read_write;
+  transfer.count = 2;
+  sim_fault(0, SIM_FAULT_NACK, 2, 1, 0);
+  expect(scene, "an address refused after a read",
+         transfer_idle(&transfer), I2C_NACK_ADDRESS);
+  expect(scene, "a read, then a write", transfer_idle(&transfer),
+         I2C_OK);
+
+  // Transfers the driver won't take
+  transfer.count = 0;
+  if (i2c_submit(&bus, &transfer)) {
+    fail(scene, "a transfer with no segments was taken");
+  }
+  transfer.segments = &bad_read;
+  transfer.count = 1;
+  if (i2c_submit(&bus, &transfer)) {
+    fail(scene, "a read of 0 bytes was taken");
+  }
+  transfer.segments = &bad_start;
+  if (i2c_submit(&bus, &transfer)) {
+    fail(scene, "a first segment without a start was taken");
+  }
+  transfer.segments = bad_after_read;
+  transfer.count = 2;
+  if (i2c_submit(&bus, &transfer)) {
+    fail(scene, "a write without a start after a read was taken");
+  }
+
+  report(scene, 9);
+}
+
+#define QUEUED 8
+
+static uint8_t completed[QUEUED];
+static volatile uint8_t completions;
+static I2CTransfer queue[QUEUED];
+
+void static done(I2CTransfer *transfer) {
+  completed[completions++] = transfer - queue;
+
+  // The sixth queues the last, from the interrupt
+  if (transfer == &queue[5]) {
+    i2c_submit(&bus, &queue[QUEUED - 1]);
+  }
+}
+
+void static queue_scene(void) {
+  const char * const scene = "queue";
+  static const uint8_t codec_setup[] = { 0x04, 0x11, 0x22, 0x33, 0x44 };
+  static const uint8_t wanted[QUEUED] = {
+    I2C_OK, I2C_NACK_ADDRESS, I2C_NACK_DATA, I2C_NACK_ADDRESS, I2C_OK,
+    I2C_OK, I2C_OK, I2C_OK
+  };
+  uint8_t address = 0x40, data[4], back[4], first, next[4];
+  const I2CSegment write[] = {
+    I2C_WRITE(&address, 1), I2C_WRITE_ON(data, sizeof data)
+  };
+  const I2CSegment probe = I2C_WRITE(0, 0);
+  const I2CSegment setup = I2C_WRITE(codec_setup, sizeof codec_setup);
+  const I2CSegment read_one = I2C_READ_INTO(&first, 1);
+  const I2CSegment probe_read[] = { I2C_WRITE(0, 0), I2C_READ_INTO(&first, 1) };
+  const I2CSegment read_on = I2C_READ_INTO(next, sizeof next);
+  const I2CSegment write_read[] = {
+    I2C_WRITE(&address, 1), I2C_READ_INTO(back, sizeof back)
+  };
+  const I2CTransfer transfers[QUEUED] = {
+    { MEMORY, write, 2, done },
+    { ABSENT, &probe, 1, done },
+    { CODEC, &setup, 1, done },
+    { ABSENT, &read_one, 1, done },
+    { MEMORY, probe_read, 2, done },
+    { MEMORY, &probe, 1, done },
+    { MEMORY, &read_on, 1, done },
+    { MEMORY, write_read, 2, done }
+  };
+  uint_fast8_t i;
+
+  fill(data, sizeof data, 9);
+  memcpy(queue, transfers, sizeof queue);
+  completions = 0;
+  for (i = 0; i < QUEUED - 1; ++i) {
+    if (!i2c_submit(&bus, &queue[i])) {
+      fail(scene, "a transfer wasn't taken");
+    }
+  }
+  SLEEP_UNTIL(completions == QUEUED);
+
+  for (i = 0; i < QUEUED; ++i) {
+    if (completed[i] != i) {
+      fail(scene, "transfers completed out of order");
+    }
+    expect(scene, "a queued transfer", queue[i].status, wanted[i]);
+  }
+  if (memcmp(back, data, sizeof data)) {
+    fail(scene, "what was read back isn't what was written");
+  }
+
+  report(scene, QUEUED);
+}
+
+void static arbitration_scene(void) {
+  const char * const scene = "arbitration";
+  uint8_t data[8], back[8];
+
+  fill(data, sizeof data, 3);
+
+  // At the address, the first byte, a later byte, and the address after
+  // the repeated start, each retried to the end
+  sim_fault(0, SIM_FAULT_ARBITRATION, 0, 1, 0);
+  expect(scene, "lost at the address", memory_write(0x80, data, 8), I2C_OK);
+  sim_fault(0, SIM_FAULT_ARBITRATION, 1, 1, 0);
+  expect(scene, "lost at the first byte", memory_write(0x80, data, 8),
+         I2C_OK);
+  sim_fault(0, SIM_FAULT_ARBITRATION, 4, 2, 0);
+  expect(scene, "lost twice at the fourth byte", memory_write(0x80, data, 8),
+         I2C_OK);
+  sim_fault(0, SIM_FAULT_ARBITRATION, 2, 1, 0);
+  expect(scene, "lost at a repeated start", memory_read(0x80, back, 8),
+         I2C_OK);
+  if (memcmp(back, data, sizeof data)) {
+    fail(scene, "what was read back isn't what was written");
+  }
+
+  sim_fault(0, SIM_FAULT_ARBITRATION, 0, I2C_RETRIES + 1, 0);
+  expect(scene, "lost every time", memory_write(0x80, data, 8),
+         I2C_ARBITRATION_LOST);
+
+  report(scene, 5);
+}
+
+void static bus_error_scene(void) {
+  const char * const scene = "bus errors";
+  uint8_t data[8], back[8];
+  const I2CSegment read[] = {
+    I2C_WRITE(data, 1), I2C_READ_INTO(back, sizeof back)
+  };
+  I2CTransfer failing = { MEMORY, read, 2 }, after = { MEMORY, read, 2 };
+
+  fill(data, sizeof data, 0xA0);
+  data[0] = 0xC0;
+
+  sim_fault(0, SIM_FAULT_BUS_ERROR, 3, 1, 3);
+  expect(scene, "writing", memory_write(0xC0, data, 8), I2C_BUS_ERROR);
+  expect(scene, "writing after one", memory_write(0xC0, data, 8), I2C_OK);
+  sim_fault(0, SIM_FAULT_BUS_ERROR, 1, 1, 0);
+  expect(scene, "writing the first byte", memory_write(0xC0, data, 8),
+         I2C_BUS_ERROR);
+
+  // During a read, with the next transfer queued behind it
+  sim_fault(0, SIM_FAULT_BUS_ERROR, 5, 1, 7);
+  i2c_submit(&bus, &failing);
+  i2c_submit(&bus, &after);
+  expect(scene, "reading", i2c_wait(&failing), I2C_BUS_ERROR);
+  expect(scene, "reading after one", i2c_wait(&after), I2C_OK);
+  if (memcmp(back, data, sizeof data)) {
+    fail(scene, "what was read back isn't what was written");
+  }
+
+  report(scene, 5);
+}
+
+void static stuck_scene(void) {
+  const char * const scene = "stuck bus";
+  static I2CBus other = I2C_BUS(1);
+  uint8_t data[4];
+  const I2CSegment write[] = { I2C_WRITE(data, sizeof data) };
+  I2CTransfer transfer = { MEMORY, write, 1 };
+  uint_fast16_t steps;
+
+  fill(data, sizeof data, 0x55);
+  sim_stick_sda(0, 5);
+  i2c_submit(&bus, &transfer);
+  for (steps = 0; steps < STUCK_STEPS; ++steps) {
+    sim_step();
+  }
+  expect(scene, "a transfer with SDA stuck", transfer.status, I2C_PENDING);
+  if (sim_stats(0)->busy_steps < STUCK_STEPS) {
+    fail(scene, "the start didn't wait for the bus");
+  }
+
+  // As a timeout would. The stop after the 5 pulses takes one more.
+  i2c_abort(&bus);
+  expect(scene, "the aborted transfer", transfer.status, I2C_ABORTED);
+  if (sim_stats(0)->pulses != 5 + 1 || sim_stats(0)->gpio_stops != 1) {
+    fail(scene, "the recovery didn't clock SDA free and stop");
+  }
+  expect(scene, "the transfer after", i2c_transfer(&bus, &transfer), I2C_OK);
+  report(scene, 2);
+
+  // Too stuck to recover at once, then free on trying again
+  sim_stick_sda(1, I2C_RECOVERY_PULSES + 3);
+  if (i2c_init(&other, RATE) || (sim_sc.PCONP & PC_I2C1)) {
+    fail(scene, "I2C1 was initialized with SDA stuck");
+  }
+  if (!i2c_init(&other, RATE)) {
+    fail(scene, "I2C1 couldn't be initialized once SDA was free");
+  }
+  printf("%s: I2C1 initialized on the second try, after %llu pulses\n",
+         scene, (unsigned long long) sim_stats(1)->pulses);
+}
+
+void static coverage(void) {
+  uint_fast8_t from, to, i, missing = 0;
+
+  printf("\nI2STAT transitions seen (from down, to across):\n    ");
+  for (to = 0; to < SIM_STATES; ++to) {
+    printf("   %02X", sim_states[to]);
+  }
+  printf("\n");
+  for (from = 0; from < SIM_STATES; ++from) {
+    printf("  %02X", sim_states[from]);
+    for (to = 0; to < SIM_STATES; ++to) {
+      const uint32_t count = sim_transitions(from, to);
+
+      if (count) {
+        printf(" %4u", count);
+      } else {
+        printf("    .");
+      }
+    }
+    printf("\n");
+  }
+
+  for (i = 0; i < sizeof expected / sizeof expected[0]; ++i) {
+    for (from = 0; sim_states[from] != expected[i][0]; ++from)
+      ;
+    for (to = 0; sim_states[to] != expected[i][1]; ++to)
+      ;
+    if (!sim_transitions(from, to)) {
+      printf("missing %02X -> %02X\n", expected[i][0], expected[i][1]);
+      ++missing;
+    }
+  }
+
+  printf("%u of %u transitions covered\n",
+         (unsigned) (sizeof expected / sizeof expected[0]) - missing,
+         (unsigned) (sizeof expected / sizeof expected[0]));
+  if (missing) {
+    exit(1);
+  }
+}
+
+int main(void) {
+  sim_reset();
+  sim_attach(0, &memory);
+  sim_attach(0, &codec);
+
+  rates();
+  memory_scene();
+  refusals_scene();
+  queue_scene();
+  arbitration_scene();
+  bus_error_scene();
+  stuck_scene();
+  coverage();
+
+  return 0;
+}
@@ -0,0 +1,242 @@
+/*
+ ===============================================================================
+ Name        : imgconv.c
+ Description :
+
+   Converts a binary PPM (P6) image to the run length encoded format
+   drawn by TFT_image (see SoundRecorderSD/src/tftimage.h). Pixels are
+   reduced to RGB565; images with at most 256 colors get a palette,
+   others are stored as RGB565 values.
+
+   Usage: imgconv [-d] input.ppm output.tfi
+
+     -d  don't use a palette, even if the image would fit in one
+
+   The output can then be written to the card at a block boundary,
+   e.g. with dd if=output.tfi of=/dev/sdX bs=512 seek=<block>.
+
+ ===============================================================================
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+
+#define BLOCK_LEN 512
+#define RUN_MIN 2
+#define RUN_MAX 129
+#define LITERAL_MAX 128
+
+typedef struct {
+  uint8_t *data;
+  size_t len, size;
+} Buffer;
+
+void static put_byte(Buffer *buffer, uint8_t byte) {
+  if (buffer->len == buffer->size) {
+    buffer->size = buffer->size ? buffer->size * 2 : 4096;
+    buffer->data = realloc(buffer->data, buffer->size);
+    if (!buffer->data) {
+      fprintf(stderr, "Out of memory\n");
+      exit(1);
+    }
+  }
+  buffer->data[buffer->len++] = byte;
+}
+
+void static put_word(Buffer *buffer, uint16_t word) {
+  put_byte(buffer, word & 0xFF);
+  put_byte(buffer, word >> 8);
+}
+
+// Skips whitespace and comments in a PPM header
+void static skip_space(FILE *file) {
+  int c;
+
+  while ((c = fgetc(file)) != EOF) {
+    if (c == '#') {
+      while ((c = fgetc(file)) != EOF && c != '\n')
+        ;
+    } else if (c != ' ' && c != '\t' && c != '\r' && c != '\n') {
+      ungetc(c, file);
+      return;
+    }
+  }
+}
+
+// Reads a P6 image as RGB565 pixels, returns 0 on failure
+uint16_t static *read_ppm(const char *path, unsigned *width,
+                          unsigned *height) {
+  FILE *file = fopen(path, "rb");
+  unsigned maxval, i;
+  uint8_t rgb[3];
+  uint16_t *pixels;
+
+  if (!file) {
+    perror(path);
+    return 0;
+  }
+
+  if (fgetc(file) != 'P' || fgetc(file) != '6') {
+    fprintf(stderr, "%s: not a binary PPM (P6) file\n", path);
+    fclose(file);
+    return 0;
+  }
+
+  skip_space(file);
+  if (fscanf(file, "%u", width) != 1) goto bad_header;
+  skip_space(file);
+  if (fscanf(file, "%u", height) != 1) goto bad_header;
+  skip_space(file);
+  if (fscanf(file, "%u", &maxval) != 1 || maxval != 255) goto bad_header;
+  fgetc(file);
+
+  if (!*width || !*height || *width > 0xFFFF || *height > 0xFFFF) {
+    goto bad_header;
+  }
+
+  pixels = malloc(sizeof(*pixels) * *width * *height);
+  for (i = 0; i < *width * *height; ++i) {
+    if (fread(rgb, 1, 3, file) != 3) {
+      fprintf(stderr, "%s: truncated\n", path);
+      free(pixels);
+      fclose(file);
+      return 0;
+    }
+    pixels[i] = ((rgb[0] >> 3) << 11) | ((rgb[1] >> 2) << 5) | (rgb[2] >> 3);
+  }
+
+  fclose(file);
+  return pixels;
+
+bad_header:
+  fprintf(stderr, "%s: unsupported PPM header (8 bit channels only)\n",
+          path);
+  fclose(file);
+  return 0;
+}
+
+// Builds a palette of the pixels' colors, and maps the pixels onto
+// it. Returns the number of colors, or 0 if there are more than 256.
+unsigned static build_palette(const uint16_t *pixels, unsigned count,
+                              uint16_t *palette, uint16_t *indices) {
+  static int16_t index_of[65536];
+  unsigned colors = 0, i;
+
+  memset(index_of, 0xFF, sizeof(index_of));
+
+  for (i = 0; i < count; ++i) {
+    if (index_of[pixels[i]] < 0) {
+      if (colors == 256) {
+        return 0;
+      }
+      index_of[pixels[i]] = colors;
+      palette[colors++] = pixels[i];
+    }
+    indices[i] = index_of[pixels[i]];
+  }
+
+  return colors;
+}
+
+void static put_value(Buffer *buffer, uint16_t value, unsigned colors) {
+  if (colors) {
+    put_byte(buffer, value);
+  } else {
+    put_word(buffer, value);
+  }
+}
+
+// Encodes values as runs (of RUN_MIN or more) and literals
+void static encode(Buffer *buffer, const uint16_t *values, unsigned count,
+                   unsigned colors) {
+  unsigned i = 0, run, literal;
+
+  while (i < count) {
+    for (run = 1; i + run < count && run < RUN_MAX
+           && values[i + run] == values[i]; ++run)
+      ;
+
+    if (run >= RUN_MIN) {
+      put_byte(buffer, 0x80 | (run - 2));
+      put_value(buffer, values[i], colors);
+      i += run;
+      continue;
+    }
+
+    // Gather literals up to the next run
+    for (literal = 1; i + literal < count && literal < LITERAL_MAX; ++literal) {
+      if (i + literal + 1 < count
+          && values[i + literal] == values[i + literal + 1]) {
+        break;
+      }
+    }
+
+    put_byte(buffer, literal - 1);
+    for (run = 0; run < literal; ++run) {
+      put_value(buffer, values[i + run], colors);
+    }
+    i += literal;
+  }
+}
+
+int main(int argc, char **argv) {
+  int direct = 0, arg = 1;
+  unsigned width, height, count, colors = 0, i;
+  uint16_t *pixels, *indices, palette[256];
+  Buffer out = { 0, 0, 0 };
+  FILE *file;
+
+  if (arg < argc && !strcmp(argv[arg], "-d")) {
+    direct = 1;
+    ++arg;
+  }
+  if (argc - arg != 2) {
+    fprintf(stderr, "Usage: %s [-d] input.ppm output.tfi\n", argv[0]);
+    return 1;
+  }
+
+  pixels = read_ppm(argv[arg], &width, &height);
+  if (!pixels) {
+    return 1;
+  }
+  count = width * height;
+
+  indices = malloc(sizeof(*indices) * count);
+  if (!direct) {
+    colors = build_palette(pixels, count, palette, indices);
+  }
+
+  put_byte(&out, 'T');
+  put_byte(&out, 'F');
+  put_byte(&out, 'I');
+  put_byte(&out, '1');
+  put_word(&out, width);
+  put_word(&out, height);
+  put_word(&out, colors);
+  put_word(&out, 0);
+  for (i = 0; i < colors; ++i) {
+    put_word(&out, palette[i]);
+  }
+
+  encode(&out, colors ? indices : pixels, count, colors);
+
+  file = fopen(argv[arg + 1], "wb");
+  if (!file || fwrite(out.data, 1, out.len, file) != out.len
+      || fclose(file)) {
+    perror(argv[arg + 1]);
+    return 1;
+  }
+
+  printf("%ux%u, %s: %u bytes as RGB565, %lu bytes (%lu blocks)\n",
+         width, height,
+         colors ? "palette" : "no palette",
+         count * 2, (unsigned long) out.len,
+         (unsigned long) (out.len + BLOCK_LEN - 1) / BLOCK_LEN);
+
+  free(pixels);
+  free(indices);
+  free(out.data);
+  return 0;
+}
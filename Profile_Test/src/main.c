@@ -0,0 +1,222 @@
+/*
+ ===============================================================================
+ Name        : main.c
+ Description :
+
+   Checks the profiling zones from UMD_LPC1769 (see
+   UMDLPC/system/profile.h), timed on a fake cycle counter which moves
+   on only when read, or when a zone's made up work is done:
+
+     overhead  the cost of reading the counter, which profile_init
+               measures, is taken off every record
+     wrap      a zone across the counter wrapping is timed right
+     clock     the mean is reported in microseconds at the clock the
+               zone was timed at, after switching to another
+     mask      records leave interrupts masked, or not, as they were
+     overflow  records for zones past PROFILE_ZONES_MAX are counted,
+               and reported on a last line
+     reset     resetting zeroes the stats, keeping the zones, and the
+               report leaves out zones not timed since
+
+   Each prints what it found, and the test fails if any is wrong.
+
+   Usage: profiletest
+
+ ===============================================================================
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "UMDLPC/system/profile.h"
+
+// The cycles each read of the counter takes, as the two back to back
+// reads around a zone do on the target
+#define COUNTER_READ_CYCLES 3
+
+// The clocks SoundRecorderSD switches between
+#define BUSY_HZ 120000000
+#define IDLE_HZ 24000000
+
+uint32_t SystemCoreClock = BUSY_HZ;
+
+static uint32_t counter;
+static uint_fast8_t failures;
+
+// The last report, a line after another
+static char report[1024];
+
+void delay_init(void) {
+}
+
+uint32_t delay_counter(void) {
+  const uint32_t now = counter;
+
+  counter += COUNTER_READ_CYCLES;
+  return now;
+}
+
+void static check(uint_fast8_t ok, const char *what) {
+  if (!ok) {
+    printf("    FAILED: %s\n", what);
+    ++failures;
+  }
+}
+
+// Times cycles of made up work in the zone "work"
+void static work(uint32_t cycles) {
+  PROFILE_ENTER(work);
+  counter += cycles;
+  PROFILE_EXIT(work);
+}
+
+void static write_report(const char *line) {
+  strncat(report, line, sizeof(report) - strlen(report) - 1);
+}
+
+void static take_report(void) {
+  report[0] = '\0';
+  profile_report(write_report);
+}
+
+// The report's line for the zone name, or 0 if it has none
+const char static *report_line(const char *name) {
+  const size_t length = strlen(name);
+  const char *line;
+
+  for (line = report; *line; line = strchr(line, '\n') + 1) {
+    if (!strncmp(line, name, length) && line[length] == ' ') {
+      return line;
+    }
+  }
+  return 0;
+}
+
+void static overhead(void) {
+  const ProfileZone *z;
+
+  printf("overhead\n");
+  profile_init();
+  work(100);
+  work(300);
+
+  z = profile_zone(0);
+  printf("  %lu records, %lu/%llu/%lu cycles\n", (unsigned long) z->count,
+         (unsigned long) z->min_cycles,
+         (unsigned long long) z->total_cycles, (unsigned long) z->max_cycles);
+  check(!strcmp(z->name, "work"), "the zone is named work");
+  check(z->count == 2, "2 records");
+  check(z->min_cycles == 100 && z->max_cycles == 300
+        && z->total_cycles == 400, "the work's cycles, without the reads");
+}
+
+void static wrap(void) {
+  const ProfileZone *z;
+
+  printf("wrap\n");
+  profile_reset();
+  counter = UINT32_MAX - 500;
+  work(1000);
+
+  z = profile_zone(0);
+  printf("  %lu cycles from %lu\n", (unsigned long) z->max_cycles,
+         (unsigned long) (UINT32_MAX - 500));
+  check(z->count == 1 && z->max_cycles == 1000, "1000 cycles");
+}
+
+void static clock(void) {
+  const char *line;
+  unsigned long count, us, tenths;
+
+  printf("clock\n");
+  profile_reset();
+  SystemCoreClock = BUSY_HZ;
+  work(1200);
+  work(1200);
+  work(2400);
+
+  // Reported at the idle clock, as SoundRecorderSD does
+  SystemCoreClock = IDLE_HZ;
+  take_report();
+  SystemCoreClock = BUSY_HZ;
+
+  line = report_line("work");
+  check(line != 0, "the zone is reported");
+  if (line) {
+    printf("  %.*s", (int) (strchr(line, '\n') - line + 1), line);
+    check(sscanf(line, "work %lu %lu.%lu", &count, &us, &tenths) == 3
+          && count == 3 && us == 13 && tenths == 3,
+          "3 records, 13.3us (1600 cycles at 120MHz)");
+  }
+}
+
+void static mask(void) {
+  printf("mask\n");
+  profile_reset();
+
+  __disable_irq();
+  work(10);
+  check(__get_PRIMASK() == 1, "still masked after a masked record");
+  __enable_irq();
+  work(10);
+  check(__get_PRIMASK() == 0, "unmasked after an unmasked record");
+}
+
+void static overflow(void) {
+  static char names[PROFILE_ZONES_MAX + 3][8];
+  static ProfileZone *zones[PROFILE_ZONES_MAX + 3];
+  const char *line;
+  uint_fast8_t i, count;
+
+  printf("overflow\n");
+  profile_reset();
+
+  // "work" already takes one
+  for (i = 0; i < PROFILE_ZONES_MAX + 3; ++i) {
+    snprintf(names[i], sizeof(names[i]), "z%u", i);
+    profile_record(&zones[i], names[i], 50);
+  }
+  for (count = 0; profile_zone(count); ++count)
+    ;
+  take_report();
+
+  line = strstr(report, "records not in table");
+  printf("  %u zones, %s", count, line ? line - 3 : "no records dropped\n");
+  check(count == PROFILE_ZONES_MAX, "the table is full");
+  check(line && !strcmp(line - 3, "(4 records not in table)\n"),
+        "4 records dropped");
+  check(report_line("z14") && !report_line("z15"), "z0 to z14 reported");
+}
+
+void static reset(void) {
+  const ProfileZone *z;
+
+  printf("reset\n");
+  profile_reset();
+  work(20);
+  take_report();
+
+  z = profile_zone(1);
+  printf("  %s now %lu records\n", z->name, (unsigned long) z->count);
+  check(!strcmp(z->name, "z0") && !z->count && !z->total_cycles,
+        "z0 kept, with no records");
+  check(report_line("work") && !report_line("z0"),
+        "only work reported");
+  check(!strstr(report, "not in table"), "the dropped count zeroed");
+}
+
+int main(void) {
+  overhead();
+  wrap();
+  clock();
+  mask();
+  overflow();
+  reset();
+
+  if (failures) {
+    printf("%u failed\n", failures);
+    return 1;
+  }
+  printf("all passed\n");
+  return 0;
+}
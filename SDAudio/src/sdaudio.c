@@ -64,9 +64,9 @@ void DMA_IRQHandler(void) {
   LPC_GPDMA->DMACIntTCClear = 0xf;
 }
 
+// Sleeps until the DMA interrupt moves us into desired_state
 void wait_for_state(ProgramState desired_state) {
-  while (current_state != desired_state)
-    ;
+  SLEEP_UNTIL(current_state == desired_state);
 }
 
 // memcpy, unpack 8 bit fields to 32 bit fields shifted for the DAC
@@ -158,6 +158,9 @@ int main(void) {
   // Undivided peripheral clock for DAC (bits 23:22)
   LPC_SC->PCLKSEL0 |= (1 << 22);
 
+  // Sleep between DMA interrupts instead of spinning
+  sleep_init();
+
   // Configure pins
   //   P0.23 as AD0.0 (1 at bit 14)
   //   P0.26 as AOUT  (2 at bit 20)
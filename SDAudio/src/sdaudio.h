@@ -13,6 +13,7 @@
 #include "UMDLPC/system/clocking.h"
 #include "UMDLPC/system/pconp.h"
 #include "UMDLPC/system/dma.h"
+#include "UMDLPC/system/sleep.h"
 #include "UMDLPC/util/pins.h"
 #include "UMDLPC/util/util.h"
 
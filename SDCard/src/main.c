@@ -14,6 +14,9 @@
 
 #define CLOCK_SPEED 24000000
 
+// How often the LED is toggled, to show the program is running
+#define BLINK_MS 10
+
 // Variable to store CRP value in. Will be placed automatically
 // by the linker when "Enable Code Read Protect" selected.
 // See crp.h header for more information
@@ -46,28 +49,32 @@ void sd_command(uint_fast8_t command, uint_fast32_t arguments) {
   spi_write(0x95);
 }
 
-static uint32_t systick_delay_timer = 0;
-void SysTick_Handler (void) /* SysTick Interrupt Handler (1ms)   */
-{
-  BUILTIN_LED_TOGGLE();
-  if (systick_delay_timer){
-    --systick_delay_timer;
-  }
+// Writes a count to the card, one byte a run, keeping itself queued
+void static pattern_run(Task *task, uint32_t events) {
+  static uint8_t i = 0;
+
+  spi_write(i++);
+  sched_post(task, 1);
 }
 
-void systick_delay_millis(uint32_t millis)
-{
-  systick_delay_timer = millis;
-  while (systick_delay_timer);
+void static blink_run(Task *task, uint32_t events) {
+  BUILTIN_LED_TOGGLE();
 }
 
+// Blinking comes first, so it's only held up by one byte's write
+static Task pattern = TASK(pattern_run, 1);
+static Task blink = TASK(blink_run, 0);
+static Timer blink_timer;
+
 int main(void) {
+  uint64_t deadline;
+
   // Run at 24MHz, from the 12MHz crystal oscillator
   // (remember to update CLOCK_SPEED)
   LPC_SC->CLKSRCSEL = MAIN_OSCILLATOR;
   PLL_init(12, 1, 12);
 
-  SysTick_Config(SystemCoreClock/100 - 1);
+  systick_init();
 
   // Peripheral power
   LPC_SC->PCONP = PC_SSP0;
@@ -99,7 +106,9 @@ int main(void) {
   // The SD spec requires a slow start at 400khz
   LPC_SSP0->CPSR = CLOCK_SPEED / 400000;
 
-  systick_delay_millis(1);
+  deadline = systick_deadline_ms(1);
+  while (!systick_expired(deadline))
+    ;
 
   // SPI Control Register 1
   //   Defaults to Master
@@ -122,10 +131,7 @@ int main(void) {
 
   spi_write(CMD0);
 
-
-  uint32_t i = 0;
-  while (1) {
-    spi_write(i++);
-  }
-  return 0;
+  sched_timer_start(&blink_timer, &blink, 1, BLINK_MS, BLINK_MS);
+  sched_post(&pattern, 1);
+  sched_run();
 }
@@ -13,6 +13,8 @@
 
 #include "UMDLPC/system/clocking.h"
 #include "UMDLPC/system/pconp.h"
+#include "UMDLPC/system/sched.h"
+#include "UMDLPC/system/systick.h"
 #include "UMDLPC/util/pins.h"
 
 #define _BV(n) (1 << (n))
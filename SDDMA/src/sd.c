@@ -3,6 +3,7 @@
 #include <stdint.h>
 
 #include "UMDLPC/system/dma.h"
+#include "UMDLPC/system/sleep.h"
 #include "../inc/LPC17xx.h"
 #include "../inc/core_cm3.h"
 #include "sd.h"
@@ -75,6 +76,7 @@ int sd_init() //{{{
 	 */
 
   spi_init();
+  sleep_init();
 
 	LPC_GPIO0->FIODIR |= GPIO_SD_CS_m; // enable chip select
 	LPC_GPIO0->FIOSET = GPIO_SD_CS_m; // turn off the chip select (high)
@@ -254,9 +256,11 @@ char sd_read_block_dma(uint8_t* block, uint32_t block_num,
   //  Destination transfer width: word (2, bits 23:21)
   //  Source increment: don't increment (0, bit 26)
   //  Destination increment: increment (1, bit 27)
+  //  Terminal count interrupt: enabled (bit 31)
   dma_channel->DMACCControl  = (SD_BLOCK_LEN)
                                | (4 << 12)
-                               | (2 << 18) | (2 << 21) | (1 << 27);
+                               | (2 << 18) | (2 << 21) | (1 << 27)
+                               | (1 << 31);
 
   // Enable read dma
   LPC_SSP0->DMACR = 1;
@@ -265,9 +269,10 @@ char sd_read_block_dma(uint8_t* block, uint32_t block_num,
   //  Source peripheral: memory (default, bits  5:1)
   //  Destination peripheral: SSP0 RX (1, bits  10:6)
   //  Transfer Type: peripheral-to-memory (2, bits 13:11)
-  dma_channel->DMACCConfig = (1 << 0) | (2 << 11);
+  //  Enable terminal count interrupt (bit 15)
+  dma_channel->DMACCConfig = (1 << 0) | (2 << 11) | (1 << 15);
 
-  while (!(dma_channel->DMACCConfig & 1));
+  dma_wait(dma_channel);
 
   // Clean up SSP0 DMA settings
   LPC_SSP0->DMACR = 0;
@@ -320,9 +325,11 @@ char sd_write_block_dma(uint8_t* block, uint32_t block_num,
   //  Destination transfer width: word (2, bits 23:21)
   //  Source increment: increment (1, bit 26)
   //  Destination increment: don't increment (0, bit 27)
+  //  Terminal count interrupt: enabled (bit 31)
   dma_channel->DMACCControl  = (SD_BLOCK_LEN / 4)
                                | (4 << 12)
-                               | (2 << 18) | (2 << 21) | (1 << 26);
+                               | (2 << 18) | (2 << 21) | (1 << 26)
+                               | (1 << 31);
 
   // Enable transmit DMA
   LPC_SSP0->DMACR = 2;
@@ -331,9 +338,10 @@ char sd_write_block_dma(uint8_t* block, uint32_t block_num,
   //  Source peripheral: memory (default, bits  5:1)
   //  Destination peripheral: SSP0 TX (0, bits  10:6)
   //  Transfer Type: memory-to-peripheral (1, bits 13:11)
-  dma_channel->DMACCConfig = (1 << 0) | (1 << 11);
+  //  Enable terminal count interrupt (bit 15)
+  dma_channel->DMACCConfig = (1 << 0) | (1 << 11) | (1 << 15);
 
-  while (!(dma_channel->DMACCConfig & 1));
+  dma_wait(dma_channel);
 
   // Clean up SSP0 DMA settings
   LPC_SSP0->DMACR = 0;
@@ -0,0 +1,115 @@
+#include "console.h"
+
+// Most characters on a line, for the narrowest (8 wide) fonts
+#define MAX_COLUMNS ((TFT_WIDTH + 1) / 9)
+
+static const uint8_t *font;
+static uint16_t glyph_width, glyph_height, fg, bg;
+
+// Rows of GDDRAM per line of text, and the screen size in characters
+static uint16_t pitch, rows, columns;
+
+// GDDRAM row shown at the top of the screen, and the cursor
+static uint16_t scroll, row, column;
+
+// Characters written to the current line but not yet drawn, so that
+// they can be drawn together through one window
+static char pending[MAX_COLUMNS + 1];
+static uint16_t pending_column, pending_count;
+
+uint16_t static line_y(uint16_t line) {
+  return (scroll + line * pitch) % TFT_HEIGHT;
+}
+
+void static flush(void) {
+  if (!pending_count) {
+    return;
+  }
+
+  pending[pending_count] = '\0';
+  TFT_string(font, pending, pending_column * (glyph_width + 1),
+             line_y(row), fg, bg, glyph_width, glyph_height);
+  pending_count = 0;
+}
+
+void static newline(void) {
+  flush();
+  column = 0;
+
+  if (row < rows - 1) {
+    ++row;
+    return;
+  }
+
+  // The screen is full: the top line's rows of GDDRAM become the new
+  // bottom line, which only needs clearing before scrolling onto it
+  scroll = (scroll + pitch) % TFT_HEIGHT;
+  TFT_fill_rect(0, line_y(row), TFT_WIDTH, pitch, bg);
+  TFT_scroll(scroll);
+}
+
+void static put(char c) {
+  if (c == '\n') {
+    newline();
+    return;
+  }
+  if (c == '\r') {
+    flush();
+    column = 0;
+    return;
+  }
+
+  if (column == columns) {
+    newline();
+  }
+  if (c < ' ' || c > '~') {
+    c = '?';
+  }
+
+  if (!pending_count) {
+    pending_column = column;
+  }
+  pending[pending_count++] = c;
+  ++column;
+}
+
+void console_init(const uint8_t *new_font, uint16_t width, uint16_t height,
+                  uint16_t fg_color, uint16_t bg_color) {
+  font = new_font;
+  glyph_width = width;
+  glyph_height = height;
+  fg = fg_color;
+  bg = bg_color;
+
+  // The closest spacing, of at least one row, which divides GDDRAM
+  for (pitch = height + 1; TFT_HEIGHT % pitch; ++pitch)
+    ;
+  rows = TFT_HEIGHT / pitch;
+
+  columns = (TFT_WIDTH + 1) / (width + 1);
+  if (columns > MAX_COLUMNS) {
+    columns = MAX_COLUMNS;
+  }
+
+  console_clear();
+}
+
+void console_clear(void) {
+  pending_count = 0;
+  scroll = row = column = 0;
+
+  TFT_scroll(0);
+  TFT_fill(bg);
+}
+
+void console_putc(char c) {
+  put(c);
+  flush();
+}
+
+void console_puts(const char *s) {
+  while (*s) {
+    put(*s++);
+  }
+  flush();
+}
@@ -0,0 +1,42 @@
+/* console.h
+ *
+ * Declares a scrolling text console on the SSD1289, for logging on
+ * the device. The console takes over the whole panel: new lines are
+ * drawn into GDDRAM below the last one, and once the screen is full
+ * the panel's vertical scroll (register 0x41) is moved on by a line
+ * instead of redrawing the text, so each new line only costs clearing
+ * and drawing that one line.
+ *
+ * Lines are spaced so that a whole number of them fills the 320 rows
+ * of GDDRAM (10 rows for FONT_8x8, 20 for FONT_16x16), so that no line
+ * wraps around the bottom of GDDRAM.
+ */
+
+#ifndef __CONSOLE_h_
+#define __CONSOLE_h_
+
+/* Provides uintN_t, uint_fastN_t, etc. (for N {8,16,32}) */
+#include <stdint.h>
+
+#include "ssd1289.h"
+
+/* console_init(font, width, height, fg_color, bg_color)
+ * Clears the panel and starts the console at its top left, writing
+ * with the given font (of width by height glyphs, e.g. FONT_8x8, 8, 8).
+ */
+void console_init(const uint8_t *font, uint16_t width, uint16_t height,
+                  uint16_t fg_color, uint16_t bg_color);
+
+/* console_clear()
+ * Clears the panel, and returns to its top left.
+ */
+void console_clear(void);
+
+/* console_putc(c), console_puts(s)
+ * Write text at the cursor. '\n' starts a new line, '\r' returns to
+ * the start of the line, and long lines wrap.
+ */
+void console_putc(char c);
+void console_puts(const char *s);
+
+#endif
@@ -7,6 +7,18 @@
 
 #include "UMDLPC/util/pins.h"
 
+/* Uncomment to shift data out to the TFT's shift register with SSP1
+ * (SCK1 on P0.7, MOSI1 on P0.9) instead of bit banging it. The latch
+ * and WR are still strobed over GPIO.
+ */
+// #define TFT_SHIFT_SSP1
+
+/* Or uncomment to also wire SSEL1 (P0.6) to both the shift register
+ * latch and the TFT's WR line, which lets pixel runs be streamed to
+ * the TFT by DMA (see ssd1289.c).
+ */
+// #define TFT_SHIFT_SSP1_SSEL
+
 DEFINE_PIN(TFT_RS, 2, 12);
 DEFINE_PIN(TFT_WR, 2, 11);
 DEFINE_PIN(TFT_RD, 2, 10);
@@ -17,17 +29,20 @@ DEFINE_PIN(TFT_SHIFT_DATA, 2, 6);
 DEFINE_PIN(TFT_SHIFT_CLOCK, 2, 5);
 DEFINE_PIN(TFT_SHIFT_LATCH, 2, 4);
 
-/*
+#if defined(TFT_SHIFT_SSP1) || defined(TFT_SHIFT_SSP1_SSEL)
+// The SSP1 pins are taken by the TFT
 DEFINE_PIN(TOUCH_CLK, 2, 3);
 DEFINE_PIN(TOUCH_IN, 2, 1);
 DEFINE_PIN(TOUCH_BUSY, 0, 11);
 DEFINE_PIN(TOUCH_OUT, 2, 2);
 DEFINE_PIN(TOUCH_PENIRQ, 2, 0);
-*/
-
+#else
+// The touch controller is on SSP1's pins, so it's read with SSP1
+#define TOUCH_SSP1
 DEFINE_PIN(TOUCH_CLK, 0, 7);
 DEFINE_PIN(TOUCH_IN, 0, 9);
 DEFINE_PIN(TOUCH_OUT, 0, 8);
 DEFINE_PIN(TOUCH_PENIRQ, 2, 13);
+#endif
 
 #endif
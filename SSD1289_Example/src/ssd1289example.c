@@ -10,14 +10,71 @@
 
 #include "ssd1289example.h"
 #include "ssd1289.h"
+#include "tilefb.h"
 #include "touch.h"
 #include "fonts.h"
 
+#include <stdio.h>
+
+// Uncomment to measure fill rates at startup
+// #define TFT_BENCHMARK
+#define TFT_BENCHMARK_FRAMES 10
+#define TFT_BENCHMARK_RECTS 1000
+#define TFT_BENCHMARK_LINES 20
+
 // Variable to store CRP value in. Will be placed automatically
 // by the linker when "Enable Code Read Protect" selected.
 // See crp.h header for more information
 __CRP const unsigned int CRP_WORD = CRP_NO_CRP;
 
+#ifdef TFT_BENCHMARK
+// Times TFT_BENCHMARK_FRAMES full screen fills against the free
+// running sleep counter (which counts CPU cycles), and returns the
+// fill rate in tenths of a frame per second.
+uint32_t benchmark_fill(void) {
+  uint64_t cycles = 0;
+  uint32_t start;
+
+  for (uint_fast8_t i = 0; i < TFT_BENCHMARK_FRAMES; ++i) {
+    start = sleep_counter();
+    TFT_fill((i & 1) ? 0x0000 : 0xFFFF);
+    cycles += sleep_counter() - start;
+  }
+
+  return (uint64_t) TFT_BENCHMARK_FRAMES * 10 * SystemCoreClock / cycles;
+}
+
+// Times TFT_BENCHMARK_RECTS 16x16 rectangle fills, where setting up
+// the window is a large part of the cost, and returns the fill rate in
+// thousands of pixels per second.
+uint32_t benchmark_rects(void) {
+  uint32_t start = sleep_counter(), cycles;
+
+  for (uint_fast16_t i = 0; i < TFT_BENCHMARK_RECTS; ++i) {
+    TFT_fill_rect((i * 16) % TFT_WIDTH, (i * 48) % TFT_HEIGHT, 16, 16, i);
+  }
+  cycles = sleep_counter() - start;
+
+  return (uint64_t) TFT_BENCHMARK_RECTS * 16 * 16 * SystemCoreClock
+    / 1000 / cycles;
+}
+
+// Times drawing a sentence TFT_BENCHMARK_LINES times in the given font,
+// and returns the rate in glyphs per second.
+uint32_t benchmark_glyphs(const uint8_t *font, uint16_t size) {
+  static const char text[] = "The quick brown fox jumps over the lazy dog";
+  uint32_t start = sleep_counter(), cycles;
+
+  for (uint_fast8_t i = 0; i < TFT_BENCHMARK_LINES; ++i) {
+    TFT_string(font, text, 0, 0, i, 0xFFFF, size, size);
+  }
+  cycles = sleep_counter() - start;
+
+  return (uint64_t) TFT_BENCHMARK_LINES * (sizeof(text) - 1)
+    * SystemCoreClock / cycles;
+}
+#endif
+
 int main(void) {
   // Select 12MHz crystal oscillator
   LPC_SC ->CLKSRCSEL = 1;
@@ -30,39 +87,63 @@ int main(void) {
   TFT_init();
   touch_init();
 
-  TFT_fill(0xffff);
-  TFT_box_outline(2, 2, 91, 22, 2, 0x0000);
+#ifdef TFT_BENCHMARK
+  uint32_t fps_tenths = benchmark_fill();
+  uint32_t rect_kpps = benchmark_rects();
+  uint32_t glyphs_8 = benchmark_glyphs(FONT_8x8, 8);
+  uint32_t glyphs_16 = benchmark_glyphs(FONT_16x16, 16);
+#endif
+
+  FB_init(0xffff);
+  FB_box_outline(2, 2, 91, 22, 2, 0x0000);
+
+  FB_char(FONT_16x16, 'C', 5, 5, 0, 0xFFFF, 16, 16);
+  FB_char(FONT_16x16, 'l', 22, 5, 0, 0xFFFF, 16, 16);
+  FB_char(FONT_16x16, 'e', 39, 5, 0, 0xFFFF, 16, 16);
+  FB_char(FONT_16x16, 'a', 56, 5, 0, 0xFFFF, 16, 16);
+  FB_char(FONT_16x16, 'r', 73, 5, 0, 0xFFFF, 16, 16);
+  FB_flush();
 
-  TFT_char(FONT_16x16, 'C', 5, 5, 0, 0xFFFF, 16, 16);
-  TFT_char(FONT_16x16, 'l', 22, 5, 0, 0xFFFF, 16, 16);
-  TFT_char(FONT_16x16, 'e', 39, 5, 0, 0xFFFF, 16, 16);
-  TFT_char(FONT_16x16, 'a', 56, 5, 0, 0xFFFF, 16, 16);
-  TFT_char(FONT_16x16, 'r', 73, 5, 0, 0xFFFF, 16, 16);
+#ifdef TFT_BENCHMARK
+  char result[28];
+  snprintf(result, sizeof(result), "fill: %lu.%lu fps %lu kpx/s",
+           (unsigned long) fps_tenths / 10, (unsigned long) fps_tenths % 10,
+           (unsigned long) fps_tenths * TFT_WIDTH * TFT_HEIGHT / 10000);
+  TFT_string(FONT_8x8, result, 5, 290, 0, 0xFFFF, 8, 8);
+  snprintf(result, sizeof(result), "16x16 rects: %lu kpx/s",
+           (unsigned long) rect_kpps);
+  TFT_string(FONT_8x8, result, 5, 300, 0, 0xFFFF, 8, 8);
+  snprintf(result, sizeof(result), "glyphs/s: %lu %lu",
+           (unsigned long) glyphs_8, (unsigned long) glyphs_16);
+  TFT_string(FONT_8x8, result, 5, 310, 0, 0xFFFF, 8, 8);
+#endif
 
   uint16_t x, y, box_x1=0xFFFF, box_x2, box_y1, box_y2;
   while(1) {
-    if (touch_available()) {
-      touch_read(&x, &y);
-
+    if (touch_read(&x, &y)) {
       box_x1 = (x >= 1)? (x-1) : 0;
       box_x2 = (x <= 238)? (x+1) : 239;
 
       box_y1 = (y >= 1)? (y-1) : 0;
       box_y2 = (y <= 318)? (y+1) : 319;
 
-      TFT_draw_box(box_x1, box_y1, box_x2, box_y2, 61);
+      FB_fill_rect(box_x1, box_y1, box_x2 - box_x1 + 1,
+                   box_y2 - box_y1 + 1, 61);
 
       if (x > 2 && x < 92 && y > 2 && y < 24) {
-        TFT_fill(0xFFFF);
+        // Only the tiles that were drawn on go out to the panel again
+        FB_fill(0xFFFF);
 
-        TFT_box_outline(2,2,92,24,2,0);
+        FB_box_outline(2,2,92,24,2,0);
 
-        TFT_char(FONT_16x16, 'C', 5, 5, 0, 0xFFFF, 16, 16);
-        TFT_char(FONT_16x16, 'l', 22, 5, 0, 0xFFFF, 16, 16);
-        TFT_char(FONT_16x16, 'e', 39, 5, 0, 0xFFFF, 16, 16);
-        TFT_char(FONT_16x16, 'a', 56, 5, 0, 0xFFFF, 16, 16);
-        TFT_char(FONT_16x16, 'r', 73, 5, 0, 0xFFFF, 16, 16);
+        FB_char(FONT_16x16, 'C', 5, 5, 0, 0xFFFF, 16, 16);
+        FB_char(FONT_16x16, 'l', 22, 5, 0, 0xFFFF, 16, 16);
+        FB_char(FONT_16x16, 'e', 39, 5, 0, 0xFFFF, 16, 16);
+        FB_char(FONT_16x16, 'a', 56, 5, 0, 0xFFFF, 16, 16);
+        FB_char(FONT_16x16, 'r', 73, 5, 0, 0xFFFF, 16, 16);
       }
+
+      FB_flush();
     }
   }
 
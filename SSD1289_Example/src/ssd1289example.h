@@ -12,6 +12,7 @@
 #include <NXP/crp.h>
 
 #include "UMDLPC/system/clocking.h"
+#include "UMDLPC/system/sleep.h"
 #include "pins.h"
 
 #define _BV(n) (1 << (n))
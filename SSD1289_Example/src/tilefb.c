@@ -0,0 +1,332 @@
+#include "tilefb.h"
+
+#define FB_TILES (FB_COLUMNS * FB_ROWS)
+#define FB_TILE_PIXELS (FB_TILE_SIZE * FB_TILE_SIZE)
+
+#if FB_POOL_TILES > 32
+#error "FB_POOL_TILES must be at most 32"
+#endif
+
+// Values of Tile.slot other than a pool buffer index
+#define SOLID  0xFE
+#define DIRECT 0xFF
+
+typedef struct {
+  uint16_t color;  // the tile's color, when SOLID
+  uint8_t slot;    // pool buffer holding the tile, SOLID or DIRECT
+
+  // The changed area in tile coordinates, empty when x1 > x2
+  uint8_t x1, y1, x2, y2;
+} Tile;
+
+static Tile tiles[FB_TILES];
+
+// In the AHB SRAM, leaving the local SRAM to the stack and the audio
+// buffers: the linker scripts place .bss.$RamAHB32 there (as
+// __BSS(RAM2) does), and zero it at startup
+__attribute__ ((section(".bss.$RamAHB32")))
+static uint16_t pool[FB_POOL_TILES][FB_TILE_PIXELS];
+static uint32_t pool_used;
+
+// The tile each buffer holds, and when it was last drawn on
+static uint16_t pool_tile[FB_POOL_TILES];
+static uint32_t pool_drawn[FB_POOL_TILES], draw_count;
+
+uint32_t static flush_tile(uint_fast16_t t);
+
+// Takes a free buffer for tile t. When there are none, the buffer
+// drawn on least recently is taken over: its tile is flushed and left
+// to be drawn on directly, so that the buffers stay with the tiles
+// which keep changing.
+uint_fast8_t static pool_alloc(uint_fast16_t t) {
+  uint_fast8_t i, oldest = 0;
+
+  for (i = 0; i < FB_POOL_TILES; ++i) {
+    if (!(pool_used & (1UL << i))) {
+      pool_used |= (1UL << i);
+      pool_tile[i] = t;
+      return i;
+    }
+
+    if (draw_count - pool_drawn[i] > draw_count - pool_drawn[oldest]) {
+      oldest = i;
+    }
+  }
+
+  flush_tile(pool_tile[oldest]);
+  tiles[pool_tile[oldest]].slot = DIRECT;
+  pool_tile[oldest] = t;
+  return oldest;
+}
+
+void static mark_clean(Tile *tile) {
+  tile->x1 = tile->y1 = FB_TILE_SIZE;
+  tile->x2 = tile->y2 = 0;
+}
+
+void static mark_dirty(Tile *tile, uint_fast8_t x1, uint_fast8_t y1,
+                       uint_fast8_t x2, uint_fast8_t y2) {
+  if (x1 < tile->x1) tile->x1 = x1;
+  if (y1 < tile->y1) tile->y1 = y1;
+  if (x2 > tile->x2) tile->x2 = x2;
+  if (y2 > tile->y2) tile->y2 = y2;
+}
+
+uint_fast8_t static whole_tile(uint_fast8_t x1, uint_fast8_t y1,
+                               uint_fast8_t x2, uint_fast8_t y2) {
+  return x1 == 0 && y1 == 0
+    && x2 == FB_TILE_SIZE - 1 && y2 == FB_TILE_SIZE - 1;
+}
+
+// Sends the changed area of tile t to the panel, returns the number of
+// pixels written
+uint32_t static flush_tile(uint_fast16_t t) {
+  Tile *tile = &tiles[t];
+  uint16_t x, y, w, h;
+
+  if (tile->x1 > tile->x2) {
+    return 0;
+  }
+
+  x = (t % FB_COLUMNS) * FB_TILE_SIZE + tile->x1;
+  y = (t / FB_COLUMNS) * FB_TILE_SIZE + tile->y1;
+  w = tile->x2 - tile->x1 + 1;
+  h = tile->y2 - tile->y1 + 1;
+
+  if (tile->slot == SOLID) {
+    TFT_fill_rect(x, y, w, h, tile->color);
+  } else if (tile->slot < FB_POOL_TILES) {
+    TFT_blit(x, y, w, h,
+             &pool[tile->slot][tile->y1 * FB_TILE_SIZE + tile->x1],
+             FB_TILE_SIZE);
+  }
+
+  mark_clean(tile);
+  return (uint32_t) w * h;
+}
+
+// Fills the area x1..x2, y1..y2 (inclusive, in tile coordinates) of
+// tile t
+void static tile_fill(uint_fast16_t t, uint_fast8_t x1, uint_fast8_t y1,
+                      uint_fast8_t x2, uint_fast8_t y2, uint16_t color) {
+  Tile *tile = &tiles[t];
+  uint16_t *row;
+  uint_fast16_t i;
+  uint_fast8_t x, y, slot, changed = 0;
+
+  if (whole_tile(x1, y1, x2, y2)) {
+    if (tile->slot == SOLID && tile->color == color) {
+      return;
+    }
+
+    if (tile->slot < FB_POOL_TILES) {
+      pool_used &= ~(1UL << tile->slot);
+    }
+    tile->slot = SOLID;
+    tile->color = color;
+    mark_dirty(tile, x1, y1, x2, y2);
+    return;
+  }
+
+  if (tile->slot == SOLID) {
+    if (tile->color == color) {
+      return;
+    }
+
+    slot = pool_alloc(t);
+    for (i = 0; i < FB_TILE_PIXELS; ++i) {
+      pool[slot][i] = tile->color;
+    }
+    tile->slot = slot;
+  }
+
+  if (tile->slot == DIRECT) {
+    TFT_fill_rect((t % FB_COLUMNS) * FB_TILE_SIZE + x1,
+                  (t / FB_COLUMNS) * FB_TILE_SIZE + y1,
+                  x2 - x1 + 1, y2 - y1 + 1, color);
+    return;
+  }
+
+  pool_drawn[tile->slot] = ++draw_count;
+
+  for (y = y1; y <= y2; ++y) {
+    row = &pool[tile->slot][y * FB_TILE_SIZE];
+    for (x = x1; x <= x2; ++x) {
+      if (row[x] != color) {
+        row[x] = color;
+        changed = 1;
+      }
+    }
+  }
+
+  // Redrawing what is already there costs nothing at the next flush
+  if (changed) {
+    mark_dirty(tile, x1, y1, x2, y2);
+  }
+}
+
+void FB_init(uint16_t color) {
+  uint_fast16_t t;
+
+  pool_used = 0;
+  for (t = 0; t < FB_TILES; ++t) {
+    tiles[t].slot = SOLID;
+    tiles[t].color = color;
+    mark_dirty(&tiles[t], 0, 0, FB_TILE_SIZE - 1, FB_TILE_SIZE - 1);
+  }
+}
+
+void FB_invalidate(void) {
+  uint_fast16_t t;
+
+  for (t = 0; t < FB_TILES; ++t) {
+    if (tiles[t].slot != DIRECT) {
+      mark_dirty(&tiles[t], 0, 0, FB_TILE_SIZE - 1, FB_TILE_SIZE - 1);
+    }
+  }
+}
+
+uint32_t FB_flush(void) {
+  uint_fast16_t row, col, run, t;
+  uint32_t pixels = 0;
+  Tile *tile;
+
+  for (row = 0; row < FB_ROWS; ++row) {
+    for (col = 0; col < FB_COLUMNS; col += run) {
+      t = row * FB_COLUMNS + col;
+      tile = &tiles[t];
+      run = 1;
+
+      if (tile->slot != SOLID
+          || !whole_tile(tile->x1, tile->y1, tile->x2, tile->y2)) {
+        pixels += flush_tile(t);
+        continue;
+      }
+
+      // Neighbouring tiles cleared to the same color go out as one
+      // rectangle, so clearing the screen is a single fill
+      while (col + run < FB_COLUMNS
+             && tile[run].slot == SOLID && tile[run].color == tile->color
+             && whole_tile(tile[run].x1, tile[run].y1,
+                           tile[run].x2, tile[run].y2)) {
+        ++run;
+      }
+
+      TFT_fill_rect(col * FB_TILE_SIZE, row * FB_TILE_SIZE,
+                    run * FB_TILE_SIZE, FB_TILE_SIZE, tile->color);
+      pixels += (uint32_t) run * FB_TILE_PIXELS;
+
+      for (t = 0; t < run; ++t) {
+        mark_clean(&tile[t]);
+      }
+    }
+  }
+
+  return pixels;
+}
+
+void FB_fill_rect(int16_t x, int16_t y, int16_t w, int16_t h,
+                  uint16_t color) {
+  int16_t x2, y2, left, top;
+  uint_fast8_t tx, ty;
+
+  if (x < 0) {
+    w += x;
+    x = 0;
+  }
+  if (y < 0) {
+    h += y;
+    y = 0;
+  }
+  if (x + w > TFT_WIDTH) {
+    w = TFT_WIDTH - x;
+  }
+  if (y + h > TFT_HEIGHT) {
+    h = TFT_HEIGHT - y;
+  }
+  if (w <= 0 || h <= 0) {
+    return;
+  }
+
+  x2 = x + w - 1;
+  y2 = y + h - 1;
+
+  for (ty = y / FB_TILE_SIZE; ty <= y2 / FB_TILE_SIZE; ++ty) {
+    top = ty * FB_TILE_SIZE;
+
+    for (tx = x / FB_TILE_SIZE; tx <= x2 / FB_TILE_SIZE; ++tx) {
+      left = tx * FB_TILE_SIZE;
+
+      tile_fill(ty * FB_COLUMNS + tx,
+                (x > left ? x : left) - left,
+                (y > top ? y : top) - top,
+                (x2 < left + FB_TILE_SIZE - 1 ? x2 : left + FB_TILE_SIZE - 1)
+                  - left,
+                (y2 < top + FB_TILE_SIZE - 1 ? y2 : top + FB_TILE_SIZE - 1)
+                  - top,
+                color);
+    }
+  }
+}
+
+void FB_fill(uint16_t color) {
+  FB_fill_rect(0, 0, TFT_WIDTH, TFT_HEIGHT, color);
+}
+
+void FB_box_outline(uint16_t x1, uint16_t y1, uint16_t x2,
+                    uint16_t y2, uint16_t width, uint16_t color) {
+  FB_fill_rect(x1, y1, x2 - x1 + 1, width, color);
+
+  FB_fill_rect(x1, y1 + width, width, y2 - y1 + 1 - 2 * width, color);
+  FB_fill_rect(x2 - width + 1, y1 + width,
+               width, y2 - y1 + 1 - 2 * width, color);
+
+  FB_fill_rect(x1, y2 - width + 1, x2 - x1 + 1, width, color);
+}
+
+void FB_dot(uint16_t x, uint16_t y, uint16_t color) {
+  FB_fill_rect(x, y, 1, 1, color);
+}
+
+void FB_char(const uint8_t *font, uint8_t ch,
+             uint16_t x, uint16_t y,
+             uint16_t fg_color, uint16_t bg_color,
+             uint16_t width, uint16_t height) {
+  const uint8_t *bmp_addr = font + ((ch - ' ')*height*(width/8));
+  uint16_t row, col, start, color, run_color;
+
+  // Each row of the glyph is drawn as runs of one color
+  for (row = 0; row < height; ++row, bmp_addr += width / 8) {
+    start = 0;
+    run_color = color = (bmp_addr[0] & 0x80) ? fg_color : bg_color;
+
+    for (col = 1; col <= width; ++col) {
+      if (col < width) {
+        color = (bmp_addr[col / 8] & (0x80 >> (col % 8)))
+          ? fg_color : bg_color;
+        if (color == run_color) {
+          continue;
+        }
+      }
+
+      FB_fill_rect(x + start, y + row, col - start, 1, run_color);
+      start = col;
+      run_color = color;
+    }
+  }
+}
+
+void FB_string(const uint8_t *font, const char * s,
+               uint16_t x, uint16_t y,
+               uint16_t fg_color, uint16_t bg_color,
+               uint16_t width, uint16_t height) {
+  while (*s) {
+    FB_char(font, *s, x, y, fg_color, bg_color, width, height);
+    ++s;
+    x += width + 1;
+    if (x > (TFT_WIDTH - width)) {
+      x = 0;
+      y += height + 1;
+    }
+  }
+}
@@ -0,0 +1,65 @@
+/* tilefb.h
+ *
+ * Declares a damage tracking framebuffer for the SSD1289. The panel is
+ * cut into 16x16 tiles; a tile which is one color is stored as just
+ * that color, and only tiles with detail on them take one of a small
+ * pool of pixel buffers (kept in the AHB SRAM). Drawing calls only
+ * touch the framebuffer and record which part of each tile changed,
+ * and FB_flush() then sends just those parts to the panel.
+ *
+ * If the pool runs out, the buffer drawn on least recently is flushed
+ * and given up, and its tile is written through to the panel directly
+ * from then on, until it is next filled with one color.
+ */
+
+#ifndef __TILEFB_h_
+#define __TILEFB_h_
+
+/* Provides uintN_t, uint_fastN_t, etc. (for N {8,16,32}) */
+#include <stdint.h>
+
+#include "ssd1289.h"
+
+#define FB_TILE_SIZE 16
+#define FB_COLUMNS (TFT_WIDTH / FB_TILE_SIZE)
+#define FB_ROWS (TFT_HEIGHT / FB_TILE_SIZE)
+
+/* Number of tile pixel buffers, at 512 bytes each. At most 32. */
+#ifndef FB_POOL_TILES
+#define FB_POOL_TILES 24
+#endif
+
+/* FB_init(color)
+ * Clears the framebuffer to color, and marks all of it to be flushed.
+ */
+void FB_init(uint16_t color);
+
+/* FB_invalidate()
+ * Marks the whole framebuffer to be flushed, e.g. after drawing to the
+ * panel with the TFT_ functions.
+ */
+void FB_invalidate(void);
+
+/* FB_flush()
+ * Sends the changed parts of the framebuffer to the panel. Returns the
+ * number of pixels written.
+ */
+uint32_t FB_flush(void);
+
+void FB_fill_rect(int16_t x, int16_t y, int16_t w, int16_t h,
+                  uint16_t color);
+void FB_fill(uint16_t color);
+void FB_box_outline(uint16_t x1, uint16_t y1, uint16_t x2,
+                    uint16_t y2, uint16_t width, uint16_t color);
+void FB_dot(uint16_t x, uint16_t y, uint16_t color);
+
+void FB_string(const uint8_t *font, const char * s,
+               uint16_t x, uint16_t y,
+               uint16_t fg_color, uint16_t bg_color,
+               uint16_t width, uint16_t height);
+void FB_char(const uint8_t *font, uint8_t ch,
+             uint16_t x, uint16_t y,
+             uint16_t fg_color, uint16_t bg_color,
+             uint16_t width, uint16_t height);
+
+#endif
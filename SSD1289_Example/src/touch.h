@@ -1,3 +1,35 @@
+/* touch.h
+ *
+ * Declares the driver for the touch screen controller (an ADS7843 or
+ * XPT2046, bit banged), which is read in the background.
+ *
+ * A falling edge on PENIRQ (a GPIO interrupt, so the pin must be on
+ * port 0 or 2) starts TIMER1 ticking every TOUCH_SAMPLE_US. Each tick
+ * takes one x/y reading, and every TOUCH_SAMPLES readings make an
+ * event in a queue. Once the pen is lifted, a release event is
+ * queued, the timer is stopped and PENIRQ is armed again. So the main
+ * loop never waits on the controller, and a touch is reported
+ * TOUCH_SAMPLES + 1 ticks after it lands.
+ *
+ * The position of each event is the median of its readings, smoothed
+ * by a first order IIR filter over the events since the pen went
+ * down. A reading of 0, which the controller gives as the pen is
+ * lifted, throws the rest of its batch away, so no conversions are
+ * spent finishing a batch that would be filtered out.
+ *
+ * Readings are mapped to the screen by an affine calibration, which
+ * can be worked out from where three points on the screen read (see
+ * touch_calibration_solve).
+ *
+ * With TOUCH_SSP1 defined (in pins.h, with the controller's clock, in
+ * and out on SCK1, MOSI1 and MISO1), the controller is read over SSP1
+ * instead of bit banged: each tick is TOUCH_SAMPLES times longer, and
+ * starts DMA reading a whole batch of samples, which is made into an
+ * event on the next tick. A touch is then reported one tick (2.5ms)
+ * after it lands, and reading it takes a few microseconds of CPU time
+ * rather than hundreds.
+ */
+
 #ifndef __TOUCH_h
 #define __TOUCH_h
 
@@ -5,9 +37,72 @@
 
 #include "pins.h"
 
+#define TOUCH_SAMPLE_US 500
+#define TOUCH_SAMPLES 5
+
+/* Each event moves the smoothed position 1/2^TOUCH_SMOOTHING of the
+ * way to its median
+ */
+#define TOUCH_SMOOTHING 1
+
+#define TOUCH_WIDTH 240
+#define TOUCH_HEIGHT 320
+
+/* Events which can be queued; more are dropped until there's room */
+#define TOUCH_QUEUE_LEN 8
+
+typedef struct {
+  uint16_t x, y;          /* screen position */
+  uint16_t raw_x, raw_y;  /* filtered readings the position is from */
+  uint16_t pressure;      /* bigger is harder, 0 when the pen is lifted */
+  uint32_t time;          /* sleep_counter() when the event was made */
+} TouchEvent;
+
+typedef struct {
+  int32_t x, y;
+} TouchPoint;
+
+/* Maps readings to the screen:
+ *   x = (a * raw_x + b * raw_y + c) / divider
+ *   y = (d * raw_x + e * raw_y + f) / divider
+ */
+typedef struct {
+  int64_t a, b, c, d, e, f, divider;
+} TouchCalibration;
+
+/* touch_init()
+ * Sets up the pins, TIMER1, and the PENIRQ interrupt. The core clock
+ * must be set up first.
+ */
 void touch_init(void);
 
-uint_fast8_t touch_read(uint16_t *out_x, uint16_t *out_y);
+/* touch_calibration_solve(screen, raw, out)
+ * Works out the calibration which maps the three readings in raw to
+ * the three screen points. Returns 0 if the points are in a line.
+ */
+uint_fast8_t touch_calibration_solve(const TouchPoint screen[3],
+                                     const TouchPoint raw[3],
+                                     TouchCalibration *out);
+
+/* touch_set_calibration(calibration)
+ * Uses calibration for events from now on.
+ */
+void touch_set_calibration(const TouchCalibration *calibration);
+
+/* touch_available()
+ * Returns whether there are events queued.
+ */
 uint_fast8_t touch_available(void);
 
+/* touch_get(event)
+ * Takes the oldest queued event. Returns 0 if there are none.
+ */
+uint_fast8_t touch_get(TouchEvent *event);
+
+/* touch_read(out_x, out_y)
+ * Takes queued events up to and including the next press, giving its
+ * position. Returns 0 if no press was queued.
+ */
+uint_fast8_t touch_read(uint16_t *out_x, uint16_t *out_y);
+
 #endif
@@ -0,0 +1,73 @@
+/* Host stand-ins for the parts of the UMDLPC library used by the
+ * simulated drivers. Delays return at once, and are only accounted
+ * for by the simulator. The SD card is a file.
+ */
+
+#include "LPC17xx.h"
+#include "UMDLPC/system/sleep.h"
+#include "UMDLPC/system/delay.h"
+#include "ssd1289sim.h"
+#include "host.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#define SD_BLOCK_LEN 512
+
+// The clock the driver's bus timings are worked out for
+uint32_t SystemCoreClock = 100000000;
+
+void sleep_init(void) {
+}
+
+void sleep_delay_cycles(uint32_t cycles) {
+  sim_delay_us(cycles / (SystemCoreClock / 1000000));
+}
+
+void sleep_delay_us(uint32_t us) {
+  sim_delay_us(us);
+}
+
+void sleep_delay_ms(uint32_t ms) {
+  sim_delay_us(ms * 1000);
+}
+
+uint32_t sleep_counter(void) {
+  return 0;
+}
+
+void delay_init(void) {
+}
+
+uint32_t delay_ns_to_cycles(uint32_t ns) {
+  return ns * (SystemCoreClock / 1000000) / 1000;
+}
+
+// The bus timings aren't modelled, so the delays return at once
+void delay_cycles(uint32_t cycles) {
+}
+
+static FILE *card;
+uint32_t host_blocks_read;
+
+int host_card_open(const char *path) {
+  card = fopen(path, "rb");
+  return card ? 0 : -1;
+}
+
+// Blocks past the end of the card file read as zeros
+char sd_read_block(uint8_t *block, uint32_t block_num) {
+  size_t got = 0;
+
+  if (!card) {
+    return 0;
+  }
+
+  if (!fseek(card, (long) block_num * SD_BLOCK_LEN, SEEK_SET)) {
+    got = fread(block, 1, SD_BLOCK_LEN, card);
+  }
+  memset(block + got, 0, SD_BLOCK_LEN - got);
+
+  ++host_blocks_read;
+  return 1;
+}
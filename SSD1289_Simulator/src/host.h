@@ -0,0 +1,20 @@
+/* host.h
+ *
+ * Declares the host side of the stand-ins in host.c.
+ */
+
+#ifndef __HOST_h_
+#define __HOST_h_
+
+#include <stdint.h>
+
+/* host_card_open(path)
+ * Backs sd_read_block with the file at path, as block 0 onwards.
+ * Returns 0 on success.
+ */
+int host_card_open(const char *path);
+
+/* Blocks read through sd_read_block */
+extern uint32_t host_blocks_read;
+
+#endif
@@ -0,0 +1,29 @@
+/* LPC17xx.h
+ *
+ * Stands in for the CMSIS device header in host builds. Only what the
+ * simulated drivers refer to is declared; GPIO goes through the
+ * simulator instead (see UMDLPC/util/pins.h next to this file).
+ */
+
+#ifndef __LPC17xx_H__
+#define __LPC17xx_H__
+
+#include <stdint.h>
+
+extern uint32_t SystemCoreClock;
+
+typedef struct {
+  volatile uint32_t DMACCSrcAddr;
+  volatile uint32_t DMACCDestAddr;
+  volatile uint32_t DMACCLLI;
+  volatile uint32_t DMACCControl;
+  volatile uint32_t DMACCConfig;
+} LPC_GPDMACH_TypeDef;
+
+/* Masking only; nothing interrupts the drivers (see Host/src/irq.c) */
+uint32_t __get_PRIMASK(void);
+void __set_PRIMASK(uint32_t primask);
+void __disable_irq(void);
+void __enable_irq(void);
+
+#endif
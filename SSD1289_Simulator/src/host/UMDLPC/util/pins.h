@@ -0,0 +1,54 @@
+/* pins.h
+ *
+ * Host version of UMDLPC/util/pins.h: DEFINE_PIN defines the same
+ * functions, but they drive the simulator's signals, looked up by the
+ * pin's name. Pins the simulator doesn't know about read as 0 and
+ * ignore writes.
+ */
+
+#ifndef __UMDLPC_util_pins_h_
+#define __UMDLPC_util_pins_h_
+
+#include <stdint.h>
+
+#include "ssd1289sim.h"
+
+// Resolves the pin's signal once per function
+#define SIM_SIGNAL(name) \
+  static int signal = -1; \
+  if (signal < 0) { \
+    signal = sim_signal(#name); \
+  }
+
+#define DEFINE_PIN(name, port, pin) \
+inline static void name##_DEASSERT() { \
+  SIM_SIGNAL(name) sim_pin_write(signal, 0); \
+} \
+inline static void name##_OFF() { \
+  SIM_SIGNAL(name) sim_pin_write(signal, 0); \
+} \
+inline static void name##_LOW() { \
+  SIM_SIGNAL(name) sim_pin_write(signal, 0); \
+} \
+inline static void name##_ASSERT() { \
+  SIM_SIGNAL(name) sim_pin_write(signal, 1); \
+} \
+inline static void name##_ON() { \
+  SIM_SIGNAL(name) sim_pin_write(signal, 1); \
+} \
+inline static void name##_HIGH() { \
+  SIM_SIGNAL(name) sim_pin_write(signal, 1); \
+} \
+inline static void name##_TOGGLE() { \
+  SIM_SIGNAL(name) sim_pin_write(signal, !sim_pin_read(signal)); \
+} \
+inline static void name##_INPUT() { \
+} \
+inline static void name##_OUTPUT() { \
+} \
+inline static uint_fast8_t name##_READ() { \
+  SIM_SIGNAL(name) return sim_pin_read(signal); \
+} \
+enum { name##_PORT_NUM = port, name##_PIN_NUM = pin }
+
+#endif
@@ -0,0 +1,229 @@
+/*
+ ===============================================================================
+ Name        : main.c
+ Description :
+
+   Runs the SSD1289 driver against the simulated panel, through a set
+   of typical drawing scenes, and reports the bus transactions each
+   one took. These counts don't depend on the host, so they can be
+   compared between changes to the driver.
+
+   Usage: ssd1289sim [output directory] [card image]
+
+   With an output directory, the panel is also saved as <scene>.ppm
+   after each scene. With a card image (e.g. a .tfi file from
+   ImageConverter), the image stored at its block 0 is drawn by
+   TFT_image as one more scene.
+
+ ===============================================================================
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "ssd1289.h"
+#include "tilefb.h"
+#include "console.h"
+#include "fonts.h"
+#include "tftimage.h"
+#include "scope.h"
+#include "spectrum.h"
+#include "ssd1289sim.h"
+#include "host.h"
+
+static const char TEXT[] = "The quick brown fox jumps over the lazy dog";
+
+void static scene_init(void) {
+  TFT_init();
+}
+
+void static scene_fill(void) {
+  TFT_fill(0xF800);
+}
+
+void static scene_rects(void) {
+  uint16_t i;
+
+  for (i = 0; i < 100; ++i) {
+    TFT_fill_rect((i * 16) % TFT_WIDTH, (i * 48) % TFT_HEIGHT, 16, 16,
+                  i * 0x0841);
+  }
+}
+
+void static scene_text_8x8(void) {
+  TFT_fill(0xFFFF);
+  TFT_string(FONT_8x8, TEXT, 0, 0, 0x0000, 0xFFFF, 8, 8);
+}
+
+void static scene_text_16x16(void) {
+  TFT_fill(0xFFFF);
+  TFT_string(FONT_16x16, TEXT, 0, 0, 0x001F, 0xFFFF, 16, 16);
+}
+
+void static scene_fb_screen(void) {
+  FB_init(0xFFFF);
+  FB_box_outline(1, 1, 237, 317, 2, 0xFF00);
+  FB_string(FONT_16x16, "SD Card Music", 5, 5, 0, 0xFFFF, 16, 16);
+  FB_string(FONT_16x16, "IDLE     ", 10, 40, 0, 0xFFFF, 16, 16);
+  FB_flush();
+}
+
+void static scene_fb_status(void) {
+  FB_string(FONT_16x16, "RECORDING", 10, 40, 0, 0xFFFF, 16, 16);
+  FB_flush();
+}
+
+void static scene_fb_redraw(void) {
+  FB_string(FONT_16x16, "RECORDING", 10, 40, 0, 0xFFFF, 16, 16);
+  FB_flush();
+}
+
+void static scene_console(void) {
+  char line[32];
+  uint16_t i;
+
+  console_init(FONT_8x8, 8, 8, 0x07E0, 0x0000);
+  for (i = 0; i < 50; ++i) {
+    snprintf(line, sizeof(line), "log line %u\n", i);
+    console_puts(line);
+  }
+}
+
+void static scene_console_line(void) {
+  console_puts("one more line, scrolled\n");
+}
+
+// A buffer of ADC data register values, holding a triangle wave of
+// the given period and amplitude (in 12 bit counts)
+void static fill_audio(uint32_t *buffer, uint32_t period, uint32_t amplitude) {
+  static uint32_t phase;
+  uint32_t i;
+
+  for (i = 0; i < 512; ++i, ++phase) {
+    uint32_t t = phase % period;
+    uint32_t level = (t < period / 2 ? t : period - t) * 2 * amplitude / period;
+    buffer[i] = (2048 - amplitude / 2 + level) << 4;
+  }
+}
+
+static uint32_t audio[512];
+static const volatile uint32_t scope_counter;
+
+void static scene_scope(void) {
+  uint16_t i;
+
+  // Undo the console's scrolling
+  TFT_scroll(0);
+  scope_init(10, 70);
+  for (i = 0; i < 64; ++i) {
+    fill_audio(audio, 300, 400 + i * 50);
+    scope_snapshot(audio, 512);
+    scope_draw(&scope_counter);
+  }
+}
+
+void static scene_scope_buffer(void) {
+  fill_audio(audio, 300, 3000);
+  scope_snapshot(audio, 512);
+  scope_draw(&scope_counter);
+}
+
+// Hum at the 3rd bin and its harmonics, over a little noise, drawn
+// a buffer at a time until it settles
+void static scene_spectrum(void) {
+  uint32_t i, t;
+
+  spectrum_init(10, 220);
+  for (t = 0; t < 16 * SPECTRUM_INTERVAL; ++t) {
+    for (i = 0; i < 512; ++i) {
+      uint32_t hum = (i * 3) % 512, noise = (i * 2654435761u) >> 28;
+      audio[i] = (1800 + (hum < 256 ? hum : 512 - hum) + noise) << 4;
+    }
+    spectrum_snapshot(audio, 512);
+    spectrum_draw(&scope_counter);
+  }
+}
+
+void static scene_image(void) {
+  static uint8_t block[512];
+
+  host_blocks_read = 0;
+  if (!TFT_image(0, 0, 0, block)) {
+    fprintf(stderr, "TFT_image failed\n");
+  }
+}
+
+typedef struct {
+  const char *name;
+  void (*run)(void);
+} Scene;
+
+static const Scene SCENES[] = {
+  { "init", scene_init },
+  { "fill", scene_fill },
+  { "rects", scene_rects },
+  { "text_8x8", scene_text_8x8 },
+  { "text_16x16", scene_text_16x16 },
+  { "fb_screen", scene_fb_screen },
+  { "fb_status", scene_fb_status },
+  { "fb_redraw", scene_fb_redraw },
+  { "console", scene_console },
+  { "console_line", scene_console_line },
+  { "scope", scene_scope },
+  { "scope_buffer", scene_scope_buffer },
+  { "spectrum", scene_spectrum },
+  { "image", scene_image },
+};
+
+int main(int argc, char **argv) {
+  const char *output = (argc > 1) ? argv[1] : 0;
+  unsigned scenes = sizeof(SCENES) / sizeof(SCENES[0]);
+  char path[256];
+  SimStats stats;
+  unsigned i;
+
+  if (argc > 2) {
+    if (host_card_open(argv[2])) {
+      perror(argv[2]);
+      return 1;
+    }
+  } else {
+    // No card, so no image scene
+    --scenes;
+  }
+
+  sim_reset();
+
+  printf("%-12s %10s %10s %10s %10s %12s %8s\n", "scene", "wr_cycles",
+         "pixels", "registers", "shifts", "pin_writes", "delay_ms");
+
+  for (i = 0; i < scenes; ++i) {
+    sim_stats_reset();
+    SCENES[i].run();
+    sim_stats(&stats);
+
+    printf("%-12s %10llu %10llu %10llu %10llu %12llu %8llu\n",
+           SCENES[i].name,
+           (unsigned long long) stats.wr_cycles,
+           (unsigned long long) stats.pixel_writes,
+           (unsigned long long) (stats.index_writes
+                                 + stats.register_writes),
+           (unsigned long long) stats.shift_clocks,
+           (unsigned long long) stats.pin_writes,
+           (unsigned long long) stats.delay_us / 1000);
+
+    if (output) {
+      snprintf(path, sizeof(path), "%s/%s.ppm", output, SCENES[i].name);
+      if (sim_write_ppm(path)) {
+        fprintf(stderr, "Couldn't write %s\n", path);
+        return 1;
+      }
+    }
+  }
+
+  if (argc > 2) {
+    printf("image: %lu blocks read\n", (unsigned long) host_blocks_read);
+  }
+
+  return 0;
+}
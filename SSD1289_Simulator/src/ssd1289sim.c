@@ -0,0 +1,235 @@
+#include "ssd1289sim.h"
+
+#include <stdio.h>
+#include <string.h>
+
+typedef enum {
+  SIG_NONE = 0,
+  SIG_RS,
+  SIG_WR,
+  SIG_RD,
+  SIG_CS,
+  SIG_RST,
+  SIG_SHIFT_DATA,
+  SIG_SHIFT_CLOCK,
+  SIG_SHIFT_LATCH,
+  SIGNALS
+} Signal;
+
+static const char * const SIGNAL_NAMES[SIGNALS] = {
+  [SIG_RS] = "TFT_RS",
+  [SIG_WR] = "TFT_WR",
+  [SIG_RD] = "TFT_RD",
+  [SIG_CS] = "TFT_CS",
+  [SIG_RST] = "TFT_RST",
+  [SIG_SHIFT_DATA] = "TFT_SHIFT_DATA",
+  [SIG_SHIFT_CLOCK] = "TFT_SHIFT_CLOCK",
+  [SIG_SHIFT_LATCH] = "TFT_SHIFT_LATCH",
+};
+
+// Entry mode (0x11) bits
+#define ENTRY_ID0 (1 << 4)  // increment X
+#define ENTRY_ID1 (1 << 5)  // increment Y
+#define ENTRY_AM  (1 << 3)  // move vertically first
+
+static uint8_t levels[SIGNALS];
+
+static uint16_t shift_register, bus;
+static uint8_t index_register;
+static uint16_t registers[256];
+static uint16_t address_x, address_y;
+static uint16_t gddram[SIM_HEIGHT][SIM_WIDTH];
+
+static SimStats stats;
+
+void sim_reset(void) {
+  memset(registers, 0, sizeof(registers));
+  memset(gddram, 0, sizeof(gddram));
+
+  // Power on values from the datasheet
+  registers[0x11] = 0x6830;
+  registers[0x44] = 0xEF00;
+  registers[0x45] = 0x0000;
+  registers[0x46] = 0x013F;
+
+  index_register = 0;
+  address_x = address_y = 0;
+}
+
+int sim_signal(const char *name) {
+  int i;
+
+  for (i = SIG_NONE + 1; i < SIGNALS; ++i) {
+    if (!strcmp(name, SIGNAL_NAMES[i])) {
+      return i;
+    }
+  }
+
+  return SIG_NONE;
+}
+
+// Moves the GDDRAM address counter on by one pixel, within the window
+void static advance(void) {
+  const uint16_t entry = registers[0x11];
+  const uint16_t x_start = registers[0x44] & 0xFF,
+                 x_end = registers[0x44] >> 8,
+                 y_start = registers[0x45] & 0x1FF,
+                 y_end = registers[0x46] & 0x1FF;
+  uint_fast8_t wrapped = 0;
+
+  // Step along the primary direction, wrapping within the window
+  if (!(entry & ENTRY_AM)) {
+    if (entry & ENTRY_ID0) {
+      wrapped = address_x >= x_end;
+      address_x = wrapped ? x_start : address_x + 1;
+    } else {
+      wrapped = address_x <= x_start;
+      address_x = wrapped ? x_end : address_x - 1;
+    }
+  } else {
+    if (entry & ENTRY_ID1) {
+      wrapped = address_y >= y_end;
+      address_y = wrapped ? y_start : address_y + 1;
+    } else {
+      wrapped = address_y <= y_start;
+      address_y = wrapped ? y_end : address_y - 1;
+    }
+  }
+
+  if (!wrapped) {
+    return;
+  }
+
+  // ...and then along the other one
+  if (!(entry & ENTRY_AM)) {
+    if (entry & ENTRY_ID1) {
+      address_y = (address_y >= y_end) ? y_start : address_y + 1;
+    } else {
+      address_y = (address_y <= y_start) ? y_end : address_y - 1;
+    }
+  } else {
+    if (entry & ENTRY_ID0) {
+      address_x = (address_x >= x_end) ? x_start : address_x + 1;
+    } else {
+      address_x = (address_x <= x_start) ? x_end : address_x - 1;
+    }
+  }
+}
+
+// The panel latches the bus on the rising edge of WR
+void static write_cycle(void) {
+  ++stats.wr_cycles;
+
+  if (!levels[SIG_RS]) {
+    ++stats.index_writes;
+    index_register = bus & 0xFF;
+    return;
+  }
+
+  if (index_register == 0x22) {
+    ++stats.pixel_writes;
+    if (address_x < SIM_WIDTH && address_y < SIM_HEIGHT) {
+      gddram[address_y][address_x] = bus;
+    }
+    advance();
+    return;
+  }
+
+  ++stats.register_writes;
+  registers[index_register] = bus;
+
+  if (index_register == 0x4E) {
+    address_x = bus & 0xFF;
+  } else if (index_register == 0x4F) {
+    address_y = bus & 0x1FF;
+  }
+}
+
+void sim_pin_write(int signal, uint_fast8_t level) {
+  uint_fast8_t rising;
+
+  ++stats.pin_writes;
+  if (signal == SIG_NONE) {
+    return;
+  }
+
+  level = !!level;
+  rising = level && !levels[signal];
+  levels[signal] = level;
+
+  if (!rising) {
+    if (signal == SIG_RST && !level) {
+      sim_reset();
+    }
+    return;
+  }
+
+  switch (signal) {
+  case SIG_SHIFT_CLOCK:
+    ++stats.shift_clocks;
+    shift_register = (shift_register << 1) | levels[SIG_SHIFT_DATA];
+    break;
+  case SIG_SHIFT_LATCH:
+    ++stats.latches;
+    bus = shift_register;
+    break;
+  case SIG_WR:
+    if (!levels[SIG_CS] && levels[SIG_RST]) {
+      write_cycle();
+    }
+    break;
+  }
+}
+
+uint_fast8_t sim_pin_read(int signal) {
+  return levels[signal];
+}
+
+void sim_delay_us(uint32_t us) {
+  stats.delay_us += us;
+}
+
+uint16_t sim_register(uint8_t index) {
+  return registers[index];
+}
+
+uint16_t sim_pixel(uint16_t x, uint16_t y) {
+  return gddram[y][x];
+}
+
+void sim_stats(SimStats *out) {
+  *out = stats;
+}
+
+void sim_stats_reset(void) {
+  memset(&stats, 0, sizeof(stats));
+}
+
+int sim_write_ppm(const char *path) {
+  FILE *file = fopen(path, "wb");
+  uint16_t x, y, line, pixel;
+  uint8_t rgb[3];
+
+  if (!file) {
+    return -1;
+  }
+
+  fprintf(file, "P6\n%d %d\n255\n", SIM_WIDTH, SIM_HEIGHT);
+
+  for (y = 0; y < SIM_HEIGHT; ++y) {
+    // The first screen starts at the vertical scroll line
+    line = (y + (registers[0x41] & 0x1FF)) % SIM_HEIGHT;
+
+    for (x = 0; x < SIM_WIDTH; ++x) {
+      pixel = gddram[line][x];
+
+      // RGB565 to 8 bits per channel
+      rgb[0] = ((pixel >> 11) & 0x1F) * 255 / 31;
+      rgb[1] = ((pixel >> 5) & 0x3F) * 255 / 63;
+      rgb[2] = (pixel & 0x1F) * 255 / 31;
+      fwrite(rgb, 1, sizeof(rgb), file);
+    }
+  }
+
+  return fclose(file) ? -1 : 0;
+}
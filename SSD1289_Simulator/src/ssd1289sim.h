@@ -0,0 +1,68 @@
+/* ssd1289sim.h
+ *
+ * Declares a simulated SSD1289 panel, wired up as on the boards in
+ * this repository: a 16 bit 74HC595 shift register (data, clock and
+ * latch) feeding the panel's data bus, plus its RS, WR, RD, CS and
+ * RST lines. The simulator is driven through the pin functions made
+ * by DEFINE_PIN, and counts every bus transaction it sees.
+ *
+ * The controller models the index register, the entry mode (0x11),
+ * the RAM address window (0x44-0x46), the GDDRAM address counter
+ * (0x4E/0x4F), GDDRAM writes through 0x22 and the vertical scroll
+ * (0x41). Other registers are only stored.
+ */
+
+#ifndef __SSD1289SIM_h_
+#define __SSD1289SIM_h_
+
+#include <stdint.h>
+
+#define SIM_WIDTH 240
+#define SIM_HEIGHT 320
+
+typedef struct {
+  uint64_t wr_cycles;       /* WR strobes with CS low */
+  uint64_t index_writes;    /* ... of which with RS low */
+  uint64_t register_writes; /* ... with RS high, other than to GDDRAM */
+  uint64_t pixel_writes;    /* ... with RS high, to GDDRAM */
+  uint64_t shift_clocks;    /* rising edges on the shift register clock */
+  uint64_t latches;         /* rising edges on the shift register latch */
+  uint64_t pin_writes;      /* all pin writes, as a measure of CPU cost */
+  uint64_t delay_us;        /* time spent in sleep_delay_* */
+} SimStats;
+
+/* sim_reset()
+ * Returns the panel to its power on state, with GDDRAM cleared.
+ */
+void sim_reset(void);
+
+/* sim_signal(name)
+ * Returns the signal for a pin name from pins.h (e.g. "TFT_WR"), or
+ * an unconnected signal for pins which aren't the panel's.
+ */
+int sim_signal(const char *name);
+
+void sim_pin_write(int signal, uint_fast8_t level);
+uint_fast8_t sim_pin_read(int signal);
+
+/* sim_delay_us(us)
+ * Accounts for a delay asked for by the driver.
+ */
+void sim_delay_us(uint32_t us);
+
+/* sim_register(index), sim_pixel(x, y)
+ * Read back controller state.
+ */
+uint16_t sim_register(uint8_t index);
+uint16_t sim_pixel(uint16_t x, uint16_t y);
+
+void sim_stats(SimStats *stats);
+void sim_stats_reset(void);
+
+/* sim_write_ppm(path)
+ * Writes what the panel currently shows (GDDRAM, after scrolling) to
+ * a binary PPM image. Returns 0 on success.
+ */
+int sim_write_ppm(const char *path);
+
+#endif
@@ -0,0 +1,153 @@
+/* Host stand-ins for the parts of the Cortex-M3 and UMDLPC library
+ * used by the scheduler. Masking interrupts blocks the signals which
+ * stand in for them; a masked interrupt stays pending, and is taken as
+ * soon as the mask is lifted, as on the target.
+ */
+
+#include <pthread.h>
+#include <signal.h>
+#include <sys/time.h>
+#include <time.h>
+
+#include "LPC17xx.h"
+#include "UMDLPC/system/systick.h"
+#include "UMDLPC/system/sleep.h"
+#include "host.h"
+
+uint32_t SystemCoreClock = 100000000;
+
+uint64_t host_sleeps;
+
+static pthread_t main_thread;
+static sigset_t irqs;
+static volatile uint32_t primask;
+
+static volatile uint64_t ticks;
+
+static void (*volatile irq_handler)(void);
+static volatile uint32_t irq_period_us;
+static pthread_t irq_thread;
+static uint_fast8_t irq_thread_started;
+
+uint64_t host_time_ns(void) {
+  struct timespec now;
+
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (uint64_t) now.tv_sec * 1000000000 + now.tv_nsec;
+}
+
+uint32_t __get_PRIMASK(void) {
+  return primask;
+}
+
+void __set_PRIMASK(uint32_t value) {
+  if (value) {
+    __disable_irq();
+  } else {
+    __enable_irq();
+  }
+}
+
+void __disable_irq(void) {
+  pthread_sigmask(SIG_BLOCK, &irqs, 0);
+  primask = 1;
+}
+
+void __enable_irq(void) {
+  primask = 0;
+  pthread_sigmask(SIG_UNBLOCK, &irqs, 0);
+}
+
+void static systick_handler(int signal) {
+  (void) signal;
+  ++ticks;
+}
+
+void static irq_signal(int signal) {
+  void (*handler)(void) = irq_handler;
+
+  (void) signal;
+  if (handler) {
+    handler();
+  }
+}
+
+void systick_init(void) {
+  static uint_fast8_t initialized;
+  struct itimerval period = { { 0, 1000000 / SYSTICK_HZ },
+                              { 0, 1000000 / SYSTICK_HZ } };
+  struct sigaction action = { .sa_handler = systick_handler };
+
+  if (initialized) {
+    return;
+  }
+
+  main_thread = pthread_self();
+  sigemptyset(&irqs);
+  sigaddset(&irqs, SIGALRM);
+  sigaddset(&irqs, SIGUSR1);
+
+  // Each handler masks the other, as a single priority would
+  action.sa_mask = irqs;
+  sigaction(SIGALRM, &action, 0);
+  action.sa_handler = irq_signal;
+  sigaction(SIGUSR1, &action, 0);
+
+  setitimer(ITIMER_REAL, &period, 0);
+  initialized = 1;
+}
+
+uint64_t systick_ticks(void) {
+  const uint32_t mask = __get_PRIMASK();
+  uint64_t count;
+
+  __disable_irq();
+  count = ticks;
+  __set_PRIMASK(mask);
+
+  return count;
+}
+
+// Called with the signals blocked, like WFI with PRIMASK set: it
+// returns once one is pending, though here its handler has run too
+void sleep_wfi(void) {
+  sigset_t none;
+
+  sigemptyset(&none);
+  ++host_sleeps;
+  sigsuspend(&none);
+}
+
+void static *irq_run(void *arg) {
+  sigset_t all;
+
+  (void) arg;
+  sigfillset(&all);
+  pthread_sigmask(SIG_BLOCK, &all, 0);
+
+  for (;;) {
+    const uint32_t period_us = irq_period_us;
+    struct timespec wait = { 0, (long) (period_us ? period_us : 1000) * 1000 };
+
+    nanosleep(&wait, 0);
+    if (period_us) {
+      pthread_kill(main_thread, SIGUSR1);
+    }
+  }
+  return 0;
+}
+
+void host_irq_start(uint32_t period_us, void (*handler)(void)) {
+  irq_handler = handler;
+  irq_period_us = period_us;
+
+  if (!irq_thread_started) {
+    pthread_create(&irq_thread, 0, irq_run, 0);
+    irq_thread_started = 1;
+  }
+}
+
+void host_irq_stop(void) {
+  irq_period_us = 0;
+  irq_handler = 0;
+}
@@ -0,0 +1,29 @@
+/* host.h
+ *
+ * Declares the host side of the stand-ins in host.c. Interrupts are
+ * signals taken by the main thread: SIGALRM, from an interval timer,
+ * is SysTick, and SIGUSR1, sent by a thread of its own, is a
+ * peripheral interrupt. WFI waits for either.
+ */
+
+#ifndef __HOST_h_
+#define __HOST_h_
+
+#include <stdint.h>
+
+/* host_time_ns()
+ * Returns the monotonic time, in nanoseconds.
+ */
+uint64_t host_time_ns(void);
+
+/* host_irq_start(period_us, handler), host_irq_stop()
+ * Starts or stops calling handler as an interrupt handler, about every
+ * period_us.
+ */
+void host_irq_start(uint32_t period_us, void (*handler)(void));
+void host_irq_stop(void);
+
+/* The number of times the scheduler slept in WFI */
+extern uint64_t host_sleeps;
+
+#endif
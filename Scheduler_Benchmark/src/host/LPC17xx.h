@@ -0,0 +1,20 @@
+/* LPC17xx.h
+ *
+ * Stands in for the CMSIS device header in host builds. Only what the
+ * scheduler refers to is declared: PRIMASK, which masks the signals
+ * standing in for interrupts (see host.h).
+ */
+
+#ifndef __LPC17xx_H__
+#define __LPC17xx_H__
+
+#include <stdint.h>
+
+extern uint32_t SystemCoreClock;
+
+uint32_t __get_PRIMASK(void);
+void __set_PRIMASK(uint32_t primask);
+void __disable_irq(void);
+void __enable_irq(void);
+
+#endif
@@ -0,0 +1,232 @@
+/*
+ ===============================================================================
+ Name        : main.c
+ Description :
+
+   Runs the scheduler on the host through a few scenes of a second
+   each, and reports how long events waited between being posted and
+   their handler starting:
+
+     post    tasks posting to each other, with nothing else to do: the
+             scheduler's own cost
+     idle    an interrupt posting every 500us, with the scheduler
+             asleep in between: waking included
+     busy    the same, while a lower priority task keeps itself queued
+             with 100us runs, which a post has to wait out
+     timers  8 periodic timers of 1 to 8ms, against that same task,
+             as how far each period strayed from its length
+
+   Host timings are coarser and noisier than the target's; they're for
+   comparing changes to the scheduler, rather than for their own sake.
+
+   Usage: schedbench
+
+ ===============================================================================
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "UMDLPC/system/sched.h"
+#include "host.h"
+
+#define SCENE_MS 1000
+#define IRQ_PERIOD_US 500
+#define BUSY_US 100
+#define TIMERS 8
+
+#define SAMPLES_MAX 100000
+
+static uint32_t samples[SAMPLES_MAX];
+static uint32_t sample_count;
+
+void static sample(uint64_t ns) {
+  if (sample_count < SAMPLES_MAX) {
+    samples[sample_count++] = ns;
+  }
+}
+
+// Set when an event is posted, and cleared by its handler, so that
+// only one is timed at once
+static volatile uint64_t posted_ns;
+static volatile uint_fast8_t awaited;
+
+void static measured_run(Task *task, uint32_t events) {
+  sample(host_time_ns() - posted_ns);
+  awaited = 0;
+}
+
+static Task urgent = TASK(measured_run, 0);
+
+void static irq(void) {
+  if (!awaited) {
+    awaited = 1;
+    posted_ns = host_time_ns();
+    sched_post(&urgent, 1);
+  }
+}
+
+// Keeps itself queued while busy is set, taking BUSY_US each run
+static volatile uint_fast8_t busy;
+
+void static busy_run(Task *task, uint32_t events) {
+  const uint64_t end = host_time_ns() + BUSY_US * 1000;
+
+  while (host_time_ns() < end)
+    ;
+
+  if (busy) {
+    sched_post(task, 1);
+  }
+}
+
+static Task background = TASK(busy_run, 3);
+
+// Ping posts to pong, which posts back while pinging is set
+static volatile uint_fast8_t pinging;
+static Task ping, pong;
+
+void static ping_run(Task *task, uint32_t events) {
+  posted_ns = host_time_ns();
+  sched_post(&pong, 1);
+}
+
+void static pong_run(Task *task, uint32_t events) {
+  sample(host_time_ns() - posted_ns);
+  if (pinging) {
+    sched_post(&ping, 1);
+  }
+}
+
+static Task ping = TASK(ping_run, 2);
+static Task pong = TASK(pong_run, 1);
+
+// Each timer posts its own event bit; those due on the same tick come
+// to one run
+static Timer timers[TIMERS];
+static uint64_t last_ns[TIMERS];
+
+void static timed_run(Task *task, uint32_t events) {
+  const uint64_t now = host_time_ns();
+  uint_fast8_t i;
+
+  for (i = 0; i < TIMERS; ++i) {
+    if (events & (1 << i)) {
+      const int64_t error = (int64_t) (now - last_ns[i])
+                            - (int64_t) (i + 1) * 1000000;
+
+      if (last_ns[i]) {
+        sample((error < 0) ? -error : error);
+      }
+      last_ns[i] = now;
+    }
+  }
+}
+
+static Task timed = TASK(timed_run, 0);
+
+void static scene_post(void) {
+  pinging = 1;
+  sched_post(&ping, 1);
+}
+
+void static scene_idle(void) {
+  host_irq_start(IRQ_PERIOD_US, irq);
+}
+
+void static scene_busy(void) {
+  busy = 1;
+  sched_post(&background, 1);
+  host_irq_start(IRQ_PERIOD_US, irq);
+}
+
+void static scene_timers(void) {
+  uint_fast8_t i;
+
+  busy = 1;
+  sched_post(&background, 1);
+  for (i = 0; i < TIMERS; ++i) {
+    last_ns[i] = 0;
+    sched_timer_start(&timers[i], &timed, 1 << i, i + 1, i + 1);
+  }
+}
+
+void static scene_stop(void) {
+  uint_fast8_t i;
+
+  host_irq_stop();
+  pinging = 0;
+  busy = 0;
+  awaited = 0;
+  for (i = 0; i < TIMERS; ++i) {
+    sched_timer_stop(&timers[i]);
+  }
+}
+
+typedef struct {
+  const char *name;
+  void (*start)(void);
+} Scene;
+
+static const Scene SCENES[] = {
+  { "post", scene_post },
+  { "idle", scene_idle },
+  { "busy", scene_busy },
+  { "timers", scene_timers },
+};
+
+#define SCENE_COUNT (sizeof(SCENES) / sizeof(SCENES[0]))
+
+int static compare(const void *a, const void *b) {
+  const uint32_t x = *(const uint32_t *) a, y = *(const uint32_t *) b;
+
+  return (x > y) - (x < y);
+}
+
+void static report(const char *name, uint64_t sleeps) {
+  qsort(samples, sample_count, sizeof(samples[0]), compare);
+
+  if (!sample_count) {
+    printf("%-8s %8u\n", name, 0);
+    return;
+  }
+
+  printf("%-8s %8u %8.1f %8.1f %8.1f %8.1f %8llu\n", name,
+         (unsigned) sample_count, samples[0] / 1000.0,
+         samples[sample_count / 2] / 1000.0,
+         samples[(uint64_t) sample_count * 99 / 100] / 1000.0,
+         samples[sample_count - 1] / 1000.0, (unsigned long long) sleeps);
+}
+
+// Runs each scene for SCENE_MS in turn, then reports it. Ahead of the
+// busy task, so that it's let in between runs.
+static Timer scene_timer;
+static unsigned scene;
+static uint64_t scene_sleeps;
+
+void static director_run(Task *task, uint32_t events) {
+  if (scene) {
+    scene_stop();
+    report(SCENES[scene - 1].name, host_sleeps - scene_sleeps);
+  }
+
+  if (scene == SCENE_COUNT) {
+    exit(0);
+  }
+
+  sample_count = 0;
+  scene_sleeps = host_sleeps;
+  SCENES[scene++].start();
+  sched_timer_start(&scene_timer, task, 1, SCENE_MS, 0);
+}
+
+static Task director = TASK(director_run, 1);
+
+int main(void) {
+  printf("%-8s %8s %8s %8s %8s %8s %8s\n", "scene", "samples", "min_us",
+         "med_us", "p99_us", "max_us", "sleeps");
+
+  sched_init();
+  sched_post(&director, 1);
+  sched_run();
+}
@@ -5,7 +5,9 @@
  Version     :
  Description :
     A simple example of using semi hosting to print messages to a debug
-    console
+    console. Output is buffered (see UMDLPC/system/semihost.h), so the
+    core is only halted for the debugger once per buffer, rather than
+    on every printf.
  ===============================================================================
  */
 
@@ -15,11 +17,11 @@
 
 #include <cr_section_macros.h>
 #include <NXP/crp.h>
-#include <stdio.h>
 #include <stdint.h>
 
 #include "semihosting.h"
 #include "UMDLPC/system/clocking.h"
+#include "UMDLPC/system/semihost.h"
 
 // Variable to store CRP value in. Will be placed automatically
 // by the linker when "Enable Code Read Protect" selected.
@@ -33,11 +35,12 @@ int main(void) {
   // Bypass PLL 0
   PLL_bypass();
 
-  puts("Hello, World!");
+  semihost_puts("Hello, World!\n");
+  semihost_flush();
 
   uint32_t i = 0;
   while (1) {
-    printf("A number: %u\n", i++);
+    semihost_printf("A number: %u\n", i++);
   }
   return 0;
 }
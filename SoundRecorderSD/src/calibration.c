@@ -0,0 +1,110 @@
+#include "calibration.h"
+#include "sd.h"
+#include "fonts.h"
+#include "UMDLPC/system/sleep.h"
+#include <string.h>
+
+#define FG 0x0000
+#define BG 0xFFFF
+
+// Half the length of a cross's arms
+#define CROSS_SIZE 8
+
+#define MAGIC "TCAL"
+#define CHECKSUM_OFFSET 4
+#define CALIBRATION_OFFSET 8
+
+// Far apart, but in from the edges where the panel reads worst
+static const TouchPoint targets[3] = {
+  { 24, 32 }, { TOUCH_WIDTH - 24, TOUCH_HEIGHT / 2 },
+  { TOUCH_WIDTH / 2, TOUCH_HEIGHT - 32 }
+};
+
+uint32_t static checksum(const TouchCalibration *calibration) {
+  const uint32_t *word = (const uint32_t *) calibration;
+  uint32_t sum = 0, i;
+
+  for (i = 0; i < sizeof(*calibration) / sizeof(*word); ++i) {
+    sum += word[i];
+  }
+  return sum;
+}
+
+void static draw_cross(const TouchPoint *p, uint16_t color) {
+  TFT_hline(p->x - CROSS_SIZE, p->y, 2 * CROSS_SIZE + 1, color);
+  TFT_vline(p->x, p->y - CROSS_SIZE, 2 * CROSS_SIZE + 1, color);
+}
+
+// Waits for a touch and for the pen to be lifted, and returns the
+// readings of the last press, which have settled the most
+void static wait_touch(TouchPoint *raw) {
+  TouchEvent event;
+
+  // Ignore a touch that was already going on
+  while (touch_get(&event))
+    ;
+
+  for (;;) {
+    SLEEP_UNTIL(touch_available());
+    touch_get(&event);
+
+    if (event.pressure) {
+      raw->x = event.raw_x;
+      raw->y = event.raw_y;
+    } else if (raw->x || raw->y) {
+      return;
+    }
+  }
+}
+
+char calibration_load(uint32_t block_num, uint8_t *block) {
+  TouchCalibration calibration;
+  uint32_t sum;
+
+  if (!sd_read_block(block, block_num) || memcmp(block, MAGIC, 4)) {
+    return 0;
+  }
+
+  memcpy(&sum, block + CHECKSUM_OFFSET, sizeof(sum));
+  memcpy(&calibration, block + CALIBRATION_OFFSET, sizeof(calibration));
+  if (sum != checksum(&calibration) || !calibration.divider) {
+    return 0;
+  }
+
+  touch_set_calibration(&calibration);
+  return 1;
+}
+
+void calibration_run(uint32_t block_num, uint8_t *block) {
+  TouchCalibration calibration;
+  TouchPoint raw[3];
+  uint_fast8_t i;
+  uint32_t sum;
+
+  TFT_scroll(0);
+  do {
+    TFT_fill(BG);
+    TFT_string(FONT_8x8, "Touch the crosses", 52, TOUCH_HEIGHT / 2 - 40,
+               FG, BG, 8, 8);
+
+    for (i = 0; i < 3; ++i) {
+      draw_cross(&targets[i], FG);
+      raw[i].x = raw[i].y = 0;
+      wait_touch(&raw[i]);
+      draw_cross(&targets[i], BG);
+    }
+    // Touches in a line (e.g. the same spot three times) can't be
+    // solved, so start again
+  } while (!touch_calibration_solve(targets, raw, &calibration));
+
+  touch_set_calibration(&calibration);
+
+  sum = checksum(&calibration);
+  memset(block, 0, SD_BLOCK_LEN);
+  memcpy(block, MAGIC, 4);
+  memcpy(block + CHECKSUM_OFFSET, &sum, sizeof(sum));
+  memcpy(block + CALIBRATION_OFFSET, &calibration, sizeof(calibration));
+  sd_write_block(block, block_num);
+
+  TFT_fill(BG);
+}
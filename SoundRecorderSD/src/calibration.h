@@ -0,0 +1,34 @@
+/* calibration.h
+ *
+ * Declares the touch screen calibration screen, and keeps the result
+ * in a block of the SD card so that it only has to be done once.
+ *
+ * Block format (little endian, as the structure is laid out):
+ *
+ *   offset 0   "TCAL"
+ *          4   checksum (32 bits): the sum of the calibration's words
+ *          8   the TouchCalibration
+ */
+
+#ifndef __CALIBRATION_h_
+#define __CALIBRATION_h_
+
+/* Provides uintN_t, uint_fastN_t, etc. (for N {8,16,32}) */
+#include <stdint.h>
+
+#include "ssd1289.h"
+#include "touch.h"
+
+/* calibration_load(block_num, block)
+ * Reads block_num into block, and applies the calibration stored in it.
+ * Returns 0 if the block doesn't hold a valid calibration.
+ */
+char calibration_load(uint32_t block_num, uint8_t *block);
+
+/* calibration_run(block_num, block)
+ * Has the user touch three crosses, applies the calibration solved
+ * from them, and saves it in block_num (using block as a buffer).
+ */
+void calibration_run(uint32_t block_num, uint8_t *block);
+
+#endif
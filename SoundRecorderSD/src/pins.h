@@ -15,6 +15,9 @@ DEFINE_PIN(PLAYING_LED, 0, 21);
 DEFINE_PIN(RECORD_BUTTON, 0, 2);
 DEFINE_PIN(PLAY_BUTTON, 0, 3);
 
+// P0.0 and P0.1 are UART3's, for debug builds' reports (see
+// REPORT_BAUD)
+
 DEFINE_PIN(TFT_RS, 2, 12);
 DEFINE_PIN(TFT_WR, 2, 11);
 DEFINE_PIN(TFT_RD, 2, 10);
@@ -25,6 +28,12 @@ DEFINE_PIN(TFT_SHIFT_DATA, 2, 6);
 DEFINE_PIN(TFT_SHIFT_CLOCK, 2, 5);
 DEFINE_PIN(TFT_SHIFT_LATCH, 2, 4);
 
+/* Uncomment if the touch controller's clock, in and out are wired to
+ * SCK1 (P0.7), MOSI1 (P0.9) and MISO1 (P0.8), to read it over SSP1
+ * (see touch.h).
+ */
+// #define TOUCH_SSP1
+
 DEFINE_PIN(TOUCH_CLK, 2, 3);
 DEFINE_PIN(TOUCH_IN, 2, 2);
 DEFINE_PIN(TOUCH_BUSY, 0, 11);
@@ -0,0 +1,175 @@
+#include "scope.h"
+
+#define FG 0x001F
+#define BG 0xFFFF
+#define METER_FG 0x07E0
+
+// Meter bars, below the waveform
+#define METER_GAP 4
+#define METER_HEIGHT 6
+
+typedef struct {
+  uint8_t min, max;
+} Column;
+
+static uint16_t left, top;
+
+// Queued columns, oldest at queue_head
+static Column queue[SCOPE_QUEUE_LEN];
+static uint_fast8_t queue_head, queue_count;
+static uint32_t dropped;
+
+// What is on the panel: each column's segment, where the next column
+// goes, and the lengths of the meter bars
+static Column shown[SCOPE_WIDTH];
+static uint16_t cursor;
+static uint16_t shown_peak, shown_rms;
+
+// Latest meter levels, drawn once there is time
+static uint16_t peak, rms;
+
+uint32_t static isqrt(uint32_t n) {
+  uint32_t root = 0, bit = 1UL << 30;
+
+  while (bit > n) {
+    bit >>= 2;
+  }
+  while (bit) {
+    if (n >= root + bit) {
+      n -= root + bit;
+      root = (root >> 1) + bit;
+    } else {
+      root >>= 1;
+    }
+    bit >>= 2;
+  }
+  return root;
+}
+
+// Moves a meter bar from old to new pixels long, only drawing the part
+// which changes; returns the cost
+uint32_t static draw_bar(uint16_t y, uint16_t old, uint16_t new) {
+  if (new == old) {
+    return 0;
+  }
+
+  if (new > old) {
+    TFT_fill_rect(left + old, y, new - old, METER_HEIGHT, METER_FG);
+    return (new - old) * METER_HEIGHT + SCOPE_WINDOW_COST;
+  }
+  TFT_fill_rect(left + new, y, old - new, METER_HEIGHT, BG);
+  return (old - new) * METER_HEIGHT + SCOPE_WINDOW_COST;
+}
+
+// Replaces the segment drawn in column x, only clearing the parts of
+// the old segment that the new one doesn't cover; returns the cost
+uint32_t static draw_column(uint16_t x, Column new) {
+  Column old = shown[x];
+  uint32_t cost = (new.max - new.min + 1) + SCOPE_WINDOW_COST;
+
+  if (old.min < new.min) {
+    TFT_vline(left + x, top + old.min, new.min - old.min, BG);
+    cost += new.min - old.min + SCOPE_WINDOW_COST;
+  }
+  if (old.max > new.max) {
+    TFT_vline(left + x, top + new.max + 1, old.max - new.max, BG);
+    cost += old.max - new.max + SCOPE_WINDOW_COST;
+  }
+  TFT_vline(left + x, top + new.min, new.max - new.min + 1, FG);
+
+  shown[x] = new;
+  return cost;
+}
+
+void scope_init(uint16_t x, uint16_t y) {
+  uint16_t i;
+
+  left = x;
+  top = y;
+
+  queue_head = queue_count = 0;
+  dropped = 0;
+  cursor = 0;
+  peak = rms = shown_peak = shown_rms = 0;
+
+  // Every column starts as a dot on the centre line
+  for (i = 0; i < SCOPE_WIDTH; ++i) {
+    shown[i].min = shown[i].max = SCOPE_HEIGHT / 2;
+  }
+
+  TFT_fill_rect(left, top, SCOPE_WIDTH,
+                SCOPE_HEIGHT + METER_GAP + 2 * METER_HEIGHT + 1, BG);
+  TFT_hline(left, top + SCOPE_HEIGHT / 2, SCOPE_WIDTH, FG);
+}
+
+void scope_snapshot(const uint32_t *samples, uint32_t count) {
+  const uint32_t per_column = count / SCOPE_COLUMNS_PER_BUFFER;
+  uint32_t sum = 0, sum_squares = 0, i;
+  uint_fast8_t c, low = 0xFF, high = 0;
+
+  for (c = 0; c < SCOPE_COLUMNS_PER_BUFFER; ++c) {
+    uint_fast8_t min = 0xFF, max = 0;
+
+    for (i = 0; i < per_column; ++i) {
+      // The same 8 bits of the result as are recorded
+      uint_fast8_t s = (*samples++ >> 8) & 0xff;
+
+      if (s < min) min = s;
+      if (s > max) max = s;
+      sum += s;
+      sum_squares += s * s;
+    }
+    if (min < low) low = min;
+    if (max > high) high = max;
+
+    // Drop the oldest column if drawing has fallen behind
+    if (queue_count == SCOPE_QUEUE_LEN) {
+      queue_head = (queue_head + 1) % SCOPE_QUEUE_LEN;
+      --queue_count;
+      ++dropped;
+    }
+
+    // Louder is higher up the screen
+    Column *column = &queue[(queue_head + queue_count++) % SCOPE_QUEUE_LEN];
+    column->min = (SCOPE_HEIGHT - 1) - (max >> 1);
+    column->max = (SCOPE_HEIGHT - 1) - (min >> 1);
+  }
+
+  // Levels are measured from the mean, to ignore the mic's bias
+  count = per_column * SCOPE_COLUMNS_PER_BUFFER;
+  uint32_t mean = sum / count;
+  uint32_t square_mean = sum_squares / count;
+
+  uint32_t deviation = high - mean > mean - low ? high - mean : mean - low;
+  peak = deviation * SCOPE_WIDTH / 128;
+  rms = isqrt(square_mean > mean * mean ? square_mean - mean * mean : 0)
+        * SCOPE_WIDTH / 128;
+  if (peak > SCOPE_WIDTH) peak = SCOPE_WIDTH;
+  if (rms > SCOPE_WIDTH) rms = SCOPE_WIDTH;
+}
+
+void scope_draw(const volatile uint32_t *counter) {
+  const uint32_t start = *counter;
+  const uint16_t meter_y = top + SCOPE_HEIGHT + METER_GAP;
+  uint32_t spent = 0;
+
+  // The meter is cheap, and shows the latest buffer, so it goes first
+  spent += draw_bar(meter_y, shown_peak, peak);
+  shown_peak = peak;
+  spent += draw_bar(meter_y + METER_HEIGHT + 1, shown_rms, rms);
+  shown_rms = rms;
+
+  while (queue_count && spent < SCOPE_PIXEL_BUDGET && *counter == start) {
+    spent += draw_column(cursor, queue[queue_head]);
+    queue_head = (queue_head + 1) % SCOPE_QUEUE_LEN;
+    --queue_count;
+
+    if (++cursor == SCOPE_WIDTH) {
+      cursor = 0;
+    }
+  }
+}
+
+uint32_t scope_dropped(void) {
+  return dropped;
+}
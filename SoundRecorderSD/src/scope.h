@@ -0,0 +1,63 @@
+/* scope.h
+ *
+ * Declares a scrolling waveform (min/max envelope) and peak/RMS level
+ * meter view of the audio being recorded.
+ *
+ * The work is split so that it can't hold up the audio: each ADC DMA
+ * buffer is analysed in place with scope_snapshot() as soon as it is
+ * complete, which only queues a few columns and the new meter levels.
+ * scope_draw() then draws what is queued, directly on the panel, but
+ * no more than SCOPE_PIXEL_BUDGET pixels' worth per call and never
+ * past the completion of the next buffer. When drawing falls behind,
+ * the oldest queued columns are dropped.
+ */
+
+#ifndef __SCOPE_h_
+#define __SCOPE_h_
+
+/* Provides uintN_t, uint_fastN_t, etc. (for N {8,16,32}) */
+#include <stdint.h>
+
+#include "ssd1289.h"
+
+#define SCOPE_WIDTH 220
+#define SCOPE_HEIGHT 128
+
+/* Columns of waveform made from each buffer */
+#define SCOPE_COLUMNS_PER_BUFFER 4
+
+/* Columns which can be queued for drawing */
+#define SCOPE_QUEUE_LEN 16
+
+/* Pixels which may be drawn per call to scope_draw, counting the
+ * setup of each window as SCOPE_WINDOW_COST pixels.
+ */
+#ifndef SCOPE_PIXEL_BUDGET
+#define SCOPE_PIXEL_BUDGET 1024
+#endif
+#define SCOPE_WINDOW_COST 64
+
+/* scope_init(x, y)
+ * Clears the view, with its top left corner at (x, y). The meter bars
+ * are drawn below the waveform.
+ */
+void scope_init(uint16_t x, uint16_t y);
+
+/* scope_snapshot(samples, count)
+ * Analyses a complete buffer of ADC data register values in place,
+ * queueing its columns and levels to be drawn.
+ */
+void scope_snapshot(const uint32_t *samples, uint32_t count);
+
+/* scope_draw(counter)
+ * Draws queued columns and levels, stopping early if *counter changes
+ * (e.g. a count of buffers completed, incremented by an interrupt).
+ */
+void scope_draw(const volatile uint32_t *counter);
+
+/* scope_dropped()
+ * Returns the number of columns dropped because drawing fell behind.
+ */
+uint32_t scope_dropped(void);
+
+#endif
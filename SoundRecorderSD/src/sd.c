@@ -6,16 +6,46 @@
 #include "../inc/core_cm3.h"
 #include "sd.h"
 #include "spi.h"
+#include "UMDLPC/system/clocking.h"
+#include "UMDLPC/system/systick.h"
+#include "UMDLPC/system/profile.h"
+#include "UMDLPC/system/trace.h"
+
+// The card's clock once it's initialized; SSP0 is run at this or just
+// under (SD cards take up to 25MHz)
+#define SD_SPI_HZ 12500000
 
 static int sd_version;
 
+// Clocks bytes in while the card sends value (0xFF while it prepares
+// data, 0x00 while it's busy), for up to timeout_ms. Returns the first
+// other byte, or value if the card timed out.
+uint8_t static sd_wait_while(uint8_t value, uint32_t timeout_ms)
+{
+	const uint64_t deadline = systick_deadline_ms(timeout_ms);
+	uint8_t rx;
+
+	do {
+		spi_txrx(NULL, &rx, 1);
+	} while (rx == value && !systick_expired(deadline));
+
+	return rx;
+}
+
+// SSP0 Prescaler, must be even and at least 2
+void static sd_set_clock(uint32_t cclk_hz) {
+  uint32_t cpsr = (cclk_hz + SD_SPI_HZ - 1) / SD_SPI_HZ;
+
+  cpsr = (cpsr + 1) & ~1;
+  LPC_SSP0->CPSR = (cpsr < 2) ? 2 : cpsr;
+}
+
 void sd_command(uint8_t index, uint8_t a1, uint8_t a2,
                 uint8_t a3, uint8_t a4, uint8_t crc,
                 uint8_t* response, uint16_t response_len) //{{{
 {
 	uint16_t tries;
 	uint8_t command[6];
-	uint8_t rx = 0;
 
 	memset(response, 0, response_len);
 
@@ -52,9 +82,7 @@ void sd_command(uint8_t index, uint8_t a1, uint8_t a2,
 	/* read until the busy flag is cleared,
 	 * this also gives the SD card at least 8 clock pulses to give
 	 * it a chance to prepare for the next CMD */
-	rx = 0;
-	while (rx == 0)
-		spi_txrx(NULL, &rx, 1);
+	sd_wait_while(0x00, SD_WRITE_TIMEOUT_MS);
 } //}}}
 
 int sd_init() //{{{
@@ -74,6 +102,7 @@ int sd_init() //{{{
 	 */
 
   spi_init();
+  systick_init();
 
 	LPC_GPIO0->FIODIR |= GPIO_SD_CS_m; // enable chip select
 	LPC_GPIO0->FIOSET = GPIO_SD_CS_m; // turn off the chip select (high)
@@ -110,8 +139,12 @@ int sd_init() //{{{
 	}
 
 	// the initialization process
+	uint64_t deadline = systick_deadline_ms(SD_INIT_TIMEOUT_MS);
 	while (resp[0] != 0x00) // 0 when the card is initialized
 	{
+		if (systick_expired(deadline))
+			return -4;
+
 		LPC_GPIO0->FIOCLR = GPIO_SD_CS_m;
 		sd_command(55, 0x00, 0x00, 0x00, 0x00, 0x00, resp, 1); // CMD55
 		LPC_GPIO0->FIOSET = GPIO_SD_CS_m;
@@ -125,8 +158,10 @@ int sd_init() //{{{
 		LPC_GPIO0->FIOSET = GPIO_SD_CS_m;
 	}
 
-	// Set clock speed to 10MHz
-  LPC_SSP0->CPSR = SystemCoreClock / 10000000;
+	// Speed the clock up, and keep it at that speed through CPU clock
+	// changes
+  sd_set_clock(SystemCoreClock);
+  clock_on_change(sd_set_clock);
 
 	// check the OCR register to see if it's a high capacity card
 	LPC_GPIO0->FIOCLR = GPIO_SD_CS_m;
@@ -140,11 +175,14 @@ int sd_init() //{{{
 	return 0;
 } //}}}
 
-char sd_read_block(uint8_t* block, uint32_t block_num) //{{{
+char static read_block(uint8_t* block, uint32_t block_num) //{{{
 {
 	// TODO bounds checking
 	uint8_t rx = 0xFF;
 
+	// Only reads which succeed are timed
+	PROFILE_ENTER(sd_read_block);
+
 	// send the single block command
 	LPC_GPIO0->FIOCLR = GPIO_SD_CS_m;
 	sd_command(17, (0xFF000000 & block_num) >> 24,
@@ -156,12 +194,18 @@ char sd_read_block(uint8_t* block, uint32_t block_num) //{{{
 	// the token, but I doubt this happens
 
 	if (rx != 0x00)
+	{
+		LPC_GPIO0->FIOSET = GPIO_SD_CS_m;
 		return 0;
+	}
 
-	// read until the data token is received
-	rx = 0xFF;
-	while (rx != 0b11111110)
-		spi_txrx(NULL, &rx, 1);
+	// read until the data token is received (an error token, or none,
+	// fails the read)
+	if (sd_wait_while(0xFF, SD_READ_TIMEOUT_MS) != 0b11111110)
+	{
+		LPC_GPIO0->FIOSET = GPIO_SD_CS_m;
+		return 0;
+	}
 
 	spi_txrx(NULL, block, SD_BLOCK_LEN); // read the block
 	spi_txrx(NULL, NULL, 2); // throw away the CRC
@@ -169,10 +213,11 @@ char sd_read_block(uint8_t* block, uint32_t block_num) //{{{
 
 	LPC_GPIO0->FIOSET = GPIO_SD_CS_m;
 
+	PROFILE_EXIT(sd_read_block);
 	return 1;
 } //}}}
 
-char sd_write_block(uint8_t* block, uint32_t block_num) //{{{
+char static write_block(uint8_t* block, uint32_t block_num) //{{{
 {
 	// TODO bounds checking
 	uint8_t rx = 0xFF;
@@ -188,7 +233,10 @@ char sd_write_block(uint8_t* block, uint32_t block_num) //{{{
 	// Could be an issue here where the last 8 of SD command contains
 	// the token, but I doubt this happens
 	if (rx != 0x00)
+	{
+		LPC_GPIO0->FIOSET = GPIO_SD_CS_m;
 		return 0;
+	}
 
 	// tick clock 8 times to start write operation
 	spi_txrx(NULL, NULL, 1);
@@ -205,15 +253,43 @@ char sd_write_block(uint8_t* block, uint32_t block_num) //{{{
 
 	// check if the data is accepted
 	if (!((rx & 0xE) >> 1 == 0x2))
+	{
+		LPC_GPIO0->FIOSET = GPIO_SD_CS_m;
 		return 0;
+	}
 
 	// wait for the card to release the busy flag
-	rx = 0;
-	while (rx == 0)
-		spi_txrx(NULL, &rx, 1);
+	if (sd_wait_while(0x00, SD_WRITE_TIMEOUT_MS) == 0x00)
+	{
+		LPC_GPIO0->FIOSET = GPIO_SD_CS_m;
+		return 0;
+	}
 
 	spi_txrx(NULL, NULL, 1); // 8 cycles to prepare the card for the next command
 
 	LPC_GPIO0->FIOSET = GPIO_SD_CS_m;
 	return 1;
 } //}}}
+
+// The block commands' spans in the trace end with whether they succeeded
+char sd_read_block(uint8_t* block, uint32_t block_num) //{{{
+{
+	char ok;
+
+	TRACE_BEGIN_SPAN(TRACE_SD_READ, block_num);
+	ok = read_block(block, block_num);
+	TRACE_END_SPAN(TRACE_SD_READ, ok);
+
+	return ok;
+} //}}}
+
+char sd_write_block(uint8_t* block, uint32_t block_num) //{{{
+{
+	char ok;
+
+	TRACE_BEGIN_SPAN(TRACE_SD_WRITE, block_num);
+	ok = write_block(block, block_num);
+	TRACE_END_SPAN(TRACE_SD_WRITE, ok);
+
+	return ok;
+} //}}}
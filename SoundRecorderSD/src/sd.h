@@ -6,6 +6,13 @@
 #define SD_MAX_RESET_TRIES 100
 #define SD_INVALID_SECTOR 0xFFFFFFFF
 
+// How long the card may take before it's given up on, from the SD
+// spec's limits: initialization within 1s, reads within 100ms, and
+// writes (busy) within 250ms, or 500ms for SDXC cards
+#define SD_INIT_TIMEOUT_MS 1000
+#define SD_READ_TIMEOUT_MS 100
+#define SD_WRITE_TIMEOUT_MS 500
+
 #define GPIO_SD_CS_m (1<<6) // 498A: Defined as P0
 
 int sd_init();
@@ -48,13 +48,21 @@ typedef enum {
 } ProgramState;
 ProgramState current_state = WAITING;
 
-void EINT3_IRQHandler (void)
-{
-  LPC_SC->EXTINT = _BV(3);		/* clear interrupt */
-  LPC_GPIOINT->IO2IntClr = _BV(13);		/* clear interrupt */
-
-  RECORDING_LED_TOGGLE();
-}
+// Recorded buffers completed by the DMA and handled by record(). If
+// the DMA completes another buffer before the last one has been
+// handled, it has started overwriting it: that's an overrun.
+volatile uint32_t buffers_recorded;
+uint32_t buffers_handled, audio_overruns;
+
+#ifdef DEBUG
+// Where reports go, as well as over semihosting (see REPORT_BAUD)
+static uint8_t report_tx[1024], report_rx[16];
+static Uart report_uart = UART(3, report_tx, report_rx, LPC_GPDMACH2,
+                               LPC_GPDMACH3, 0);
+#endif
+
+// The terminal counts of the record and playback channels
+#define AUDIO_CHANNELS_TC ((1 << 0) | (1 << 1))
 
 void DMA_IRQHandler(void) {
   const static ProgramState TRANSITIONS[] = {
@@ -64,24 +72,54 @@ void DMA_IRQHandler(void) {
     [PLAYING_BUFFER1] = PLAYING_BUFFER2,
     [PLAYING_BUFFER2] = PLAYING_BUFFER1
   };
+  const uint32_t status = LPC_GPDMA->DMACIntTCStat;
+  uint_fast8_t i;
+
+  // Other channels (the TFT's or the SD card's streams) belong to
+  // dma_wait, which acknowledges them once the channel has stopped.
+  // Their interrupt is masked until then, so as not to be taken again.
+  for (i = 0; i < 8; ++i) {
+    if ((status & (1 << i)) && !(AUDIO_CHANNELS_TC & (1 << i))) {
+      ((LPC_GPDMACH_TypeDef *) (LPC_GPDMACH0_BASE + 0x20 * i))
+        ->DMACCConfig &= ~(1 << 15);
+    }
+  }
+
+  if (!(status & AUDIO_CHANNELS_TC)) {
+    return;
+  }
 
+  if (current_state == RECORDING_BUFFER1
+      || current_state == RECORDING_BUFFER2) {
+    ++buffers_recorded;
+  }
   current_state = TRANSITIONS[current_state];
+  TRACE(TRACE_DMA_TC, current_state);
 
   PLAYING_LED_TOGGLE();
 
-  LPC_GPDMA->DMACIntTCClear = 0xff;
+  LPC_GPDMA->DMACIntTCClear = status & AUDIO_CHANNELS_TC;
 }
 
+// Cycles slept and busy during the last playback or recording, read
+// after each wait, so more often than every 2^32 cycles
+SleepStats run_sleep;
+
+// Sleeps until the DMA interrupt moves us into desired_state
 void wait_for_state(ProgramState desired_state) {
-  while (current_state != desired_state)
-    ;
+  TRACE_BEGIN_SPAN(TRACE_WAIT, desired_state);
+  SLEEP_UNTIL(current_state == desired_state);
+  sleep_stats(&run_sleep);
+  TRACE_END_SPAN(TRACE_WAIT, desired_state);
 }
 
 // memcpy, unpack 8 bit fields to 32 bit fields shifted for the DAC
 void transfer_from_block(uint8_t *source, uint32_t *dest, uint32_t len) {
+  PROFILE_ENTER(transfer_from_block);
   while (len--) {
     *dest++ = ((uint32_t) (*source++)) << 8;
   }
+  PROFILE_EXIT(transfer_from_block);
 }
 
 // memcpy, pack 32 bit fields from the ADC in to 8 bit fields
@@ -100,7 +138,7 @@ void load_dma_node(LPC_GPDMACH_TypeDef * const channel,
 }
 
 void playback() {
-  uint32_t cur_block = 0;
+  uint32_t cur_block = RECORDING_BLOCK;
 
   sd_read_block(sd_block, cur_block++);
   transfer_from_block(sd_block, audio_buffer1, SD_BLOCK_LEN);
@@ -128,8 +166,34 @@ void playback() {
   PLAYBACK_CHANNEL->DMACCConfig &= ~(_BV(0));
 }
 
+// Stores a complete recorded buffer, and shows it on the scope and
+// spectrum with whatever time is left before the next one completes
+void record_buffer(uint32_t *buffer, uint32_t block_num) {
+  TRACE_BEGIN_SPAN(TRACE_STORE, block_num);
+  transfer_to_block(buffer, sd_block, SD_BLOCK_LEN);
+  scope_snapshot(buffer, AUDIO_BUFFER_LEN);
+  spectrum_snapshot(buffer, AUDIO_BUFFER_LEN);
+
+  // The trace stops at the first overrun, keeping what led up to it
+  if (buffers_recorded != ++buffers_handled) {
+    TRACE(TRACE_OVERRUN, buffers_recorded);
+    trace_stop();
+    ++audio_overruns;
+    buffers_handled = buffers_recorded;
+  }
+
+  sd_write_block(sd_block, block_num);
+  scope_draw(&buffers_recorded);
+  spectrum_draw(&buffers_recorded);
+  TRACE_END_SPAN(TRACE_STORE, block_num);
+}
+
 void record() {
-  uint32_t cur_block = 0;
+  uint32_t cur_block = RECORDING_BLOCK;
+
+  buffers_recorded = buffers_handled = 0;
+  scope_init(SCOPE_X, SCOPE_Y);
+  spectrum_init(SPECTRUM_X, SPECTRUM_Y);
 
   current_state = RECORDING_BUFFER1;
   load_dma_node(RECORD_CHANNEL, &record_node1);
@@ -137,18 +201,117 @@ void record() {
 
   while (RECORD_BUTTON_READ()) {
     wait_for_state(RECORDING_BUFFER2);
-
-    transfer_to_block(audio_buffer1, sd_block, SD_BLOCK_LEN);
-    sd_write_block(sd_block, cur_block++);
+    record_buffer(audio_buffer1, cur_block++);
 
     wait_for_state(RECORDING_BUFFER1);
+    record_buffer(audio_buffer2, cur_block++);
+  }
+
+  RECORD_CHANNEL->DMACCConfig &= ~(_BV(0));
+}
+
+// We want to sample at 44.1khz, and a full sample takes 65 cycles,
+// so we want an ADC clock of 44,100*65 = 2,866,500. The ADC's
+// peripheral clock is CCLK / 4.
+uint32_t adc_clkdiv(uint32_t cclk_hz) {
+  return (cclk_hz / 2866500) / 4;
+}
+
+// Keeps the ADC and DAC at the sample rate when the CPU clock is
+// switched
+void clock_changed(uint32_t cclk_hz) {
+  LPC_ADC->ADCR = (LPC_ADC->ADCR & ~(0xFF << 8))
+                  | (adc_clkdiv(cclk_hz) << 8);
+  LPC_DAC->DACCNTVAL = cclk_hz / SAMPLE_RATE - 1;
+}
+
+// Runs fn with the CPU clock at CCLKDIV_BUSY, and switches back to
+// CCLKDIV_IDLE after. The switches happen with no DMA running, so no
+// sample is taken at the wrong rate.
+void run_busy(void (*fn)(void)) {
+  clock_set_divider(CCLKDIV_BUSY);
+  sleep_stats_reset();
+  fn();
+  sleep_stats(&run_sleep);
+  clock_set_divider(CCLKDIV_IDLE);
+}
 
-    transfer_to_block(audio_buffer2, sd_block, SD_BLOCK_LEN);
-    sd_write_block(sd_block, cur_block++);
+// Writes a line of a report to the debug console (over semihosting),
+// which drops it with no debugger attached, and out of the report UART
+void report_puts(const char *line) {
+  semihost_puts(line);
+#ifdef DEBUG
+  uart_write(&report_uart, line, strlen(line));
+#endif
+}
+
+// Reports the profiling zones' stats since the last report, in debug
+// builds
+void report_profile(void) {
+#if PROFILE
+  profile_report(report_puts);
+  semihost_flush();
+  profile_reset();
+#endif
+}
+
+// Reports the cycles slept and busy during the last playback or
+// recording, in thousands (at CCLKDIV_BUSY), in debug builds
+void report_sleep(void) {
+#ifdef DEBUG
+  const uint32_t slept = run_sleep.slept_cycles / 1000;
+  const uint32_t total = run_sleep.total_cycles / 1000;
+  char line[64];
+
+  format_string(line, sizeof(line),
+                "sleep: %lu slept, %lu busy, %lu total kcycles\n",
+                (unsigned long) slept, (unsigned long) (total - slept),
+                (unsigned long) total);
+  report_puts(line);
+  format_string(line, sizeof(line), "  in %lu sleeps\n",
+                (unsigned long) run_sleep.sleeps);
+  report_puts(line);
+  semihost_flush();
+#endif
+}
+
+// Times the spectrum's window and transform on a made up buffer of ADC
+// results, so it can be had without recording, in debug builds
+void benchmark_spectrum(void) {
+#ifdef DEBUG
+  uint32_t i;
 
+  for (i = 0; i < AUDIO_BUFFER_LEN; ++i) {
+    audio_buffer1[i] = (1536 + ((i * 1103) & 0x3ff)) << 4;
   }
+  semihost_printf("%u point FFT (with window): %lu cycles\n",
+                  SPECTRUM_POINTS,
+                  (unsigned long) spectrum_benchmark(audio_buffer1));
+  semihost_flush();
+#endif
+}
 
-  RECORD_CHANNEL->DMACCConfig &= ~(_BV(0));
+#if TRACING
+static int32_t trace_file;
+
+void static write_trace(const void *data, uint32_t length) {
+  semihost_file_write(trace_file, data, length);
+}
+#endif
+
+// Dumps the trace to trace.bin on the host (over semihosting), for
+// TraceDecoder, and starts a new one, in debug builds. Without a
+// debugger attached, the trace is just cleared.
+void dump_trace(void) {
+#if TRACING
+  trace_file = semihost_file_open("trace.bin");
+  if (trace_file >= 0) {
+    trace_dump(write_trace);
+    semihost_file_close(trace_file);
+  }
+  trace_clear();
+  trace_start();
+#endif
 }
 
 typedef struct {
@@ -171,22 +334,33 @@ typedef struct {
 ULPC_PINSEL4_t *ULPC_PINSEL4 = (ULPC_PINSEL4_t *)0x4002C010;
 
 int main(void) {
-  // Select 12MHz crystal oscillator
-  LPC_SC->CLKSRCSEL = 1;
-
-  // We need to input and output samples at 44.1khz
-  // And the ADC samples with
-  // Run PLL 0 at 44.1MHz
-  PLL_init(147, 8, 10);
-  SystemCoreClockUpdate();
-
+  char status[16];
+  TouchEvent touch;
+
+  // We need to input and output samples at 44.1khz, so the CPU clock
+  // has to be an exact multiple of that: run PLL 0 at 44.1MHz, from the
+  // 12MHz crystal oscillator. PLL_solve(12000000, CLOCK_SPEED,
+  // SAMPLE_RATE, ...) finds settings for other speeds.
+  static const PLLConfig pll = { PLL_M, PLL_N, PLL_CCLKDIV };
+  CT_ASSERT(PLL_VALID(12000000, PLL_M, PLL_N, PLL_CCLKDIV));
+  CT_ASSERT(PLL_CCLK_HZ(12000000, PLL_M, PLL_N, PLL_CCLKDIV) == CLOCK_SPEED);
+  CT_ASSERT(CLOCK_SPEED % SAMPLE_RATE == 0);
+  CT_ASSERT(PLL_VALID(12000000, PLL_M, PLL_N, CCLKDIV_BUSY));
+  CT_ASSERT(PLL_CCLK_HZ(12000000, PLL_M, PLL_N, CCLKDIV_BUSY)
+            % SAMPLE_RATE == 0);
+  CT_ASSERT(PLL_VALID(12000000, PLL_M, PLL_N, CCLKDIV_IDLE));
+  CT_ASSERT(PLL_CCLK_HZ(12000000, PLL_M, PLL_N, CCLKDIV_IDLE)
+            % SAMPLE_RATE == 0);
+  PLL_configure(MAIN_OSCILLATOR, &pll);
+
+  profile_init();
+  trace_init();
+  trace_name(TRACE_DMA_TC, "dma_tc");
+  trace_name(TRACE_WAIT, "wait");
+  trace_name(TRACE_STORE, "store");
+  trace_name(TRACE_OVERRUN, "overrun");
   TFT_init();
 
-  TFT_fill(0xffff);
-  TFT_box_outline(1, 1, 237, 317, 2, 0xFF00);
-
-  TFT_string(FONT_16x16, "SD Card Music", 5, 5, 0, 0xFFFF, 16, 16);
-
   touch_init();
 
   // Peripheral power (Note: DAC is always powered)
@@ -199,8 +373,9 @@ int main(void) {
   //   P0.23 as AD0.0 (1 at bit 14)
   //   P0.26 as AOUT  (2 at bit 20)
   LPC_PINCON->PINSEL1 = (1 << 14) | (2 << 20);
-  //   P2.13 as EINT3 (1 at bit 26)
-  LPC_PINCON->PINSEL4 = (1 << 26);
+#ifdef DEBUG
+  uart_init(&report_uart, REPORT_BAUD);
+#endif
   RECORDING_LED_OUTPUT();
   PLAYING_LED_OUTPUT();
   RECORD_BUTTON_INPUT();
@@ -208,23 +383,39 @@ int main(void) {
 
   sd_init();
 
-  NVIC_DisableIRQ(EINT3_IRQn);
-  LPC_GPIOINT->IO2IntEnF = _BV(13);	// EXTINT on P2.13 triggers on falling edge
-  LPC_SC->EXTMODE = _BV(3);	  // EINT3 is edge senstive
-  LPC_SC->EXTPOLAR = 0;				// EINT3 is falling edge sensitive
-  LPC_SC->EXTINT = _BV(3);		// clear interrupt
-  NVIC_EnableIRQ(EINT3_IRQn);
+  // Show the splash screen for a while, if the card has one
+#ifdef DEBUG
+  uint32_t splash_start = sleep_counter();
+#endif
+  if (TFT_image(SPLASH_BLOCK, 0, 0, sd_block)) {
+#ifdef DEBUG
+    semihost_printf("Splash screen drawn in %lu us\n",
+                    (unsigned long) (sleep_counter() - splash_start)
+                    / (SystemCoreClock / 1000000));
+    semihost_flush();
+#endif
+    sleep_delay_ms(SPLASH_MS);
+  }
+
+  // Calibrate the touch screen the first time, or if Record is held
+  if (RECORD_BUTTON_READ() || !calibration_load(CALIBRATION_BLOCK, sd_block)) {
+    calibration_run(CALIBRATION_BLOCK, sd_block);
+  }
+
+  FB_init(0xffff);
+  FB_box_outline(1, 1, 237, 317, 2, 0xFF00);
+
+  FB_string(FONT_16x16, "SD Card Music", 5, 5, 0, 0xFFFF, 16, 16);
+  FB_flush();
+  benchmark_spectrum();
 
-  // We want to sample at 44.1khz, and a full sample takes 65 cycles,
-  // so we want an ADC clock of 44,100*65 = 2,866,500.
-  //
   // A/D Control Register
   //  1 in bit 0 - Select AD0.0 to be sampled
-  //       bits 15:8 - Set clock to 2,866,500MHz
+  //       bits 15:8 - Set clock to 2,866,500MHz (see adc_clkdiv)
   //  1 in bit 16 - Enable burst mode
   //  1 in bit 21 - Not in power-down mode
   //  0 in bits 26:24 - don't start a conversion yet
-  LPC_ADC->ADCR = _BV(0) | ((((SystemCoreClock/2866500)/4)) << 8)
+  LPC_ADC->ADCR = _BV(0) | (adc_clkdiv(SystemCoreClock) << 8)
                  | _BV(16) | _BV(21);
 
   // A/D Interrupt Enable Register
@@ -238,7 +429,7 @@ int main(void) {
 
   // DAC Counter Value
   //  44.1MHz / 1000 = 44.1kHz
-  LPC_DAC->DACCNTVAL = (1000 - 1);
+  LPC_DAC->DACCNTVAL = (CLOCK_SPEED / SAMPLE_RATE - 1);
 
   LPC_GPDMA->DMACConfig |= 1;
 
@@ -306,15 +497,51 @@ int main(void) {
 
   NVIC_EnableIRQ(DMA_IRQn);
 
+  // From here on the CPU clock is switched between CCLKDIV_BUSY and
+  // CCLKDIV_IDLE, and the ADC and DAC (and the SD card, TFT and touch
+  // drivers) follow it
+  clock_on_change(clock_changed);
+  clock_set_divider(CCLKDIV_IDLE);
+
   while (1) {
+    // Touches (on PENIRQ, P2.13, sampled by touch.c) blink the LED
+    if (touch_get(&touch) && touch.pressure) {
+      RECORDING_LED_TOGGLE();
+    }
+
+    // Status changes go through the framebuffer, so only the letters
+    // that differ are sent to the panel
     if (PLAY_BUTTON_READ()) {
-      TFT_string(FONT_16x16, "PLAYING", 10, 40, 0, 0xFFFF, 16, 16);
-      playback();
-      TFT_string(FONT_16x16, "IDLE   ", 10, 40, 0, 0xFFFF, 16, 16);
+      FB_string(FONT_16x16, "PLAYING", 10, 40, 0, 0xFFFF, 16, 16);
+      FB_flush();
+      run_busy(playback);
+      FB_string(FONT_16x16, "IDLE   ", 10, 40, 0, 0xFFFF, 16, 16);
+      FB_flush();
+      report_profile();
+      report_sleep();
+      dump_trace();
     } else if (RECORD_BUTTON_READ()) {
-      TFT_string(FONT_16x16, "RECORDING", 10, 40, 0, 0xFFFF, 16, 16);
-      record();
-      TFT_string(FONT_16x16, "IDLE     ", 10, 40, 0, 0xFFFF, 16, 16);
+      FB_string(FONT_16x16, "RECORDING", 10, 40, 0, 0xFFFF, 16, 16);
+      FB_flush();
+      run_busy(record);
+      FB_string(FONT_16x16, "IDLE     ", 10, 40, 0, 0xFFFF, 16, 16);
+
+      // Overruns lose audio, so they're shown; dropped scope columns
+      // only lose some of the picture
+      format_string(status, sizeof(status), "OVERRUNS %-5lu",
+                    (unsigned long) audio_overruns);
+      FB_string(FONT_8x8, status, 10, 290, 0, 0xFFFF, 8, 8);
+      FB_flush();
+#ifdef DEBUG
+      semihost_printf("Scope columns dropped: %lu\n",
+                      (unsigned long) scope_dropped());
+      semihost_printf("%u point FFT (with window): %lu cycles\n",
+                      SPECTRUM_POINTS, (unsigned long) spectrum_cycles());
+      semihost_flush();
+#endif
+      report_profile();
+      report_sleep();
+      dump_trace();
     }
   }
   return 0;
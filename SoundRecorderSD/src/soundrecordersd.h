@@ -9,19 +9,75 @@
 #include <NXP/crp.h>
 
 #include <stdint.h>
+#include <stdio.h>
+#include <string.h>
 
 #include "UMDLPC.h"
 
 #include "ssd1289.h"
+#include "tilefb.h"
+#include "tftimage.h"
+#include "scope.h"
+#include "spectrum.h"
 #include "touch.h"
+#include "calibration.h"
 #include "fonts.h"
 #include "sd.h"
 #include "pins.h"
 
 #define _BV(n) (1 << (n))
 
+#define SAMPLE_RATE 44100
+
+// The CPU clock, and the PLL 0 settings for it (see main)
 #define CLOCK_SPEED 44100000
+#define PLL_M 147
+#define PLL_N 8
+#define PLL_CCLKDIV 10
+
+// The CPU clock dividers switched to once running: 110.25MHz while
+// recording or playing, for the drawing and SD card work, and
+// 22.05MHz while idle. Both keep the clock a multiple of SAMPLE_RATE.
+#define CCLKDIV_BUSY 4
+#define CCLKDIV_IDLE 20
+
 #define DMA_LL_POOL_SIZE 64
 #define AUDIO_BUFFER_LEN SD_BLOCK_LEN
 
+// Where the touch screen calibration is on the card
+#define CALIBRATION_BLOCK 0
+
+// and the splash screen image (made with ImageConverter), after it.
+// SPLASH_BLOCKS is room for any image the size of the panel, even
+// stored as RGB565 values with no runs (303 blocks).
+#define SPLASH_BLOCK 1
+#define SPLASH_BLOCKS 512
+#define SPLASH_MS 1500
+
+// Recordings go after both, so however long they run they never
+// overwrite them
+#define RECORDING_BLOCK (SPLASH_BLOCK + SPLASH_BLOCKS)
+
+// Where the scope is drawn while recording, below the status line
+#define SCOPE_X 10
+#define SCOPE_Y 70
+
+// and the spectrum below it
+#define SPECTRUM_X 10
+#define SPECTRUM_Y 220
+
+// Debug builds also write their reports out of UART3 (TXD3 on P0.0),
+// at REPORT_BAUD, through DMA channels 2 and 3, so they can be read on
+// the bench with no debugger attached to take them over semihosting
+#define REPORT_BAUD 115200
+
+// Events in the trace (see UMDLPC/system/trace.h), dumped to trace.bin
+// over semihosting after each playback or recording
+enum {
+  TRACE_DMA_TC = TRACE_USER,  // arg is the state moved to
+  TRACE_WAIT,                 // span: arg is the state waited for
+  TRACE_STORE,                // span: arg is the block
+  TRACE_OVERRUN               // arg is the buffers recorded
+};
+
 #endif
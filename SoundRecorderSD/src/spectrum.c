@@ -0,0 +1,116 @@
+#include "spectrum.h"
+#include "UMDLPC/system/sleep.h"
+
+#define FG 0xF800
+#define BG 0xFFFF
+
+static uint16_t left, top;
+
+static Q15Complex data[SPECTRUM_POINTS];
+
+// Buffers since the last transform, and the cycles it took
+static uint_fast8_t buffers;
+static uint32_t cycles;
+
+// The height each bar should be and is, and the bar to look at first
+// on the next draw, so that every bar gets its turn
+static uint8_t height[SPECTRUM_BARS], shown[SPECTRUM_BARS];
+static uint_fast8_t next_bar;
+
+// log2(power), in 1/16ths, with the fraction taken linearly between
+// powers of 2 (good to about half a dB)
+uint32_t static log2_16(uint32_t power) {
+  uint32_t bits;
+
+  if (!power) {
+    return 0;
+  }
+
+  bits = 31 - __builtin_clz(power);
+  return bits * 16 + (((power << (31 - bits)) >> 27) & 0xF);
+}
+
+void spectrum_init(uint16_t x, uint16_t y) {
+  uint_fast8_t i;
+
+  left = x;
+  top = y;
+
+  buffers = 0;
+  next_bar = 0;
+  for (i = 0; i < SPECTRUM_BARS; ++i) {
+    height[i] = shown[i] = 0;
+  }
+
+  TFT_fill_rect(left, top, SPECTRUM_BARS * 2, SPECTRUM_HEIGHT, BG);
+}
+
+// Windows and transforms samples into data, returning the cycles taken
+uint32_t static transform(const uint32_t *samples) {
+  const uint32_t start = sleep_counter();
+
+  fft_window(samples, data, SPECTRUM_POINTS);
+  fft_q15(data, SPECTRUM_POINTS);
+
+  return sleep_counter() - start;
+}
+
+void spectrum_snapshot(const uint32_t *samples, uint32_t count) {
+  uint32_t start;
+  uint_fast8_t i;
+
+  if (count < SPECTRUM_POINTS || ++buffers < SPECTRUM_INTERVAL) {
+    return;
+  }
+  buffers = 0;
+  start = sleep_counter();
+
+  transform(samples);
+
+  for (i = 0; i < SPECTRUM_BARS; ++i) {
+    int32_t re = data[i + 1].re, im = data[i + 1].im;
+    uint32_t power = (uint32_t) (re * re) + (uint32_t) (im * im);
+
+    // All 32 bits of power (~96dB) over the height of the view
+    height[i] = log2_16(power) * SPECTRUM_HEIGHT / (32 * 16);
+  }
+
+  cycles = sleep_counter() - start;
+}
+
+void spectrum_draw(const volatile uint32_t *counter) {
+  const uint32_t start = *counter;
+  const uint16_t bottom = top + SPECTRUM_HEIGHT;
+  uint32_t spent = 0;
+  uint_fast8_t looked;
+
+  for (looked = 0; looked < SPECTRUM_BARS; ++looked) {
+    const uint_fast8_t i = next_bar;
+    const uint16_t x = left + 2 * i;
+
+    if (spent >= SPECTRUM_PIXEL_BUDGET || *counter != start) {
+      return;
+    }
+    if (++next_bar == SPECTRUM_BARS) {
+      next_bar = 0;
+    }
+
+    // Only the part of the bar which changed is drawn
+    if (height[i] > shown[i]) {
+      TFT_fill_rect(x, bottom - height[i], 2, height[i] - shown[i], FG);
+      spent += 2 * (height[i] - shown[i]) + SPECTRUM_WINDOW_COST;
+    } else if (height[i] < shown[i]) {
+      TFT_fill_rect(x, bottom - shown[i], 2, shown[i] - height[i], BG);
+      spent += 2 * (shown[i] - height[i]) + SPECTRUM_WINDOW_COST;
+    }
+    shown[i] = height[i];
+  }
+}
+
+uint32_t spectrum_cycles(void) {
+  return cycles;
+}
+
+uint32_t spectrum_benchmark(const uint32_t *samples) {
+  return transform(samples);
+}
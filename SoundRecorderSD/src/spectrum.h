@@ -0,0 +1,72 @@
+/* spectrum.h
+ *
+ * Declares a spectrum view of the audio being recorded, for spotting
+ * hum and noise: a bar per FFT bin, on a log (dB) scale.
+ *
+ * Like the scope, it is fed each complete ADC DMA buffer as it comes
+ * (spectrum_snapshot), but only transforms every SPECTRUM_INTERVAL'th
+ * one, and draws the bars which changed a few at a time
+ * (spectrum_draw), within a pixel budget and never past the
+ * completion of the next buffer.
+ */
+
+#ifndef __SPECTRUM_h_
+#define __SPECTRUM_h_
+
+/* Provides uintN_t, uint_fastN_t, etc. (for N {8,16,32}) */
+#include <stdint.h>
+
+#include "UMDLPC/util/fft.h"
+#include "ssd1289.h"
+
+/* Points per transform, taken from the start of a buffer. At 44.1kHz
+ * 512 points gives bins 86Hz apart.
+ */
+#define SPECTRUM_POINTS 512
+
+/* The bars, each 2 pixels wide, show bins 1 to SPECTRUM_BARS (so DC
+ * is left out, and the top shown is SPECTRUM_BARS * 86Hz = 9.5kHz)
+ */
+#define SPECTRUM_BARS 110
+#define SPECTRUM_HEIGHT 64
+
+/* Buffers per transform */
+#define SPECTRUM_INTERVAL 8
+
+/* Pixels which may be drawn per call to spectrum_draw, with each
+ * window setup counting as SPECTRUM_WINDOW_COST
+ */
+#ifndef SPECTRUM_PIXEL_BUDGET
+#define SPECTRUM_PIXEL_BUDGET 512
+#endif
+#define SPECTRUM_WINDOW_COST 64
+
+/* spectrum_init(x, y)
+ * Clears the view, with its top left corner at (x, y).
+ */
+void spectrum_init(uint16_t x, uint16_t y);
+
+/* spectrum_snapshot(samples, count)
+ * Takes a complete buffer of at least SPECTRUM_POINTS ADC data
+ * register values, transforming it if it's time for a new spectrum.
+ */
+void spectrum_snapshot(const uint32_t *samples, uint32_t count);
+
+/* spectrum_draw(counter)
+ * Draws bars which changed, stopping early if *counter changes.
+ */
+void spectrum_draw(const volatile uint32_t *counter);
+
+/* spectrum_cycles()
+ * Returns the CPU cycles the last window and transform took.
+ */
+uint32_t spectrum_cycles(void);
+
+/* spectrum_benchmark(samples)
+ * Windows and transforms SPECTRUM_POINTS ADC data register values as
+ * spectrum_snapshot does, but without changing the view, and returns
+ * the CPU cycles taken.
+ */
+uint32_t spectrum_benchmark(const uint32_t *samples);
+
+#endif
@@ -1,43 +1,238 @@
 #include "ssd1289.h"
+#include "UMDLPC/system/sleep.h"
+#include "UMDLPC/system/dma.h"
+#include "UMDLPC/system/pconp.h"
+#include "UMDLPC/system/clocking.h"
+#include "UMDLPC/system/delay.h"
+#include "UMDLPC/system/profile.h"
+
+#include <stdint.h>
+
+/* Bus timings, in ns. The SSD1289 figures are from the 80-system
+ * write timing in its datasheet: a write cycle of at least 100ns, with
+ * WR held low and then high for at least 50ns each, and RS/CS set up
+ * 10ns before WR falls. The shift register clock and latch pulses are
+ * for a 74HC595 at 3.3V.
+ */
+#define T_WR_LOW_NS 50
+#define T_WR_HIGH_NS 50
+#define T_SETUP_NS 10
+#define T_SHIFT_PULSE_NS 25
+
+// The timings above as cycles, at the current clock
+static uint32_t wr_low_cycles, wr_high_cycles, setup_cycles, shift_cycles;
+
+void static timing_init(void) {
+  wr_low_cycles = delay_ns_to_cycles(T_WR_LOW_NS);
+  wr_high_cycles = delay_ns_to_cycles(T_WR_HIGH_NS);
+  setup_cycles = delay_ns_to_cycles(T_SETUP_NS);
+  shift_cycles = delay_ns_to_cycles(T_SHIFT_PULSE_NS);
+}
 
-#define CLOCK_DELAY 10
+#if defined(TFT_SHIFT_SSP1_SSEL) && !defined(TFT_SHIFT_SSP1)
+#define TFT_SHIFT_SSP1
+#endif
 
-__attribute__((always_inline))
-void static _delay_loop_2(uint16_t __count) {
-  while (__count--) {
-    __asm__ volatile (
-       "nop" "\n"
-       "nop"
-       ::
-      );
-  }
+#ifdef TFT_SHIFT_SSP1
+
+#define SSP_TNF (1 << 1)
+#define SSP_BSY (1 << 4)
+
+// Shift clock, limited by the 74HC595 at 3.3V
+#ifndef TFT_SSP_HZ
+#define TFT_SSP_HZ 25000000
+#endif
+
+// SSP1 Prescaler, must be even and at least 2
+void static ssp_set_clock(uint32_t cclk_hz) {
+  uint32_t cpsr = (cclk_hz + TFT_SSP_HZ - 1) / TFT_SSP_HZ;
+
+  cpsr = (cpsr + 1) & ~1;
+  LPC_SSP1->CPSR = (cpsr < 2) ? 2 : cpsr;
 }
 
-__attribute__ ((always_inline))
-void static _delay_ms(uint_fast16_t __ms) {
-  uint16_t __ticks;
-  double __tmp;
-  __tmp = ((SystemCoreClock) / 4e3) * __ms;
-  if (__tmp < 1.0)
-    __ticks = 1;
-  else if (__tmp > 65535)
-  {
-    //      __ticks = requested delay in 1/10 ms
-    __ticks = (uint16_t) (__ms * 10.0);
-    while(__ticks)
-    {
-      // wait 1/10 ms
-      _delay_loop_2(((SystemCoreClock) / 4e3) / 10);
-      __ticks --;
+void static shift_init(void) {
+  // Power SSP1
+  LPC_SC->PCONP |= PC_SSP1;
+
+  // Peripheral clock - select undivided clock for SSP1 (1 at 21:20)
+  LPC_SC->PCLKSEL0 &= ~(3 << 20);
+  LPC_SC->PCLKSEL0 |= (1 << 20);
+
+  // Select pin functions
+  //   P0.7 as SCK1 (2 at 15:14)
+  //   P0.9 as MOSI1 (2 at 19:18)
+  LPC_PINCON->PINSEL0 &= ~((3 << 14) | (3 << 18));
+  LPC_PINCON->PINSEL0 |= (2 << 14) | (2 << 18);
+
+#ifdef TFT_SHIFT_SSP1_SSEL
+  //   P0.6 as SSEL1 (2 at 13:12)
+  LPC_PINCON->PINSEL0 &= ~(3 << 12);
+  LPC_PINCON->PINSEL0 |= (2 << 12);
+
+  // WR is strobed by SSEL1, don't fight it
+  TFT_WR_INPUT();
+
+  LPC_SC->PCONP |= PC_GPDMA;
+  LPC_GPDMA->DMACConfig |= 1;
+#endif
+
+  // SSP1 Control Register 0
+  //   16-bit transfers (15 at 3:0)
+  //   SPI (0 at 5:4)
+  //   Polarity and Phase default to Mode 0, so SSEL1 is deasserted
+  //   for a clock between back to back frames
+  LPC_SSP1->CR0 = 15;
+
+  ssp_set_clock(SystemCoreClock);
+
+  // SPI Control Register 1
+  //   Defaults to Master
+  //   Start serial communications (bit 1)
+  LPC_SSP1->CR1 |= (1 << 1);
+}
+
+void static ssp_frame(uint16_t data) {
+  while (!(LPC_SSP1->SR & SSP_TNF))
+    ;
+  LPC_SSP1->DR = data;
+}
+
+void static ssp_flush(void) {
+  while (LPC_SSP1->SR & SSP_BSY)
+    ;
+}
+
+#else
+
+void static shift_init(void) {
+  TFT_SHIFT_DATA_OUTPUT();
+  TFT_SHIFT_CLOCK_OUTPUT();
+}
+
+#endif
+
+#ifdef TFT_SHIFT_SSP1_SSEL
+
+/* With SSEL1 wired to both the shift register latch and WR, every
+ * frame's rising SSEL edge writes the word already on the bus to the
+ * panel, and then latches the word that was just shifted in (the
+ * 74HC595's propagation delay provides the hold time). So the panel
+ * always receives the previous frame's word. A write is a frame with
+ * CS high (latched, but ignored by the panel), followed by frames
+ * with CS low.
+ */
+
+#ifndef TFT_DMA_CHANNEL
+#define TFT_DMA_CHANNEL LPC_GPDMACH7
+#endif
+
+// The most transfers a single DMA transfer can do (bits 11:0)
+#define DMA_MAX_TRANSFER 4095
+
+// The last word shifted out, still sitting in the shift register latch
+static uint16_t latched_word;
+
+void static bus_prime(uint16_t word) {
+  TFT_CS_ON();
+  ssp_frame(word);
+  ssp_flush();
+  TFT_CS_OFF();
+
+  latched_word = word;
+}
+
+void static bus_write(uint16_t word) {
+  bus_prime(word);
+  ssp_frame(word);
+  ssp_flush();
+}
+
+// Stream count frames from source over DMA, incrementing through
+// source or repeating its first word
+void static bus_stream(const uint16_t *source, uint32_t count,
+                       uint_fast8_t increment) {
+  LPC_GPDMACH_TypeDef * const channel = TFT_DMA_CHANNEL;
+  uint32_t chunk;
+
+  // Transmit DMA
+  LPC_SSP1->DMACR = 2;
+
+  while (count) {
+    chunk = (count > DMA_MAX_TRANSFER) ? DMA_MAX_TRANSFER : count;
+
+    channel->DMACCSrcAddr  = (uint32_t) source;
+    channel->DMACCDestAddr = (uint32_t) &(LPC_SSP1->DR);
+    channel->DMACCLLI      = 0;
+
+    // Channel control register
+    //  Transfer size: chunk (bits 11:0)
+    //  Source burst size: 1 (0, bits 14:12)
+    //  Destination burst size: 4 (1, bits 17:15)
+    //  Source transfer width: halfword (1, bits 20:18)
+    //  Destination transfer width: halfword (1, bits 23:21)
+    //  Source increment: increment (bit 26)
+    //  Destination increment: don't increment (0, bit 27)
+    //  Terminal count interrupt: enabled (bit 31)
+    channel->DMACCControl = chunk
+                          | (1 << 15)
+                          | (1 << 18) | (1 << 21)
+                          | (increment ? (1 << 26) : 0)
+                          | (1 << 31);
+
+    //  Enable channel (1 at bit 0)
+    //  Source peripheral: memory (default, bits  5:1)
+    //  Destination peripheral: SSP1 TX (2, bits  10:6)
+    //  Transfer Type: memory-to-peripheral (1, bits 13:11)
+    //  Enable terminal count interrupt (bit 15)
+    channel->DMACCConfig = (1 << 0) | (2 << 6) | (1 << 11) | (1 << 15);
+
+    dma_wait(channel);
+
+    if (increment) {
+      source += chunk;
     }
+    count -= chunk;
+  }
+
+  LPC_SSP1->DMACR = 0;
+  ssp_flush();
+}
+
+// Below this many frames, writing them directly is quicker than
+// setting up a DMA transfer
+#define DMA_MIN_TRANSFER 8
+
+void static bus_repeat(uint32_t count) {
+  if (count >= DMA_MIN_TRANSFER) {
+    bus_stream(&latched_word, count, 0);
     return;
   }
-  else
-    __ticks = (uint16_t)__tmp;
-  _delay_loop_2(__ticks);
+
+  while (count--) {
+    ssp_frame(latched_word);
+  }
+  ssp_flush();
+}
+
+void static bus_write_run(const uint16_t *words, uint32_t count) {
+  bus_prime(words[0]);
+  if (count > 1) {
+    bus_stream(words + 1, count - 1, 1);
+  }
+
+  // One more frame to clock out the last word
+  ssp_frame(words[count - 1]);
+  ssp_flush();
 }
 
+#else
+
 void static shift_out(uint16_t data) {
+#ifdef TFT_SHIFT_SSP1
+  ssp_frame(data);
+  ssp_flush();
+#else
   uint16_t mask = 1 << 15; //0x8000; // 1000 0000b
 
   while (mask) {
@@ -48,40 +243,81 @@ void static shift_out(uint16_t data) {
     }
 
     TFT_SHIFT_CLOCK_ON();
-    _delay_loop_2(CLOCK_DELAY);
+    delay_cycles(shift_cycles);
     TFT_SHIFT_CLOCK_OFF();
 
     mask >>= 1;
   }
+#endif
 
   TFT_SHIFT_LATCH_ON();
-  _delay_loop_2(CLOCK_DELAY);
+  delay_cycles(shift_cycles);
   TFT_SHIFT_LATCH_OFF();
 }
 
+void static bus_write(uint16_t word) {
+  shift_out(word);
+
+  TFT_WR_OFF();
+  delay_cycles(wr_low_cycles);
+  TFT_WR_ON();
+  delay_cycles(wr_high_cycles);
+}
+
+// Write the latched word again, count more times, by just strobing WR
+void static bus_repeat(uint32_t count) {
+  while (count--) {
+    TFT_WR_OFF();
+    delay_cycles(wr_low_cycles);
+    TFT_WR_ON();
+    delay_cycles(wr_high_cycles);
+  }
+}
+
+void static bus_write_run(const uint16_t *words, uint32_t count) {
+  while (count--) {
+    bus_write(*words++);
+  }
+}
+
+#endif
+
 void TFT_shift_test() {
   uint32_t i=0;
-  while(1)shift_out(i++);
+  while(1)bus_write(i++);
 }
 
 void TFT_write_command(uint16_t command) {
   TFT_RS_OFF();
-  _delay_loop_2(CLOCK_DELAY);
-  shift_out(command);
-
-  TFT_WR_OFF();
-  _delay_loop_2(CLOCK_DELAY);
-  TFT_WR_ON();
+  delay_cycles(setup_cycles);
+  bus_write(command);
 }
 
 void TFT_write_data(uint16_t data) {
   TFT_RS_ON();
-  _delay_loop_2(CLOCK_DELAY);
-  shift_out(data);
+  delay_cycles(setup_cycles);
+  bus_write(data);
+}
 
-  TFT_WR_OFF();
-  _delay_loop_2(CLOCK_DELAY);
-  TFT_WR_ON();
+void TFT_write_pixels(const uint16_t *pixels, uint32_t count) {
+  if (!count) {
+    return;
+  }
+
+  TFT_RS_ON();
+  delay_cycles(setup_cycles);
+  bus_write_run(pixels, count);
+}
+
+void TFT_write_repeat(uint16_t pixel, uint32_t count) {
+  if (!count) {
+    return;
+  }
+
+  TFT_RS_ON();
+  delay_cycles(setup_cycles);
+  bus_write(pixel);
+  bus_repeat(count - 1);
 }
 
 void TFT_write_command_data(uint16_t command, uint16_t data) {
@@ -89,59 +325,102 @@ void TFT_write_command_data(uint16_t command, uint16_t data) {
   TFT_write_data(data);
 }
 
+// The window registers as last written, so that unchanged ones can be
+// skipped (0xFFFF never matches)
+static uint16_t window_x = 0xFFFF, window_y1 = 0xFFFF, window_y2 = 0xFFFF;
+
 void TFT_write_address(uint16_t x1, uint16_t y1, uint16_t x2, uint16_t y2) {
-  TFT_write_command_data(0x0044, (x2 << 8) + x1);
-  TFT_write_command_data(0x0045, y1);
-  TFT_write_command_data(0x0046, y2);
+  uint16_t x = (x2 << 8) + x1;
+
+  if (x != window_x) {
+    TFT_write_command_data(0x0044, x);
+    window_x = x;
+  }
+  if (y1 != window_y1) {
+    TFT_write_command_data(0x0045, y1);
+    window_y1 = y1;
+  }
+  if (y2 != window_y2) {
+    TFT_write_command_data(0x0046, y2);
+    window_y2 = y2;
+  }
+
   TFT_write_command_data(0x004e, x1);
   TFT_write_command_data(0x004f, y1);
   TFT_write_command(0x0022);
 }
 
-void TFT_fill(uint16_t color) {
-  uint32_t i;
+// Clip a rectangle to the panel, returns 0 if nothing is left of it
+uint_fast8_t static clip(int16_t *x, int16_t *y, int16_t *w, int16_t *h) {
+  if (*x < 0) {
+    *w += *x;
+    *x = 0;
+  }
+  if (*y < 0) {
+    *h += *y;
+    *y = 0;
+  }
+  if (*x + *w > TFT_WIDTH) {
+    *w = TFT_WIDTH - *x;
+  }
+  if (*y + *h > TFT_HEIGHT) {
+    *h = TFT_HEIGHT - *y;
+  }
+
+  return *w > 0 && *h > 0;
+}
+
+void TFT_fill_rect(int16_t x, int16_t y, int16_t w, int16_t h,
+                   uint16_t color) {
+  if (!clip(&x, &y, &w, &h)) {
+    return;
+  }
+
   TFT_CS_OFF();
-  _delay_loop_2(CLOCK_DELAY);
-  TFT_write_address(0,0,239,319);
+  delay_cycles(setup_cycles);
+  TFT_write_address(x, y, x + w - 1, y + h - 1);
   TFT_write_data(color);
 
-  for(i = 0; i <= 0x9600; i++)
-  {
-    TFT_WR_OFF();
-    _delay_loop_2(CLOCK_DELAY);
-    TFT_WR_ON();
-    _delay_loop_2(CLOCK_DELAY);
-    TFT_WR_OFF();
-    _delay_loop_2(CLOCK_DELAY);
-    TFT_WR_ON();
-    _delay_loop_2(CLOCK_DELAY);
-  }
+  // The color stays latched, so the rest of the window is just strobes
+  bus_repeat((uint32_t) w * h - 1);
 
   TFT_CS_ON();
 }
 
-void TFT_draw_box(uint16_t x1, uint16_t y1, uint16_t x2,
-                  uint16_t y2, uint16_t color) {
-  uint16_t dx = x2 - x1 + 2, j;
+void TFT_blit(uint16_t x, uint16_t y, uint16_t w, uint16_t h,
+              const uint16_t *pixels, uint16_t stride) {
   TFT_CS_OFF();
-  _delay_loop_2(CLOCK_DELAY);
-  TFT_write_address(x1, y1, x2, y2);
-  TFT_write_data(color);
-
-  y2 = (y2 - y1) + 2;
-  while (--y2) {
-    j = dx;
-    while (--j) {
-      TFT_WR_OFF();
-      _delay_loop_2(CLOCK_DELAY);
-      TFT_WR_ON();
-      _delay_loop_2(CLOCK_DELAY);
+  delay_cycles(setup_cycles);
+  TFT_write_address(x, y, x + w - 1, y + h - 1);
+
+  if (stride == w) {
+    TFT_write_pixels(pixels, (uint32_t) w * h);
+  } else {
+    for (; h; --h, pixels += stride) {
+      TFT_write_pixels(pixels, w);
     }
   }
 
   TFT_CS_ON();
 }
 
+void TFT_hline(int16_t x, int16_t y, int16_t w, uint16_t color) {
+  TFT_fill_rect(x, y, w, 1, color);
+}
+
+void TFT_vline(int16_t x, int16_t y, int16_t h, uint16_t color) {
+  TFT_fill_rect(x, y, 1, h, color);
+}
+
+void TFT_fill(uint16_t color) {
+  TFT_fill_rect(0, 0, TFT_WIDTH, TFT_HEIGHT, color);
+}
+
+void TFT_draw_box(uint16_t x1, uint16_t y1, uint16_t x2,
+                  uint16_t y2, uint16_t color) {
+  TFT_fill_rect(x1, y1, x2 - x1 + 1, y2 - y1 + 1, color);
+}
+
 void TFT_box_outline(uint16_t x1, uint16_t y1, uint16_t x2,
                      uint16_t y2, uint16_t width, uint16_t color) {
   width-=1;
@@ -153,6 +432,13 @@ void TFT_box_outline(uint16_t x1, uint16_t y1, uint16_t x2,
   TFT_draw_box(x1, y2 - width, x2, y2, color);
 }
 
+void TFT_scroll(uint16_t line) {
+  TFT_CS_OFF();
+  delay_cycles(setup_cycles);
+  TFT_write_command_data(0x0041, line % TFT_HEIGHT);
+  TFT_CS_ON();
+}
+
 void TFT_dot(uint16_t x, uint16_t y, uint16_t color) {
   TFT_CS_OFF();
 
@@ -162,29 +448,41 @@ void TFT_dot(uint16_t x, uint16_t y, uint16_t color) {
   TFT_CS_ON();
 }
 
+// Works the bus timings out again for a new CPU clock
+void static clock_changed(uint32_t cclk_hz) {
+  timing_init();
+#ifdef TFT_SHIFT_SSP1
+  ssp_set_clock(cclk_hz);
+#endif
+}
+
 void TFT_init(void) {
+  sleep_init();
+  delay_init();
+  timing_init();
+  clock_on_change(clock_changed);
+
   TFT_RS_OUTPUT();
   TFT_WR_OUTPUT();
   TFT_RD_OUTPUT();
   TFT_CS_OUTPUT();
   TFT_RST_OUTPUT();
 
-  TFT_SHIFT_DATA_OUTPUT();
-  TFT_SHIFT_CLOCK_OUTPUT();
   TFT_SHIFT_LATCH_OUTPUT();
+  shift_init();
 
   TFT_RD_ON();
-  _delay_loop_2(CLOCK_DELAY);
+  delay_cycles(setup_cycles);
 
   TFT_RST_ON();
-  _delay_ms(5);
+  sleep_delay_ms(5);
   TFT_RST_OFF();
-  _delay_ms(15);
+  sleep_delay_ms(15);
   TFT_RST_ON();
-  _delay_ms(15);
+  sleep_delay_ms(15);
 
   TFT_CS_OFF();
-  _delay_loop_2(CLOCK_DELAY);
+  delay_cycles(setup_cycles);
 
   TFT_write_command_data(0x0000,0x0001); // Turn on oscillator
   TFT_write_command_data(0x0003,0xA8A4); // Power control
@@ -203,8 +501,8 @@ void TFT_init(void) {
   TFT_write_command_data(0x0007,0x0233); // Display Control
   TFT_write_command_data(0x000B,0x0000); // Frame cycle control
   TFT_write_command_data(0x000F,0x0000); // Gate scan start position
-  TFT_write_command_data(0x0041,0x0000); // Vertical scroll control
-  TFT_write_command_data(0x0042,0x0000); // Horiz scroll control
+  TFT_write_command_data(0x0041,0x0000); // Vertical scroll, 1st screen
+  TFT_write_command_data(0x0042,0x0000); // Vertical scroll, 2nd screen
   TFT_write_command_data(0x0048,0x0000); // First window start
   TFT_write_command_data(0x0049,0x013F); // First window end
   TFT_write_command_data(0x004A,0x0000); // Second window start
@@ -229,59 +527,206 @@ void TFT_init(void) {
   TFT_write_command_data(0x004e,0x0000); // GDDRAM X addr counter
   TFT_write_command(0x0022); // RAM data write
 
+  // The window was written directly above
+  window_x = window_y1 = window_y2 = 0xFFFF;
 }
 
-void TFT_char(const uint8_t *font, uint8_t ch,
-              uint16_t x, uint16_t y,
-              uint16_t fg_color, uint16_t bg_color,
-              uint16_t width, uint16_t height) {
-  uint16_t j, k;
+/* Glyphs are drawn as runs of one color, each of which costs a single
+ * bus write followed by only WR strobes. The runs for a glyph are kept
+ * in a small cache, per row, as a run count followed by run lengths
+ * alternating between background and foreground (starting with the
+ * background, whose run may be empty). They don't depend on the colors,
+ * so one entry serves any fg/bg pair.
+ */
+typedef struct {
+  const uint8_t *font;
+  uint8_t ch;
+  uint32_t line;  // the last line drawn with this entry
+  uint8_t runs[TFT_GLYPH_RUN_BYTES];
+} GlyphRuns;
+
+static GlyphRuns glyph_cache[TFT_GLYPH_CACHE];
+
+// Counts lines drawn, so entries in use by the current one aren't
+// replaced under it
+static uint32_t line_number;
+
+// Where each glyph of a line being drawn is up to: its next row of
+// cached runs or, for glyphs too detailed for the cache, of bitmap
+typedef struct {
+  const uint8_t *runs;
+  const uint8_t *bitmap;
+} GlyphCursor;
+
+// Most glyphs (at least 8 wide, plus spacing) on one line of the panel
+#define LINE_GLYPHS (TFT_WIDTH / 9 + 1)
+
+static uint16_t run_color;
+static uint32_t run_length;
+
+void static run_flush(void) {
+  if (run_length) {
+    bus_write(run_color);
+    bus_repeat(run_length - 1);
+    run_length = 0;
+  }
+}
+
+// Queue length pixels of color, joining them onto the last run if the
+// color matches
+void static run_emit(uint16_t color, uint32_t length) {
+  if (run_length && color != run_color) {
+    run_flush();
+  }
+
+  run_color = color;
+  run_length += length;
+}
+
+// Returns the cached runs for ch, encoding them first if needed, or 0
+// if they don't fit in a cache entry
+const uint8_t static *glyph_runs(const uint8_t *font, uint8_t ch,
+                                 uint16_t width, uint16_t height) {
+  GlyphRuns *entry =
+    &glyph_cache[(ch ^ ((uintptr_t) font >> 4)) % TFT_GLYPH_CACHE];
   const uint8_t *bmp_addr = font + ((ch - ' ')*height*(width/8));
-  uint8_t bmp_byte = 0, pixel_mask = 0x80;
-  uint8_t bit_set = 0;
+  uint8_t *out = entry->runs, *end = entry->runs + TFT_GLYPH_RUN_BYTES;
+  uint8_t *count, length, bit, last;
+  uint16_t row, col;
 
-  TFT_CS_OFF();
-  _delay_loop_2(CLOCK_DELAY);
-  TFT_write_address(x, y, x + width - 1, y + height - 1);
-
-  k = 0;
-  while (height--)
-  {
-    for (j = width; j; --j)
-    {
-      if ((k % 8) == 0) {
-        bmp_byte = *bmp_addr;
-        pixel_mask = 0x80;
-        ++bmp_addr;
+  if (entry->font == font && entry->ch == ch) {
+    entry->line = line_number;
+    return entry->runs;
+  }
+
+  if (entry->font && entry->line == line_number) {
+    return 0;
+  }
+
+  entry->font = 0;
+  entry->line = line_number;
+
+  for (row = 0; row < height; ++row, bmp_addr += width / 8) {
+    if (end - out < 2) {
+      return 0;
+    }
+    count = out++;
+    *count = 0;
+    length = 0;
+    last = 0;
+
+    for (col = 0; col < width; ++col) {
+      bit = (bmp_addr[col / 8] >> (7 - col % 8)) & 1;
+      if (bit != last) {
+        if (out == end) {
+          return 0;
+        }
+        *out++ = length;
+        ++*count;
+        length = 0;
+        last = bit;
       }
+      ++length;
+    }
+
+    if (out == end) {
+      return 0;
+    }
+    *out++ = length;
+    ++*count;
+  }
+
+  entry->font = font;
+  entry->ch = ch;
+  return entry->runs;
+}
+
+void static glyph_row(GlyphCursor *glyph, uint16_t width,
+                      uint16_t fg_color, uint16_t bg_color) {
+  uint8_t count;
+  uint16_t col;
+
+  if (glyph->runs) {
+    count = *glyph->runs++;
+    for (col = 0; col < count; ++col) {
+      run_emit((col & 1) ? fg_color : bg_color, *glyph->runs++);
+    }
+  } else {
+    for (col = 0; col < width; ++col) {
+      run_emit((glyph->bitmap[col / 8] & (0x80 >> (col % 8)))
+               ? fg_color : bg_color, 1);
+    }
+    glyph->bitmap += width / 8;
+  }
+}
 
-      bit_set = bmp_byte & pixel_mask;
+// Draws count glyphs side by side, one pixel apart, through a single
+// window; the spacing columns are filled with the background
+void static draw_line(const uint8_t *font, const char *s, uint_fast8_t count,
+                      uint16_t x, uint16_t y,
+                      uint16_t fg_color, uint16_t bg_color,
+                      uint16_t width, uint16_t height) {
+  GlyphCursor glyphs[LINE_GLYPHS];
+  uint_fast8_t i;
+  uint16_t row;
+
+  ++line_number;
+  for (i = 0; i < count; ++i) {
+    glyphs[i].runs = glyph_runs(font, s[i], width, height);
+    glyphs[i].bitmap = font + ((((uint8_t) s[i]) - ' ')*height*(width/8));
+  }
 
-      pixel_mask >>= 1;
-      ++k;
+  TFT_CS_OFF();
+  delay_cycles(setup_cycles);
+  TFT_write_address(x, y, x + count * (width + 1) - 2, y + height - 1);
+  TFT_RS_ON();
+  delay_cycles(setup_cycles);
 
-      if (bit_set) {
-        TFT_write_data(fg_color);
-      } else {
-        TFT_write_data(bg_color);
+  for (row = 0; row < height; ++row) {
+    for (i = 0; i < count; ++i) {
+      if (i) {
+        run_emit(bg_color, 1);
       }
+      glyph_row(&glyphs[i], width, fg_color, bg_color);
     }
   }
+  run_flush();
 
   TFT_CS_ON();
 }
 
+void TFT_char(const uint8_t *font, uint8_t ch,
+              uint16_t x, uint16_t y,
+              uint16_t fg_color, uint16_t bg_color,
+              uint16_t width, uint16_t height) {
+  PROFILE_ENTER(TFT_char);
+  draw_line(font, (const char *) &ch, 1, x, y,
+            fg_color, bg_color, width, height);
+  PROFILE_EXIT(TFT_char);
+}
+
 void TFT_string(const uint8_t *font, const char * s,
                 uint16_t x, uint16_t y,
                 uint16_t fg_color, uint16_t bg_color,
                 uint16_t width, uint16_t height) {
+  uint_fast8_t count, fits;
+
   while (*s) {
-    TFT_char(font, *s, x, y, fg_color, bg_color, width, height);
-    x += width + 1;
-    if (x > (320 - width)) {
+    if (x > (TFT_WIDTH - width)) {
       x = 0;
       y += height + 1;
     }
-    ++s;
+
+    // As many of the following characters as fit on this line
+    fits = (TFT_WIDTH - width - x) / (width + 1) + 1;
+    if (fits > LINE_GLYPHS) {
+      fits = LINE_GLYPHS;
+    }
+    for (count = 1; count < fits && s[count]; ++count)
+      ;
+
+    draw_line(font, s, count, x, y, fg_color, bg_color, width, height);
+    s += count;
+    x += count * (width + 1);
   }
 }
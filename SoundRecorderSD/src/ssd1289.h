@@ -6,6 +6,19 @@
 
 #include "pins.h"
 
+#define TFT_WIDTH 240
+#define TFT_HEIGHT 320
+
+/* Glyph run cache (see TFT_char): number of entries, and bytes of runs
+ * per entry. Glyphs needing more are drawn straight from the font.
+ */
+#ifndef TFT_GLYPH_CACHE
+#define TFT_GLYPH_CACHE 16
+#endif
+#ifndef TFT_GLYPH_RUN_BYTES
+#define TFT_GLYPH_RUN_BYTES 112
+#endif
+
 void TFT_init(void);
 
 void TFT_write_command(uint16_t command);
@@ -13,6 +26,35 @@ void TFT_write_data(uint16_t data);
 void TFT_write_command_data(uint16_t command, uint16_t data);
 void TFT_write_address(uint16_t x1, uint16_t y1, uint16_t x2, uint16_t y2);
 
+/* TFT_write_pixels(pixels, count)
+ * Streams count pixels into the window set by TFT_write_address. With
+ * TFT_SHIFT_SSP1_SSEL this is done by DMA.
+ */
+void TFT_write_pixels(const uint16_t *pixels, uint32_t count);
+
+/* TFT_write_repeat(pixel, count)
+ * Writes pixel count times into the window set by TFT_write_address,
+ * shifting it out once and then only strobing WR.
+ */
+void TFT_write_repeat(uint16_t pixel, uint32_t count);
+
+/* TFT_fill_rect(x, y, w, h, color)
+ * Fills a w by h rectangle, clipped to the panel. The color is shifted
+ * out once and then only WR is strobed for each pixel.
+ */
+void TFT_fill_rect(int16_t x, int16_t y, int16_t w, int16_t h,
+                   uint16_t color);
+
+/* TFT_blit(x, y, w, h, pixels, stride)
+ * Copies a w by h block of pixels, whose rows start stride pixels
+ * apart, to the panel at (x, y). The block must lie on the panel.
+ */
+void TFT_blit(uint16_t x, uint16_t y, uint16_t w, uint16_t h,
+              const uint16_t *pixels, uint16_t stride);
+
+void TFT_hline(int16_t x, int16_t y, int16_t w, uint16_t color);
+void TFT_vline(int16_t x, int16_t y, int16_t h, uint16_t color);
+
 void TFT_fill(uint16_t color);
 void TFT_draw_box(uint16_t x1, uint16_t y1, uint16_t x2,
                   uint16_t y2, uint16_t color);
@@ -20,6 +62,16 @@ void TFT_box_outline(uint16_t x1, uint16_t y1, uint16_t x2,
                      uint16_t y2, uint16_t width, uint16_t color);
 void TFT_dot(uint16_t x, uint16_t y, uint16_t color);
 
+/* TFT_scroll(line)
+ * Scrolls the panel vertically, so that its top row shows GDDRAM row
+ * line. Drawing coordinates still address GDDRAM, not the screen.
+ */
+void TFT_scroll(uint16_t line);
+
+/* TFT_string(font, s, x, y, fg_color, bg_color, width, height)
+ * Draws s with one pixel of spacing, wrapping at the right edge. Each
+ * line of text is sent through a single window, spacing included.
+ */
 void TFT_string(const uint8_t *font, const char * ch,
                 uint16_t x, uint16_t y,
                 uint16_t fg_color, uint16_t bg_color,
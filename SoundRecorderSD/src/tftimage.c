@@ -0,0 +1,92 @@
+#include "tftimage.h"
+#include "sd.h"
+
+#include <string.h>
+
+// Longest literal packet (control byte 0x7F)
+#define LITERAL_MAX 128
+
+typedef struct {
+  uint8_t *block;
+  uint32_t block_num;
+  uint16_t pos;
+  char ok;
+} Reader;
+
+uint8_t static read_byte(Reader *reader) {
+  if (reader->pos == SD_BLOCK_LEN) {
+    if (!sd_read_block(reader->block, ++reader->block_num)) {
+      reader->ok = 0;
+    }
+    reader->pos = 0;
+  }
+
+  return reader->block[reader->pos++];
+}
+
+uint16_t static read_word(Reader *reader) {
+  uint16_t low = read_byte(reader);
+  return low | (read_byte(reader) << 8);
+}
+
+char TFT_image(uint32_t block_num, uint16_t x, uint16_t y, uint8_t *block) {
+  static uint16_t palette[256];
+  uint16_t literal[LITERAL_MAX];
+  Reader reader = { block, block_num, 0, 1 };
+  uint16_t width, height, colors, i;
+  uint32_t left, count;
+  uint8_t control;
+
+  if (!sd_read_block(block, block_num)
+      || memcmp(block, "TFI1", 4)) {
+    return 0;
+  }
+
+  reader.pos = 4;
+  width = read_word(&reader);
+  height = read_word(&reader);
+  colors = read_word(&reader);
+  read_word(&reader);
+
+  if (!width || !height || colors > 256
+      || x + width > TFT_WIDTH || y + height > TFT_HEIGHT) {
+    return 0;
+  }
+
+  for (i = 0; i < colors; ++i) {
+    palette[i] = read_word(&reader);
+  }
+
+  TFT_CS_OFF();
+  TFT_write_address(x, y, x + width - 1, y + height - 1);
+
+  // Runs go out as a single write and then WR strobes; literals are
+  // looked up into a buffer and written together.
+  left = (uint32_t) width * height;
+  while (left && reader.ok) {
+    control = read_byte(&reader);
+    count = (control & 0x80) ? (control & 0x7F) + 2 : control + 1;
+
+    if (count > left) {
+      reader.ok = 0;
+      count = left;
+    }
+
+    if (control & 0x80) {
+      TFT_write_repeat(colors ? palette[read_byte(&reader)]
+                              : read_word(&reader), count);
+    } else {
+      for (i = 0; i < count; ++i) {
+        literal[i] = colors ? palette[read_byte(&reader)]
+                            : read_word(&reader);
+      }
+      TFT_write_pixels(literal, count);
+    }
+
+    left -= count;
+  }
+
+  TFT_CS_ON();
+
+  return reader.ok;
+}
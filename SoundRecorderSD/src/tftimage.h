@@ -0,0 +1,48 @@
+/* tftimage.h
+ *
+ * Declares a blitter for compressed images stored on the SD card,
+ * which streams them into a TFT window one block at a time, without
+ * a frame buffer. Images are made from PPM files with the converter
+ * in ImageConverter.
+ *
+ * Image format (all values little endian):
+ *
+ *   offset 0   "TFI1"
+ *          4   width (16 bits)
+ *          6   height (16 bits)
+ *          8   colors (16 bits): palette entries, 1 to 256, or 0 if
+ *              pixels are stored as RGB565 values
+ *         10   reserved, 0 (16 bits)
+ *         12   the palette, colors RGB565 values (16 bits each)
+ *
+ * followed by packets of pixels, left to right and top to bottom,
+ * each starting with a control byte c:
+ *
+ *   c & 0x80   a run: one value, repeated (c & 0x7F) + 2 times
+ *   otherwise  c + 1 values
+ *
+ * where a value is a palette index (8 bits), or an RGB565 pixel
+ * (16 bits) for images without a palette. The image is read from
+ * consecutive blocks, with packets and the palette carrying on from
+ * one block into the next.
+ */
+
+#ifndef __TFTIMAGE_h_
+#define __TFTIMAGE_h_
+
+/* Provides uintN_t, uint_fastN_t, etc. (for N {8,16,32}) */
+#include <stdint.h>
+
+#include "ssd1289.h"
+
+#define TFT_IMAGE_HEADER_LEN 12
+
+/* TFT_image(block_num, x, y, block)
+ * Draws the image stored from block block_num onwards with its top
+ * left corner at (x, y), using block (SD_BLOCK_LEN bytes) as the read
+ * buffer. Returns 1 on success, or 0 if a block couldn't be read, the
+ * image is corrupt or it doesn't fit on the panel at (x, y).
+ */
+char TFT_image(uint32_t block_num, uint16_t x, uint16_t y, uint8_t *block);
+
+#endif
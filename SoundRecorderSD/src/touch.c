@@ -1,28 +1,211 @@
 #include "touch.h"
 #include <stdio.h>
 #include "UMDLPC/util/util.h"
+#include "UMDLPC/system/pconp.h"
+#include "UMDLPC/system/sleep.h"
+#include "UMDLPC/system/clocking.h"
+#include "UMDLPC/system/delay.h"
+
+/* Readings at the edges of the first panel this was used with, which
+ * make up the calibration until touch_set_calibration is called. The
+ * controller's x runs along the screen's y, and its y along x.
+ */
+static const int32_t MIN_X = 0x2a0, MAX_X = 0x1f00,
+                     MIN_Y = 0x210, MAX_Y = 0x1dd0;
+
+// Controller commands: start, 12 bit differential conversion of
+// channel (bits 6:4), powering down between conversions so that
+// PENIRQ stays enabled
+#define READ_X  0x90
+#define READ_Y  0xD0
+#define READ_Z1 0xB0
+#define READ_Z2 0xC0
+
+// Timer control bits
+#define TCR_ENABLE (1 << 0)
+#define TCR_RESET  (1 << 1)
+
+#define PENIRQ_MASK (1 << TOUCH_PENIRQ_PIN_NUM)
+
+// Readings from this batch
+static uint16_t samples_x[TOUCH_SAMPLES], samples_y[TOUCH_SAMPLES];
+
+static TouchCalibration calibration;
+
+// Whether a press has been queued since the pen went down, the
+// filtered readings (in 1/16ths), and the last press, for the release
+// event
+static uint_fast8_t pressed;
+static int32_t smooth_x, smooth_y;
+static TouchEvent last;
+
+static TouchEvent queue[TOUCH_QUEUE_LEN];
+static volatile uint_fast8_t queue_head, queue_tail;
+
+#ifdef TOUCH_SSP1
+
+/* SSP1 is run in SPI mode 0 with 8 bit frames, and each conversion is
+ * 3 frames (24 clocks): the command, then 16 clocks which bring back
+ * a clock of busy, the 12 bits of the result, and 3 zeros.
+ *
+ * In the background, a whole batch of conversions (one to throw away,
+ * x and y for each sample, then Z1 and Z2) is started on one tick and
+ * streamed by two DMA channels, and is read back on the next tick.
+ * The channels' terminal count interrupts aren't used, so the batch
+ * costs no CPU time while it runs.
+ */
+
+#ifndef TOUCH_TX_CHANNEL
+#define TOUCH_TX_CHANNEL LPC_GPDMACH5
+#define TOUCH_RX_CHANNEL LPC_GPDMACH6
+#endif
+
+// The controller's fastest clock; SSP1 is run at this or just under
+#define TOUCH_SSP_HZ 2000000
+
+// SSP status bits
+#define SSP_RNE (1 << 2)
+#define SSP_BSY (1 << 4)
+
+#define BATCH_CONVERSIONS (1 + 2 * TOUCH_SAMPLES + 2)
+#define BATCH_BYTES (3 * BATCH_CONVERSIONS)
+
+static uint8_t batch_commands[BATCH_BYTES], batch_results[BATCH_BYTES];
+static uint_fast8_t batch_started;
+
+// SSP1 Prescaler, must be even and at least 2
+void static ssp_set_clock(uint32_t cclk_hz) {
+  uint32_t cpsr = (cclk_hz + TOUCH_SSP_HZ - 1) / TOUCH_SSP_HZ;
+
+  cpsr = (cpsr + 1) & ~1;
+  LPC_SSP1->CPSR = (cpsr < 2) ? 2 : cpsr;
+}
 
-/* Calibration values */
-static const uint32_t MIN_X = 0x210, MAX_X = 0x1dd0,
-                      MIN_Y = 0x2a0, MAX_Y = 0x1f00;
+void static transport_init(void) {
+  uint_fast8_t i;
 
-void touch_init(void) {
+  LPC_SC->PCONP |= PC_SSP1 | PC_GPDMA;
+  LPC_GPDMA->DMACConfig |= 1;
+
+  // Peripheral clock - select undivided clock for SSP1 (1 at 21:20)
+  LPC_SC->PCLKSEL0 &= ~(3 << 20);
+  LPC_SC->PCLKSEL0 |= (1 << 20);
+
+  // Select pin functions
+  //   P0.7 as SCK1 (2 at 15:14)
+  //   P0.8 as MISO1 (2 at 17:16)
+  //   P0.9 as MOSI1 (2 at 19:18)
+  LPC_PINCON->PINSEL0 &= ~((3 << 14) | (3 << 16) | (3 << 18));
+  LPC_PINCON->PINSEL0 |= (2 << 14) | (2 << 16) | (2 << 18);
+
+  // SSP1 Control Register 0
+  //   8-bit transfers (7 at 3:0)
+  //   SPI (0 at 5:4)
+  //   Polarity and Phase default to Mode 0
+  LPC_SSP1->CR0 = 7;
+
+  ssp_set_clock(SystemCoreClock);
+
+  // Receive and transmit DMA requests (bits 1:0); they're ignored
+  // while the channels are disabled
+  LPC_SSP1->DMACR = 3;
+
+  // SPI Control Register 1
+  //   Defaults to Master
+  //   Start serial communications (bit 1)
+  LPC_SSP1->CR1 |= (1 << 1);
+
+  // Each conversion's command, followed by 2 bytes of clocks
+  for (i = 0; i < BATCH_BYTES; ++i) {
+    batch_commands[i] = 0;
+  }
+  batch_commands[0] = READ_X;
+  for (i = 0; i < TOUCH_SAMPLES; ++i) {
+    batch_commands[3 + 6 * i] = READ_X;
+    batch_commands[6 + 6 * i] = READ_Y;
+  }
+  batch_commands[BATCH_BYTES - 6] = READ_Z1;
+  batch_commands[BATCH_BYTES - 3] = READ_Z2;
+}
+
+void static ssp_drain(void) {
+  while (LPC_SSP1->SR & SSP_RNE) {
+    (void) LPC_SSP1->DR;
+  }
+}
+
+// The result in a conversion's 3 frames, at the same scale as the bit
+// banged reads (which the calibration values are for)
+uint16_t static frame_result(const uint8_t *frame) {
+  return ((frame[1] << 8) | frame[2]) >> 2;
+}
+
+void static batch_start(void) {
+  ssp_drain();
+
+  // Receive first, so no frame is missed
+  TOUCH_RX_CHANNEL->DMACCSrcAddr  = (uint32_t) &(LPC_SSP1->DR);
+  TOUCH_RX_CHANNEL->DMACCDestAddr = (uint32_t) batch_results;
+  TOUCH_RX_CHANNEL->DMACCLLI      = 0;
+
+  // Channel control register
+  //  Transfer size: BATCH_BYTES (bits 11:0)
+  //  Burst sizes: 1 (0, bits 17:12)
+  //  Transfer widths: byte (0, bits 23:18)
+  //  Destination increment: increment (bit 27)
+  TOUCH_RX_CHANNEL->DMACCControl = BATCH_BYTES | (1 << 27);
+
+  //  Enable channel (1 at bit 0)
+  //  Source peripheral: SSP1 RX (3, bits  5:1)
+  //  Transfer Type: peripheral-to-memory (2, bits 13:11)
+  TOUCH_RX_CHANNEL->DMACCConfig = (1 << 0) | (3 << 1) | (2 << 11);
+
+  TOUCH_TX_CHANNEL->DMACCSrcAddr  = (uint32_t) batch_commands;
+  TOUCH_TX_CHANNEL->DMACCDestAddr = (uint32_t) &(LPC_SSP1->DR);
+  TOUCH_TX_CHANNEL->DMACCLLI      = 0;
+
+  //  Transfer size: BATCH_BYTES (bits 11:0)
+  //  Burst sizes: 1 (0, bits 17:12)
+  //  Transfer widths: byte (0, bits 23:18)
+  //  Source increment: increment (bit 26)
+  TOUCH_TX_CHANNEL->DMACCControl = BATCH_BYTES | (1 << 26);
+
+  //  Enable channel (1 at bit 0)
+  //  Destination peripheral: SSP1 TX (2, bits  10:6)
+  //  Transfer Type: memory-to-peripheral (1, bits 13:11)
+  TOUCH_TX_CHANNEL->DMACCConfig = (1 << 0) | (2 << 6) | (1 << 11);
+
+  batch_started = 1;
+}
+
+#else
+
+// Readings so far from this batch, and whether the next tick's
+// reading is the first since the pen went down (and thrown away)
+static uint_fast8_t sample_count, settling;
+
+// The controller's DCLK high and low times, at least 200ns each, as
+// cycles at the current clock
+#define T_DCLK_NS 200
+static uint32_t pulse_cycles;
+
+void static transport_init(void) {
   // Out is in and in is out!
   // (As in, the touch controller's in/out)
   TOUCH_IN_OUTPUT();
   TOUCH_CLK_OUTPUT();
   TOUCH_OUT_INPUT();
-  TOUCH_PENIRQ_INPUT();
+
+  delay_init();
+  pulse_cycles = delay_ns_to_cycles(T_DCLK_NS);
 }
 
-__attribute__((always_inline))
+__attribute__((always_inline)) inline
 void static _pulse_delay() {
-  __NOP();
-  __NOP();
-  __NOP();
+  delay_cycles(pulse_cycles);
 }
 
-__attribute__((always_inline))
+__attribute__((always_inline)) inline
 void static _clock() {
   TOUCH_CLK_ON();
   _pulse_delay();
@@ -30,7 +213,7 @@ void static _clock() {
   _pulse_delay();
 }
 
-__attribute__((always_inline))
+__attribute__((always_inline)) inline
 void static _clock_rev() {
   TOUCH_CLK_OFF();
   _pulse_delay();
@@ -74,81 +257,329 @@ uint16_t touch_read_data(void) {
   return data;
 }
 
-__attribute__((always_inline))
-void static touch_single_read(uint16_t *out_x, uint16_t *out_y) {
-  touch_write_data(0x90);
-
-  __NOP(); __NOP(); __NOP(); __NOP();
+// Returns the result of a conversion (12 bits, with a 0 below them)
+uint16_t static touch_convert(uint_fast8_t command) {
+  touch_write_data(command);
 
-  *out_x = touch_read_data();
+  _pulse_delay();
 
-  touch_write_data(0xD0);
+  return touch_read_data();
+}
 
-  __NOP(); __NOP(); __NOP(); __NOP();
+#endif
 
-  *out_y = touch_read_data();
+// Only ports 0 and 2 have GPIO interrupts
+void static penirq_arm(void) {
+  if (TOUCH_PENIRQ_PORT_NUM == 0) {
+    LPC_GPIOINT->IO0IntClr = PENIRQ_MASK;
+    LPC_GPIOINT->IO0IntEnF |= PENIRQ_MASK;
+  } else {
+    LPC_GPIOINT->IO2IntClr = PENIRQ_MASK;
+    LPC_GPIOINT->IO2IntEnF |= PENIRQ_MASK;
+  }
 }
 
-uint_fast8_t touch_read(uint16_t *out_x, uint16_t *out_y) {
-  uint16_t temp_x, temp_y;
-  uint32_t tx = 0, ty = 0;
+void static penirq_disarm(void) {
+  if (TOUCH_PENIRQ_PORT_NUM == 0) {
+    LPC_GPIOINT->IO0IntEnF &= ~PENIRQ_MASK;
+    LPC_GPIOINT->IO0IntClr = PENIRQ_MASK;
+  } else {
+    LPC_GPIOINT->IO2IntEnF &= ~PENIRQ_MASK;
+    LPC_GPIOINT->IO2IntClr = PENIRQ_MASK;
+  }
+}
 
-  // Throwaway reading: (first ADC reading is usually inaccurate)
-  touch_single_read(&temp_x, &temp_y);
+void static push(const TouchEvent *event) {
+  uint_fast8_t next = (queue_head + 1) % TOUCH_QUEUE_LEN;
 
-  uint_fast8_t datacount = 0;
+  if (next == queue_tail) {
+    return;
+  }
 
-  for (uint_fast8_t i = 8; i; --i) {
-    touch_single_read(&temp_x, &temp_y);
+  queue[queue_head] = *event;
+  queue[queue_head].time = sleep_counter();
+  queue_head = next;
+}
 
-    // 0 values usually mean the pen was lifted up while we were sampling
-    if (temp_y && temp_x) {
-      ty += temp_x;
-      tx += temp_y;
+// Median of the readings (which are sorted in place)
+uint16_t static median(uint16_t *readings, uint_fast8_t count) {
+  uint_fast8_t i, j;
+  uint16_t r;
 
-      ++datacount;
+  for (i = 1; i < count; ++i) {
+    r = readings[i];
+    for (j = i; j && readings[j - 1] > r; --j) {
+      readings[j] = readings[j - 1];
     }
+    readings[j] = r;
   }
 
-  if (datacount && tx && ty) {
-    tx /= datacount;
-    ty /= datacount;
+  return readings[count / 2];
+}
 
-    if (tx <= MIN_X) {
-      tx = 0;
-    } else {
-      tx -= MIN_X;
+// Clamped screen coordinate from raw readings, by one row of the
+// calibration
+int32_t static apply(int64_t a, int64_t b, int64_t c,
+                     int32_t raw_x, int32_t raw_y, int32_t max) {
+  int32_t v = (a * raw_x + b * raw_y + c) / calibration.divider;
 
-      tx *= 240;
-      tx /= (MAX_X - MIN_X);
-    }
+  return (v < 0) ? 0 : (v > max) ? max : v;
+}
 
-    if (ty <= MIN_Y) {
-      ty = 0;
-    } else {
-      ty -= MIN_X;
+// Queues a press from a batch of count readings
+void static make_event(uint16_t z1, uint16_t z2, uint_fast8_t count) {
+  int32_t x = median(samples_x, count) << 4, y = median(samples_y, count) << 4;
+
+  // Smooth the median over the presses since the pen went down
+  if (pressed) {
+    smooth_x += (x - smooth_x) >> TOUCH_SMOOTHING;
+    smooth_y += (y - smooth_y) >> TOUCH_SMOOTHING;
+  } else {
+    smooth_x = x;
+    smooth_y = y;
+  }
 
-      ty *= 320;
-      ty /= (MAX_Y - MIN_Y);
+  last.raw_x = (smooth_x + 8) >> 4;
+  last.raw_y = (smooth_y + 8) >> 4;
+  last.x = apply(calibration.a, calibration.b, calibration.c,
+                 last.raw_x, last.raw_y, TOUCH_WIDTH - 1);
+  last.y = apply(calibration.d, calibration.e, calibration.f,
+                 last.raw_x, last.raw_y, TOUCH_HEIGHT - 1);
+
+  // A touch is harder the lower the resistance across the panel,
+  // which brings Z1 and Z2 (read as 13 bits, like x and y) together
+  last.pressure = z1 + 0x1FFE - z2;
+  if (!last.pressure) {
+    // 0 is kept for releases
+    last.pressure = 1;
+  }
+
+  push(&last);
+  pressed = 1;
+}
+
+#ifdef TOUCH_SSP1
+
+// A batch is read on each tick
+#define TICK_US (TOUCH_SAMPLE_US * TOUCH_SAMPLES)
+
+void static pen_down(void) {
+  batch_start();
+}
+
+void static pen_up(void) {
+  batch_started = 0;
+}
+
+void static tick(void) {
+  const uint8_t *frame = batch_results + 3;
+  uint_fast8_t i;
+
+  // The batch started on the last tick is long finished, unless the
+  // DMA has been kept very busy
+  if (batch_started && !(TOUCH_RX_CHANNEL->DMACCConfig & 1)) {
+    for (i = 0; i < TOUCH_SAMPLES; ++i, frame += 6) {
+      samples_x[i] = frame_result(frame);
+      samples_y[i] = frame_result(frame + 3);
+
+      // 0 values mean the pen was lifted up while we were sampling,
+      // and the rest of the batch can't be trusted either
+      if (!samples_x[i] || !samples_y[i]) {
+        break;
+      }
     }
 
-    if (tx > 239) {
-      tx = 239;
+    if (i == TOUCH_SAMPLES) {
+      frame = batch_results + BATCH_BYTES - 6;
+      make_event(frame_result(frame), frame_result(frame + 3),
+                 TOUCH_SAMPLES);
     }
+  }
+
+  batch_start();
+}
 
-    if (ty > 319) {
-      ty = 319;
+#else
+
+// A reading is taken on each tick
+#define TICK_US TOUCH_SAMPLE_US
+
+void static pen_down(void) {
+  sample_count = 0;
+  settling = 1;
+}
+
+void static pen_up(void) {
+}
+
+void static tick(void) {
+  uint16_t x, y, z1, z2;
+
+  // The first reading after the pen lands is usually inaccurate
+  x = touch_convert(READ_X);
+  y = touch_convert(READ_Y);
+  if (settling) {
+    settling = 0;
+    return;
+  }
+
+  // 0 values mean the pen is being lifted, so the batch so far is
+  // thrown away now rather than being filtered out later
+  if (!x || !y) {
+    sample_count = 0;
+    return;
+  }
+
+  samples_x[sample_count] = x;
+  samples_y[sample_count] = y;
+  if (++sample_count == TOUCH_SAMPLES) {
+    sample_count = 0;
+
+    z1 = touch_convert(READ_Z1);
+    z2 = touch_convert(READ_Z2);
+    make_event(z1, z2, TOUCH_SAMPLES);
+  }
+}
+
+#endif
+
+// PENIRQ went low: the pen is down
+void EINT3_IRQHandler(void) {
+  penirq_disarm();
+
+  pressed = 0;
+  pen_down();
+
+  LPC_TIM1->TCR = TCR_ENABLE;
+}
+
+void TIMER1_IRQHandler(void) {
+  // Clear the MR0 interrupt
+  LPC_TIM1->IR = 1;
+
+  // PENIRQ is only valid between conversions, which is now
+  if (TOUCH_PENIRQ_READ()) {
+    LPC_TIM1->TCR = TCR_RESET;
+    pen_up();
+
+    if (pressed) {
+      last.pressure = 0;
+      push(&last);
     }
+    penirq_arm();
+    return;
+  }
+
+  tick();
+}
+
+// Keeps the tick (and SSP1's clock, or the bit banged timing) for a
+// new CPU clock
+void static clock_changed(uint32_t cclk_hz) {
+  LPC_TIM1->PR = cclk_hz / 1000000 - 1;
+#ifdef TOUCH_SSP1
+  ssp_set_clock(cclk_hz);
+#else
+  pulse_cycles = delay_ns_to_cycles(T_DCLK_NS);
+#endif
+}
+
+void touch_init(void) {
+  // The corners of the screen, and the readings the first panel gave
+  // there
+  const TouchPoint screen[3] = {
+    { 0, 0 }, { TOUCH_WIDTH, 0 }, { 0, TOUCH_HEIGHT }
+  };
+  const TouchPoint raw[3] = {
+    { MAX_X, MIN_Y }, { MAX_X, MAX_Y }, { MIN_X, MIN_Y }
+  };
+  touch_calibration_solve(screen, raw, &calibration);
+
+  transport_init();
+  TOUCH_PENIRQ_INPUT();
+
+  sleep_init();
+
+  LPC_SC->PCONP |= PC_TIM1;
+
+  // Undivided peripheral clock for TIMER1 (1 at bits 5:4)
+  LPC_SC->PCLKSEL0 &= ~(3 << 4);
+  LPC_SC->PCLKSEL0 |= (1 << 4);
 
-    *out_x = tx;
-    *out_y = 319 - ty;
+  // Count microseconds, and interrupt and restart every tick
+  LPC_TIM1->TCR = TCR_RESET;
+  LPC_TIM1->PR = SystemCoreClock / 1000000 - 1;
+  LPC_TIM1->MR0 = TICK_US - 1;
+  LPC_TIM1->MCR = (1 << 0) | (1 << 1);
+  LPC_TIM1->IR = 0x3F;
+  clock_on_change(clock_changed);
 
-    return 1;
+  queue_head = queue_tail = 0;
+  penirq_arm();
+
+  // GPIO interrupts come in through EINT3
+  NVIC_EnableIRQ(TIMER1_IRQn);
+  NVIC_EnableIRQ(EINT3_IRQn);
+}
+
+uint_fast8_t touch_calibration_solve(const TouchPoint screen[3],
+                                     const TouchPoint raw[3],
+                                     TouchCalibration *out) {
+  const int64_t x0 = raw[0].x, x1 = raw[1].x, x2 = raw[2].x,
+                y0 = raw[0].y, y1 = raw[1].y, y2 = raw[2].y;
+  const int64_t sx0 = screen[0].x, sx1 = screen[1].x, sx2 = screen[2].x,
+                sy0 = screen[0].y, sy1 = screen[1].y, sy2 = screen[2].y;
+
+  // Cramer's rule, for screen = (a b; d e) raw + (c; f), all over the
+  // divider
+  out->divider = (x0 - x2) * (y1 - y2) - (x1 - x2) * (y0 - y2);
+  if (!out->divider) {
+    return 0;
   }
 
-  return 0;
+  out->a = (sx0 - sx2) * (y1 - y2) - (sx1 - sx2) * (y0 - y2);
+  out->b = (x0 - x2) * (sx1 - sx2) - (sx0 - sx2) * (x1 - x2);
+  out->c = y0 * (x2 * sx1 - x1 * sx2) + y1 * (x0 * sx2 - x2 * sx0)
+         + y2 * (x1 * sx0 - x0 * sx1);
+  out->d = (sy0 - sy2) * (y1 - y2) - (sy1 - sy2) * (y0 - y2);
+  out->e = (x0 - x2) * (sy1 - sy2) - (sy0 - sy2) * (x1 - x2);
+  out->f = y0 * (x2 * sy1 - x1 * sy2) + y1 * (x0 * sy2 - x2 * sy0)
+         + y2 * (x1 * sy0 - x0 * sy1);
+
+  return 1;
+}
+
+void touch_set_calibration(const TouchCalibration *new_calibration) {
+  // Not while an event is being made with it
+  NVIC_DisableIRQ(TIMER1_IRQn);
+  calibration = *new_calibration;
+  NVIC_EnableIRQ(TIMER1_IRQn);
 }
 
 uint_fast8_t touch_available(void) {
-  return !(TOUCH_PENIRQ_READ());
+  return queue_head != queue_tail;
+}
+
+uint_fast8_t touch_get(TouchEvent *event) {
+  if (queue_head == queue_tail) {
+    return 0;
+  }
+
+  *event = queue[queue_tail];
+  queue_tail = (queue_tail + 1) % TOUCH_QUEUE_LEN;
+  return 1;
+}
+
+uint_fast8_t touch_read(uint16_t *out_x, uint16_t *out_y) {
+  TouchEvent event;
+
+  while (touch_get(&event)) {
+    if (event.pressure) {
+      *out_x = event.x;
+      *out_y = event.y;
+      return 1;
+    }
+  }
+
+  return 0;
 }
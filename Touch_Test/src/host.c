@@ -0,0 +1,130 @@
+/* Host stand-ins for the parts of the UMDLPC library and the
+ * SoundRecorderSD drivers used by the touch screen driver and the
+ * calibration screen. Sleeping steps the simulator, the SD card is
+ * memory, and the TFT only keeps track of the cross last drawn.
+ */
+
+#include "LPC17xx.h"
+#include "UMDLPC/system/sleep.h"
+#include "UMDLPC/system/delay.h"
+#include "ssd1289.h"
+#include "touchsim.h"
+#include "host.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+uint32_t SystemCoreClock = 100000000;
+
+LPC_SC_TypeDef sim_sc;
+LPC_TIM_TypeDef sim_tim1;
+LPC_GPIOINT_TypeDef sim_gpioint;
+
+uint8_t host_card[HOST_CARD_BLOCKS][SD_BLOCK_LEN];
+
+static void (*idle_handler)(void);
+static uint32_t steps, idle_steps;
+
+// The lines of the cross, if both are showing
+static TouchPoint hline_center, vline_center;
+static uint_fast8_t hline_shown, vline_shown;
+
+void NVIC_EnableIRQ(IRQn_Type irq) {
+}
+
+void NVIC_DisableIRQ(IRQn_Type irq) {
+}
+
+void sleep_init(void) {
+}
+
+// Plays more, if there's nothing left and there's a handler for that,
+// and steps on. Code waiting for something the pen never does would
+// otherwise wait forever.
+void sleep_wfi(void) {
+  if (!sim_playing() && idle_handler) {
+    idle_handler();
+  }
+
+  if (sim_playing()) {
+    idle_steps = 0;
+  } else if (++idle_steps > HOST_IDLE_STEPS_MAX) {
+    printf("gave up waiting on the touch screen\n");
+    exit(1);
+  }
+
+  sim_step();
+  ++steps;
+}
+
+// A tick's worth of cycles a step
+uint32_t sleep_counter(void) {
+  return steps * (SystemCoreClock / 1000000) * TOUCH_SAMPLE_US;
+}
+
+void delay_init(void) {
+}
+
+uint32_t delay_ns_to_cycles(uint32_t ns) {
+  return ns * (SystemCoreClock / 1000000) / 1000;
+}
+
+// The simulated controller follows the clock's edges, not its timing,
+// so the delays return at once
+void delay_cycles(uint32_t cycles) {
+}
+
+void host_on_idle(void (*handler)(void)) {
+  idle_handler = handler;
+}
+
+char sd_read_block(uint8_t *block, uint32_t block_num) {
+  if (block_num >= HOST_CARD_BLOCKS) {
+    return 0;
+  }
+  memcpy(block, host_card[block_num], SD_BLOCK_LEN);
+  return 1;
+}
+
+char sd_write_block(uint8_t *block, uint32_t block_num) {
+  if (block_num >= HOST_CARD_BLOCKS) {
+    return 0;
+  }
+  memcpy(host_card[block_num], block, SD_BLOCK_LEN);
+  return 1;
+}
+
+uint_fast8_t host_cross(TouchPoint *center) {
+  if (!hline_shown || !vline_shown || hline_center.x != vline_center.x
+      || hline_center.y != vline_center.y) {
+    return 0;
+  }
+  *center = hline_center;
+  return 1;
+}
+
+// Lines are drawn in black on white
+void TFT_hline(int16_t x, int16_t y, int16_t w, uint16_t color) {
+  hline_center.x = x + w / 2;
+  hline_center.y = y;
+  hline_shown = !color;
+}
+
+void TFT_vline(int16_t x, int16_t y, int16_t h, uint16_t color) {
+  vline_center.x = x;
+  vline_center.y = y + h / 2;
+  vline_shown = !color;
+}
+
+void TFT_fill(uint16_t color) {
+  hline_shown = vline_shown = 0;
+}
+
+void TFT_scroll(uint16_t line) {
+}
+
+void TFT_string(const uint8_t *font, const char *ch, uint16_t x, uint16_t y,
+                uint16_t fg_color, uint16_t bg_color, uint16_t width,
+                uint16_t height) {
+}
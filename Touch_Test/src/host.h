@@ -0,0 +1,35 @@
+/* host.h
+ *
+ * Declares the host side of the stand-ins in host.c.
+ */
+
+#ifndef __HOST_h_
+#define __HOST_h_
+
+#include <stdint.h>
+
+#include "sd.h"
+#include "touch.h"
+
+/* The SD card, as blocks in memory */
+#define HOST_CARD_BLOCKS 8
+extern uint8_t host_card[HOST_CARD_BLOCKS][SD_BLOCK_LEN];
+
+/* The most steps sleep_wfi takes with nothing left to play, before
+ * giving up on the code sleeping
+ */
+#define HOST_IDLE_STEPS_MAX 10000
+
+/* host_on_idle(handler)
+ * Has sleep_wfi call handler when there's nothing left to play, to
+ * play more (0 for none).
+ */
+void host_on_idle(void (*handler)(void));
+
+/* host_cross(center)
+ * Returns whether a cross (of a vertical and horizontal line through
+ * the same point) is showing, and where.
+ */
+uint_fast8_t host_cross(TouchPoint *center);
+
+#endif
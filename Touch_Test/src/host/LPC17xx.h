@@ -0,0 +1,51 @@
+/* LPC17xx.h
+ *
+ * Stands in for the CMSIS device header in host builds. Only what the
+ * touch screen driver refers to is declared, with its registers in
+ * plain memory which the simulator (see touchsim.h) looks at; GPIO
+ * goes through the simulator instead (see UMDLPC/util/pins.h next to
+ * this file).
+ */
+
+#ifndef __LPC17xx_H__
+#define __LPC17xx_H__
+
+#include <stdint.h>
+
+extern uint32_t SystemCoreClock;
+
+typedef enum {
+  TIMER1_IRQn = 2,
+  EINT3_IRQn = 21
+} IRQn_Type;
+
+typedef struct {
+  volatile uint32_t PCONP, PCLKSEL0, PCLKSEL1;
+} LPC_SC_TypeDef;
+
+typedef struct {
+  volatile uint32_t IR, TCR, TC, PR, PC, MCR, MR0;
+} LPC_TIM_TypeDef;
+
+typedef struct {
+  volatile uint32_t IO0IntEnF, IO0IntClr, IO2IntEnF, IO2IntClr;
+} LPC_GPIOINT_TypeDef;
+
+extern LPC_SC_TypeDef sim_sc;
+extern LPC_TIM_TypeDef sim_tim1;
+extern LPC_GPIOINT_TypeDef sim_gpioint;
+
+#define LPC_SC (&sim_sc)
+#define LPC_TIM1 (&sim_tim1)
+#define LPC_GPIOINT (&sim_gpioint)
+
+void NVIC_EnableIRQ(IRQn_Type irq);
+void NVIC_DisableIRQ(IRQn_Type irq);
+
+/* Masking only; nothing interrupts the drivers (see Host/src/irq.c) */
+uint32_t __get_PRIMASK(void);
+void __set_PRIMASK(uint32_t primask);
+void __disable_irq(void);
+void __enable_irq(void);
+
+#endif
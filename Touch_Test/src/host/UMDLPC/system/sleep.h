@@ -0,0 +1,23 @@
+/* sleep.h
+ *
+ * Host version of UMDLPC/system/sleep.h: only what the touch screen
+ * driver and calibration screen use. Sleeping steps the simulator
+ * instead (see host.c).
+ */
+
+#ifndef __UMDLPC_system_sleep_h_
+#define __UMDLPC_system_sleep_h_
+
+#include <stdint.h>
+
+void sleep_init(void);
+void sleep_wfi(void);
+uint32_t sleep_counter(void);
+
+#define SLEEP_UNTIL(cond) do {                  \
+    while (!(cond)) {                           \
+      sleep_wfi();                              \
+    }                                           \
+  } while (0)
+
+#endif
@@ -0,0 +1,480 @@
+/*
+ ===============================================================================
+ Name        : main.c
+ Description :
+
+   Runs the touch screen driver and calibration screen from
+   SoundRecorderSD against a simulated ADS7843 (see touchsim.h),
+   through these scenes:
+
+     default      presses over the whole panel, mapped by the default
+                  calibration, checked against the mapping it replaced
+     solve        calibrations solved from three points, checked
+                  against the same transforms worked out in doubles
+     noisy        a trace of noisy readings (see traces/noisy.txt),
+                  with the error of the median and IIR filtered
+                  events from where the pen really was, with it held
+                  still and moving, checked against the limits below
+                  and compared with the mean of 8 readings used before
+     calibration  the calibration screen, with a panel which reads
+                  differently from the first, its result stored on
+                  the card, loaded back and checked with presses
+                  over the panel; and corrupt blocks refused
+
+   Usage: touchtest trace
+
+ ===============================================================================
+ */
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "calibration.h"
+#include "touchsim.h"
+#include "host.h"
+
+// The filtered events' error from where the pen was, in raw units
+// (about 25 to a pixel): with the pen held still for STILL_TICKS, the
+// mean and the most for any event, and the most with it moving, which
+// is mostly how far the filters lag behind
+#define STILL_TICKS 10
+#define STILL_MEAN_MAX 25.0
+#define STILL_PEAK_MAX 200.0
+#define MOVING_PEAK_MAX 400.0
+
+// The readings the first panel gave at its edges, as in touch.c
+#define MIN_X 0x2a0
+#define MAX_X 0x1f00
+#define MIN_Y 0x210
+#define MAX_Y 0x1dd0
+
+// Steps a press is held for: the one it lands on, a reading thrown
+// away, then a batch
+#define PRESS_STEPS (1 + TOUCH_SAMPLES + 1)
+#define RELEASE_STEPS 3
+
+#define TRACE_MAX 100000
+#define CALIBRATION_BLOCK 3
+
+static SimSample script[PRESS_STEPS + RELEASE_STEPS];
+static SimSample trace[TRACE_MAX];
+
+void static fail(const char *scene, const char *what) {
+  printf("%s: %s\n", scene, what);
+  exit(1);
+}
+
+// Plays a press of the pen at readings x, y, and its release
+void static play_press(uint16_t x, uint16_t y) {
+  uint_fast8_t i;
+
+  memset(script, 0, sizeof(script));
+  for (i = 0; i < PRESS_STEPS; ++i) {
+    script[i].down = 1;
+    script[i].x = script[i].true_x = x;
+    script[i].y = script[i].true_y = y;
+  }
+  sim_play(script, PRESS_STEPS + RELEASE_STEPS);
+}
+
+// Presses at readings x, y, and returns the first press event
+uint_fast8_t static press(uint16_t x, uint16_t y, TouchEvent *pressed) {
+  TouchEvent event;
+  uint_fast8_t found = 0;
+
+  play_press(x, y);
+  while (sim_playing()) {
+    sim_step();
+  }
+  while (touch_get(&event)) {
+    if (event.pressure && !found) {
+      *pressed = event;
+      found = 1;
+    }
+  }
+  return found;
+}
+
+int32_t static clamp(int32_t v, int32_t max) {
+  return (v < 0) ? 0 : (v > max) ? max : v;
+}
+
+void static default_scene(void) {
+  const char * const scene = "default";
+  uint32_t points = 0, off = 0, worst = 0;
+  TouchEvent event;
+  int32_t x, y;
+
+  touch_init();
+
+  for (x = MIN_X - 200; x <= MAX_X + 200; x += 97) {
+    for (y = MIN_Y - 200; y <= MAX_Y + 200; y += 89) {
+      // The old mapping, with y no longer offset by the minimum x
+      const int32_t old_x = (y <= MIN_Y) ? 0
+        : clamp((y - MIN_Y) * TOUCH_WIDTH / (MAX_Y - MIN_Y), TOUCH_WIDTH - 1);
+      const int32_t old_y = TOUCH_HEIGHT - 1 - ((x <= MIN_X) ? 0
+        : clamp((x - MIN_X) * TOUCH_HEIGHT / (MAX_X - MIN_X),
+                TOUCH_HEIGHT - 1));
+      uint32_t difference;
+
+      if (!press(x, y, &event)) {
+        fail(scene, "a press made no event");
+      }
+      difference = abs(event.x - old_x) + abs(event.y - old_y);
+      off += (difference != 0);
+      worst = (difference > worst) ? difference : worst;
+      ++points;
+    }
+  }
+
+  printf("%s: %u presses, %u off the old mapping, by at most %upx\n", scene,
+         points, off, worst);
+  // The old mapping rounded y the other way (319 - floor(t) rather than
+  // floor(320 - t)), so where t is whole they're a pixel apart
+  if (worst > 1) {
+    fail(scene, "the default calibration strays from the old mapping");
+  }
+}
+
+// Solves the calibration through screen and raw, and checks it maps
+// other readings as the same transform worked out in doubles does
+void static solve_case(const char *scene, const TouchPoint screen[3],
+                       const TouchPoint raw[3]) {
+  TouchCalibration c;
+  double m[6], det;
+  int32_t x, y, worst_points = 0;
+  double worst = 0;
+  uint_fast8_t i;
+
+  if (!touch_calibration_solve(screen, raw, &c)) {
+    fail(scene, "three points not in a line weren't solved");
+  }
+
+  // The solved points come back exactly
+  for (i = 0; i < 3; ++i) {
+    const int64_t sx = (c.a * raw[i].x + c.b * raw[i].y + c.c) / c.divider;
+    const int64_t sy = (c.d * raw[i].x + c.e * raw[i].y + c.f) / c.divider;
+
+    worst_points |= (sx != screen[i].x) | (sy != screen[i].y);
+  }
+  if (worst_points) {
+    fail(scene, "the points solved from don't map back to themselves");
+  }
+
+  // screen = (m0 m1; m3 m4) raw + (m2; m5)
+  det = (double) (raw[0].x - raw[2].x) * (raw[1].y - raw[2].y)
+      - (double) (raw[1].x - raw[2].x) * (raw[0].y - raw[2].y);
+  m[0] = ((double) (screen[0].x - screen[2].x) * (raw[1].y - raw[2].y)
+        - (double) (screen[1].x - screen[2].x) * (raw[0].y - raw[2].y)) / det;
+  m[1] = ((double) (raw[0].x - raw[2].x) * (screen[1].x - screen[2].x)
+        - (double) (raw[1].x - raw[2].x) * (screen[0].x - screen[2].x)) / det;
+  m[2] = screen[2].x - m[0] * raw[2].x - m[1] * raw[2].y;
+  m[3] = ((double) (screen[0].y - screen[2].y) * (raw[1].y - raw[2].y)
+        - (double) (screen[1].y - screen[2].y) * (raw[0].y - raw[2].y)) / det;
+  m[4] = ((double) (raw[0].x - raw[2].x) * (screen[1].y - screen[2].y)
+        - (double) (raw[1].x - raw[2].x) * (screen[0].y - screen[2].y)) / det;
+  m[5] = screen[2].y - m[3] * raw[2].x - m[4] * raw[2].y;
+
+  for (x = 0; x < 8192; x += 61) {
+    for (y = 0; y < 8192; y += 67) {
+      const double sx = m[0] * x + m[1] * y + m[2];
+      const double sy = m[3] * x + m[4] * y + m[5];
+      const double dx = (c.a * x + c.b * y + c.c) / c.divider - sx;
+      const double dy = (c.d * x + c.e * y + c.f) / c.divider - sy;
+
+      // Only the division's truncation is allowed
+      worst = fmax(worst, fmax(fabs(dx), fabs(dy)));
+    }
+  }
+  if (!(worst < 1)) {
+    fail(scene, "a solved calibration strays from its transform");
+  }
+}
+
+void static solve_scene(void) {
+  const char * const scene = "solve";
+  static const TouchPoint targets[3] = {
+    { 24, 32 }, { TOUCH_WIDTH - 24, TOUCH_HEIGHT / 2 },
+    { TOUCH_WIDTH / 2, TOUCH_HEIGHT - 32 }
+  };
+  static const TouchPoint panels[][3] = {
+    { { 7200, 1200 }, { 4100, 6800 }, { 1000, 3900 } },  // as the first
+    { { 7000, 6900 }, { 4000, 1300 }, { 1200, 4200 } },  // mirrored
+    { { 1500, 1100 }, { 4300, 7000 }, { 7300, 3600 } },  // turned over
+    { { 6100, 2000 }, { 4300, 5200 }, { 2000, 3300 } },  // small, skewed
+  };
+  static const TouchPoint line[3] = {
+    { 1000, 1000 }, { 2000, 2500 }, { 3000, 4000 }
+  };
+  TouchCalibration c;
+  uint_fast8_t i;
+
+  for (i = 0; i < sizeof panels / sizeof panels[0]; ++i) {
+    solve_case(scene, targets, panels[i]);
+  }
+  if (touch_calibration_solve(targets, line, &c)) {
+    fail(scene, "points in a line were solved");
+  }
+
+  printf("%s: %u panels solved, points in a line refused\n", scene,
+         (unsigned) (sizeof panels / sizeof panels[0]));
+}
+
+uint32_t static load_trace(const char *path) {
+  FILE *file = fopen(path, "r");
+  char line[128];
+  uint32_t count = 0, ticks;
+  int x, y, true_x, true_y;
+
+  if (!file) {
+    perror(path);
+    exit(1);
+  }
+
+  while (fgets(line, sizeof line, file)) {
+    if (line[0] == '#' || line[0] == '\n') {
+      continue;
+    }
+    if (!strncmp(line, "up", 2)) {
+      ticks = 1;
+      sscanf(line + 2, "%u", &ticks);
+      while (ticks-- && count < TRACE_MAX) {
+        memset(&trace[count++], 0, sizeof(SimSample));
+      }
+    } else if (sscanf(line, "%d %d %d %d", &x, &y, &true_x, &true_y) == 4
+               && count < TRACE_MAX) {
+      trace[count].down = 1;
+      trace[count].x = x;
+      trace[count].y = y;
+      trace[count].true_x = true_x;
+      trace[count].true_y = true_y;
+      ++count;
+    }
+  }
+
+  fclose(file);
+  return count;
+}
+
+// Error figures, of events from where the pen was, split between the
+// pen holding still and moving
+typedef struct {
+  double sum, peak;
+  uint32_t count;
+} Errors;
+
+void static add_error(Errors *errors, double error) {
+  errors->sum += error;
+  errors->peak = fmax(errors->peak, error);
+  ++errors->count;
+}
+
+double static mean(const Errors *errors) {
+  return errors->count ? errors->sum / errors->count : 0;
+}
+
+// Whether the pen was still over the STILL_TICKS ticks up to i
+uint_fast8_t static still(uint32_t i) {
+  uint32_t j;
+
+  if (i < STILL_TICKS) {
+    return 0;
+  }
+  for (j = i - STILL_TICKS; j < i; ++j) {
+    if (!trace[j].down || trace[j].true_x != trace[i].true_x
+        || trace[j].true_y != trace[i].true_y) {
+      return 0;
+    }
+  }
+  return 1;
+}
+
+// The error of taking the mean of 8 readings after throwing one away,
+// as the driver did before, over the same trace
+void static mean_of_8(uint32_t count, Errors *held, Errors *moving) {
+  uint32_t i = 0, j, n;
+
+  while (i < count) {
+    if (!trace[i].down) {
+      ++i;
+      continue;
+    }
+
+    // Throwaway reading
+    ++i;
+    while (i + 8 <= count && trace[i + 7].down) {
+      double x = 0, y = 0;
+
+      for (j = n = 0; j < 8; ++j) {
+        if (trace[i + j].x && trace[i + j].y) {
+          x += trace[i + j].x;
+          y += trace[i + j].y;
+          ++n;
+        }
+      }
+      if (n) {
+        add_error(still(i + 7) ? held : moving,
+                  hypot(x / n - trace[i + 7].true_x,
+                        y / n - trace[i + 7].true_y));
+      }
+      i += 8;
+    }
+    while (i < count && trace[i].down) {
+      ++i;
+    }
+  }
+}
+
+void static noisy_scene(const char *path) {
+  const char * const scene = "noisy";
+  const uint32_t count = load_trace(path);
+  uint32_t releases = 0, strokes = 0, i;
+  Errors held = { 0 }, moving = { 0 }, old_held = { 0 }, old_moving = { 0 };
+  TouchEvent event;
+
+  for (i = 0; i < count; ++i) {
+    strokes += trace[i].down && (!i || !trace[i - 1].down);
+  }
+
+  touch_init();
+  sim_play(trace, count);
+  for (i = 0; i < count + RELEASE_STEPS; ++i) {
+    sim_step();
+
+    // Events are made on a tick, so they're from where the pen is now
+    while (touch_get(&event)) {
+      if (event.pressure) {
+        add_error((i < count && still(i)) ? &held : &moving,
+                  hypot(event.raw_x - sim_sample()->true_x,
+                        event.raw_y - sim_sample()->true_y));
+      } else {
+        ++releases;
+      }
+    }
+  }
+
+  mean_of_8(count, &old_held, &old_moving);
+  printf("%s: %u ticks, %u strokes; %u presses, %u releases\n", scene,
+         count, strokes, held.count + moving.count, releases);
+  printf("                         still              moving\n");
+  printf("                         mean  most events  mean  most events\n");
+  printf("  median of %u and IIR  %5.1f %5.1f %5u  %5.1f %5.1f %5u\n",
+         TOUCH_SAMPLES, mean(&held), held.peak, held.count, mean(&moving),
+         moving.peak, moving.count);
+  printf("  mean of 8 (before)   %5.1f %5.1f %5u  %5.1f %5.1f %5u\n",
+         mean(&old_held), old_held.peak, old_held.count, mean(&old_moving),
+         old_moving.peak, old_moving.count);
+
+  if (!held.count || !moving.count || releases != strokes) {
+    fail(scene, "presses or releases were missed");
+  }
+  if (mean(&held) > STILL_MEAN_MAX || held.peak > STILL_PEAK_MAX) {
+    fail(scene, "events stray too far from a pen held still");
+  }
+  if (moving.peak > MOVING_PEAK_MAX) {
+    fail(scene, "events fall too far behind a moving pen");
+  }
+  if (mean(&held) >= mean(&old_held)) {
+    fail(scene, "the filtered events are no better than the mean of 8");
+  }
+}
+
+// A panel which reads differently from the first: turned a little,
+// and offset
+void static panel_reading(int32_t sx, int32_t sy, uint16_t *x, uint16_t *y) {
+  *x = lround(7900 - 22.6 * sy + 1.1 * sx);
+  *y = lround(540 + 29.1 * sx - 0.7 * sy);
+}
+
+// Presses each cross the calibration screen shows
+static uint32_t crosses_pressed;
+
+void static press_cross(void) {
+  TouchPoint center;
+  uint16_t x, y;
+
+  if (host_cross(&center)) {
+    panel_reading(center.x, center.y, &x, &y);
+    play_press(x, y);
+    ++crosses_pressed;
+  }
+}
+
+void static calibration_scene(void) {
+  const char * const scene = "calibration";
+  uint8_t block[SD_BLOCK_LEN];
+  uint32_t points = 0, worst = 0;
+  TouchEvent event;
+  int32_t sx, sy;
+  uint16_t x, y;
+
+  memset(host_card, 0, sizeof(host_card));
+  touch_init();
+
+  host_on_idle(press_cross);
+  calibration_run(CALIBRATION_BLOCK, block);
+  host_on_idle(0);
+  if (crosses_pressed != 3) {
+    fail(scene, "the calibration screen didn't take three crosses");
+  }
+
+  // Back to the default, and then the stored calibration
+  touch_init();
+  if (!calibration_load(CALIBRATION_BLOCK, block)) {
+    fail(scene, "the calibration stored wasn't loaded back");
+  }
+
+  for (sx = 0; sx < TOUCH_WIDTH; sx += 13) {
+    for (sy = 0; sy < TOUCH_HEIGHT; sy += 17) {
+      uint32_t difference;
+
+      panel_reading(sx, sy, &x, &y);
+      if (!press(x, y, &event)) {
+        fail(scene, "a press made no event");
+      }
+      difference = abs(event.x - sx);
+      if (abs(event.y - sy) > difference) {
+        difference = abs(event.y - sy);
+      }
+      worst = (difference > worst) ? difference : worst;
+      ++points;
+    }
+  }
+
+  printf("%s: %u crosses pressed, stored and loaded back; %u presses, off"
+         " by at most %upx\n", scene, crosses_pressed, points, worst);
+  if (worst > 1) {
+    fail(scene, "presses are off where they were touched");
+  }
+
+  host_card[CALIBRATION_BLOCK][20] ^= 1;
+  if (calibration_load(CALIBRATION_BLOCK, block)) {
+    fail(scene, "a corrupt calibration was loaded");
+  }
+  if (calibration_load(CALIBRATION_BLOCK + 1, block)) {
+    fail(scene, "an empty block was loaded as a calibration");
+  }
+  printf("  corrupt and empty blocks refused\n");
+}
+
+int main(int argc, char **argv) {
+  if (argc != 2) {
+    printf("Usage: %s trace\n", argv[0]);
+    return 1;
+  }
+
+  sim_reset();
+  default_scene();
+  solve_scene();
+  noisy_scene(argv[1]);
+  calibration_scene();
+
+  if (sim_stats()->bad_commands) {
+    fail("controller", "commands for channels not modelled were sent");
+  }
+  printf("all passed: %u conversions, %u ticks\n", sim_stats()->conversions,
+         sim_stats()->ticks);
+  return 0;
+}
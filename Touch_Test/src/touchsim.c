@@ -0,0 +1,202 @@
+#include "touchsim.h"
+#include "LPC17xx.h"
+
+#include <string.h>
+
+// The driver's interrupt handlers
+void TIMER1_IRQHandler(void);
+void EINT3_IRQHandler(void);
+
+typedef enum {
+  SIG_NONE = 0,
+  SIG_CLK,
+  SIG_IN,
+  SIG_OUT,
+  SIG_PENIRQ,
+  SIGNALS
+} Signal;
+
+static const char * const SIGNAL_NAMES[SIGNALS] = {
+  [SIG_CLK] = "TOUCH_CLK",
+  [SIG_IN] = "TOUCH_IN",
+  [SIG_OUT] = "TOUCH_OUT",
+  [SIG_PENIRQ] = "TOUCH_PENIRQ",
+};
+
+// Channels selected by bits 6:4 of a command
+#define CHANNEL_X 1
+#define CHANNEL_Z1 3
+#define CHANNEL_Z2 4
+#define CHANNEL_Y 5
+
+// TIMER1's TCR
+#define TCR_ENABLE (1 << 0)
+#define TCR_RESET (1 << 1)
+
+typedef enum {
+  IDLE,         // waiting for a start bit on DIN
+  COMMAND,      // taking the rest of the command
+  BUSY,         // converting, until the clock falls
+  SHIFTING      // shifting out the result
+} State;
+
+static uint8_t levels[SIGNALS];
+
+static State state;
+static uint8_t command, command_bits, result_bits;
+static uint16_t result;
+
+static const SimSample *samples;
+static uint32_t sample_count, next_sample;
+static SimSample sample;
+
+static SimStats stats;
+
+void sim_reset(void) {
+  memset(levels, 0, sizeof(levels));
+  levels[SIG_PENIRQ] = 1;
+  state = IDLE;
+  samples = 0;
+  sample_count = next_sample = 0;
+  memset(&sample, 0, sizeof(sample));
+  memset(&stats, 0, sizeof(stats));
+}
+
+void sim_play(const SimSample *new_samples, uint32_t count) {
+  samples = new_samples;
+  sample_count = count;
+  next_sample = 0;
+}
+
+uint_fast8_t sim_playing(void) {
+  return next_sample < sample_count;
+}
+
+const SimSample *sim_sample(void) {
+  return &sample;
+}
+
+const SimStats *sim_stats(void) {
+  return &stats;
+}
+
+void sim_step(void) {
+  const uint_fast8_t was_down = sample.down;
+
+  if (sim_playing()) {
+    sample = samples[next_sample++];
+  } else {
+    memset(&sample, 0, sizeof(sample));
+  }
+  levels[SIG_PENIRQ] = !sample.down;
+
+  if ((LPC_TIM1->TCR & (TCR_ENABLE | TCR_RESET)) == TCR_ENABLE) {
+    ++stats.ticks;
+    TIMER1_IRQHandler();
+  }
+
+  // Falling edges only interrupt while enabled
+  if (sample.down && !was_down
+      && (LPC_GPIOINT->IO0IntEnF | LPC_GPIOINT->IO2IntEnF)) {
+    ++stats.pen_downs;
+    EINT3_IRQHandler();
+  }
+}
+
+int sim_signal(const char *name) {
+  int i;
+
+  for (i = SIG_NONE + 1; i < SIGNALS; ++i) {
+    if (!strcmp(name, SIGNAL_NAMES[i])) {
+      return i;
+    }
+  }
+
+  return SIG_NONE;
+}
+
+// The result of a conversion, 12 bits
+uint16_t static convert(uint8_t channel) {
+  switch (channel) {
+  case CHANNEL_X:
+    return sample.x >> 1;
+  case CHANNEL_Y:
+    return sample.y >> 1;
+  case CHANNEL_Z1:
+    return SIM_Z1 >> 1;
+  case CHANNEL_Z2:
+    return SIM_Z2 >> 1;
+  default:
+    ++stats.bad_commands;
+    return 0;
+  }
+}
+
+// DIN is taken on the rising edge of DCLK
+void static clock_rise(void) {
+  switch (state) {
+  case IDLE:
+    if (levels[SIG_IN]) {
+      command = 1;
+      command_bits = 1;
+      state = COMMAND;
+    }
+    break;
+
+  case COMMAND:
+    command = (command << 1) | levels[SIG_IN];
+    if (++command_bits == 8) {
+      result = convert((command >> 4) & 7);
+      state = BUSY;
+    }
+    break;
+
+  default:
+    break;
+  }
+}
+
+// DOUT changes on the falling edge: a clock of busy, then the result,
+// most significant bit first
+void static clock_fall(void) {
+  switch (state) {
+  case BUSY:
+    levels[SIG_OUT] = 0;
+    result_bits = 0;
+    state = SHIFTING;
+    break;
+
+  case SHIFTING:
+    levels[SIG_OUT] = (result >> (11 - result_bits)) & 1;
+    if (++result_bits == 12) {
+      ++stats.conversions;
+      state = IDLE;
+    }
+    break;
+
+  default:
+    break;
+  }
+}
+
+void sim_pin_write(int signal, uint_fast8_t level) {
+  const uint_fast8_t was = levels[signal];
+
+  // DOUT and PENIRQ are the controller's
+  if (signal == SIG_NONE || signal == SIG_OUT || signal == SIG_PENIRQ) {
+    return;
+  }
+  levels[signal] = level;
+
+  if (signal == SIG_CLK && level != was) {
+    if (level) {
+      clock_rise();
+    } else {
+      clock_fall();
+    }
+  }
+}
+
+uint_fast8_t sim_pin_read(int signal) {
+  return levels[signal];
+}
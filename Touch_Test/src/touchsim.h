@@ -0,0 +1,75 @@
+/* touchsim.h
+ *
+ * Declares a simulated touch screen controller (an ADS7843), wired up
+ * as on the SoundRecorderSD board: its DCLK, DIN and DOUT lines bit
+ * banged, and PENIRQ on a GPIO interrupt. The controller follows the
+ * clock through the pin functions made by DEFINE_PIN, taking each
+ * command on DIN and shifting its 12 bit result out on DOUT.
+ *
+ * The pen is played from a list of samples, one per tick of
+ * TOUCH_SAMPLE_US. Each step of the simulation moves on a tick: it
+ * sets PENIRQ, takes TIMER1's interrupt if the timer is running, and
+ * then the PENIRQ interrupt if it's armed and the pen just landed.
+ * Conversions during a tick read that tick's sample.
+ */
+
+#ifndef __TOUCHSIM_h_
+#define __TOUCHSIM_h_
+
+#include <stdint.h>
+
+typedef struct {
+  uint8_t down;              /* PENIRQ held low */
+  uint16_t x, y;             /* readings, 13 bit as touch.c gets them */
+  uint16_t true_x, true_y;   /* where the pen really was */
+} SimSample;
+
+/* The pressure readings given for every sample */
+#define SIM_Z1 0x0600
+#define SIM_Z2 0x1200
+
+typedef struct {
+  uint32_t conversions;      /* results shifted out */
+  uint32_t bad_commands;     /* commands for channels not modelled */
+  uint32_t ticks;            /* TIMER1 interrupts taken */
+  uint32_t pen_downs;        /* PENIRQ interrupts taken */
+} SimStats;
+
+/* sim_reset()
+ * Lifts the pen, with nothing to play, and zeroes the stats.
+ */
+void sim_reset(void);
+
+/* sim_play(samples, count)
+ * Plays count samples from the next step on, after which the pen is
+ * up. samples must stay valid until they've been played.
+ */
+void sim_play(const SimSample *samples, uint32_t count);
+
+/* sim_step()
+ * Moves the simulation on a tick.
+ */
+void sim_step(void);
+
+/* sim_playing()
+ * Returns whether there are samples left to play.
+ */
+uint_fast8_t sim_playing(void);
+
+/* sim_sample()
+ * Returns the sample of the last step.
+ */
+const SimSample *sim_sample(void);
+
+/* sim_signal(name)
+ * Returns the signal for a pin name from pins.h (e.g. "TOUCH_CLK"), or
+ * an unconnected signal for pins which aren't the controller's.
+ */
+int sim_signal(const char *name);
+
+void sim_pin_write(int signal, uint_fast8_t level);
+uint_fast8_t sim_pin_read(int signal);
+
+const SimStats *sim_stats(void);
+
+#endif
@@ -0,0 +1,276 @@
+/*
+ ===============================================================================
+ Name        : tracedec.c
+ Description :
+
+   Converts a trace dumped by trace_dump (see
+   UMD_LPC1769/inc/UMDLPC/system/trace.h) to Chrome trace event JSON,
+   which chrome://tracing and https://ui.perfetto.dev show as a
+   timeline. Thread mode and each interrupt get a track of their own;
+   spans show as slices, and other events as instants, each with its
+   argument.
+
+   Usage: tracedec trace.bin [trace.json]
+
+   Times are in microseconds from the oldest event in the dump. A
+   summary goes to stderr.
+
+ ===============================================================================
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+
+// From trace.h, which can't be included on the host
+#define TRACE_MAGIC 0x45435254
+#define TRACE_VERSION 1
+#define TRACE_BEGIN 0x8000
+#define TRACE_END 0x4000
+#define TRACE_ID_MASK 0x3FFF
+#define TRACE_CLOCK 1
+
+#define HEADER_LEN 20
+#define EVENT_LEN 12
+
+// Exceptions, by number (IPSR); the LPC17xx's interrupts start at 16
+#define EXCEPTIONS 64
+
+typedef struct {
+  uint32_t cycles;
+  uint16_t id;
+  uint16_t exception;
+  uint32_t arg;
+  double us;
+} Event;
+
+typedef struct {
+  uint16_t id;
+  char *name;
+} Name;
+
+uint16_t static get16(const uint8_t *p) {
+  return p[0] | (p[1] << 8);
+}
+
+uint32_t static get32(const uint8_t *p) {
+  return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t) p[3] << 24);
+}
+
+// Reads the whole of path, returns 0 on failure
+uint8_t static *read_file(const char *path, size_t *len) {
+  FILE *file = fopen(path, "rb");
+  uint8_t *data = 0;
+  size_t size = 0, got;
+
+  if (!file) {
+    perror(path);
+    return 0;
+  }
+
+  *len = 0;
+  do {
+    size = size ? size * 2 : 4096;
+    data = realloc(data, size);
+    if (!data) {
+      fprintf(stderr, "Out of memory\n");
+      exit(1);
+    }
+    got = fread(data + *len, 1, size - *len, file);
+    *len += got;
+  } while (*len == size);
+
+  fclose(file);
+  return data;
+}
+
+const char static *name_of(const Name *names, unsigned count, uint16_t id) {
+  unsigned i;
+
+  for (i = 0; i < count; ++i) {
+    if (names[i].id == id) {
+      return names[i].name;
+    }
+  }
+  return 0;
+}
+
+// Writes s as a JSON string
+void static put_string(FILE *out, const char *s) {
+  fputc('"', out);
+  for (; *s; ++s) {
+    if (*s == '"' || *s == '\\') {
+      fprintf(out, "\\%c", *s);
+    } else if ((unsigned char) *s < 0x20) {
+      fprintf(out, "\\u%04x", *s);
+    } else {
+      fputc(*s, out);
+    }
+  }
+  fputc('"', out);
+}
+
+int main(int argc, char **argv) {
+  uint32_t count, lost, clock_hz;
+  uint16_t version, name_count;
+  uint8_t tracks[EXCEPTIONS] = { 0 };
+  const uint8_t *p, *end;
+  size_t len;
+  uint8_t *data;
+  Event *events;
+  Name *names;
+  FILE *out = stdout;
+  unsigned i;
+  int first = 1;
+
+  if (argc < 2 || argc > 3) {
+    fprintf(stderr, "Usage: %s trace.bin [trace.json]\n", argv[0]);
+    return 1;
+  }
+
+  data = read_file(argv[1], &len);
+  if (!data) {
+    return 1;
+  }
+  p = data;
+  end = data + len;
+
+  if (len < HEADER_LEN || get32(p) != TRACE_MAGIC) {
+    fprintf(stderr, "%s: not a trace\n", argv[1]);
+    return 1;
+  }
+  version = get16(p + 4);
+  if (version != TRACE_VERSION) {
+    fprintf(stderr, "%s: trace version %u, not %u\n", argv[1], version,
+            TRACE_VERSION);
+    return 1;
+  }
+  name_count = get16(p + 6);
+  count = get32(p + 8);
+  lost = get32(p + 12);
+  clock_hz = get32(p + 16);
+  p += HEADER_LEN;
+
+  names = calloc(name_count ? name_count : 1, sizeof(Name));
+  for (i = 0; i < name_count; ++i) {
+    uint16_t name_len;
+
+    if (end - p < 4 || end - p - 4 < (name_len = get16(p + 2))) {
+      fprintf(stderr, "%s: truncated in the names\n", argv[1]);
+      return 1;
+    }
+    names[i].id = get16(p);
+    names[i].name = malloc(name_len + 1);
+    memcpy(names[i].name, p + 4, name_len);
+    names[i].name[name_len] = '\0';
+    p += 4 + name_len;
+  }
+
+  if ((size_t) (end - p) < (size_t) count * EVENT_LEN) {
+    fprintf(stderr, "%s: truncated in the events\n", argv[1]);
+    return 1;
+  }
+  events = calloc(count ? count : 1, sizeof(Event));
+  for (i = 0; i < count; ++i, p += EVENT_LEN) {
+    events[i].cycles = get32(p);
+    events[i].id = get16(p + 4);
+    events[i].exception = get16(p + 6);
+    events[i].arg = get32(p + 8);
+  }
+
+  // Going back from the newest event, at the clock at the dump, each
+  // clock switch gives the clock before it. The cycles between two
+  // events are taken mod 2^32, for the counter wrapping.
+  if (count) {
+    events[count - 1].us = 0;
+    for (i = count - 1; i > 0; --i) {
+      if ((events[i].id & TRACE_ID_MASK) == TRACE_CLOCK) {
+        clock_hz = events[i].arg;
+      }
+      if (!clock_hz) {
+        fprintf(stderr, "%s: a clock of 0Hz\n", argv[1]);
+        return 1;
+      }
+      events[i - 1].us = events[i].us
+                         - (double) (uint32_t) (events[i].cycles
+                                                - events[i - 1].cycles)
+                           * 1e6 / clock_hz;
+    }
+    for (i = count; i-- > 0; ) {
+      events[i].us -= events[0].us;
+    }
+  }
+
+  if (argc == 3) {
+    out = fopen(argv[2], "w");
+    if (!out) {
+      perror(argv[2]);
+      return 1;
+    }
+  }
+
+  fprintf(out, "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n");
+
+  for (i = 0; i < count; ++i) {
+    const Event *event = &events[i];
+    const uint16_t id = event->id & TRACE_ID_MASK;
+    const char *name = name_of(names, name_count, id);
+    const char phase = (event->id & TRACE_BEGIN) ? 'B'
+                       : (event->id & TRACE_END) ? 'E' : 'i';
+    char unnamed[16];
+
+    if (!name) {
+      snprintf(unnamed, sizeof(unnamed), "0x%x", id);
+      name = unnamed;
+    }
+
+    fprintf(out, "%s{\"name\":", first ? "" : ",\n");
+    put_string(out, name);
+    fprintf(out, ",\"ph\":\"%c\",\"ts\":%.3f,\"pid\":1,\"tid\":%u,"
+            "\"args\":{\"arg\":%lu}%s}", phase, event->us,
+            event->exception, (unsigned long) event->arg,
+            (phase == 'i') ? ",\"s\":\"t\"" : "");
+    first = 0;
+
+    if (event->exception < EXCEPTIONS) {
+      tracks[event->exception] = 1;
+    }
+  }
+
+  // Track names, thread mode first
+  for (i = 0; i < EXCEPTIONS; ++i) {
+    char track[16];
+
+    if (!tracks[i]) {
+      continue;
+    }
+    if (!i) {
+      snprintf(track, sizeof(track), "thread");
+    } else if (i < 16) {
+      snprintf(track, sizeof(track), "exception %u", i);
+    } else {
+      snprintf(track, sizeof(track), "IRQ %u", i - 16);
+    }
+    fprintf(out, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,"
+            "\"tid\":%u,\"args\":{\"name\":\"%s\"}}", first ? "" : ",\n",
+            i, track);
+    fprintf(out, ",\n{\"name\":\"thread_sort_index\",\"ph\":\"M\","
+            "\"pid\":1,\"tid\":%u,\"args\":{\"sort_index\":%u}}", i, i);
+    first = 0;
+  }
+
+  fprintf(out, "\n]}\n");
+  if (out != stdout) {
+    fclose(out);
+  }
+
+  fprintf(stderr, "%lu events over %.1f us", (unsigned long) count,
+          count ? events[count - 1].us : 0.0);
+  if (lost) {
+    fprintf(stderr, ", after %lu overwritten", (unsigned long) lost);
+  }
+  fprintf(stderr, "\n");
+
+  return 0;
+}
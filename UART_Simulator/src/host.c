@@ -0,0 +1,81 @@
+/* Host stand-ins for the parts of the Cortex-M3 and UMDLPC library
+ * used by the UART driver. Masking interrupts blocks the signal which
+ * stands in for them; a masked interrupt stays pending, and is taken
+ * as soon as the mask is lifted, as on the target.
+ */
+
+#include <signal.h>
+#include <time.h>
+
+#include "LPC17xx.h"
+#include "UMDLPC/system/sleep.h"
+#include "host.h"
+
+uint32_t SystemCoreClock = 100000000;
+
+volatile uint32_t host_nvic_enabled;
+
+static volatile uint32_t primask;
+static volatile uint_fast8_t in_irq;
+
+uint64_t host_time_ns(void) {
+  struct timespec now;
+
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (uint64_t) now.tv_sec * 1000000000 + now.tv_nsec;
+}
+
+uint32_t __get_PRIMASK(void) {
+  return primask;
+}
+
+void __set_PRIMASK(uint32_t value) {
+  if (value) {
+    __disable_irq();
+  } else {
+    __enable_irq();
+  }
+}
+
+void __disable_irq(void) {
+  sigset_t irq;
+
+  sigemptyset(&irq);
+  sigaddset(&irq, HOST_IRQ_SIGNAL);
+  sigprocmask(SIG_BLOCK, &irq, 0);
+  primask = 1;
+}
+
+void __enable_irq(void) {
+  sigset_t irq;
+
+  sigemptyset(&irq);
+  sigaddset(&irq, HOST_IRQ_SIGNAL);
+  primask = 0;
+  if (!in_irq) {
+    sigprocmask(SIG_UNBLOCK, &irq, 0);
+  }
+}
+
+void host_irq_enter(void) {
+  in_irq = 1;
+}
+
+// The signal's handler returning unblocks it
+void host_irq_exit(void) {
+  in_irq = 0;
+}
+
+void NVIC_EnableIRQ(IRQn_Type irq) {
+  host_nvic_enabled |= 1 << (irq - UART0_IRQn);
+}
+
+// Called with the interrupt signal blocked, like WFI with PRIMASK set.
+// The hardware tick wakes it as well, which SLEEP_UNTIL takes in its
+// stride.
+void sleep_wfi(void) {
+  sigset_t none;
+
+  sigemptyset(&none);
+  sigsuspend(&none);
+}
@@ -0,0 +1,32 @@
+/* host.h
+ *
+ * Declares the host side of the stand-ins in host.c. Interrupts are a
+ * signal (HOST_IRQ_SIGNAL) which the simulator raises (see uartsim.h),
+ * and which masking interrupts blocks.
+ */
+
+#ifndef __HOST_h_
+#define __HOST_h_
+
+#include <signal.h>
+#include <stdint.h>
+
+#define HOST_IRQ_SIGNAL SIGUSR1
+
+/* host_time_ns()
+ * Returns the monotonic time, in nanoseconds.
+ */
+uint64_t host_time_ns(void);
+
+/* host_irq_enter(), host_irq_exit()
+ * Bracket an interrupt handler, which runs with the signal blocked, as
+ * a handler can't be interrupted by another of the same priority:
+ * unmasking interrupts inside one doesn't unblock it.
+ */
+void host_irq_enter(void);
+void host_irq_exit(void);
+
+/* The interrupts enabled in the NVIC, a bit per UART */
+extern volatile uint32_t host_nvic_enabled;
+
+#endif
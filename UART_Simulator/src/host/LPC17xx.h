@@ -0,0 +1,87 @@
+/* LPC17xx.h
+ *
+ * Stands in for the CMSIS device header in host builds. Only what the
+ * UART driver refers to is declared, with its registers in plain
+ * memory which the simulator (see uartsim.h) watches and updates.
+ * Registers sharing an address on the LPC (RBR, THR and DLL, say) are
+ * apart here, and reading one has no side effects, so the simulator
+ * makes them when the driver's interrupt handler returns instead.
+ */
+
+#ifndef __LPC17xx_H__
+#define __LPC17xx_H__
+
+#include <stdint.h>
+
+extern uint32_t SystemCoreClock;
+
+typedef enum {
+  UART0_IRQn = 5,
+  UART1_IRQn = 6,
+  UART2_IRQn = 7,
+  UART3_IRQn = 8
+} IRQn_Type;
+
+typedef struct {
+  volatile uint32_t RBR, THR, DLL, DLM, IER, IIR, FCR, LCR, LSR, FDR;
+  volatile uint32_t FIFOLVL;
+} LPC_UART_TypeDef;
+
+typedef LPC_UART_TypeDef LPC_UART1_TypeDef;
+
+typedef struct {
+  volatile uint32_t PCONP, PCLKSEL0, PCLKSEL1, DMAREQSEL;
+} LPC_SC_TypeDef;
+
+typedef struct {
+  volatile uint32_t PINSEL0, PINSEL1, PINSEL2, PINSEL3, PINSEL4;
+} LPC_PINCON_TypeDef;
+
+typedef struct {
+  volatile uint32_t DMACConfig, DMACSoftSReq;
+} LPC_GPDMA_TypeDef;
+
+typedef struct {
+  volatile uint32_t DMACCSrcAddr;
+  volatile uint32_t DMACCDestAddr;
+  volatile uint32_t DMACCLLI;
+  volatile uint32_t DMACCControl;
+  volatile uint32_t DMACCConfig;
+} LPC_GPDMACH_TypeDef;
+
+// Channels are 0x20 apart, as on the LPC, for dma_channel_number
+typedef struct {
+  LPC_GPDMACH_TypeDef regs;
+  uint32_t reserved[3];
+} SimDMAChannel;
+
+extern LPC_UART_TypeDef sim_uarts[4];
+extern LPC_SC_TypeDef sim_sc;
+extern LPC_PINCON_TypeDef sim_pincon;
+extern LPC_GPDMA_TypeDef sim_gpdma;
+extern SimDMAChannel sim_dma_channels[8];
+
+#define LPC_UART0 (&sim_uarts[0])
+#define LPC_UART1 ((LPC_UART1_TypeDef *) &sim_uarts[1])
+#define LPC_UART2 (&sim_uarts[2])
+#define LPC_UART3 (&sim_uarts[3])
+#define LPC_SC (&sim_sc)
+#define LPC_PINCON (&sim_pincon)
+#define LPC_GPDMA (&sim_gpdma)
+#define LPC_GPDMACH0 (&sim_dma_channels[0].regs)
+#define LPC_GPDMACH1 (&sim_dma_channels[1].regs)
+#define LPC_GPDMACH2 (&sim_dma_channels[2].regs)
+#define LPC_GPDMACH3 (&sim_dma_channels[3].regs)
+#define LPC_GPDMACH4 (&sim_dma_channels[4].regs)
+#define LPC_GPDMACH5 (&sim_dma_channels[5].regs)
+#define LPC_GPDMACH6 (&sim_dma_channels[6].regs)
+#define LPC_GPDMACH7 (&sim_dma_channels[7].regs)
+
+void NVIC_EnableIRQ(IRQn_Type irq);
+
+uint32_t __get_PRIMASK(void);
+void __set_PRIMASK(uint32_t primask);
+void __disable_irq(void);
+void __enable_irq(void);
+
+#endif
@@ -0,0 +1,312 @@
+/*
+ ===============================================================================
+ Name        : main.c
+ Description :
+
+   Runs the UART driver from UMD_LPC1769 against the simulated UARTs,
+   with UART0 and UART2 wired to each other, through these scenes:
+
+     baud      the dividers chosen for common rates, at 100 and 120MHz,
+               against the integer divider alone
+     stream    both ways at once through uart_reserve and uart_commit,
+               checked byte for byte
+     messages  uart_write and uart_flush one way, each message read
+               back whole when on_idle says the line went idle
+     behind    three rings' worth sent without reading, then what's
+               left read back: uart_overruns counts the overwriting,
+               and what's read is the end of what was sent, in order
+     clock     messages again, after the CPU clock switches under the
+               driver
+     fast      the stream again at 2Mbaud
+
+   Interrupts are counted by what IIR showed; DMA transfers and bursts
+   show how little of the data passed through the CPU. Times are the
+   simulation's (see uartsim.h), so the throughput is against the line
+   rate, with the host taking the CPU's part.
+
+   Usage: uartsim
+
+ ===============================================================================
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "UMDLPC/system/uart.h"
+#include "UMDLPC/system/sleep.h"
+#include "UMDLPC/system/clocking.h"
+#include "uartsim.h"
+#include "host.h"
+
+#define BAUD 1000000
+#define FAST_BAUD 2000000
+#define STREAM_BYTES 50000
+#define MESSAGES 300
+#define MESSAGE_MAX 200
+#define TIMEOUT_MS 20000
+
+static volatile uint32_t idles[4];
+
+void static idle(Uart *uart) {
+  ++idles[uart->port];
+}
+
+static uint8_t tx_a[1024], rx_a[1024];
+static uint8_t tx_b[512], rx_b[600];
+static Uart uart_a = UART(0, tx_a, rx_a, LPC_GPDMACH2, LPC_GPDMACH3, idle);
+static Uart uart_b = UART(2, tx_b, rx_b, LPC_GPDMACH4, LPC_GPDMACH5, idle);
+
+// A reproducible byte stream, one per direction
+typedef struct {
+  uint32_t state;
+} Stream;
+
+uint8_t static stream_next(Stream *stream) {
+  stream->state ^= stream->state << 13;
+  stream->state ^= stream->state >> 17;
+  stream->state ^= stream->state << 5;
+  return stream->state >> 24;
+}
+
+void static baud_table(uint32_t pclk_hz) {
+  static const uint32_t rates[] = {
+    9600, 38400, 115200, 230400, 460800, 921600, 1000000, 2000000, 3000000
+  };
+  uint_fast8_t i;
+
+  printf("PCLK %uMHz   divisor  fraction  rate      error  integer only\n",
+         pclk_hz / 1000000);
+  for (i = 0; i < sizeof rates / sizeof rates[0]; ++i) {
+    UartDivider divider;
+    const uint32_t rate = uart_baud_solve(pclk_hz, rates[i], &divider);
+    const uint32_t whole = (pclk_hz + 8 * rates[i]) / (16 * rates[i]);
+    const double plain = (double) pclk_hz / (16.0 * (whole ? whole : 1));
+
+    printf("  %8u  %6u  %2u/%-2u     %-8u %6.3f%%  %7.3f%%\n",
+           rates[i], divider.divisor, divider.divaddval, divider.mulval,
+           rate, 100.0 * ((double) rate - rates[i]) / rates[i],
+           100.0 * (plain - rates[i]) / rates[i]);
+  }
+}
+
+void static report(const char *scene, uint64_t bytes, uint64_t ns) {
+  uint_fast8_t i;
+
+  printf("%s: %llu bytes in %.1fms, %.0f bytes/s", scene,
+         (unsigned long long) bytes, ns / 1e6, bytes * 1e9 / ns);
+  printf(", driver errors %u/%u overruns %u/%u\n", uart_errors(&uart_a),
+         uart_errors(&uart_b), uart_overruns(&uart_a),
+         uart_overruns(&uart_b));
+
+  for (i = 0; i < 4; i += 2) {
+    const SimStats * const stats = sim_stats(i);
+
+    printf("  UART%u: sent %llu received %llu overruns %llu framing %llu"
+           " stale %llu\n", i, (unsigned long long) stats->sent,
+           (unsigned long long) stats->received,
+           (unsigned long long) stats->overruns,
+           (unsigned long long) stats->framing_errors,
+           (unsigned long long) stats->stale_reads);
+    printf("    DMA: %llu TX transfers, %llu RX bursts, %llu singles;"
+           " IRQs: THRE %llu RDA %llu CTI %llu RLS %llu none %llu;"
+           " idles %u\n", (unsigned long long) stats->tx_transfers,
+           (unsigned long long) stats->rx_bursts,
+           (unsigned long long) stats->rx_singles,
+           (unsigned long long) stats->irqs[SIM_IRQ_THRE],
+           (unsigned long long) stats->irqs[SIM_IRQ_RDA],
+           (unsigned long long) stats->irqs[SIM_IRQ_CTI],
+           (unsigned long long) stats->irqs[SIM_IRQ_RLS],
+           (unsigned long long) stats->irqs[SIM_IRQ_NONE], idles[i]);
+  }
+}
+
+// Sends what room there is of to_send more bytes from stream, in
+// chunks of random length; returns how many went
+uint32_t static send_some(Uart *uart, Stream *stream, uint32_t to_send) {
+  uint32_t space, length, i;
+  uint8_t *to = uart_reserve(uart, &space);
+
+  length = 1 + rand() % 300;
+  if (length > space) {
+    length = space;
+  }
+  if (length > to_send) {
+    length = to_send;
+  }
+
+  for (i = 0; i < length; ++i) {
+    to[i] = stream_next(stream);
+  }
+  if (length) {
+    uart_commit(uart, length);
+  }
+  return length;
+}
+
+// Checks what has arrived against stream; returns how many bytes
+// arrived, or stops at the first wrong one
+uint32_t static receive_some(Uart *uart, Stream *stream, uint64_t offset) {
+  const uint8_t *from;
+  uint32_t total = 0, length, i;
+
+  while ((length = uart_peek(uart, &from))) {
+    for (i = 0; i < length; ++i) {
+      const uint8_t expected = stream_next(stream);
+
+      if (from[i] != expected) {
+        printf("UART%u: byte %llu is %02x, not %02x\n", uart->port,
+               (unsigned long long) (offset + total + i), from[i], expected);
+        exit(1);
+      }
+    }
+    if (!uart_consume(uart, length)) {
+      printf("UART%u: overrun at byte %llu\n", uart->port,
+             (unsigned long long) (offset + total));
+      exit(1);
+    }
+    total += length;
+  }
+  return total;
+}
+
+uint_fast8_t static timed_out(uint64_t start) {
+  return host_time_ns() - start > TIMEOUT_MS * 1000000ULL;
+}
+
+void static wait(void) {
+  __disable_irq();
+  sleep_wfi();
+  __enable_irq();
+}
+
+void static stream(const char *scene) {
+  Stream out_a = { 1 }, out_b = { 2 }, in_a = { 2 }, in_b = { 1 };
+  uint64_t sent_a = 0, sent_b = 0, got_a = 0, got_b = 0;
+  const uint64_t start = host_time_ns(), sim_start_ns = sim_time_ns();
+
+  sim_stats_reset();
+  idles[0] = idles[2] = 0;
+
+  while (got_a < STREAM_BYTES || got_b < STREAM_BYTES) {
+    uint32_t done = 0, n;
+
+    n = send_some(&uart_a, &out_a, STREAM_BYTES - sent_a);
+    sent_a += n;
+    done += n;
+    n = send_some(&uart_b, &out_b, STREAM_BYTES - sent_b);
+    sent_b += n;
+    done += n;
+
+    n = receive_some(&uart_a, &in_a, got_a);
+    got_a += n;
+    done += n;
+    n = receive_some(&uart_b, &in_b, got_b);
+    got_b += n;
+    done += n;
+
+    if (timed_out(start)) {
+      printf("%s: timed out with %llu and %llu bytes received\n", scene,
+             (unsigned long long) got_a, (unsigned long long) got_b);
+      exit(1);
+    }
+    if (!done) {
+      wait();
+    }
+  }
+
+  report(scene, got_a + got_b, sim_time_ns() - sim_start_ns);
+}
+
+void static messages(const char *scene) {
+  static uint8_t message[MESSAGE_MAX], received[MESSAGE_MAX + 1];
+  const uint64_t start = host_time_ns(), sim_start_ns = sim_time_ns();
+  uint64_t bytes = 0;
+  uint32_t i, j, length, got, before;
+
+  sim_stats_reset();
+  idles[0] = idles[2] = 0;
+
+  for (i = 0; i < MESSAGES; ++i) {
+    length = 1 + rand() % MESSAGE_MAX;
+    for (j = 0; j < length; ++j) {
+      message[j] = rand();
+    }
+
+    before = idles[2];
+    uart_write(&uart_a, message, length);
+    uart_flush(&uart_a);
+    SLEEP_UNTIL(idles[2] != before || timed_out(start));
+
+    // By the time the line's idle, the whole message is in the ring
+    got = uart_read(&uart_b, received, sizeof received);
+    if (got != length || memcmp(message, received, length)) {
+      printf("%s: message %u of %u bytes came as %u bytes%s\n", scene, i,
+             length, got, (got == length) ? ", garbled" : "");
+      exit(1);
+    }
+    bytes += length;
+  }
+
+  report(scene, bytes, sim_time_ns() - sim_start_ns);
+}
+
+void static behind(const char *scene) {
+  static uint8_t message[3 * sizeof rx_b], received[sizeof rx_b + 1];
+  const uint64_t start = host_time_ns(), sim_start_ns = sim_time_ns();
+  const uint32_t overruns = uart_overruns(&uart_b);
+  uint32_t i, got, before;
+
+  sim_stats_reset();
+  idles[0] = idles[2] = 0;
+
+  for (i = 0; i < sizeof message; ++i) {
+    message[i] = rand();
+  }
+
+  before = idles[2];
+  uart_write(&uart_a, message, sizeof message);
+  uart_flush(&uart_a);
+  SLEEP_UNTIL(idles[2] != before || timed_out(start));
+
+  got = uart_read(&uart_b, received, sizeof received);
+  if (uart_overruns(&uart_b) == overruns || got > sizeof rx_b
+      || memcmp(received, message + sizeof message - got, got)) {
+    printf("%s: %u bytes read after %u overruns, %s\n", scene, got,
+           uart_overruns(&uart_b) - overruns,
+           memcmp(received, message + sizeof message - got, got)
+           ? "not the end of those sent" : "the end of those sent");
+    exit(1);
+  }
+
+  report(scene, got, sim_time_ns() - sim_start_ns);
+}
+
+int main(void) {
+  baud_table(100000000);
+  baud_table(120000000);
+
+  sim_reset();
+  sim_connect(0, 2);
+  sim_connect(2, 0);
+  sim_start();
+
+  printf("\nUART0 at %u, UART2 at %u\n", uart_init(&uart_a, BAUD),
+         uart_init(&uart_b, BAUD));
+
+  stream("stream");
+  messages("messages");
+  behind("behind");
+
+  host_clock_switch(120000000);
+  printf("At 120MHz, UART0 at %.0f, UART2 at %.0f\n", sim_baud(0),
+         sim_baud(2));
+  messages("clock");
+
+  printf("UART0 at %u, UART2 at %u\n", uart_set_baud(&uart_a, FAST_BAUD),
+         uart_set_baud(&uart_b, FAST_BAUD));
+  stream("fast");
+
+  sim_stop();
+  return 0;
+}
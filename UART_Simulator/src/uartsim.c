@@ -0,0 +1,473 @@
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+
+#include "uartsim.h"
+#include "host.h"
+
+#define PORTS 4
+#define FIFO_DEPTH 16
+
+#define IER_RBR (1 << 0)
+#define IER_THRE (1 << 1)
+#define IER_RLS (1 << 2)
+
+#define LSR_RDR (1 << 0)
+#define LSR_OE (1 << 1)
+#define LSR_FE (1 << 3)
+#define LSR_THRE (1 << 5)
+#define LSR_TEMT (1 << 6)
+
+#define DMA_ENABLE (1 << 0)
+#define DMA_HALT (1 << 18)
+#define DMA_M2P 1
+#define DMA_P2M 2
+#define DMA_SI (1 << 26)
+#define DMA_DI (1 << 27)
+
+LPC_UART_TypeDef sim_uarts[PORTS];
+LPC_SC_TypeDef sim_sc;
+LPC_PINCON_TypeDef sim_pincon;
+LPC_GPDMA_TypeDef sim_gpdma;
+SimDMAChannel sim_dma_channels[8];
+
+void UART0_IRQHandler(void);
+void UART1_IRQHandler(void);
+void UART2_IRQHandler(void);
+void UART3_IRQHandler(void);
+
+static void (* const handlers[PORTS])(void) = {
+  UART0_IRQHandler, UART1_IRQHandler, UART2_IRQHandler, UART3_IRQHandler
+};
+
+static const uint32_t powers[PORTS] = {
+  1 << 3, 1 << 4, 1 << 24, 1 << 25
+};
+
+static const uint8_t iir_codes[SIM_IRQ_KINDS] = {
+  0x06, 0x04, 0x0C, 0x02, 0x01
+};
+
+typedef struct {
+  int peer;
+
+  uint8_t tx_fifo[FIFO_DEPTH], rx_fifo[FIFO_DEPTH];
+  uint_fast8_t tx_first, tx_count, rx_first, rx_count;
+
+  // The character on its way out of the transmit shift register
+  uint_fast8_t shifting;
+  uint8_t shift_byte;
+  uint64_t shift_done_ns;
+
+  // When a character last arrived in or left the RX FIFO, for the
+  // character timeout
+  uint64_t rx_last_ns;
+
+  uint_fast8_t thre;
+  uint32_t line_errors;
+
+  // The interrupt latched by the NVIC, and the cause IIR shows while
+  // the handler runs
+  uint_fast8_t latched, in_service;
+  enum SimInterrupt shown;
+
+  SimStats stats;
+} SimPort;
+
+static SimPort ports[PORTS];
+static volatile uint32_t pending;
+static uint64_t sim_ns;
+
+static sigset_t tick_signal;
+
+double sim_baud(uint8_t port) {
+  static const uint8_t pclk_dividers[4] = { 4, 1, 2, 8 };
+  const LPC_UART_TypeDef * const regs = &sim_uarts[port];
+  const uint32_t pclksel = (port < 2)
+      ? (sim_sc.PCLKSEL0 >> (6 + 2 * port)) & 3
+      : (sim_sc.PCLKSEL1 >> (16 + 2 * (port - 2))) & 3;
+  const uint32_t divisor = ((regs->DLM & 0xFF) << 8) | (regs->DLL & 0xFF);
+  uint32_t mulval = (regs->FDR >> 4) & 0xF;
+  const uint32_t divaddval = regs->FDR & 0xF;
+
+  if (!(sim_sc.PCONP & powers[port]) || !divisor) {
+    return 0;
+  }
+
+  // MULVAL 0 is taken as 1, and DIVADDVAL must be below it to count
+  if (!mulval) {
+    mulval = 1;
+  }
+
+  return (double) SystemCoreClock / pclk_dividers[pclksel] / 16 / divisor
+         * mulval / (mulval + (divaddval < mulval ? divaddval : 0));
+}
+
+// A character's time on the line, 8N1 being 10 bits
+uint64_t static char_ns(uint8_t port) {
+  const double baud = sim_baud(port);
+
+  return baud ? (uint64_t) (10e9 / baud) : 0;
+}
+
+// The channel serving a request line, if one is enabled for it
+LPC_GPDMACH_TypeDef static *channel_for(uint8_t request, uint8_t type) {
+  uint_fast8_t i;
+
+  if (!(sim_gpdma.DMACConfig & 1) || (sim_sc.DMAREQSEL & (1 << (request - 8)))) {
+    return 0;
+  }
+
+  for (i = 0; i < 8; ++i) {
+    LPC_GPDMACH_TypeDef * const channel = &sim_dma_channels[i].regs;
+    const uint32_t config = channel->DMACCConfig;
+    const uint32_t peripheral = (type == DMA_M2P) ? (config >> 6) & 0x1F
+                                                  : (config >> 1) & 0x1F;
+
+    if ((config & DMA_ENABLE) && !(config & DMA_HALT)
+        && ((config >> 11) & 7) == type && peripheral == request) {
+      return channel;
+    }
+  }
+
+  return 0;
+}
+
+// Counts down one transfer, loading the next node or disabling the
+// channel after the last. Returns whether the channel finished.
+uint_fast8_t static channel_step(LPC_GPDMACH_TypeDef *channel) {
+  const uint32_t control = channel->DMACCControl;
+
+  if (control & DMA_SI) {
+    ++channel->DMACCSrcAddr;
+  }
+  if (control & DMA_DI) {
+    ++channel->DMACCDestAddr;
+  }
+
+  if ((control & 0xFFF) > 1) {
+    channel->DMACCControl = control - 1;
+    return 0;
+  }
+
+  if (channel->DMACCLLI) {
+    const uint32_t *node = (const uint32_t *) (uintptr_t) channel->DMACCLLI;
+
+    channel->DMACCSrcAddr = node[0];
+    channel->DMACCDestAddr = node[1];
+    channel->DMACCLLI = node[2];
+    channel->DMACCControl = node[3];
+    return 0;
+  }
+
+  channel->DMACCControl = control & ~0xFFF;
+  channel->DMACCConfig &= ~DMA_ENABLE;
+  return 1;
+}
+
+void static check_address(uint32_t address, volatile uint32_t *reg,
+                          const char *what) {
+  if (address != (uint32_t) (uintptr_t) reg) {
+    fprintf(stderr, "uartsim: DMA %s at 0x%08x\n", what, address);
+    exit(1);
+  }
+}
+
+// Moves one character from RBR to where the channel points
+void static rx_transfer(uint8_t port, LPC_GPDMACH_TypeDef *channel,
+                        uint64_t now) {
+  SimPort * const p = &ports[port];
+  uint8_t byte = 0;
+
+  check_address(channel->DMACCSrcAddr, &sim_uarts[port].RBR,
+                "read not from RBR");
+
+  if (p->rx_count) {
+    byte = p->rx_fifo[p->rx_first];
+    p->rx_first = (p->rx_first + 1) % FIFO_DEPTH;
+    --p->rx_count;
+  } else {
+    ++p->stats.stale_reads;
+  }
+  p->rx_last_ns = now;
+
+  *(uint8_t *) (uintptr_t) channel->DMACCDestAddr = byte;
+  channel_step(channel);
+}
+
+uint_fast8_t static trigger_level(uint8_t port) {
+  static const uint8_t levels[4] = { 1, 4, 8, 14 };
+
+  return levels[(sim_uarts[port].FCR >> 6) & 3];
+}
+
+// Serves the port's DMA requests, and starts its next character out
+void static service(uint8_t port, uint64_t now) {
+  SimPort * const p = &ports[port];
+  LPC_UART_TypeDef * const regs = &sim_uarts[port];
+  const uint8_t tx_request = 8 + 2 * port, rx_request = tx_request + 1;
+  LPC_GPDMACH_TypeDef *channel;
+
+  if (!(sim_sc.PCONP & powers[port])) {
+    return;
+  }
+
+  // The TX line requests while the FIFO has room
+  while (p->tx_count < FIFO_DEPTH
+         && (channel = channel_for(tx_request, DMA_M2P))) {
+    check_address(channel->DMACCDestAddr, &regs->THR, "write not to THR");
+    p->tx_fifo[(p->tx_first + p->tx_count++) % FIFO_DEPTH] =
+        *(const uint8_t *) (uintptr_t) channel->DMACCSrcAddr;
+    p->thre = 0;
+    if (channel_step(channel)) {
+      ++p->stats.tx_transfers;
+    }
+  }
+
+  if (!p->shifting && p->tx_count) {
+    p->shift_byte = p->tx_fifo[p->tx_first];
+    p->tx_first = (p->tx_first + 1) % FIFO_DEPTH;
+    p->shifting = 1;
+    p->shift_done_ns = now + char_ns(port);
+    if (!--p->tx_count) {
+      p->thre = 1;
+    }
+  }
+
+  // The RX line requests a burst at the trigger level; the data
+  // available interrupt comes on at the same time, if only for a moment
+  while (p->rx_count >= trigger_level(port)) {
+    static const uint16_t bursts[8] = { 1, 4, 8, 16, 32, 64, 128, 256 };
+    uint_fast16_t burst;
+
+    if (regs->IER & IER_RBR) {
+      p->latched = 1;
+    }
+    if (!(channel = channel_for(rx_request, DMA_P2M))) {
+      break;
+    }
+
+    ++p->stats.rx_bursts;
+    for (burst = bursts[(channel->DMACCControl >> 12) & 7]; burst; --burst) {
+      rx_transfer(port, channel, now);
+    }
+  }
+
+  if (sim_gpdma.DMACSoftSReq & (1 << rx_request)) {
+    if (p->rx_count && (channel = channel_for(rx_request, DMA_P2M))) {
+      ++p->stats.rx_singles;
+      rx_transfer(port, channel, now);
+    }
+    sim_gpdma.DMACSoftSReq &= ~(1 << rx_request);
+  }
+
+  regs->LSR = (p->rx_count ? LSR_RDR : 0) | p->line_errors
+              | (p->tx_count ? 0 : LSR_THRE)
+              | ((p->tx_count || p->shifting) ? 0 : LSR_TEMT);
+  regs->FIFOLVL = p->rx_count | (p->tx_count << 8);
+}
+
+// The character in port's shift register reaches its peer
+void static deliver(uint8_t port) {
+  SimPort * const p = &ports[port];
+  uint8_t byte = p->shift_byte;
+  SimPort *q;
+  double from, to;
+
+  p->shifting = 0;
+  ++p->stats.sent;
+
+  if (p->peer < 0 || !(to = sim_baud(p->peer))) {
+    return;
+  }
+  q = &ports[p->peer];
+  from = sim_baud(port);
+
+  if (from < to * 0.98 || from > to * 1.02) {
+    byte ^= 0xA5;
+    q->line_errors |= LSR_FE;
+    ++q->stats.framing_errors;
+  }
+
+  if (q->rx_count == FIFO_DEPTH) {
+    q->line_errors |= LSR_OE;
+    ++q->stats.overruns;
+  } else {
+    q->rx_fifo[(q->rx_first + q->rx_count++) % FIFO_DEPTH] = byte;
+    ++q->stats.received;
+  }
+  q->rx_last_ns = p->shift_done_ns;
+}
+
+// Latches port's interrupt while a cause is asserted, and raises it
+// once the handler is free
+void static interrupt(uint8_t port, uint64_t now) {
+  SimPort * const p = &ports[port];
+  const uint32_t ier = sim_uarts[port].IER;
+  const uint64_t timeout = 4 * char_ns(port);
+  enum SimInterrupt cause = SIM_IRQ_NONE;
+
+  if ((ier & IER_RLS) && p->line_errors) {
+    cause = SIM_IRQ_RLS;
+  } else if ((ier & IER_RBR) && p->rx_count >= trigger_level(port)) {
+    cause = SIM_IRQ_RDA;
+  } else if ((ier & IER_RBR) && p->rx_count
+             && now - p->rx_last_ns >= timeout) {
+    cause = SIM_IRQ_CTI;
+  } else if ((ier & IER_THRE) && p->thre) {
+    cause = SIM_IRQ_THRE;
+  }
+
+  if (cause != SIM_IRQ_NONE) {
+    p->latched = 1;
+  }
+
+  if (p->latched && !p->in_service && (host_nvic_enabled & (1 << port))) {
+    p->latched = 0;
+    p->in_service = 1;
+    p->shown = cause;
+    sim_uarts[port].IIR = 0xC0 | iir_codes[cause];
+    ++p->stats.irqs[cause];
+
+    __sync_fetch_and_or(&pending, 1 << port);
+    raise(HOST_IRQ_SIGNAL);
+  }
+}
+
+void static tick(int signal) {
+  const uint64_t now = sim_ns + SIM_STEP_NS;
+  uint_fast8_t i;
+
+  (void) signal;
+
+  // Each character completing, in order, up to now
+  for (;;) {
+    int next = -1;
+
+    for (i = 0; i < PORTS; ++i) {
+      if (ports[i].shifting && ports[i].shift_done_ns <= now
+          && (next < 0 || ports[i].shift_done_ns < ports[next].shift_done_ns)) {
+        next = i;
+      }
+    }
+    if (next < 0) {
+      break;
+    }
+
+    sim_ns = ports[next].shift_done_ns;
+    deliver(next);
+    for (i = 0; i < PORTS; ++i) {
+      service(i, sim_ns);
+    }
+  }
+
+  sim_ns = now;
+  for (i = 0; i < PORTS; ++i) {
+    service(i, now);
+    interrupt(i, now);
+  }
+}
+
+// The interrupt handlers, with the hardware running on beneath them
+void static irq_signal(int signal) {
+  const uint32_t ports_pending = __sync_fetch_and_and(&pending, 0);
+  uint_fast8_t i;
+
+  (void) signal;
+  host_irq_enter();
+  for (i = 0; i < PORTS; ++i) {
+    if (ports_pending & (1 << i)) {
+      SimPort * const p = &ports[i];
+
+      handlers[i]();
+
+      // What reading IIR and LSR would have cleared. The DMA answers
+      // the handler at once, rather than on the next tick.
+      sigprocmask(SIG_BLOCK, &tick_signal, 0);
+      if (p->shown == SIM_IRQ_THRE) {
+        p->thre = 0;
+      }
+      if (p->shown == SIM_IRQ_RLS || p->shown == SIM_IRQ_CTI) {
+        p->line_errors = 0;
+      }
+      sim_uarts[i].IIR = 0xC1;
+      p->in_service = 0;
+      service(i, sim_ns);
+      sigprocmask(SIG_UNBLOCK, &tick_signal, 0);
+    }
+  }
+  host_irq_exit();
+}
+
+void sim_reset(void) {
+  uint_fast8_t i;
+
+  sim_stop();
+
+  memset(sim_uarts, 0, sizeof sim_uarts);
+  memset(&sim_sc, 0, sizeof sim_sc);
+  memset(&sim_pincon, 0, sizeof sim_pincon);
+  memset(&sim_gpdma, 0, sizeof sim_gpdma);
+  memset(sim_dma_channels, 0, sizeof sim_dma_channels);
+  memset(ports, 0, sizeof ports);
+  pending = 0;
+
+  // UART0 and 1 are powered at reset, and the UARTs' dividers give
+  // PCLK / 16
+  sim_sc.PCONP = powers[0] | powers[1];
+  for (i = 0; i < PORTS; ++i) {
+    sim_uarts[i].DLL = 1;
+    sim_uarts[i].FDR = 0x10;
+    sim_uarts[i].IIR = 0xC1;
+    sim_uarts[i].LSR = LSR_THRE | LSR_TEMT;
+    ports[i].peer = -1;
+  }
+}
+
+void sim_connect(uint8_t from, uint8_t to) {
+  ports[from].peer = to;
+}
+
+void sim_start(void) {
+  struct itimerval period = { { 0, SIM_TICK_US }, { 0, SIM_TICK_US } };
+  struct sigaction action = { .sa_handler = tick };
+
+  sigemptyset(&tick_signal);
+  sigaddset(&tick_signal, SIGALRM);
+
+  // No interrupt is taken in the middle of a tick, but ticks go on
+  // during interrupts, as the hardware would
+  sigemptyset(&action.sa_mask);
+  sigaddset(&action.sa_mask, HOST_IRQ_SIGNAL);
+  sigaction(SIGALRM, &action, 0);
+
+  action.sa_handler = irq_signal;
+  sigemptyset(&action.sa_mask);
+  sigaction(HOST_IRQ_SIGNAL, &action, 0);
+
+  setitimer(ITIMER_REAL, &period, 0);
+}
+
+void sim_stop(void) {
+  struct itimerval off = { { 0, 0 }, { 0, 0 } };
+
+  setitimer(ITIMER_REAL, &off, 0);
+}
+
+uint64_t sim_time_ns(void) {
+  return sim_ns;
+}
+
+const SimStats *sim_stats(uint8_t port) {
+  return &ports[port].stats;
+}
+
+void sim_stats_reset(void) {
+  uint_fast8_t i;
+
+  for (i = 0; i < PORTS; ++i) {
+    memset(&ports[i].stats, 0, sizeof ports[i].stats);
+  }
+}
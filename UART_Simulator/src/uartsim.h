@@ -0,0 +1,93 @@
+/* uartsim.h
+ *
+ * Declares a simulation of UART0-3 and the GPDMA channels serving
+ * them, running on a timer signal (the "hardware tick") alongside the
+ * driver. Each tick moves the simulated time on by SIM_STEP_NS, a
+ * character at a time, which is slower than real time, but keeps the
+ * driver's interrupt handlers as quick, next to the line, as they'd be
+ * on the target, however the host schedules the process.
+ *
+ * Each UART has its 16 byte FIFOs, dividers, receive trigger level,
+ * character timeout and line status, and its TXD may be wired to any
+ * UART's RXD. Characters sent at a rate more than 2% off the
+ * receiver's arrive garbled, with a framing error. The DMA model
+ * follows the request lines the channels are configured for: a UART's
+ * TX line requests while its FIFO isn't full, its RX line requests a
+ * burst at the trigger level, and DMACSoftSReq makes single requests.
+ * Channels count down their transfers and follow linked list nodes.
+ *
+ * Interrupts are raised as a signal which masking interrupts blocks
+ * (see host.c), with IIR showing their cause as the driver's handler
+ * reads it. Reads being free of side effects here, the THRE interrupt
+ * and line status errors are cleared when the handler returns.
+ */
+
+#ifndef __UARTSIM_h_
+#define __UARTSIM_h_
+
+#include <stdint.h>
+
+#include "LPC17xx.h"
+
+/* How often the hardware tick comes, and how far it moves the
+ * simulated time on
+ */
+#define SIM_TICK_US 50
+#define SIM_STEP_NS 5000
+
+enum SimInterrupt {
+  SIM_IRQ_RLS,     /* receive line status */
+  SIM_IRQ_RDA,     /* receive data available */
+  SIM_IRQ_CTI,     /* character timeout */
+  SIM_IRQ_THRE,    /* transmit holding register empty */
+  SIM_IRQ_NONE,    /* taken, but with nothing to identify by then */
+  SIM_IRQ_KINDS
+};
+
+typedef struct {
+  uint64_t sent;              /* characters shifted out on TXD */
+  uint64_t received;          /* characters put in the RX FIFO */
+  uint64_t overruns;          /* characters lost to a full RX FIFO */
+  uint64_t framing_errors;    /* characters garbled by a rate mismatch */
+  uint64_t stale_reads;       /* DMA reads of an empty RX FIFO */
+  uint64_t tx_transfers;      /* TX channel transfers completed */
+  uint64_t rx_bursts;         /* RX DMA bursts */
+  uint64_t rx_singles;        /* RX DMA single requests served */
+  uint64_t irqs[SIM_IRQ_KINDS];
+} SimStats;
+
+/* sim_reset()
+ * Puts every register back to its reset value, empties the FIFOs,
+ * disconnects the UARTs from each other and zeroes the stats.
+ */
+void sim_reset(void);
+
+/* sim_connect(from, to)
+ * Wires UART from's TXD to UART to's RXD.
+ */
+void sim_connect(uint8_t from, uint8_t to);
+
+/* sim_start(), sim_stop()
+ * Start and stop the hardware tick.
+ */
+void sim_start(void);
+void sim_stop(void);
+
+/* sim_time_ns()
+ * Returns the simulated time, which starts at 0.
+ */
+uint64_t sim_time_ns(void);
+
+/* sim_baud(port)
+ * Returns the rate port's dividers give at the current clock, or 0
+ * while it's off.
+ */
+double sim_baud(uint8_t port);
+
+/* sim_stats(port), sim_stats_reset()
+ * Return port's stats, or zero them all.
+ */
+const SimStats *sim_stats(uint8_t port);
+void sim_stats_reset(void);
+
+#endif
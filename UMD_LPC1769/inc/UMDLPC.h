@@ -10,10 +10,20 @@
 #include "UMDLPC/util/util.h"
 #include "UMDLPC/util/fonts.h"
 #include "UMDLPC/util/pins.h"
+#include "UMDLPC/util/fft.h"
+#include "UMDLPC/util/format.h"
 #include "UMDLPC/system/systick.h"
 #include "UMDLPC/system/clocking.h"
+#include "UMDLPC/system/delay.h"
+#include "UMDLPC/system/profile.h"
+#include "UMDLPC/system/trace.h"
 #include "UMDLPC/system/dma.h"
 #include "UMDLPC/system/pinsel.h"
 #include "UMDLPC/system/pconp.h"
+#include "UMDLPC/system/sleep.h"
+#include "UMDLPC/system/sched.h"
+#include "UMDLPC/system/semihost.h"
+#include "UMDLPC/system/uart.h"
+#include "UMDLPC/system/i2c.h"
 
 #endif
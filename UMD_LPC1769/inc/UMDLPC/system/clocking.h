@@ -4,6 +4,14 @@
  * Phase Locked Loop (PLL). Refer to chapter 4 (4.5 in particular) for
  * more information.
  *
+ * PLL0 multiplies its input up to F_CCO = 2 * m * F_IN / n, which must
+ * be within 275-550MHz, and the CPU clock is F_CCO / cclkdiv.
+ *
+ * The CPU clock can be switched at runtime, either by changing cclkdiv
+ * alone (quick, as PLL0 stays locked) or by reconfiguring PLL0. Drivers
+ * which derive a divider or timing from SystemCoreClock register a
+ * handler with clock_on_change, which is called after each switch to
+ * set them up again for the new clock.
  */
 
 #ifndef __UMDLPC_system_clocking_h_
@@ -14,11 +22,74 @@
 #include <NXP/crp.h>
 #include <stdint.h>
 
-#include "assert.h"
+#include "UMDLPC/assert.h"
+
+enum ClockSource {
+  INTERNAL_RC = 0,
+  MAIN_OSCILLATOR = 1,
+  RTC_OSCILLATOR = 2
+};
+
+/* Limits on the PLL0 settings, and on the clocks they give */
+#define PLL_M_MIN 6
+#define PLL_M_MAX 512
+#define PLL_N_MIN 1
+#define PLL_N_MAX 32
+#define PLL_CCLKDIV_MIN 2
+#define PLL_CCLKDIV_MAX 256
+#define PLL_FCCO_MIN_HZ 275000000ULL
+#define PLL_FCCO_MAX_HZ 550000000ULL
+#define PLL_CCLK_MAX_HZ 120000000ULL
+
+/* PLL_FCCO_HZ(source_hz, m, n), PLL_CCLK_HZ(source_hz, m, n, cclkdiv)
+ * The PLL0 output and CPU clock for a setting, as constant expressions,
+ * e.g. for CT_ASSERT(PLL_CCLK_HZ(12000000, 147, 8, 10) == CLOCK_SPEED)
+ */
+#define PLL_FCCO_HZ(source_hz, m, n) (2ULL * (m) * (source_hz) / (n))
+#define PLL_CCLK_HZ(source_hz, m, n, cclkdiv) \
+  (2ULL * (m) * (source_hz) / ((uint64_t) (n) * (cclkdiv)))
+
+/* PLL_VALID(source_hz, m, n, cclkdiv)
+ * Whether a setting is in range, as a constant expression
+ */
+#define PLL_VALID(source_hz, m, n, cclkdiv)                          \
+  ((m) >= PLL_M_MIN && (m) <= PLL_M_MAX                              \
+   && (n) >= PLL_N_MIN && (n) <= PLL_N_MAX                           \
+   && (cclkdiv) >= PLL_CCLKDIV_MIN && (cclkdiv) <= PLL_CCLKDIV_MAX   \
+   && PLL_FCCO_HZ(source_hz, m, n) >= PLL_FCCO_MIN_HZ                \
+   && PLL_FCCO_HZ(source_hz, m, n) <= PLL_FCCO_MAX_HZ                \
+   && PLL_CCLK_HZ(source_hz, m, n, cclkdiv) <= PLL_CCLK_MAX_HZ)
+
+typedef struct {
+  uint16_t m;        /* multiplier, PLL_M_MIN to PLL_M_MAX */
+  uint16_t n;        /* pre-divider, PLL_N_MIN to PLL_N_MAX */
+  uint16_t cclkdiv;  /* CPU clock divider, PLL_CCLKDIV_MIN to _MAX */
+} PLLConfig;
+
+/* PLL_solve(source_hz, cclk_hz, multiple_hz, config)
+ * Finds the setting giving the CPU clock closest to cclk_hz from a
+ * source_hz input. If multiple_hz isn't 0, only CPU clocks which are
+ * exact multiples of it are considered, so that a peripheral rate can
+ * be divided down from the CPU clock exactly (e.g. 44100 for a DAC
+ * counter at 44.1kHz). Ties go to the lowest F_CCO, which uses the
+ * least power. Returns the CPU clock, or 0 if no setting fits.
+ */
+uint32_t PLL_solve(uint32_t source_hz, uint32_t cclk_hz,
+                   uint32_t multiple_hz, PLLConfig *config);
+
+/* PLL_configure(source, config)
+ * Switches the CPU clock over to PLL0 running from source with config,
+ * following the sequence in 4.5.13: PLL0 is disconnected and disabled
+ * before the source and settings are changed, and only connected once
+ * it has locked. The flash accelerator's access time is set for the
+ * new clock, and SystemCoreClock updated.
+ */
+void PLL_configure(enum ClockSource source, const PLLConfig *config);
 
 /* PLL_init(m, n, cclkdiv)
  * Takes multiplier (m), divider (n) and CPU clock divider (cclkdiv)
- * and initializes the PLL with those settings.
+ * and initializes the PLL with those settings, from the clock source
+ * already selected in CLKSRCSEL (see PLL_configure).
  */
 void PLL_init(uint_fast16_t m, uint_fast16_t n, uint_fast16_t cclkdiv);
 
@@ -27,10 +98,30 @@ void PLL_init(uint_fast16_t m, uint_fast16_t n, uint_fast16_t cclkdiv);
  */
 void PLL_bypass();
 
-enum ClockSource {
-  INTERNAL_RC = 0,
-  MAIN_OSCILLATOR = 1,
-  RTC_OSCILLATOR = 2
-};
+/* The most handlers clock_on_change can hold */
+#define CLOCK_HANDLERS_MAX 8
+
+/* A clock change handler is given the new CPU clock, in Hz */
+typedef void (*ClockChangeHandler)(uint32_t cclk_hz);
+
+/* clock_on_change(handler)
+ * Registers handler to be called after every CPU clock switch (by
+ * clock_set_divider, PLL_configure, PLL_init or PLL_bypass). Handlers
+ * run in the order they were registered, with interrupts masked, so
+ * they should only rewrite registers. Registering a handler again has
+ * no effect. Returns 0 if there's no room.
+ */
+uint_fast8_t clock_on_change(ClockChangeHandler handler);
+
+/* clock_set_divider(cclkdiv)
+ * Switches the CPU clock to F_CCO / cclkdiv, keeping PLL0 as it is, so
+ * the switch takes effect at once. The flash access time is raised
+ * before speeding up and lowered after slowing down, and the handlers
+ * are called. Returns the new CPU clock, or 0 (leaving the clock as it
+ * was) if PLL0 isn't connected or the clock would be out of range.
+ * Peripherals keep running through the switch, but anything timed
+ * from the CPU clock (e.g. an SPI transfer) should be finished first.
+ */
+uint32_t clock_set_divider(uint_fast16_t cclkdiv);
 
 #endif
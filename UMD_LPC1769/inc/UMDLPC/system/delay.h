@@ -0,0 +1,70 @@
+/* delay.h
+ *
+ * Declares busy-wait delays timed on the Cortex-M3's DWT cycle counter,
+ * for the short bus timings drivers need. Unlike a loop of NOPs, they
+ * don't depend on the optimization level, and unlike sleep_delay_*
+ * they may be used from interrupt handlers. Interrupts taken during a
+ * delay only make it longer.
+ *
+ * The cycle counter stops while the core sleeps, so it can't time
+ * anything across WFI; sleep.h and systick.h are for that.
+ */
+
+#ifndef __UMDLPC_system_delay_h_
+#define __UMDLPC_system_delay_h_
+
+#include "LPC17xx.h"
+#include <stdint.h>
+
+/* The DWT control and cycle count registers (see the ARMv7-M
+ * Architecture Reference Manual, C1.8), which CMSIS 2.00 doesn't
+ * declare
+ */
+#define DWT_CTRL (*(volatile uint32_t *) 0xE0001000)
+#define DWT_CYCCNT (*(volatile uint32_t *) 0xE0001004)
+#define DWT_CTRL_CYCCNTENA (1 << 0)
+
+/* DELAY_NS_TO_CYCLES(ns, cclk_hz)
+ * The cycles covering at least ns at cclk_hz, as a constant expression
+ * where both are known at compile time (e.g. for a fixed CLOCK_SPEED)
+ */
+#define DELAY_NS_TO_CYCLES(ns, cclk_hz) \
+  ((uint32_t) (((uint64_t) (ns) * (cclk_hz) + 999999999) / 1000000000))
+
+/* delay_init()
+ * Starts the cycle counter. Safe to call more than once.
+ */
+void delay_init(void);
+
+/* delay_counter()
+ * Returns the cycle counter, which wraps every 2^32 cycles.
+ */
+inline static uint32_t delay_counter(void) {
+  return DWT_CYCCNT;
+}
+
+/* delay_cycles(cycles)
+ * Spins for at least cycles.
+ */
+inline static void delay_cycles(uint32_t cycles) {
+  const uint32_t start = DWT_CYCCNT;
+
+  while (DWT_CYCCNT - start < cycles)
+    ;
+}
+
+/* delay_ns_to_cycles(ns)
+ * The cycles covering at least ns at the current clock, without
+ * division by anything but constants. Good for up to 35ms at 120MHz.
+ */
+uint32_t delay_ns_to_cycles(uint32_t ns);
+
+/* delay_ns(ns), delay_us(us), delay_ms(ms)
+ * Spin for at least the given time at the current clock. For more than
+ * a few microseconds, sleep_delay_* lets the core sleep instead.
+ */
+void delay_ns(uint32_t ns);
+void delay_us(uint32_t us);
+void delay_ms(uint32_t ms);
+
+#endif
@@ -1,14 +1,17 @@
-/* clocking.h
+/* dma.h
  *
- * Declares handy utility functions for configuring the clock, via the
- * Phase Locked Loop (PLL). Refer to chapter 4 (4.5 in particular) for
- * more information.
+ * Declares the GPDMA linked list node layout, and a helper for
+ * waiting on a channel to finish. Refer to chapter 31 for more
+ * information.
  *
  */
 
 #ifndef __UMDLPC_system_dma_h_
 #define __UMDLPC_system_dma_h_
 
+#include "LPC17xx.h"
+#include <stdint.h>
+
 typedef struct {
   uint32_t sourceAddr;
   uint32_t destAddr;
@@ -16,4 +19,19 @@ typedef struct {
   uint32_t dmaControl;
 } DMALinkedListNode;
 
+/* dma_channel_number(channel)
+ * Returns the index (0-7) of a GPDMA channel register block.
+ */
+#define dma_channel_number(channel) \
+  (((uint32_t) (channel) - (uint32_t) LPC_GPDMACH0) / 0x20)
+
+/* dma_wait(channel)
+ * Sleeps until channel disables itself at the end of its transfer,
+ * then acknowledges its terminal count. The channel must have been
+ * started with its terminal count interrupt enabled (bit 31 of the
+ * control word and bit 15 of the config word), which is what wakes
+ * the core, whether or not DMA_IRQn is enabled in the NVIC.
+ */
+void dma_wait(LPC_GPDMACH_TypeDef * const channel);
+
 #endif
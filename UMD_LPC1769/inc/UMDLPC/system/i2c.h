@@ -0,0 +1,159 @@
+/* i2c.h
+ *
+ * Declares an interrupt driven master driver for I2C0-2 (chapter 19).
+ * Transfers are queued on their bus and carried out one after another
+ * by the I2C interrupt, following the master states in I2STAT (19.10),
+ * so the CPU is free between bytes. Each transfer is a list of
+ * segments, read or written, with a repeated start between them (or
+ * none, for a write continuing the one before), and ends with a stop.
+ * Its done handler is called from the interrupt when it completes, and
+ * may queue another transfer; a task waiting on it can be woken with
+ * sched_post.
+ *
+ * A transfer losing arbitration to another master is retried from its
+ * start, up to I2C_RETRIES times. After a bus error, and on i2c_abort,
+ * the bus is recovered by clocking SCL until a slave stuck holding SDA
+ * low lets go, then sending a stop (I2C specification, 3.1.16).
+ * Nothing here times out on its own: a transfer held up by a bus stuck
+ * before it could start (or a slave stretching SCL forever) waits until
+ * the application calls i2c_abort, say from a sched timer.
+ *
+ * The pins used are
+ *   I2C0: P0.27 SDA0, P0.28 SCL0
+ *   I2C1: P0.19 SDA1, P0.20 SCL1 (P0.0 and P0.1 being UART3's)
+ *   I2C2: P0.10 SDA2, P0.11 SCL2, which UART2 uses as well
+ * I2C1 and I2C2's pins are set to open drain, without pull ups, so the
+ * bus needs its own.
+ */
+
+#ifndef __UMDLPC_system_i2c_h_
+#define __UMDLPC_system_i2c_h_
+
+#include "LPC17xx.h"
+#include <stdint.h>
+
+/* How many times a transfer losing arbitration is tried again */
+#ifndef I2C_RETRIES
+#define I2C_RETRIES 3
+#endif
+
+/* The most SCL pulses bus recovery gives a slave to let go of SDA */
+#define I2C_RECOVERY_PULSES 9
+
+/* Segment flags */
+#define I2C_READ (1 << 0)        /* read, rather than write */
+#define I2C_NO_START (1 << 1)    /* a write going on from the one before */
+
+enum I2CStatus {
+  I2C_OK,
+  I2C_PENDING,                /* queued, or under way */
+  I2C_NACK_ADDRESS,           /* no slave answered its address */
+  I2C_NACK_DATA,              /* the slave refused a byte written */
+  I2C_ARBITRATION_LOST,       /* to another master, I2C_RETRIES times */
+  I2C_BUS_ERROR,              /* a start or stop out of place */
+  I2C_ABORTED                 /* by i2c_abort */
+};
+
+typedef struct {
+  uint8_t *data;
+  uint16_t length;      /* at least 1 for reads */
+  uint8_t flags;
+} I2CSegment;
+
+/* I2C_WRITE(data, length), I2C_READ_INTO(data, length),
+ * I2C_WRITE_ON(data, length)
+ * Initialize segments writing, reading, or writing on from the segment
+ * before without a repeated start (e.g. a register address, then the
+ * data for it from another buffer)
+ */
+#define I2C_WRITE(data, length) { (uint8_t *) (data), (length), 0 }
+#define I2C_READ_INTO(data, length) { (data), (length), I2C_READ }
+#define I2C_WRITE_ON(data, length) \
+  { (uint8_t *) (data), (length), I2C_NO_START }
+
+typedef struct I2CTransfer I2CTransfer;
+
+/* Called from the I2C interrupt when a transfer has completed, its
+ * status set
+ */
+typedef void (*I2CHandler)(I2CTransfer *transfer);
+
+struct I2CTransfer {
+  uint8_t address;                /* 7 bit */
+  const I2CSegment *segments;
+  uint8_t count;
+  I2CHandler done;                /* may be 0 */
+  void *context;                  /* for done, untouched by the driver */
+
+  // The driver's own
+  volatile uint8_t status;
+  I2CTransfer *next;
+};
+
+typedef struct {
+  uint8_t port;
+
+  // The driver's own
+  LPC_I2C_TypeDef *regs;
+  uint32_t rate;
+  I2CTransfer *head, *tail;
+  uint8_t active;                 // a transfer is on the bus
+  uint8_t segment, retries;
+  uint16_t index;
+  volatile uint32_t recoveries;
+} I2CBus;
+
+/* I2C_BUS(port)
+ * Initializes an I2CBus for port 0-2, e.g.
+ *   static I2CBus codec_bus = I2C_BUS(0);
+ */
+#define I2C_BUS(port) { (port) }
+
+/* i2c_init(bus, rate_hz)
+ * Powers bus's port, selects its pins, recovers the bus should a slave
+ * be holding SDA low, and sets the SCL rate closest to rate_hz, up to
+ * 400kHz. Returns the rate, or 0 (leaving the port off) if rate_hz is
+ * out of reach, or SDA is stuck low even so.
+ */
+uint32_t i2c_init(I2CBus *bus, uint32_t rate_hz);
+
+/* i2c_submit(bus, transfer)
+ * Queues transfer, to start once those before it have completed.
+ * Returns 0, leaving it alone, if its segments aren't allowed (none, a
+ * read of 0 bytes, or a segment flagged I2C_NO_START which isn't a
+ * write after a write). transfer and its segments and data mustn't be
+ * touched until it has completed. Callable from interrupt handlers,
+ * including done handlers.
+ */
+uint_fast8_t i2c_submit(I2CBus *bus, I2CTransfer *transfer);
+
+/* i2c_wait(transfer)
+ * Sleeps until transfer has completed, returning its status. Not to be
+ * called from interrupt handlers.
+ */
+uint8_t i2c_wait(I2CTransfer *transfer);
+
+/* i2c_transfer(bus, transfer)
+ * Submits transfer and waits for it, returning its status (or
+ * I2C_PENDING if it wasn't allowed).
+ */
+uint8_t i2c_transfer(I2CBus *bus, I2CTransfer *transfer);
+
+/* i2c_abort(bus)
+ * Stops the transfer on the bus, completing it as I2C_ABORTED,
+ * recovers the bus and goes on to the next transfer. Does nothing if
+ * the queue is empty.
+ */
+void i2c_abort(I2CBus *bus);
+
+/* i2c_recover(bus)
+ * Resets the I2C controller, takes the pins from it and clocks SCL, up
+ * to I2C_RECOVERY_PULSES times, until SDA goes high, then sends a stop
+ * and gives the pins back. Returns whether both lines were high at the
+ * end. The driver does this itself as needed, from the I2C interrupt
+ * or with interrupts masked, taking around 100us at most; otherwise,
+ * it's not for while a transfer is under way (see i2c_abort).
+ */
+uint_fast8_t i2c_recover(I2CBus *bus);
+
+#endif
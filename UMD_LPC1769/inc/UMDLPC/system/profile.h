@@ -0,0 +1,108 @@
+/* profile.h
+ *
+ * Declares profiling zones timed on the DWT cycle counter (see
+ * delay.h), for finding out what code costs on the target itself:
+ *
+ *   PROFILE_ENTER(sd_read);
+ *   ...
+ *   PROFILE_EXIT(sd_read);
+ *
+ * Each zone keeps a count, and the least, most and total cycles spent
+ * in it, in a fixed table of PROFILE_ZONES_MAX zones, which
+ * profile_report writes out a line at a time (to semihosting, a UART or
+ * the TFT console). Zones are named by identifiers, and those with the
+ * same name share their stats wherever they are. They may nest, and be
+ * used in interrupt handlers; a zone which is interrupted counts the
+ * handler's cycles too.
+ *
+ * Zones are compiled in when PROFILE is 1, which it is by default in
+ * debug builds, and compile to nothing otherwise.
+ */
+
+#ifndef __UMDLPC_system_profile_h_
+#define __UMDLPC_system_profile_h_
+
+#include <stdint.h>
+
+#include "UMDLPC/system/delay.h"
+
+#ifndef PROFILE
+#ifdef DEBUG
+#define PROFILE 1
+#else
+#define PROFILE 0
+#endif
+#endif
+
+/* The zones the table holds; further zones aren't counted */
+#ifndef PROFILE_ZONES_MAX
+#define PROFILE_ZONES_MAX 16
+#endif
+
+typedef struct {
+  const char *name;
+  uint32_t count;
+  uint32_t min_cycles, max_cycles;
+  uint64_t total_cycles;
+  uint32_t clock_hz;      /* the CPU clock when last recorded */
+} ProfileZone;
+
+/* Takes each line of a report, ending in '\n' (e.g. console_puts) */
+typedef void (*ProfileWriter)(const char *line);
+
+#if PROFILE
+
+/* PROFILE_ENTER(zone), PROFILE_EXIT(zone)
+ * Start and end timing zone, in the same block. Only the first pass
+ * through each PROFILE_EXIT looks zone up in the table.
+ */
+#define PROFILE_ENTER(zone) \
+  const uint32_t _profile_start_##zone = delay_counter()
+
+#define PROFILE_EXIT(zone) do {                                         \
+    static ProfileZone *_profile_zone;                                  \
+    profile_record(&_profile_zone, #zone,                               \
+                   delay_counter() - _profile_start_##zone);            \
+  } while (0)
+
+#else
+
+#define PROFILE_ENTER(zone) do { } while (0)
+#define PROFILE_EXIT(zone) do { } while (0)
+
+#endif
+
+/* profile_init()
+ * Starts the cycle counter, and measures the cost of timing a zone,
+ * which is taken off every time recorded. Safe to call more than once.
+ */
+void profile_init(void);
+
+/* profile_record(zone, name, cycles)
+ * Adds cycles to the zone named name, which is cached in *zone. For
+ * PROFILE_EXIT.
+ */
+void profile_record(ProfileZone **zone, const char *name, uint32_t cycles);
+
+/* profile_reset()
+ * Zeroes the stats of every zone, keeping the zones.
+ */
+void profile_reset(void);
+
+/* profile_zone(i)
+ * Returns the i'th zone, in the order they were first recorded, or 0
+ * past the last.
+ */
+const ProfileZone *profile_zone(uint_fast8_t i);
+
+/* profile_report(write)
+ * Writes a table of the zones' stats, in cycles and in microseconds at
+ * the CPU clock each zone was last recorded at (so the report may be
+ * made after switching the clock), two lines per zone (after a
+ * heading), to fit the TFT console. Zones not timed since the last
+ * reset are left out, and those which didn't fit in the table are
+ * counted on a last line.
+ */
+void profile_report(ProfileWriter write);
+
+#endif
@@ -0,0 +1,116 @@
+/* sched.h
+ *
+ * Declares a cooperative, run-to-completion scheduler. Work is split
+ * into tasks, each a handler called with the events posted to it since
+ * it last ran. Handlers return rather than block, so one stack serves
+ * every task, and none needs locking against another.
+ *
+ * Events are bits, posted from anywhere, interrupt handlers included;
+ * posts to a task which hasn't run yet are merged. Ready tasks wait in
+ * one FIFO run queue per priority, and the highest priority runs first,
+ * though only once the handler running has returned. With nothing to
+ * run, the core sleeps in WFI.
+ *
+ * Timers post events to a task after a delay, once or periodically.
+ * They're kept in a hashed timer wheel turned by SysTick (see
+ * systick.h), so they're as fine as SYSTICK_HZ, and starting or
+ * stopping one takes the same time however many are running.
+ */
+
+#ifndef __UMDLPC_system_sched_h_
+#define __UMDLPC_system_sched_h_
+
+#include "LPC17xx.h"
+#include <stdint.h>
+
+/* The number of priorities, 0 being the highest */
+#ifndef SCHED_PRIORITIES
+#define SCHED_PRIORITIES 4
+#endif
+
+/* The slots in the timer wheel, a power of 2. Timers due a multiple
+ * of this many ticks apart share a slot.
+ */
+#ifndef SCHED_WHEEL_SLOTS
+#define SCHED_WHEEL_SLOTS 64
+#endif
+
+typedef struct Task Task;
+
+/* Called with the events posted to task since it last ran, never 0 */
+typedef void (*TaskHandler)(Task *task, uint32_t events);
+
+struct Task {
+  TaskHandler handler;
+  uint8_t priority;
+
+  // The scheduler's own
+  volatile uint32_t events;
+  Task *next;
+};
+
+/* TASK(handler, priority)
+ * Initializes a Task, e.g. static Task blink = TASK(blink_run, 1);
+ */
+#define TASK(handler, priority) { (handler), (priority), 0, 0 }
+
+/* A Timer must start zeroed, as static ones do */
+typedef struct Timer Timer;
+
+struct Timer {
+  // The scheduler's own
+  Task *task;
+  uint32_t events;
+  uint32_t due, period;
+  Timer *next, **link;
+};
+
+/* sched_init()
+ * Starts the SysTick timebase, and the timer wheel from now. Safe to
+ * call more than once.
+ */
+void sched_init(void);
+
+/* sched_post(task, events)
+ * Posts events to task, queueing it to run if it isn't queued already.
+ * May be called from interrupt handlers, and from task's own handler,
+ * to have it run again once the tasks queued before it have.
+ */
+void sched_post(Task *task, uint32_t events);
+
+/* sched_dispatch()
+ * Turns the timer wheel up to now, then runs the first task queued at
+ * the highest priority, if any. Returns whether it ran one. For loops
+ * which have more to do than the scheduler's tasks; sched_run is the
+ * whole loop otherwise.
+ */
+uint_fast8_t sched_dispatch(void);
+
+/* sched_run()
+ * Dispatches tasks forever, sleeping in WFI while there are none to
+ * run. SysTick wakes the core each tick to turn the timer wheel.
+ */
+void sched_run(void) __attribute__((noreturn));
+
+/* sched_timer_start(timer, task, events, delay_ms, period_ms)
+ * Posts events to task delay_ms from now, then every period_ms after
+ * that, unless period_ms is 0. Times are rounded up to whole ticks, and
+ * count from the start of the current one, so the first post may come
+ * up to a tick early. A timer already running is restarted. Not to be
+ * called from interrupt handlers.
+ */
+void sched_timer_start(Timer *timer, Task *task, uint32_t events,
+                       uint32_t delay_ms, uint32_t period_ms);
+
+/* sched_timer_stop(timer)
+ * Stops timer, if it's running. Events it already posted stay posted.
+ * Not to be called from interrupt handlers.
+ */
+void sched_timer_stop(Timer *timer);
+
+/* sched_timer_running(timer)
+ * Returns whether timer has yet to fire, or is periodic.
+ */
+uint_fast8_t sched_timer_running(const Timer *timer);
+
+#endif
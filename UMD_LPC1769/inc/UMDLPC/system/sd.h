@@ -7,6 +7,7 @@
 
 #include "UMDLPC/system/dma.h"
 #include "UMDLPC/system/spi.h"
+#include "UMDLPC/system/systick.h"
 #include "../inc/LPC17xx.h"
 #include "../inc/core_cm3.h"
 
@@ -15,18 +16,41 @@
 #define SD_MAX_RESET_TRIES 100
 #define SD_INVALID_SECTOR 0xFFFFFFFF
 
+// How long the card may take before it's given up on, from the SD
+// spec's limits: initialization within 1s, reads within 100ms, and
+// writes (busy) within 250ms, or 500ms for SDXC cards
+#define SD_INIT_TIMEOUT_MS 1000
+#define SD_READ_TIMEOUT_MS 100
+#define SD_WRITE_TIMEOUT_MS 500
+
 #define GPIO_SD_CS_m (1<<6) // 498A: Defined as P0
 
+/* sd_init()
+ * Brings the card up and switches to the fast clock. Returns 0, or a
+ * negative number if the card didn't respond (-1), has the wrong
+ * voltage range (-2), failed to initialize (-3) or didn't finish
+ * within SD_INIT_TIMEOUT_MS (-4).
+ */
 int sd_init();
 void sd_command(uint8_t index, uint8_t a1, uint8_t a2,
                 uint8_t a3, uint8_t a4, uint8_t crc,
                 uint8_t* response, uint16_t response_len);
+
+/* sd_read_block(block, block_num), sd_write_block(block, block_num)
+ * Transfer one SD_BLOCK_LEN block. Return 1, or 0 if the card refused
+ * the command or took longer than its timeout, in which case the card
+ * is deselected.
+ */
 char sd_read_block(uint8_t* block, uint32_t block_num);
 char sd_write_block(uint8_t* block, uint32_t block_num);
 
 /***************************************************************
  * WARNING: These DMA transfer functions are a work in progress,
  *          they do NOT work yet.
+ *
+ * The caller sleeps until the transfer completes, woken by the DMA
+ * terminal count interrupt. Applications that enable DMA_IRQn in the
+ * NVIC must only act on their own channels in DMA_IRQHandler.
  ***************************************************************/
 char sd_read_block_dma(uint8_t* block, uint32_t block_num,
                        LPC_GPDMACH_TypeDef * const channel);
@@ -0,0 +1,77 @@
+/* semihost.h
+ *
+ * Declares buffered output to the debugger's console over semihosting.
+ * Each semihosting call halts the core until the debugger has handled
+ * it, which takes milliseconds, so output is gathered in RAM and only
+ * written (with one SYS_WRITE) when the buffer fills, or on
+ * semihost_flush. Formatting is with format.h's integer only printf,
+ * rather than newlib's.
+ *
+ * Files may also be written on the host, unbuffered, with
+ * semihost_file_open.
+ *
+ * Output is dropped while no debugger is attached, as a semihosting
+ * call would then fault. Unlike newlib's semihosted stdio, this needs
+ * no semihosting libraries linked in.
+ */
+
+#ifndef __UMDLPC_system_semihost_h_
+#define __UMDLPC_system_semihost_h_
+
+#include "LPC17xx.h"
+#include <stdint.h>
+
+/* The buffer, which is written out whenever it fills */
+#ifndef SEMIHOST_BUFFER_LEN
+#define SEMIHOST_BUFFER_LEN 512
+#endif
+
+/* semihost_attached()
+ * Returns whether a debugger is attached, so that semihosting calls
+ * can be made.
+ */
+uint_fast8_t semihost_attached(void);
+
+/* semihost_putc(c), semihost_puts(s), semihost_write(data, length)
+ * Add to the output. semihost_puts, like console_puts, doesn't add a
+ * '\n'. May be called from interrupt handlers, though one which fills
+ * the buffer halts the core to write it.
+ */
+void semihost_putc(char c);
+void semihost_puts(const char *s);
+void semihost_write(const char *data, uint32_t length);
+
+/* semihost_printf(fmt, ...)
+ * Formats into the output (see format.h). Returns the number of
+ * characters.
+ */
+uint32_t semihost_printf(const char *fmt, ...)
+  __attribute__((format(printf, 1, 2)));
+
+/* semihost_flush()
+ * Writes out what the buffer holds, halting the core while the
+ * debugger takes it.
+ */
+void semihost_flush(void);
+
+/* semihost_file_open(name)
+ * Creates (or truncates) the file name in the debugger's working
+ * directory, for binary output. Returns its handle, or -1 if it can't
+ * be opened, or no debugger is attached.
+ */
+int32_t semihost_file_open(const char *name);
+
+/* semihost_file_write(file, data, length)
+ * Writes length bytes to file, halting the core while the debugger
+ * does. Returns whether they were all written; nothing is written once
+ * the debugger has gone.
+ */
+uint_fast8_t semihost_file_write(int32_t file, const void *data,
+                                 uint32_t length);
+
+/* semihost_file_close(file)
+ * Closes a file from semihost_file_open. Does nothing given -1.
+ */
+void semihost_file_close(int32_t file);
+
+#endif
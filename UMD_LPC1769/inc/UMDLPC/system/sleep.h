@@ -0,0 +1,114 @@
+/* sleep.h
+ *
+ * Declares primitives for putting the core to sleep (WFI/WFE) until
+ * an interrupt signals that an awaited condition has come true,
+ * instead of spinning on that condition at 100% CPU. See chapter 4
+ * (4.8 in particular) for the power modes.
+ *
+ * The Repetitive Interrupt Timer (chapter 22) is left free running
+ * at the CPU clock, and is used both to wake the core after timed
+ * delays and to account for how many cycles were spent asleep.
+ */
+
+#ifndef __UMDLPC_system_sleep_h_
+#define __UMDLPC_system_sleep_h_
+
+#include "LPC17xx.h"
+#include <stdint.h>
+
+/* Delays shorter than this are spun out on the counter, since the
+ * RIT could pass the compare value before we get to sleep.
+ */
+#define SLEEP_MIN_CYCLES 64
+
+/* An event is a flag raised from an interrupt handler (with
+ * event_signal) and consumed by the code waiting on it.
+ */
+typedef volatile uint32_t Event;
+
+typedef struct {
+  uint64_t slept_cycles;  /* cycles spent inside WFI/WFE */
+  uint64_t total_cycles;  /* cycles since the last sleep_stats_reset */
+  uint32_t sleeps;        /* number of times the core was put to sleep */
+} SleepStats;
+
+/* sleep_init()
+ * Powers the RIT and starts it free running at the CPU clock, and
+ * enables SEVONPEND so that peripheral interrupts wake WFE even when
+ * they are disabled in the NVIC. Safe to call more than once.
+ */
+void sleep_init(void);
+
+/* sleep_wfi()
+ * Sleep until an interrupt is taken. Meant to be called with
+ * interrupts masked (see SLEEP_UNTIL): a pending interrupt still
+ * wakes the core, and runs once the mask is lifted.
+ */
+void sleep_wfi(void);
+
+/* sleep_wfe()
+ * Sleep until an event is signalled. With SEVONPEND set, any
+ * interrupt becoming pending counts as an event.
+ */
+void sleep_wfe(void);
+
+/* SLEEP_UNTIL(cond)
+ * Sleeps until cond, which must be made true by an interrupt
+ * handler. Interrupts are masked while cond is tested, so an
+ * interrupt landing between the test and the WFI cannot be missed.
+ */
+#define SLEEP_UNTIL(cond) do {                  \
+    uint32_t _sleep_primask = __get_PRIMASK();  \
+    __disable_irq();                            \
+    while (!(cond)) {                           \
+      sleep_wfi();                              \
+      __enable_irq();                           \
+      __disable_irq();                          \
+    }                                           \
+    __set_PRIMASK(_sleep_primask);              \
+  } while (0)
+
+/* SLEEP_UNTIL_PENDING(cond)
+ * Sleeps until cond, for conditions set by hardware which also pends
+ * an interrupt when it happens (e.g. a DMA terminal count with the
+ * DMA interrupt disabled in the NVIC). The event register latches
+ * the wakeup, so there is no race between test and WFE.
+ */
+#define SLEEP_UNTIL_PENDING(cond) do {          \
+    while (!(cond)) {                           \
+      sleep_wfe();                              \
+    }                                           \
+  } while (0)
+
+/* event_signal(e)
+ * Raise e from an interrupt handler.
+ */
+void event_signal(Event *e);
+
+/* event_wait(e)
+ * Sleep until e is raised, then clear it.
+ */
+void event_wait(Event *e);
+
+/* sleep_delay_cycles(cycles), sleep_delay_us(us), sleep_delay_ms(ms)
+ * Sleep for at least the given time, woken by the RIT. Not to be
+ * used from interrupt handlers.
+ */
+void sleep_delay_cycles(uint32_t cycles);
+void sleep_delay_us(uint32_t us);
+void sleep_delay_ms(uint32_t ms);
+
+/* sleep_counter()
+ * Returns the free running cycle counter.
+ */
+uint32_t sleep_counter(void);
+
+/* sleep_stats(stats), sleep_stats_reset()
+ * Read or reset the account of cycles slept vs. total cycles; the
+ * busy cycles are the difference. Stats must be read at least once
+ * per 2^32 cycles for total_cycles to be correct.
+ */
+void sleep_stats(SleepStats *stats);
+void sleep_stats_reset(void);
+
+#endif
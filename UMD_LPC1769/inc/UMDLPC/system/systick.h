@@ -1,34 +1,56 @@
 /* systick.h
  *
- * Declares functions to configure the System Tick timer (chapter 23). The
+ * Declares a monotonic timebase on the System Tick timer (chapter 23),
+ * and deadlines for bounding waits on hardware by time rather than by
+ * a count of tries.
  *
+ * SysTick interrupts at SYSTICK_HZ, counting ticks into 64 bits, which
+ * never wrap. Microsecond reads add in how far the current tick has
+ * counted down, so they're as fine as the CPU clock allows. The tick
+ * follows CPU clock switches (see clocking.h).
  */
 
-#ifndef __UMDLPC_system_clocking_h_
-#define __UMDLPC_system_clocking_h_
+#ifndef __UMDLPC_system_systick_h_
+#define __UMDLPC_system_systick_h_
 
 #include "LPC17xx.h"
-#include <cr_section_macros.h>
-#include <NXP/crp.h>
 #include <stdint.h>
 
-#include "assert.h"
+/* The tick rate, which must divide 1MHz, and be at least 200Hz */
+#ifndef SYSTICK_HZ
+#define SYSTICK_HZ 1000
+#endif
+
+/* systick_init()
+ * Starts SysTick interrupting at SYSTICK_HZ, at the lowest priority,
+ * from a count of 0. Safe to call more than once; later calls leave
+ * the count running.
+ */
+void systick_init(void);
 
-/* PLL_init(m, n, cclkdiv)
- * Takes multiplier (m), divider (n) and CPU clock divider (cclkdiv)
- * and initializes the PLL with those settings.
+/* systick_ticks()
+ * Returns the number of ticks since systick_init.
  */
-void PLL_init(uint_fast16_t m, uint_fast16_t n, uint_fast16_t cclkdiv);
+uint64_t systick_ticks(void);
 
-/* PLL_bypass()
- * Disconnect the PLL
+/* systick_us()
+ * Returns the microseconds since systick_init. Never goes backwards,
+ * and may be called from interrupt handlers, even with interrupts
+ * masked (a tick which is due but not yet handled is counted).
  */
-void PLL_bypass();
+uint64_t systick_us(void);
 
-enum ClockSource {
-  INTERNAL_RC = 0,
-  MAIN_OSCILLATOR = 1,
-  RTC_OSCILLATOR = 2
-};
+/* systick_deadline_us(us), systick_deadline_ms(ms)
+ * Returns the time (as from systick_us) the given time from now,
+ * starting the timebase first if need be, so that a deadline always
+ * comes.
+ */
+uint64_t systick_deadline_us(uint32_t us);
+uint64_t systick_deadline_ms(uint32_t ms);
+
+/* systick_expired(deadline)
+ * Returns whether deadline has passed.
+ */
+uint_fast8_t systick_expired(uint64_t deadline);
 
 #endif
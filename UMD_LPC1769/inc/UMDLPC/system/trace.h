@@ -0,0 +1,162 @@
+/* trace.h
+ *
+ * Declares a binary event trace, for seeing what order things happened
+ * in (interrupts, SD card commands, buffer swaps) without halting the
+ * core as printf over semihosting does. Each event is an id, a 32 bit
+ * argument, the DWT cycle count (see delay.h) and the exception it was
+ * recorded in, stored in a RAM ring of TRACE_EVENTS events which keeps
+ * the latest. Recording one takes a few dozen cycles, with interrupts
+ * masked.
+ *
+ * trace_dump writes the ring out in the format below, which
+ * TraceDecoder turns into Chrome trace event JSON (for chrome://tracing
+ * or Perfetto). Ids may be marked TRACE_BEGIN or TRACE_END, for spans
+ * of time, and are given names with trace_name.
+ *
+ * Events are compiled in when TRACING is 1, which it is by default in
+ * debug builds, and compile to nothing otherwise.
+ */
+
+#ifndef __UMDLPC_system_trace_h_
+#define __UMDLPC_system_trace_h_
+
+#include "LPC17xx.h"
+#include <stdint.h>
+
+#include "UMDLPC/system/delay.h"
+
+#ifndef TRACING
+#ifdef DEBUG
+#define TRACING 1
+#else
+#define TRACING 0
+#endif
+#endif
+
+/* The events the ring holds, a power of 2 */
+#ifndef TRACE_EVENTS
+#define TRACE_EVENTS 256
+#endif
+
+/* The ids which may be named */
+#ifndef TRACE_NAMES_MAX
+#define TRACE_NAMES_MAX 32
+#endif
+
+/* Flags on an id, for the start and end of a span */
+#define TRACE_BEGIN 0x8000
+#define TRACE_END 0x4000
+#define TRACE_ID_MASK 0x3FFF
+
+/* The library's ids; applications number theirs from TRACE_USER */
+enum {
+  TRACE_CLOCK = 1,      /* CPU clock switched; arg is the clock before */
+  TRACE_SD_READ = 2,    /* span: arg is the block, then success */
+  TRACE_SD_WRITE = 3,   /* span: arg is the block, then success */
+  TRACE_USER = 0x100
+};
+
+typedef struct {
+  uint32_t cycles;      /* DWT_CYCCNT */
+  uint16_t id;          /* with TRACE_BEGIN or TRACE_END */
+  uint16_t exception;   /* IPSR: 0 in thread mode, 16 + n in IRQ n */
+  uint32_t arg;
+} TraceEvent;
+
+/* A dump, all little endian, is a TraceHeader, then its names names
+ * (each a uint16_t id, a uint16_t length and that many chars), then its
+ * count TraceEvents, oldest first.
+ *
+ * The cycles between two events pass at the clock in effect after the
+ * first. A TRACE_CLOCK event's arg is the clock before it, and clock_hz
+ * the clock at the dump, so the clocks are known going back from the
+ * newest event, whichever events were overwritten. Cycle counts wrap,
+ * so events must come less than 2^32 cycles apart.
+ */
+#define TRACE_MAGIC 0x45435254  /* "TRCE" */
+#define TRACE_VERSION 1
+
+typedef struct {
+  uint32_t magic;
+  uint16_t version;
+  uint16_t names;
+  uint32_t count;       /* events in the dump */
+  uint32_t lost;        /* events overwritten before it */
+  uint32_t clock_hz;
+} TraceHeader;
+
+/* Takes each part of a dump (e.g. an fwrite to a semihosted file) */
+typedef void (*TraceWriter)(const void *data, uint32_t length);
+
+/* For trace_event; not to be used directly */
+extern TraceEvent trace_ring[TRACE_EVENTS];
+extern uint32_t trace_total;
+extern volatile uint_fast8_t trace_running;
+
+/* trace_event(id, arg)
+ * Records an event, if the trace is running. May be called from
+ * interrupt handlers.
+ */
+inline static void trace_event(uint16_t id, uint32_t arg) {
+  const uint32_t primask = __get_PRIMASK();
+  TraceEvent *event;
+
+  __disable_irq();
+  if (trace_running) {
+    event = &trace_ring[trace_total++ & (TRACE_EVENTS - 1)];
+    event->cycles = DWT_CYCCNT;
+    event->id = id;
+    event->exception = __get_IPSR();
+    event->arg = arg;
+  }
+  __set_PRIMASK(primask);
+}
+
+#if TRACING
+
+/* TRACE(id, arg), TRACE_BEGIN_SPAN(id, arg), TRACE_END_SPAN(id, arg)
+ * Record an event at an instant, or the start or end of a span
+ */
+#define TRACE(id, arg) trace_event((id), (arg))
+#define TRACE_BEGIN_SPAN(id, arg) trace_event((id) | TRACE_BEGIN, (arg))
+#define TRACE_END_SPAN(id, arg) trace_event((id) | TRACE_END, (arg))
+
+#else
+
+#define TRACE(id, arg) do { } while (0)
+#define TRACE_BEGIN_SPAN(id, arg) do { } while (0)
+#define TRACE_END_SPAN(id, arg) do { } while (0)
+
+#endif
+
+/* trace_init()
+ * Starts the cycle counter and the trace, from empty, and names the
+ * library's ids. CPU clock switches are traced from then on.
+ */
+void trace_init(void);
+
+/* trace_name(id, name)
+ * Names id (without flags) in dumps. Returns 0 if TRACE_NAMES_MAX ids
+ * are named already.
+ */
+uint_fast8_t trace_name(uint16_t id, const char *name);
+
+/* trace_stop(), trace_start()
+ * Stop and restart recording, e.g. to keep the events leading up to a
+ * fault from being overwritten before they can be dumped.
+ */
+void trace_stop(void);
+void trace_start(void);
+
+/* trace_clear()
+ * Empties the ring.
+ */
+void trace_clear(void);
+
+/* trace_dump(write)
+ * Writes out the ring, oldest event first. Recording is stopped while
+ * it does, and restarted after if it was running.
+ */
+void trace_dump(TraceWriter write);
+
+#endif
@@ -0,0 +1,167 @@
+/* uart.h
+ *
+ * Declares a driver for UART0-3 (chapters 14 and 15), 8N1, which moves
+ * data through RAM rings by GPDMA (chapter 31) so the CPU only touches
+ * it to fill or empty the rings.
+ *
+ * Transmit: bytes written to the TX ring are sent a contiguous chunk at
+ * a time by the UART's TX channel. When a chunk has gone, the UART's
+ * THRE interrupt starts the next, so the DMA interrupt is left to the
+ * application. uart_reserve and uart_commit let data be built in place
+ * in the ring, without a copy.
+ *
+ * Receive: the RX channel fills the RX ring round and round, 8 bytes at
+ * a time, as the FIFO reaches its trigger level of 14. When the line
+ * goes idle, the character timeout interrupt has the DMA take what's
+ * left in the FIFO too, then calls the on_idle handler, so a message is
+ * complete in the ring by the time it's called. The ring must be read
+ * faster than it fills, as the DMA can't be stopped from overwriting
+ * it: each interrupt counts what the DMA has written since the last,
+ * and if it has gone past the oldest unread byte, that's an overrun
+ * (see uart_overruns). The unread bytes, partly overwritten, are then
+ * dropped, and reading goes on from the next byte received. Overruns
+ * are only seen while the UART's interrupt isn't held off for as long
+ * as the ring takes to fill.
+ *
+ * The baud rate is made from the CPU clock by the integer and
+ * fractional dividers (14.4.12), and set again for each clock switch.
+ *
+ * The pins used are
+ *   UART0: P0.2 TXD0, P0.3 RXD0
+ *   UART1: P2.0 TXD1, P2.1 RXD1 (P0.15 and P0.16 being SSP0's)
+ *   UART2: P0.10 TXD2, P0.11 RXD2
+ *   UART3: P0.0 TXD3, P0.1 RXD3
+ */
+
+#ifndef __UMDLPC_system_uart_h_
+#define __UMDLPC_system_uart_h_
+
+#include "LPC17xx.h"
+#include <stdint.h>
+
+#include "UMDLPC/system/dma.h"
+
+/* The largest RX ring, one DMA transfer */
+#define UART_RX_RING_MAX 4095
+
+typedef struct Uart Uart;
+
+/* Called from the UART interrupt when received data has gone idle */
+typedef void (*UartHandler)(Uart *uart);
+
+typedef struct {
+  uint16_t divisor;      /* DLM:DLL, at least 3 with a fraction */
+  uint8_t divaddval;     /* 0 to mulval - 1 */
+  uint8_t mulval;        /* 1 to 15 */
+} UartDivider;
+
+struct Uart {
+  uint8_t port;
+  uint8_t *tx_ring;
+  uint32_t tx_size;
+  uint8_t *rx_ring;
+  uint32_t rx_size;
+  LPC_GPDMACH_TypeDef *tx_channel, *rx_channel;
+  UartHandler on_idle;
+
+  // The driver's own
+  LPC_UART_TypeDef *regs;
+  uint32_t baud;
+  volatile uint32_t tx_head, tx_tail, tx_sending;
+  uint32_t rx_tail, rx_seen, rx_unread, rx_peeked;
+  volatile uint32_t rx_errors, rx_overruns;
+  DMALinkedListNode rx_node;
+};
+
+/* UART(port, tx_ring, rx_ring, tx_channel, rx_channel, on_idle)
+ * Initializes a Uart for port 0-3, with the arrays tx_ring, whose size
+ * must be a power of 2, and rx_ring, of up to UART_RX_RING_MAX bytes,
+ * and two GPDMA channels of its own. on_idle may be 0. E.g.
+ *   static uint8_t tx[1024], rx[256];
+ *   static Uart export = UART(2, tx, rx, LPC_GPDMACH2, LPC_GPDMACH3, 0);
+ */
+#define UART(port, tx_ring, rx_ring, tx_channel, rx_channel, on_idle)  \
+  { (port), (tx_ring), sizeof (tx_ring), (rx_ring), sizeof (rx_ring),  \
+    (tx_channel), (rx_channel), (on_idle) }
+
+/* uart_baud_solve(pclk_hz, baud, divider)
+ * Finds the dividers giving the rate closest to baud from a pclk_hz
+ * peripheral clock, i.e. pclk_hz / (16 * divisor * (1 + divaddval /
+ * mulval)). Ties go to the simplest fraction. Returns the rate, or 0 if
+ * baud is out of reach.
+ */
+uint32_t uart_baud_solve(uint32_t pclk_hz, uint32_t baud,
+                         UartDivider *divider);
+
+/* uart_init(uart, baud)
+ * Powers uart's port, selects its pins, sets the rate closest to baud
+ * and starts receiving. Returns the rate, or 0 (leaving the port off)
+ * if baud is out of reach or the rings' sizes aren't allowed.
+ */
+uint32_t uart_init(Uart *uart, uint32_t baud);
+
+/* uart_set_baud(uart, baud)
+ * Changes the rate, once everything written has been sent. Returns the
+ * rate, or 0 (leaving it as it was) if baud is out of reach.
+ */
+uint32_t uart_set_baud(Uart *uart, uint32_t baud);
+
+/* uart_reserve(uart, length)
+ * Returns where the next bytes to send may be written in the TX ring,
+ * and sets *length to how many fit there, up to the end of the ring;
+ * *length may be 0 while the ring is full. The bytes go nowhere until
+ * committed.
+ */
+uint8_t *uart_reserve(Uart *uart, uint32_t *length);
+
+/* uart_commit(uart, length)
+ * Sends length bytes written where uart_reserve said, no more than it
+ * allowed.
+ */
+void uart_commit(Uart *uart, uint32_t length);
+
+/* uart_write(uart, data, length)
+ * Copies length bytes into the TX ring to be sent, sleeping while it's
+ * full. Not to be called from interrupt handlers.
+ */
+void uart_write(Uart *uart, const void *data, uint32_t length);
+
+/* uart_flush(uart)
+ * Sleeps until everything written has been sent, to the last stop bit.
+ * Not to be called from interrupt handlers.
+ */
+void uart_flush(Uart *uart);
+
+/* uart_peek(uart, data)
+ * Points *data at the oldest unread byte in the RX ring, and returns how
+ * many follow it contiguously, up to the end of the ring.
+ */
+uint32_t uart_peek(Uart *uart, const uint8_t **data);
+
+/* uart_consume(uart, length)
+ * Marks length bytes, no more than uart_peek returned, as read. Returns
+ * 0, marking nothing, if an overrun since the peek has dropped them (so
+ * they may have been overwritten while being looked at).
+ */
+uint_fast8_t uart_consume(Uart *uart, uint32_t length);
+
+/* uart_read(uart, data, length)
+ * Copies up to length unread bytes to data, returning how many. Doesn't
+ * wait for any. If uart_overruns counts one meanwhile, bytes were lost
+ * between those copied.
+ */
+uint32_t uart_read(Uart *uart, void *data, uint32_t length);
+
+/* uart_errors(uart)
+ * Returns how many overrun, parity, framing or break errors have been
+ * seen.
+ */
+uint32_t uart_errors(const Uart *uart);
+
+/* uart_overruns(uart)
+ * Returns how many times the RX ring has been overwritten before being
+ * read, losing what was unread.
+ */
+uint32_t uart_overruns(const Uart *uart);
+
+#endif
@@ -0,0 +1,46 @@
+/* fft.h
+ *
+ * Declares an in-place fixed point (Q15) FFT, for looking at the
+ * spectrum of sampled audio, and a Hann window stage which takes its
+ * input straight from ADC data register values (e.g. an ADC DMA
+ * buffer).
+ *
+ * The transform is decimation in time, with the input put in bit
+ * reversed order first, and then done in radix-4 passes (each the
+ * same as two radix-2 passes, with three complex multiplies per
+ * butterfly instead of four). Sizes with an odd number of bits, like
+ * 512, start with one radix-2 pass, which needs no multiplies.
+ *
+ * Each pass scales its output down (by 2 or 4) so nothing overflows,
+ * so the result is the DFT divided by the number of points.
+ */
+
+#ifndef __UMDLPC_util_fft_h_
+#define __UMDLPC_util_fft_h_
+
+#include <stdint.h>
+
+/* The largest transform. Twiddle factors are taken from a table of
+ * one quarter of a sine wave of this many points.
+ */
+#define FFT_MAX_POINTS 1024
+
+typedef struct {
+  int16_t re, im;
+} Q15Complex;
+
+/* fft_q15(data, n)
+ * Transforms n points of data in place. n must be a power of 2 from
+ * 4 to FFT_MAX_POINTS (256, 512 and 1024 being the useful ones for
+ * audio). Returns 0 if n is not, 1 otherwise.
+ */
+char fft_q15(Q15Complex *data, uint16_t n);
+
+/* fft_window(samples, data, n)
+ * Fills data with n ADC results (bits 15:4 of each sample), less
+ * their mean and under a Hann window, as Q15 with 3 bits of headroom.
+ * n must be a power of 2 no greater than FFT_MAX_POINTS.
+ */
+void fft_window(const uint32_t *samples, Q15Complex *data, uint16_t n);
+
+#endif
@@ -0,0 +1,33 @@
+/* format.h
+ *
+ * Declares a small, integer only printf, for output where newlib's
+ * printf costs too much code, stack or time. It handles %d, %i, %u,
+ * %x, %X, %c, %s, %p and %%, with the '-' and '0' flags, a width, a
+ * precision for %s, and 'l'. There is no floating point.
+ */
+
+#ifndef __UMDLPC_util_format_h_
+#define __UMDLPC_util_format_h_
+
+#include <stdarg.h>
+#include <stdint.h>
+
+/* Takes each character formatted, along with the context passed in */
+typedef void (*FormatPut)(char c, void *context);
+
+/* format_v(put, context, fmt, args)
+ * Formats args by fmt, passing each character to put. Returns the
+ * number of characters.
+ */
+uint32_t format_v(FormatPut put, void *context, const char *fmt,
+                  va_list args);
+
+/* format_string(buffer, size, fmt, ...)
+ * Formats into buffer, as snprintf: at most size - 1 characters and a
+ * '\0' (if size isn't 0). Returns the number of characters the whole
+ * output takes.
+ */
+uint32_t format_string(char *buffer, uint32_t size, const char *fmt, ...)
+  __attribute__((format(printf, 3, 4)));
+
+#endif
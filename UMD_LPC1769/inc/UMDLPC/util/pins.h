@@ -11,6 +11,12 @@
  *  PIN_NAME_OUTPUT() to make the pin an output
  *  PIN_NAME_READ() to read the current state of the pin
  *                  (returns a 1 or 0, typed as a uint_fast8_t)
+ *  PIN_NAME_PORT_NUM, PIN_NAME_PIN_NUM as constants, for setting up
+ *                  things like the pin's GPIO interrupt
+ *
+ * Pins are set and cleared with plain writes to FIOSET/FIOCLR, which
+ * only affect the bits written as 1, so that an interrupt handler
+ * driving other pins of the same port can't have its changes undone.
  */
 
 #ifndef __UMDLPC_util_pins_h_
@@ -20,22 +26,22 @@
 
 #define DEFINE_PIN(name, port, pin) \
 inline static void name##_DEASSERT() { \
-  LPC_GPIO##port ->FIOCLR |= (1 << pin); \
+  LPC_GPIO##port ->FIOCLR = (1 << pin); \
 } \
 inline static void name##_OFF() { \
-  LPC_GPIO##port ->FIOCLR |= (1 << pin); \
+  LPC_GPIO##port ->FIOCLR = (1 << pin); \
 } \
 inline static void name##_LOW() { \
-  LPC_GPIO##port ->FIOCLR |= (1 << pin); \
+  LPC_GPIO##port ->FIOCLR = (1 << pin); \
 } \
 inline static void name##_ASSERT() { \
-  LPC_GPIO##port ->FIOSET |= (1 << pin); \
+  LPC_GPIO##port ->FIOSET = (1 << pin); \
 } \
 inline static void name##_ON() { \
-  LPC_GPIO##port ->FIOSET |= (1 << pin); \
+  LPC_GPIO##port ->FIOSET = (1 << pin); \
 } \
 inline static void name##_HIGH() { \
-  LPC_GPIO##port ->FIOSET |= (1 << pin); \
+  LPC_GPIO##port ->FIOSET = (1 << pin); \
 } \
 inline static void name##_TOGGLE() { \
   LPC_GPIO##port ->FIOPIN ^= (1 << pin); \
@@ -47,7 +53,8 @@ inline static void name##_OUTPUT() { \
   LPC_GPIO##port ->FIODIR |= (1 << pin); \
 } \
 inline static uint_fast8_t name##_READ() { \
-  return ( LPC_GPIO##port ->FIOPIN0 >> pin) & 1; \
-}
+  return ( LPC_GPIO##port ->FIOPIN >> pin) & 1; \
+} \
+enum { name##_PORT_NUM = port, name##_PIN_NUM = pin }
 
 #endif
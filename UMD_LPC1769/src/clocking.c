@@ -7,38 +7,239 @@
 
 #include "UMDLPC/system/clocking.h"
 
-// m should be in range [6, 512]
-// n should be in range [1, 128]
-// cclkdiv should be in range [1, 256]
-void PLL_init(uint_fast16_t m, uint_fast16_t n, uint_fast16_t cclkdiv) {
-  // PLL 0 Setup
-  // F_CCO = (2 * m * CLOCK_SOURCE_FREQ)/n
-  LPC_SC ->PLL0CFG = (m - 1) | ((n - 1) << 16);
+// PLL0CON bits
+#define PLLE0 (1 << 0)  // enable
+#define PLLC0 (1 << 1)  // connect
+
+// PLL0STAT bits
+#define PLLE0_STAT (1 << 24)
+#define PLLC0_STAT (1 << 25)
+#define PLOCK0 (1 << 26)
+
+// SCS bits
+#define OSCEN (1 << 5)
+#define OSCSTAT (1 << 6)
+
+// FLASHCFG: the access time, in CPU clocks less 1, is at bits 15:12.
+// Each clock covers 20MHz, and 6 clocks are safe at any speed.
+#define FLASHTIM_SHIFT 12
+#define FLASHTIM_SAFE 5
+#define FLASHTIM_HZ 20000000
+
+// The feed sequence makes PLL0CON and PLL0CFG changes take effect; it
+// mustn't be interrupted
+void static feed(void) {
+  const uint32_t primask = __get_PRIMASK();
+
+  __disable_irq();
+  LPC_SC->PLL0FEED = 0xAA;
+  LPC_SC->PLL0FEED = 0x55;
+  __set_PRIMASK(primask);
+}
+
+void static set_flash_time(uint32_t flashtim) {
+  LPC_SC->FLASHCFG = (LPC_SC->FLASHCFG & ~(0xF << FLASHTIM_SHIFT))
+                     | (flashtim << FLASHTIM_SHIFT);
+}
+
+static ClockChangeHandler handlers[CLOCK_HANDLERS_MAX];
+static uint_fast8_t handler_count;
+
+void static notify(void) {
+  uint_fast8_t i;
+
+  for (i = 0; i < handler_count; ++i) {
+    handlers[i](SystemCoreClock);
+  }
+}
+
+uint64_t static gcd(uint64_t a, uint64_t b) {
+  while (b) {
+    uint64_t t = a % b;
+    a = b;
+    b = t;
+  }
+  return a;
+}
+
+uint32_t PLL_solve(uint32_t source_hz, uint32_t cclk_hz,
+                   uint32_t multiple_hz, PLLConfig *config) {
+  // F_CCO * n, per unit of m
+  const uint64_t per_m = 2ULL * source_hz;
+  uint64_t best_error = UINT64_MAX, best_fcco = 0;
+  uint32_t best = 0, n, cclkdiv;
+
+  for (n = PLL_N_MIN; n <= PLL_N_MAX; ++n) {
+    for (cclkdiv = PLL_CCLKDIV_MIN; cclkdiv <= PLL_CCLKDIV_MAX; ++cclkdiv) {
+      const uint64_t divider = (uint64_t) n * cclkdiv;
+      uint64_t step = 1, m;
+      uint_fast8_t i;
+
+      // The CPU clock, 2 * m * source / divider, is a multiple of
+      // multiple_hz when 2 * m * source is a multiple of divider *
+      // multiple_hz, so when m is a multiple of step
+      if (multiple_hz) {
+        step = divider * multiple_hz / gcd(per_m, divider * multiple_hz);
+      }
+
+      // The multiples of step either side of the m giving cclk_hz
+      m = cclk_hz * divider / per_m;
+      m -= m % step;
+
+      for (i = 0; i < 2; ++i, m += step) {
+        const uint64_t fcco = per_m * m / n, cclk = per_m * m / divider;
+        const uint64_t error = (cclk > cclk_hz) ? cclk - cclk_hz
+                                                : cclk_hz - cclk;
+
+        if (m < PLL_M_MIN || m > PLL_M_MAX
+            || fcco < PLL_FCCO_MIN_HZ || fcco > PLL_FCCO_MAX_HZ
+            || cclk > PLL_CCLK_MAX_HZ) {
+          continue;
+        }
+
+        if (error < best_error
+            || (error == best_error && fcco < best_fcco)) {
+          best_error = error;
+          best_fcco = fcco;
+          best = cclk;
+          config->m = m;
+          config->n = n;
+          config->cclkdiv = cclkdiv;
+        }
+      }
+    }
+  }
+
+  return best;
+}
+
+void PLL_configure(enum ClockSource source, const PLLConfig *config) {
+  const uint32_t primask = __get_PRIMASK();
+
+  // Slow flash access down to what is safe at any clock, until the new
+  // clock is known
+  set_flash_time(FLASHTIM_SAFE);
+
+  // Disconnect, then disable PLL0, each with its own feed
+  if (LPC_SC->PLL0STAT & PLLC0_STAT) {
+    LPC_SC->PLL0CON = PLLE0;
+    feed();
+  }
+  LPC_SC->PLL0CON = 0;
+  feed();
+
+  // The main oscillator is off after reset
+  if (source == MAIN_OSCILLATOR && !(LPC_SC->SCS & OSCSTAT)) {
+    LPC_SC->SCS |= OSCEN;
+    while (!(LPC_SC->SCS & OSCSTAT))
+      ;
+  }
+  LPC_SC->CLKSRCSEL = source;
+
+  LPC_SC->PLL0CFG = (config->m - 1) | ((config->n - 1) << 16);
+  feed();
 
   // Enable PLL0
-  LPC_SC ->PLL0CON = 0x01;
+  LPC_SC->PLL0CON = PLLE0;
+  feed();
 
-  LPC_SC ->PLL0FEED = 0xAA;
-  LPC_SC ->PLL0FEED = 0x55;
+  LPC_SC->CCLKCFG = config->cclkdiv - 1;
 
   // Wait for PLL0 Lock
-  while (!(LPC_SC ->PLL0STAT & (1 << 26)))
+  while (!(LPC_SC->PLL0STAT & PLOCK0))
     ;
 
-  LPC_SC ->CCLKCFG = (cclkdiv - 1);
-
   // Connect PLL0
-  LPC_SC ->PLL0CON = 0x03;
+  LPC_SC->PLL0CON = PLLE0 | PLLC0;
+  feed();
+  while ((LPC_SC->PLL0STAT & (PLLE0_STAT | PLLC0_STAT))
+         != (PLLE0_STAT | PLLC0_STAT))
+    ;
+
+  SystemCoreClockUpdate();
+  set_flash_time((SystemCoreClock - 1) / FLASHTIM_HZ);
+
+  __disable_irq();
+  notify();
+  __set_PRIMASK(primask);
+}
+
+// m should be in range [6, 512]
+// n should be in range [1, 32]
+// cclkdiv should be in range [2, 256]
+void PLL_init(uint_fast16_t m, uint_fast16_t n, uint_fast16_t cclkdiv) {
+  const PLLConfig config = { m, n, cclkdiv };
 
-  LPC_SC ->PLL0FEED = 0xAA;
-  LPC_SC ->PLL0FEED = 0x55;
+  PLL_configure(LPC_SC->CLKSRCSEL & 3, &config);
 }
 
 void PLL_bypass() {
-  // Bypass PLL0, use clock source directly
-  LPC_SC ->PLL0CON = 0;
+  const uint32_t primask = __get_PRIMASK();
+
+  // Disconnect PLL0 before disabling it, so the CPU runs from the clock
+  // source directly
+  LPC_SC->PLL0CON = PLLE0;
+  feed();
+  LPC_SC->PLL0CON = 0;
+  feed();
+
+  SystemCoreClockUpdate();
+
+  __disable_irq();
+  notify();
+  __set_PRIMASK(primask);
+}
+
+uint_fast8_t clock_on_change(ClockChangeHandler handler) {
+  uint_fast8_t i;
+
+  // Drivers register from their init, which may be called again
+  for (i = 0; i < handler_count; ++i) {
+    if (handlers[i] == handler) {
+      return 1;
+    }
+  }
+
+  if (handler_count == CLOCK_HANDLERS_MAX) {
+    return 0;
+  }
+
+  handlers[handler_count++] = handler;
+  return 1;
+}
+
+uint32_t clock_set_divider(uint_fast16_t cclkdiv) {
+  const uint32_t primask = __get_PRIMASK();
+  uint64_t fcco, cclk;
+
+  if (!(LPC_SC->PLL0STAT & PLLC0_STAT)
+      || cclkdiv < PLL_CCLKDIV_MIN || cclkdiv > PLL_CCLKDIV_MAX) {
+    return 0;
+  }
+
+  // F_CCO, from the clock it's giving now
+  fcco = (uint64_t) SystemCoreClock * ((LPC_SC->CCLKCFG & 0xFF) + 1);
+  cclk = fcco / cclkdiv;
+  if (cclk > PLL_CCLK_MAX_HZ) {
+    return 0;
+  }
+
+  // Nothing may run at the wrong speed between the switch and the
+  // handlers catching up
+  __disable_irq();
+
+  // Flash access has to be slow enough for the faster of the two
+  // clocks while switching
+  if (cclk > SystemCoreClock) {
+    set_flash_time((cclk - 1) / FLASHTIM_HZ);
+  }
+
+  LPC_SC->CCLKCFG = cclkdiv - 1;
+  SystemCoreClockUpdate();
+  set_flash_time((SystemCoreClock - 1) / FLASHTIM_HZ);
+
+  notify();
+  __set_PRIMASK(primask);
 
-  // Feed the PLL register so the PLL0CON value goes into effect
-  LPC_SC ->PLL0FEED = 0xAA;
-  LPC_SC ->PLL0FEED = 0x55;
+  return SystemCoreClock;
 }
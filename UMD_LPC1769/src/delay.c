@@ -0,0 +1,36 @@
+#include "UMDLPC/system/delay.h"
+
+void delay_init(void) {
+  // The DWT is only clocked with trace enabled
+  CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+  DWT_CTRL |= DWT_CTRL_CYCCNTENA;
+}
+
+uint32_t delay_ns_to_cycles(uint32_t ns) {
+  // Rounding the clock up to whole MHz keeps the delay at least ns
+  const uint32_t mhz = (SystemCoreClock + 999999) / 1000000;
+
+  return (ns * mhz + 999) / 1000;
+}
+
+void delay_ns(uint32_t ns) {
+  delay_cycles(delay_ns_to_cycles(ns));
+}
+
+void delay_us(uint32_t us) {
+  const uint32_t cycles_per_us = (SystemCoreClock + 999999) / 1000000;
+
+  // Split up long delays so the cycle count can't overflow
+  while (us > 1000) {
+    delay_cycles(1000 * cycles_per_us);
+    us -= 1000;
+  }
+
+  delay_cycles(us * cycles_per_us);
+}
+
+void delay_ms(uint32_t ms) {
+  while (ms--) {
+    delay_us(1000);
+  }
+}
@@ -0,0 +1,16 @@
+#include "UMDLPC/system/dma.h"
+#include "UMDLPC/system/sleep.h"
+
+void dma_wait(LPC_GPDMACH_TypeDef * const channel) {
+  // The channel disables itself once the transfer is complete
+  SLEEP_UNTIL_PENDING(!(channel->DMACCConfig & 1));
+
+  LPC_GPDMA->DMACIntTCClear = (1 << dma_channel_number(channel));
+
+  // If nobody has the DMA interrupt enabled in the NVIC it would
+  // otherwise stay pending, and the next transfer would never
+  // generate a WFE wakeup.
+  if (!(NVIC->ISER[0] & (1 << DMA_IRQn))) {
+    NVIC_ClearPendingIRQ(DMA_IRQn);
+  }
+}
@@ -0,0 +1,169 @@
+#include "UMDLPC/util/fft.h"
+
+#define QUARTER (FFT_MAX_POINTS / 4)
+
+// Bit reversals of each byte, built by the preprocessor
+#define R2(n) n, n + 2*64, n + 1*64, n + 3*64
+#define R4(n) R2(n), R2(n + 2*16), R2(n + 1*16), R2(n + 3*16)
+#define R6(n) R4(n), R4(n + 2*4), R4(n + 1*4), R4(n + 3*4)
+static const uint8_t REVERSED[256] = { R6(0), R6(2), R6(1), R6(3) };
+
+// round(32767 * sin(2 pi i / FFT_MAX_POINTS)), for the first quarter
+// turn; the rest of the circle is folded onto it by twiddle()
+static const int16_t SINE[QUARTER + 1] = {
+  0, 201, 402, 603, 804, 1005, 1206, 1407, 1608, 1809,
+  2009, 2210, 2410, 2611, 2811, 3012, 3212, 3412, 3612, 3811,
+  4011, 4210, 4410, 4609, 4808, 5007, 5205, 5404, 5602, 5800,
+  5998, 6195, 6393, 6590, 6786, 6983, 7179, 7375, 7571, 7767,
+  7962, 8157, 8351, 8545, 8739, 8933, 9126, 9319, 9512, 9704,
+  9896, 10087, 10278, 10469, 10659, 10849, 11039, 11228, 11417, 11605,
+  11793, 11980, 12167, 12353, 12539, 12725, 12910, 13094, 13279, 13462,
+  13645, 13828, 14010, 14191, 14372, 14553, 14732, 14912, 15090, 15269,
+  15446, 15623, 15800, 15976, 16151, 16325, 16499, 16673, 16846, 17018,
+  17189, 17360, 17530, 17700, 17869, 18037, 18204, 18371, 18537, 18703,
+  18868, 19032, 19195, 19357, 19519, 19680, 19841, 20000, 20159, 20317,
+  20475, 20631, 20787, 20942, 21096, 21250, 21403, 21554, 21705, 21856,
+  22005, 22154, 22301, 22448, 22594, 22739, 22884, 23027, 23170, 23311,
+  23452, 23592, 23731, 23870, 24007, 24143, 24279, 24413, 24547, 24680,
+  24811, 24942, 25072, 25201, 25329, 25456, 25582, 25708, 25832, 25955,
+  26077, 26198, 26319, 26438, 26556, 26674, 26790, 26905, 27019, 27133,
+  27245, 27356, 27466, 27575, 27683, 27790, 27896, 28001, 28105, 28208,
+  28310, 28411, 28510, 28609, 28706, 28803, 28898, 28992, 29085, 29177,
+  29268, 29358, 29447, 29534, 29621, 29706, 29791, 29874, 29956, 30037,
+  30117, 30195, 30273, 30349, 30424, 30498, 30571, 30643, 30714, 30783,
+  30852, 30919, 30985, 31050, 31113, 31176, 31237, 31297, 31356, 31414,
+  31470, 31526, 31580, 31633, 31685, 31736, 31785, 31833, 31880, 31926,
+  31971, 32014, 32057, 32098, 32137, 32176, 32213, 32250, 32285, 32318,
+  32351, 32382, 32412, 32441, 32469, 32495, 32521, 32545, 32567, 32589,
+  32609, 32628, 32646, 32663, 32678, 32692, 32705, 32717, 32728, 32737,
+  32745, 32752, 32757, 32761, 32765, 32766, 32767
+
+};
+
+// cos and sin of 2 pi m / FFT_MAX_POINTS, in Q15
+void static twiddle(uint32_t m, int32_t *c, int32_t *s) {
+  const uint32_t r = m % QUARTER;
+
+  switch ((m / QUARTER) & 3) {
+  case 0:
+    *c = SINE[QUARTER - r];
+    *s = SINE[r];
+    break;
+  case 1:
+    *c = -SINE[r];
+    *s = SINE[QUARTER - r];
+    break;
+  case 2:
+    *c = -SINE[QUARTER - r];
+    *s = -SINE[r];
+    break;
+  default:
+    *c = SINE[r];
+    *s = -SINE[QUARTER - r];
+    break;
+  }
+}
+
+// Puts the n (= 2^bits) points of data in bit reversed order
+void static bit_reverse(Q15Complex *data, uint16_t n, uint_fast8_t bits) {
+  uint32_t i, j;
+
+  for (i = 0; i < n; ++i) {
+    j = ((REVERSED[i & 0xff] << 8) | REVERSED[i >> 8]) >> (16 - bits);
+    if (j > i) {
+      Q15Complex t = data[i];
+      data[i] = data[j];
+      data[j] = t;
+    }
+  }
+}
+
+char fft_q15(Q15Complex *data, uint16_t n) {
+  uint_fast8_t bits;
+  uint32_t h, i, j, k;
+
+  if (n < 4 || n > FFT_MAX_POINTS || (n & (n - 1))) {
+    return 0;
+  }
+  bits = __builtin_ctz(n);
+
+  bit_reverse(data, n, bits);
+
+  h = 1;
+  if (bits & 1) {
+    // One radix-2 pass; its only twiddle factor is 1
+    for (i = 0; i < n; i += 2) {
+      int32_t ar = data[i].re, ai = data[i].im;
+      int32_t br = data[i + 1].re, bi = data[i + 1].im;
+
+      data[i].re = (ar + br + 1) >> 1;
+      data[i].im = (ai + bi + 1) >> 1;
+      data[i + 1].re = (ar - br + 1) >> 1;
+      data[i + 1].im = (ai - bi + 1) >> 1;
+    }
+    h = 2;
+  }
+
+  // Each radix-4 pass combines the transforms of 4 groups of h points
+  for (; h < n; h *= 4) {
+    const uint32_t step = FFT_MAX_POINTS / (4 * h);
+
+    for (k = 0; k < h; ++k) {
+      int32_t c1, s1, c2, s2, c3, s3;
+
+      twiddle(k * step, &c1, &s1);
+      twiddle(2 * k * step, &c2, &s2);
+      twiddle(3 * k * step, &c3, &s3);
+
+      for (j = k; j < n; j += 4 * h) {
+        Q15Complex *x0 = &data[j], *x1 = x0 + h, *x2 = x1 + h, *x3 = x2 + h;
+
+        // Bit reversal leaves x1 and x2 swapped from the usual radix-4
+        // order, so x1 takes the 2k twiddle and x2 the k one
+        int32_t t1r = (x1->re * c2 + x1->im * s2) >> 15;
+        int32_t t1i = (x1->im * c2 - x1->re * s2) >> 15;
+        int32_t t2r = (x2->re * c1 + x2->im * s1) >> 15;
+        int32_t t2i = (x2->im * c1 - x2->re * s1) >> 15;
+        int32_t t3r = (x3->re * c3 + x3->im * s3) >> 15;
+        int32_t t3i = (x3->im * c3 - x3->re * s3) >> 15;
+
+        // (+ 2 rounds the scaling, rather than flooring it)
+        int32_t ar = x0->re + t1r, ai = x0->im + t1i;
+        int32_t br = x0->re - t1r, bi = x0->im - t1i;
+        int32_t cr = t2r + t3r, ci = t2i + t3i;
+        int32_t dr = t2r - t3r, di = t2i - t3i;
+
+        x0->re = (ar + cr + 2) >> 2;
+        x0->im = (ai + ci + 2) >> 2;
+        x1->re = (br + di + 2) >> 2;
+        x1->im = (bi - dr + 2) >> 2;
+        x2->re = (ar - cr + 2) >> 2;
+        x2->im = (ai - ci + 2) >> 2;
+        x3->re = (br - di + 2) >> 2;
+        x3->im = (bi + dr + 2) >> 2;
+      }
+    }
+  }
+
+  return 1;
+}
+
+void fft_window(const uint32_t *samples, Q15Complex *data, uint16_t n) {
+  const uint32_t step = FFT_MAX_POINTS / n;
+  uint32_t sum = 0, i;
+  int32_t mean, c, s;
+
+  for (i = 0; i < n; ++i) {
+    sum += (samples[i] >> 4) & 0xfff;
+  }
+  mean = sum / n;
+
+  for (i = 0; i < n; ++i) {
+    int32_t sample = ((int32_t) ((samples[i] >> 4) & 0xfff) - mean) << 3;
+
+    // Hann window: (1 - cos(2 pi i / n)) / 2
+    twiddle(i * step, &c, &s);
+    data[i].re = (sample * ((32767 - c) >> 1)) >> 15;
+    data[i].im = 0;
+  }
+}
@@ -0,0 +1,193 @@
+#include "UMDLPC/util/format.h"
+
+// Enough digits for a 32 bit number in octal or anything wider
+#define DIGITS_MAX 11
+
+static const char DIGITS_LOWER[] = "0123456789abcdef";
+static const char DIGITS_UPPER[] = "0123456789ABCDEF";
+
+typedef struct {
+  FormatPut put;
+  void *context;
+  uint32_t count;
+} Output;
+
+void static put(Output *out, char c) {
+  out->put(c, out->context);
+  ++out->count;
+}
+
+void static pad(Output *out, char c, int32_t count) {
+  while (count-- > 0) {
+    put(out, c);
+  }
+}
+
+// Writes a field of width, padded on the left (with fill) or the right
+void static field(Output *out, const char *prefix, const char *s,
+                  uint32_t len, int32_t width, uint_fast8_t left,
+                  char fill) {
+  uint32_t prefix_len = 0;
+
+  while (prefix[prefix_len]) {
+    ++prefix_len;
+  }
+  width -= len + prefix_len;
+
+  // Zeros go after a sign, spaces before it
+  if (!left && fill == ' ') {
+    pad(out, ' ', width);
+  }
+  while (*prefix) {
+    put(out, *prefix++);
+  }
+  if (!left && fill == '0') {
+    pad(out, '0', width);
+  }
+  while (len--) {
+    put(out, *s++);
+  }
+  if (left) {
+    pad(out, ' ', width);
+  }
+}
+
+// Writes value in base, built from the last digit back
+void static number(Output *out, uint32_t value, uint_fast8_t base,
+                   const char *digits, const char *prefix, int32_t width,
+                   uint_fast8_t left, char fill) {
+  char buffer[DIGITS_MAX];
+  char *p = buffer + DIGITS_MAX;
+
+  do {
+    *--p = digits[value % base];
+    value /= base;
+  } while (value);
+
+  field(out, prefix, p, buffer + DIGITS_MAX - p, width, left, fill);
+}
+
+uint32_t format_v(FormatPut put_char, void *context, const char *fmt,
+                  va_list args) {
+  Output out = { put_char, context, 0 };
+
+  for (; *fmt; ++fmt) {
+    uint_fast8_t left = 0, is_long = 0;
+    char fill = ' ';
+    int32_t width = 0, precision = -1;
+
+    if (*fmt != '%') {
+      put(&out, *fmt);
+      continue;
+    }
+
+    // Flags, width and length
+    for (++fmt; *fmt == '-' || *fmt == '0'; ++fmt) {
+      if (*fmt == '-') {
+        left = 1;
+      } else {
+        fill = '0';
+      }
+    }
+    while (*fmt >= '0' && *fmt <= '9') {
+      width = width * 10 + (*fmt++ - '0');
+    }
+    if (*fmt == '.') {
+      for (precision = 0, ++fmt; *fmt >= '0' && *fmt <= '9'; ++fmt) {
+        precision = precision * 10 + (*fmt - '0');
+      }
+    }
+    while (*fmt == 'l') {
+      is_long = 1;
+      ++fmt;
+    }
+
+    switch (*fmt) {
+    case 'd':
+    case 'i': {
+      const int32_t value = is_long ? (int32_t) va_arg(args, long)
+                                    : va_arg(args, int);
+
+      // Negated as unsigned, so that INT32_MIN comes out right
+      number(&out, (value < 0) ? -(uint32_t) value : (uint32_t) value, 10,
+             DIGITS_LOWER, (value < 0) ? "-" : "", width, left, fill);
+      break;
+    }
+    case 'u':
+    case 'x':
+    case 'X': {
+      const uint32_t value = is_long ? (uint32_t) va_arg(args, unsigned long)
+                                     : va_arg(args, unsigned);
+
+      number(&out, value, (*fmt == 'u') ? 10 : 16,
+             (*fmt == 'X') ? DIGITS_UPPER : DIGITS_LOWER, "", width, left,
+             fill);
+      break;
+    }
+    case 'p':
+      number(&out, (uintptr_t) va_arg(args, void *), 16, DIGITS_LOWER, "0x",
+             width, left, fill);
+      break;
+    case 'c': {
+      const char c = va_arg(args, int);
+
+      field(&out, "", &c, 1, width, left, ' ');
+      break;
+    }
+    case 's': {
+      const char *s = va_arg(args, const char *);
+      uint32_t len = 0;
+
+      if (!s) {
+        s = "(null)";
+      }
+      while (s[len] && (precision < 0 || len < (uint32_t) precision)) {
+        ++len;
+      }
+      field(&out, "", s, len, width, left, ' ');
+      break;
+    }
+    case '%':
+      put(&out, '%');
+      break;
+    case '\0':
+      // A lone '%' at the end
+      return out.count;
+    default:
+      // Unknown, so shown as is
+      put(&out, '%');
+      put(&out, *fmt);
+      break;
+    }
+  }
+
+  return out.count;
+}
+
+typedef struct {
+  char *buffer;
+  uint32_t size, len;
+} StringOutput;
+
+void static put_string(char c, void *context) {
+  StringOutput *out = context;
+
+  if (out->len + 1 < out->size) {
+    out->buffer[out->len++] = c;
+  }
+}
+
+uint32_t format_string(char *buffer, uint32_t size, const char *fmt, ...) {
+  StringOutput out = { buffer, size, 0 };
+  uint32_t count;
+  va_list args;
+
+  va_start(args, fmt);
+  count = format_v(put_string, &out, fmt, args);
+  va_end(args);
+
+  if (size) {
+    buffer[out.len] = '\0';
+  }
+  return count;
+}
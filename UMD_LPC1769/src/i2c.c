@@ -0,0 +1,429 @@
+#include "UMDLPC/system/i2c.h"
+#include "UMDLPC/system/clocking.h"
+#include "UMDLPC/system/delay.h"
+#include "UMDLPC/system/pconp.h"
+#include "UMDLPC/system/sleep.h"
+
+// I2CONSET and I2CONCLR bits
+#define CON_AA (1 << 2)
+#define CON_SI (1 << 3)
+#define CON_STO (1 << 4)
+#define CON_STA (1 << 5)
+#define CON_I2EN (1 << 6)
+
+// Master states in I2STAT (tables 399 and 400)
+#define STAT_BUS_ERROR 0x00
+#define STAT_START 0x08
+#define STAT_RESTART 0x10
+#define STAT_SLA_W_ACK 0x18
+#define STAT_SLA_W_NACK 0x20
+#define STAT_DATA_W_ACK 0x28
+#define STAT_DATA_W_NACK 0x30
+#define STAT_ARBITRATION_LOST 0x38
+#define STAT_SLA_R_ACK 0x40
+#define STAT_SLA_R_NACK 0x48
+#define STAT_DATA_R_ACK 0x50
+#define STAT_DATA_R_NACK 0x58
+
+#define RATE_MAX 400000
+#define STANDARD_RATE_MAX 100000
+
+// Half an SCL period while recovering the bus, at 100kHz
+#define RECOVERY_HALF_US 5
+
+// PINMODE for neither pull up nor pull down
+#define PINMODE_NONE 2
+
+typedef struct {
+  LPC_I2C_TypeDef *regs;
+  uint32_t power;
+  volatile uint32_t *pclksel;
+  uint8_t pclk_shift;
+  volatile uint32_t *pinsel, *pinmode;
+  uint8_t sda, scl;       // pins on port 0
+  uint8_t function;
+  uint8_t open_drain;     // I2C0's pins are already
+  IRQn_Type irq;
+} Port;
+
+static const Port ports[3] = {
+  { LPC_I2C0, PC_I2C0, &LPC_SC->PCLKSEL0, 14,
+    &LPC_PINCON->PINSEL1, &LPC_PINCON->PINMODE1, 27, 28, 1, 0, I2C0_IRQn },
+  { LPC_I2C1, PC_I2C1, &LPC_SC->PCLKSEL1, 6,
+    &LPC_PINCON->PINSEL1, &LPC_PINCON->PINMODE1, 19, 20, 3, 1, I2C1_IRQn },
+  { LPC_I2C2, PC_I2C2, &LPC_SC->PCLKSEL1, 20,
+    &LPC_PINCON->PINSEL0, &LPC_PINCON->PINMODE0, 10, 11, 2, 1, I2C2_IRQn }
+};
+
+static I2CBus *buses[3];
+
+// Sets the SCL rate from an undivided peripheral clock at cclk_hz,
+// never above rate_hz. Fast mode's low period must be over twice its
+// high, so it gets 2/3 of the cycle there.
+uint32_t static set_rate(I2CBus *bus, uint32_t rate_hz, uint32_t cclk_hz) {
+  uint32_t cycles, high;
+
+  if (!rate_hz || rate_hz > RATE_MAX) {
+    return 0;
+  }
+
+  cycles = (cclk_hz + rate_hz - 1) / rate_hz;
+  high = (rate_hz > STANDARD_RATE_MAX) ? cycles / 3 : cycles / 2;
+  if (high < 4 || cycles - high < 4 || cycles - high > 0xFFFF) {
+    return 0;
+  }
+
+  bus->regs->I2SCLH = high;
+  bus->regs->I2SCLL = cycles - high;
+  bus->rate = rate_hz;
+
+  return cclk_hz / cycles;
+}
+
+void static clock_changed(uint32_t cclk_hz) {
+  uint_fast8_t i;
+
+  for (i = 0; i < 3; ++i) {
+    if (buses[i]) {
+      set_rate(buses[i], buses[i]->rate, cclk_hz);
+    }
+  }
+}
+
+// Gives the pins to the I2C controller (function) or GPIO (0)
+void static select_pins(const Port *port, uint_fast8_t function) {
+  const uint8_t sda_shift = (port->sda % 16) * 2;
+  const uint8_t scl_shift = (port->scl % 16) * 2;
+
+  *port->pinsel &= ~((3 << sda_shift) | (3 << scl_shift));
+  *port->pinsel |= (function << sda_shift) | (function << scl_shift);
+}
+
+// Turns the controller off, which puts it back to idle, and lets a
+// stuck slave go with the pins taken from it. Returns whether both
+// lines were high at the end; the controller is left off.
+uint_fast8_t static release_bus(I2CBus *bus) {
+  const Port * const port = &ports[bus->port];
+  const uint32_t sda = 1 << port->sda, scl = 1 << port->scl;
+  uint_fast8_t i, free;
+
+  // Lines are pulled low by making them outputs, at 0, and let go by
+  // making them inputs again
+  bus->regs->I2CONCLR = CON_AA | CON_SI | CON_STA | CON_I2EN;
+  LPC_GPIO0->FIODIR &= ~(sda | scl);
+  LPC_GPIO0->FIOCLR = sda | scl;
+  select_pins(port, 0);
+  delay_us(RECOVERY_HALF_US);
+
+  for (i = 0; i < I2C_RECOVERY_PULSES && !(LPC_GPIO0->FIOPIN & sda); ++i) {
+    LPC_GPIO0->FIODIR |= scl;
+    delay_us(RECOVERY_HALF_US);
+    LPC_GPIO0->FIODIR &= ~scl;
+    delay_us(RECOVERY_HALF_US);
+  }
+
+  // A stop: SDA rising while SCL is high
+  LPC_GPIO0->FIODIR |= scl;
+  delay_us(RECOVERY_HALF_US);
+  LPC_GPIO0->FIODIR |= sda;
+  delay_us(RECOVERY_HALF_US);
+  LPC_GPIO0->FIODIR &= ~scl;
+  delay_us(RECOVERY_HALF_US);
+  LPC_GPIO0->FIODIR &= ~sda;
+  delay_us(RECOVERY_HALF_US);
+
+  free = (LPC_GPIO0->FIOPIN & (sda | scl)) == (sda | scl);
+  ++bus->recoveries;
+
+  select_pins(port, port->function);
+
+  return free;
+}
+
+uint_fast8_t i2c_recover(I2CBus *bus) {
+  const uint_fast8_t free = release_bus(bus);
+
+  bus->regs->I2CONSET = CON_I2EN;
+  return free;
+}
+
+// Takes the transfer at the head of the queue off it with status,
+// telling its handler, which may queue more. Returns whether there's
+// another to start. Called with interrupts masked.
+uint_fast8_t static complete(I2CBus *bus, uint8_t status) {
+  I2CTransfer * const transfer = bus->head;
+
+  bus->head = transfer->next;
+  if (!bus->head) {
+    bus->tail = 0;
+  }
+  transfer->status = status;
+  if (transfer->done) {
+    transfer->done(transfer);
+  }
+
+  bus->segment = bus->retries = 0;
+  bus->index = 0;
+  bus->active = (bus->head != 0);
+  return bus->active;
+}
+
+// Ends the transfer with a stop, and starts the next after it
+void static finish(I2CBus *bus, uint8_t status) {
+  const uint32_t set = complete(bus, status) ? CON_STO | CON_STA : CON_STO;
+
+  bus->regs->I2CONSET = set;
+  bus->regs->I2CONCLR = CON_AA | CON_SI;
+}
+
+// Acknowledges every byte read but the segment's last
+void static read_on(I2CBus *bus, const I2CSegment *segment) {
+  if (segment->length - bus->index > 1) {
+    bus->regs->I2CONSET = CON_AA;
+    bus->regs->I2CONCLR = CON_SI;
+  } else {
+    bus->regs->I2CONCLR = CON_AA | CON_SI;
+  }
+}
+
+// Moves on once a segment is done: writes go on without a start where
+// the next segment is flagged so, others get a repeated start
+void static next_segment(I2CBus *bus) {
+  const I2CTransfer * const transfer = bus->head;
+  const I2CSegment *segment;
+
+  while (++bus->segment < transfer->count) {
+    segment = &transfer->segments[bus->segment];
+    bus->index = 0;
+
+    if (!(segment->flags & I2C_NO_START)) {
+      bus->regs->I2CONSET = CON_STA;
+      bus->regs->I2CONCLR = CON_SI;
+      return;
+    }
+    if (segment->length) {
+      bus->regs->I2DAT = segment->data[bus->index++];
+      bus->regs->I2CONCLR = CON_SI;
+      return;
+    }
+  }
+
+  finish(bus, I2C_OK);
+}
+
+void static i2c_irq(I2CBus *bus) {
+  LPC_I2C_TypeDef *regs;
+  const I2CSegment *segment;
+
+  if (!bus) {
+    return;
+  }
+
+  regs = bus->regs;
+  if (!bus->active) {
+    // Nothing should be under way; let the bus go
+    regs->I2CONSET = CON_STO;
+    regs->I2CONCLR = CON_AA | CON_SI | CON_STA;
+    return;
+  }
+  segment = &bus->head->segments[bus->segment];
+
+  switch (regs->I2STAT) {
+    case STAT_START:
+    case STAT_RESTART:
+      regs->I2DAT = (bus->head->address << 1) | (segment->flags & I2C_READ);
+      regs->I2CONCLR = CON_STA | CON_SI;
+      break;
+
+    case STAT_SLA_W_ACK:
+    case STAT_DATA_W_ACK:
+      if (bus->index < segment->length) {
+        regs->I2DAT = segment->data[bus->index++];
+        regs->I2CONCLR = CON_SI;
+      } else {
+        next_segment(bus);
+      }
+      break;
+
+    case STAT_SLA_W_NACK:
+    case STAT_SLA_R_NACK:
+      finish(bus, I2C_NACK_ADDRESS);
+      break;
+
+    case STAT_DATA_W_NACK:
+      finish(bus, I2C_NACK_DATA);
+      break;
+
+    case STAT_ARBITRATION_LOST:
+      // The controller has let the bus go; a start is sent once it's
+      // free again, either for this transfer over or the next
+      if (bus->retries < I2C_RETRIES) {
+        ++bus->retries;
+        bus->segment = 0;
+        bus->index = 0;
+        regs->I2CONSET = CON_STA;
+      } else if (complete(bus, I2C_ARBITRATION_LOST)) {
+        regs->I2CONSET = CON_STA;
+      }
+      regs->I2CONCLR = CON_AA | CON_SI;
+      break;
+
+    case STAT_SLA_R_ACK:
+      read_on(bus, segment);
+      break;
+
+    case STAT_DATA_R_ACK:
+      segment->data[bus->index++] = regs->I2DAT;
+      read_on(bus, segment);
+      break;
+
+    case STAT_DATA_R_NACK:
+      segment->data[bus->index++] = regs->I2DAT;
+      next_segment(bus);
+      break;
+
+    case STAT_BUS_ERROR:
+      release_bus(bus);
+      regs->I2CONSET = complete(bus, I2C_BUS_ERROR) ? CON_I2EN | CON_STA
+                                                    : CON_I2EN;
+      break;
+
+    default:
+      // No state to act on (0xF8), or a slave one, which can't come
+      // about with no slave address set
+      regs->I2CONCLR = CON_SI;
+      break;
+  }
+}
+
+void I2C0_IRQHandler(void) {
+  i2c_irq(buses[0]);
+}
+
+void I2C1_IRQHandler(void) {
+  i2c_irq(buses[1]);
+}
+
+void I2C2_IRQHandler(void) {
+  i2c_irq(buses[2]);
+}
+
+uint32_t i2c_init(I2CBus *bus, uint32_t rate_hz) {
+  const Port *port;
+  uint32_t rate;
+
+  if (bus->port > 2) {
+    return 0;
+  }
+
+  port = &ports[bus->port];
+  bus->regs = port->regs;
+
+  LPC_SC->PCONP |= port->power | PC_GPIO;
+  delay_init();
+
+  // Peripheral clock - select undivided clock (1)
+  *port->pclksel &= ~(3 << port->pclk_shift);
+  *port->pclksel |= (1 << port->pclk_shift);
+
+  rate = set_rate(bus, rate_hz, SystemCoreClock);
+  if (!rate) {
+    LPC_SC->PCONP &= ~port->power;
+    return 0;
+  }
+
+  // Neither pull up nor pull down, and open drain for I2C1 and I2C2
+  *port->pinmode &= ~((3 << (port->sda % 16) * 2)
+                      | (3 << (port->scl % 16) * 2));
+  *port->pinmode |= (PINMODE_NONE << (port->sda % 16) * 2)
+                    | (PINMODE_NONE << (port->scl % 16) * 2);
+  if (port->open_drain) {
+    LPC_PINCON->PINMODE_OD0 |= (1 << port->sda) | (1 << port->scl);
+  }
+
+  bus->head = bus->tail = 0;
+  bus->active = bus->segment = bus->retries = 0;
+  bus->index = 0;
+  bus->recoveries = 0;
+
+  // Never addressed as a slave, the general call included
+  bus->regs->I2ADR0 = 0;
+
+  // Releasing the bus selects the pins, whether or not it needed it
+  if (!release_bus(bus)) {
+    LPC_SC->PCONP &= ~port->power;
+    return 0;
+  }
+  bus->regs->I2CONSET = CON_I2EN;
+
+  buses[bus->port] = bus;
+  clock_on_change(clock_changed);
+  NVIC_EnableIRQ(port->irq);
+
+  return rate;
+}
+
+uint_fast8_t i2c_submit(I2CBus *bus, I2CTransfer *transfer) {
+  uint32_t primask;
+  uint_fast8_t i;
+
+  if (!transfer->count) {
+    return 0;
+  }
+  for (i = 0; i < transfer->count; ++i) {
+    const I2CSegment * const segment = &transfer->segments[i];
+
+    if ((segment->flags & I2C_READ) && !segment->length) {
+      return 0;
+    }
+    if ((segment->flags & I2C_NO_START) && (!i || (segment->flags & I2C_READ)
+        || (transfer->segments[i - 1].flags & I2C_READ))) {
+      return 0;
+    }
+  }
+
+  transfer->status = I2C_PENDING;
+  transfer->next = 0;
+
+  primask = __get_PRIMASK();
+  __disable_irq();
+  if (bus->tail) {
+    bus->tail->next = transfer;
+  } else {
+    bus->head = transfer;
+  }
+  bus->tail = transfer;
+
+  // Completing a transfer starts the next itself
+  if (!bus->active) {
+    bus->active = 1;
+    bus->regs->I2CONSET = CON_STA;
+  }
+  __set_PRIMASK(primask);
+
+  return 1;
+}
+
+uint8_t i2c_wait(I2CTransfer *transfer) {
+  SLEEP_UNTIL(transfer->status != I2C_PENDING);
+  return transfer->status;
+}
+
+uint8_t i2c_transfer(I2CBus *bus, I2CTransfer *transfer) {
+  if (!i2c_submit(bus, transfer)) {
+    return I2C_PENDING;
+  }
+  return i2c_wait(transfer);
+}
+
+void i2c_abort(I2CBus *bus) {
+  const uint32_t primask = __get_PRIMASK();
+
+  __disable_irq();
+  if (bus->head) {
+    release_bus(bus);
+    bus->regs->I2CONSET = complete(bus, I2C_ABORTED) ? CON_I2EN | CON_STA
+                                                     : CON_I2EN;
+  }
+  __set_PRIMASK(primask);
+}
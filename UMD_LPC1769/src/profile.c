@@ -0,0 +1,140 @@
+#include "UMDLPC/system/profile.h"
+#include "UMDLPC/util/format.h"
+
+#include <string.h>
+
+static ProfileZone zones[PROFILE_ZONES_MAX];
+static uint_fast8_t zone_count;
+
+// Records for zones which didn't fit in the table
+static uint32_t dropped;
+
+// The cycles between two reads of the counter, which every record
+// includes
+static uint32_t overhead;
+
+void profile_init(void) {
+  uint_fast8_t i;
+
+  delay_init();
+
+  // The least of a few tries, in case one is interrupted
+  overhead = UINT32_MAX;
+  for (i = 0; i < 4; ++i) {
+    const uint32_t start = delay_counter();
+    const uint32_t cycles = delay_counter() - start;
+
+    if (cycles < overhead) {
+      overhead = cycles;
+    }
+  }
+}
+
+// Finds the zone named name, adding it if there's room
+ProfileZone static *find(const char *name) {
+  uint_fast8_t i;
+
+  for (i = 0; i < zone_count; ++i) {
+    if (!strcmp(zones[i].name, name)) {
+      return &zones[i];
+    }
+  }
+
+  if (zone_count == PROFILE_ZONES_MAX) {
+    return 0;
+  }
+
+  zones[zone_count].name = name;
+  return &zones[zone_count++];
+}
+
+void profile_record(ProfileZone **zone, const char *name, uint32_t cycles) {
+  const uint32_t primask = __get_PRIMASK();
+  ProfileZone *z;
+
+  cycles = (cycles > overhead) ? cycles - overhead : 0;
+
+  // An interrupt handler may record into the same zone, or add one
+  __disable_irq();
+  if (!*zone) {
+    *zone = find(name);
+  }
+  z = *zone;
+
+  if (!z) {
+    ++dropped;
+  } else {
+    if (!z->count || cycles < z->min_cycles) {
+      z->min_cycles = cycles;
+    }
+    if (cycles > z->max_cycles) {
+      z->max_cycles = cycles;
+    }
+    z->total_cycles += cycles;
+    z->clock_hz = SystemCoreClock;
+    ++z->count;
+  }
+  __set_PRIMASK(primask);
+}
+
+void profile_reset(void) {
+  const uint32_t primask = __get_PRIMASK();
+  uint_fast8_t i;
+
+  __disable_irq();
+  for (i = 0; i < zone_count; ++i) {
+    zones[i].count = 0;
+    zones[i].min_cycles = 0;
+    zones[i].max_cycles = 0;
+    zones[i].total_cycles = 0;
+  }
+  dropped = 0;
+  __set_PRIMASK(primask);
+}
+
+const ProfileZone *profile_zone(uint_fast8_t i) {
+  return (i < zone_count) ? &zones[i] : 0;
+}
+
+// Two lines per zone, to fit the 30 columns of the TFT console in
+// FONT_8x8
+void profile_report(ProfileWriter write) {
+  char line[48];
+  uint_fast8_t i;
+
+  write("zone           count  mean us\n");
+  write("  min/mean/max cycles\n");
+
+  for (i = 0; i < zone_count; ++i) {
+    const uint32_t primask = __get_PRIMASK();
+    ProfileZone z;
+    uint32_t mean, tenths;
+
+    // A consistent copy, while interrupts may be recording
+    __disable_irq();
+    z = zones[i];
+    __set_PRIMASK(primask);
+
+    if (!z.count) {
+      continue;
+    }
+
+    mean = z.total_cycles / z.count;
+    tenths = (uint64_t) mean * 10000000 / z.clock_hz;
+
+    format_string(line, sizeof(line), "%-13.13s %7lu %5lu.%lu\n", z.name,
+                  (unsigned long) z.count, (unsigned long) tenths / 10,
+                  (unsigned long) tenths % 10);
+    write(line);
+    format_string(line, sizeof(line), "  %lu/%lu/%lu\n",
+                  (unsigned long) z.min_cycles, (unsigned long) mean,
+                  (unsigned long) z.max_cycles);
+    write(line);
+  }
+
+  if (dropped) {
+    format_string(line, sizeof(line), "(%lu records not in table)\n",
+                  (unsigned long) dropped);
+    write(line);
+  }
+}
@@ -0,0 +1,194 @@
+#include "UMDLPC/system/sched.h"
+#include "UMDLPC/system/systick.h"
+#include "UMDLPC/system/sleep.h"
+#include "UMDLPC/assert.h"
+
+#define WHEEL_MASK (SCHED_WHEEL_SLOTS - 1)
+
+CT_ASSERT(SCHED_PRIORITIES > 0);
+CT_ASSERT(SCHED_WHEEL_SLOTS > 0 && !(SCHED_WHEEL_SLOTS & WHEEL_MASK));
+
+static uint_fast8_t sched_initialized = 0;
+
+// The run queues, which interrupt handlers post to; a task is queued
+// exactly when it has events
+static Task *heads[SCHED_PRIORITIES], *tails[SCHED_PRIORITIES];
+
+// The timer wheel, and the last tick it was turned to
+static Timer *wheel[SCHED_WHEEL_SLOTS];
+static uint32_t wheel_tick;
+
+void sched_init(void) {
+  if (sched_initialized) {
+    return;
+  }
+
+  systick_init();
+  wheel_tick = (uint32_t) systick_ticks();
+
+  sched_initialized = 1;
+}
+
+void sched_post(Task *task, uint32_t events) {
+  const uint32_t primask = __get_PRIMASK();
+  const uint_fast8_t priority = (task->priority < SCHED_PRIORITIES)
+                                ? task->priority : SCHED_PRIORITIES - 1;
+
+  if (!events) {
+    return;
+  }
+
+  __disable_irq();
+  if (!task->events) {
+    task->next = 0;
+    if (tails[priority]) {
+      tails[priority]->next = task;
+    } else {
+      heads[priority] = task;
+    }
+    tails[priority] = task;
+  }
+  task->events |= events;
+  __set_PRIMASK(primask);
+}
+
+void static timer_link(Timer *timer) {
+  Timer **slot = &wheel[timer->due & WHEEL_MASK];
+
+  timer->next = *slot;
+  if (timer->next) {
+    timer->next->link = &timer->next;
+  }
+  timer->link = slot;
+  *slot = timer;
+}
+
+void static timer_unlink(Timer *timer) {
+  *timer->link = timer->next;
+  if (timer->next) {
+    timer->next->link = timer->link;
+  }
+  timer->link = 0;
+}
+
+// Visits the slot of each tick since the wheel was last turned, posting
+// the timers due then
+void static turn_wheel(void) {
+  const uint32_t now = (uint32_t) systick_ticks();
+
+  while (wheel_tick != now) {
+    Timer *timer, *next;
+
+    ++wheel_tick;
+    for (timer = wheel[wheel_tick & WHEEL_MASK]; timer; timer = next) {
+      next = timer->next;
+      if (timer->due != wheel_tick) {
+        continue;
+      }
+
+      sched_post(timer->task, timer->events);
+      timer_unlink(timer);
+
+      // Counting from when it was due, rather than from now, keeps a
+      // periodic timer from drifting; linking it at the head of its
+      // slot keeps it from being seen again this tick
+      if (timer->period) {
+        timer->due += timer->period;
+        timer_link(timer);
+      }
+    }
+  }
+}
+
+uint_fast8_t static any_queued(void) {
+  uint_fast8_t priority;
+
+  for (priority = 0; priority < SCHED_PRIORITIES; ++priority) {
+    if (heads[priority]) {
+      return 1;
+    }
+  }
+  return 0;
+}
+
+uint_fast8_t sched_dispatch(void) {
+  const uint32_t primask = __get_PRIMASK();
+  uint_fast8_t priority;
+  uint32_t events;
+  Task *task;
+
+  turn_wheel();
+
+  __disable_irq();
+  for (priority = 0; priority < SCHED_PRIORITIES; ++priority) {
+    if (heads[priority]) {
+      break;
+    }
+  }
+  if (priority == SCHED_PRIORITIES) {
+    __set_PRIMASK(primask);
+    return 0;
+  }
+
+  // Taking the events dequeues the task, so posts from now on queue it
+  // again
+  task = heads[priority];
+  heads[priority] = task->next;
+  if (!heads[priority]) {
+    tails[priority] = 0;
+  }
+  events = task->events;
+  task->events = 0;
+  __set_PRIMASK(primask);
+
+  task->handler(task, events);
+  return 1;
+}
+
+void sched_run(void) {
+  sched_init();
+
+  while (1) {
+    if (sched_dispatch()) {
+      continue;
+    }
+
+    // Interrupts are masked between the test and the WFI, so a post or
+    // tick landing in between still wakes it (see SLEEP_UNTIL)
+    __disable_irq();
+    if (!any_queued() && wheel_tick == (uint32_t) systick_ticks()) {
+      sleep_wfi();
+    }
+    __enable_irq();
+  }
+}
+
+uint32_t static ms_to_ticks(uint32_t ms) {
+  return ((uint64_t) ms * SYSTICK_HZ + 999) / 1000;
+}
+
+void sched_timer_start(Timer *timer, Task *task, uint32_t events,
+                       uint32_t delay_ms, uint32_t period_ms) {
+  const uint32_t delay = ms_to_ticks(delay_ms);
+
+  sched_init();
+  sched_timer_stop(timer);
+
+  // The wheel may be behind now, but is turned through every tick, so
+  // it can't pass due by
+  timer->task = task;
+  timer->events = events;
+  timer->due = (uint32_t) systick_ticks() + (delay ? delay : 1);
+  timer->period = ms_to_ticks(period_ms);
+  timer_link(timer);
+}
+
+void sched_timer_stop(Timer *timer) {
+  if (timer->link) {
+    timer_unlink(timer);
+  }
+}
+
+uint_fast8_t sched_timer_running(const Timer *timer) {
+  return timer->link != 0;
+}
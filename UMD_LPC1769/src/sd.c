@@ -1,14 +1,31 @@
 #include "UMDLPC/system/sd.h"
+#include "UMDLPC/system/sleep.h"
+#include "UMDLPC/system/profile.h"
+#include "UMDLPC/system/trace.h"
 
 static int sd_version;
 
+// Clocks bytes in while the card sends value (0xFF while it prepares
+// data, 0x00 while it's busy), for up to timeout_ms. Returns the first
+// other byte, or value if the card timed out.
+uint8_t static sd_wait_while(uint8_t value, uint32_t timeout_ms)
+{
+	const uint64_t deadline = systick_deadline_ms(timeout_ms);
+	uint8_t rx;
+
+	do {
+		spi_txrx(NULL, &rx, 1);
+	} while (rx == value && !systick_expired(deadline));
+
+	return rx;
+}
+
 void sd_command(uint8_t index, uint8_t a1, uint8_t a2,
                 uint8_t a3, uint8_t a4, uint8_t crc,
                 uint8_t* response, uint16_t response_len) //{{{
 {
 	uint16_t tries;
 	uint8_t command[6];
-	uint8_t rx = 0;
 
 	memset(response, 0, response_len);
 
@@ -45,9 +62,7 @@ void sd_command(uint8_t index, uint8_t a1, uint8_t a2,
 	/* read until the busy flag is cleared,
 	 * this also gives the SD card at least 8 clock pulses to give
 	 * it a chance to prepare for the next CMD */
-	rx = 0;
-	while (rx == 0)
-		spi_txrx(NULL, &rx, 1);
+	sd_wait_while(0x00, SD_WRITE_TIMEOUT_MS);
 } //}}}
 
 int sd_init() //{{{
@@ -67,6 +82,8 @@ int sd_init() //{{{
 	 */
 
   spi_init();
+  sleep_init();
+  systick_init();
 
 	LPC_GPIO0->FIODIR |= GPIO_SD_CS_m; // enable chip select
 	LPC_GPIO0->FIOSET = GPIO_SD_CS_m; // turn off the chip select (high)
@@ -103,8 +120,12 @@ int sd_init() //{{{
 	}
 
 	// the initialization process
+	uint64_t deadline = systick_deadline_ms(SD_INIT_TIMEOUT_MS);
 	while (resp[0] != 0x00) // 0 when the card is initialized
 	{
+		if (systick_expired(deadline))
+			return -4;
+
 		LPC_GPIO0->FIOCLR = GPIO_SD_CS_m;
 		sd_command(55, 0x00, 0x00, 0x00, 0x00, 0x00, resp, 1); // CMD55
 		LPC_GPIO0->FIOSET = GPIO_SD_CS_m;
@@ -133,11 +154,14 @@ int sd_init() //{{{
 	return 0;
 } //}}}
 
-char sd_read_block(uint8_t* block, uint32_t block_num) //{{{
+char static read_block(uint8_t* block, uint32_t block_num) //{{{
 {
 	// TODO bounds checking
 	uint8_t rx = 0xFF;
 
+	// Only reads which succeed are timed
+	PROFILE_ENTER(sd_read_block);
+
 	// send the single block command
 	LPC_GPIO0->FIOCLR = GPIO_SD_CS_m;
 	sd_command(17, (0xFF000000 & block_num) >> 24,
@@ -149,12 +173,18 @@ char sd_read_block(uint8_t* block, uint32_t block_num) //{{{
 	// the token, but I doubt this happens
 
 	if (rx != 0x00)
+	{
+		LPC_GPIO0->FIOSET = GPIO_SD_CS_m;
 		return 0;
+	}
 
-	// read until the data token is received
-	rx = 0xFF;
-	while (rx != 0b11111110)
-		spi_txrx(NULL, &rx, 1);
+	// read until the data token is received (an error token, or none,
+	// fails the read)
+	if (sd_wait_while(0xFF, SD_READ_TIMEOUT_MS) != 0b11111110)
+	{
+		LPC_GPIO0->FIOSET = GPIO_SD_CS_m;
+		return 0;
+	}
 
 	spi_txrx(NULL, block, SD_BLOCK_LEN); // read the block
 	spi_txrx(NULL, NULL, 2); // throw away the CRC
@@ -162,10 +192,11 @@ char sd_read_block(uint8_t* block, uint32_t block_num) //{{{
 
 	LPC_GPIO0->FIOSET = GPIO_SD_CS_m;
 
+	PROFILE_EXIT(sd_read_block);
 	return 1;
 } //}}}
 
-char sd_write_block(uint8_t* block, uint32_t block_num) //{{{
+char static write_block(uint8_t* block, uint32_t block_num) //{{{
 {
 	// TODO bounds checking
 	uint8_t rx = 0xFF;
@@ -181,7 +212,10 @@ char sd_write_block(uint8_t* block, uint32_t block_num) //{{{
 	// Could be an issue here where the last 8 of SD command contains
 	// the token, but I doubt this happens
 	if (rx != 0x00)
+	{
+		LPC_GPIO0->FIOSET = GPIO_SD_CS_m;
 		return 0;
+	}
 
 	// tick clock 8 times to start write operation
 	spi_txrx(NULL, NULL, 1);
@@ -198,12 +232,17 @@ char sd_write_block(uint8_t* block, uint32_t block_num) //{{{
 
 	// check if the data is accepted
 	if (!((rx & 0xE) >> 1 == 0x2))
+	{
+		LPC_GPIO0->FIOSET = GPIO_SD_CS_m;
 		return 0;
+	}
 
 	// wait for the card to release the busy flag
-	rx = 0;
-	while (rx == 0)
-		spi_txrx(NULL, &rx, 1);
+	if (sd_wait_while(0x00, SD_WRITE_TIMEOUT_MS) == 0x00)
+	{
+		LPC_GPIO0->FIOSET = GPIO_SD_CS_m;
+		return 0;
+	}
 
 	spi_txrx(NULL, NULL, 1); // 8 cycles to prepare the card for the next command
 
@@ -211,6 +250,29 @@ char sd_write_block(uint8_t* block, uint32_t block_num) //{{{
 	return 1;
 } //}}}
 
+// The block commands' spans in the trace end with whether they succeeded
+char sd_read_block(uint8_t* block, uint32_t block_num) //{{{
+{
+	char ok;
+
+	TRACE_BEGIN_SPAN(TRACE_SD_READ, block_num);
+	ok = read_block(block, block_num);
+	TRACE_END_SPAN(TRACE_SD_READ, ok);
+
+	return ok;
+} //}}}
+
+char sd_write_block(uint8_t* block, uint32_t block_num) //{{{
+{
+	char ok;
+
+	TRACE_BEGIN_SPAN(TRACE_SD_WRITE, block_num);
+	ok = write_block(block, block_num);
+	TRACE_END_SPAN(TRACE_SD_WRITE, ok);
+
+	return ok;
+} //}}}
+
 
 /***************************************************************
  * WARNING: This DMA transfer is a work in progress, it does NOT
@@ -232,12 +294,18 @@ char sd_read_block_dma(uint8_t* block, uint32_t block_num,
 	// the token, but I doubt this happens
 
 	if (rx != 0x00)
+	{
+		LPC_GPIO0->FIOSET = GPIO_SD_CS_m;
 		return 0;
+	}
 
-	// read until the data token is received
-	rx = 0xFF;
-	while (rx != 0b11111110)
-		spi_txrx(NULL, &rx, 1);
+	// read until the data token is received (an error token, or none,
+	// fails the read)
+	if (sd_wait_while(0xFF, SD_READ_TIMEOUT_MS) != 0b11111110)
+	{
+		LPC_GPIO0->FIOSET = GPIO_SD_CS_m;
+		return 0;
+	}
 
   dma_channel->DMACCSrcAddr  = (uint32_t) LPC_SSP0->DR;
   dma_channel->DMACCDestAddr = (uint32_t) block;
@@ -251,9 +319,11 @@ char sd_read_block_dma(uint8_t* block, uint32_t block_num,
   //  Destination transfer width: word (2, bits 23:21)
   //  Source increment: don't increment (0, bit 26)
   //  Destination increment: increment (1, bit 27)
+  //  Terminal count interrupt: enabled (bit 31)
   dma_channel->DMACCControl  = (SD_BLOCK_LEN)
                                | (4 << 12)
-                               | (2 << 18) | (2 << 21) | (1 << 27);
+                               | (2 << 18) | (2 << 21) | (1 << 27)
+                               | (1 << 31);
 
   // Enable read dma
   LPC_SSP0->DMACR = 1;
@@ -262,9 +332,10 @@ char sd_read_block_dma(uint8_t* block, uint32_t block_num,
   //  Source peripheral: memory (default, bits  5:1)
   //  Destination peripheral: SSP0 RX (1, bits  10:6)
   //  Transfer Type: peripheral-to-memory (2, bits 13:11)
-  dma_channel->DMACCConfig = (1 << 0) | (2 << 11);
+  //  Enable terminal count interrupt (bit 15)
+  dma_channel->DMACCConfig = (1 << 0) | (2 << 11) | (1 << 15);
 
-  while (!(dma_channel->DMACCConfig & 1));
+  dma_wait(dma_channel);
 
   // Clean up SSP0 DMA settings
   LPC_SSP0->DMACR = 0;
@@ -297,7 +368,10 @@ char sd_write_block_dma(uint8_t* block, uint32_t block_num,
 	// Could be an issue here where the last 8 of SD command contains
 	// the token, but I doubt this happens
 	if (rx != 0x00)
+	{
+		LPC_GPIO0->FIOSET = GPIO_SD_CS_m;
 		return 0;
+	}
 
 	// tick clock 8 times to start write operation
 	spi_txrx(NULL, NULL, 1);
@@ -321,9 +395,11 @@ char sd_write_block_dma(uint8_t* block, uint32_t block_num,
   //  Destination transfer width: word (2, bits 23:21)
   //  Source increment: increment (1, bit 26)
   //  Destination increment: don't increment (0, bit 27)
+  //  Terminal count interrupt: enabled (bit 31)
   dma_channel->DMACCControl  = (SD_BLOCK_LEN / 4)
                                | (4 << 12)
-                               | (2 << 18) | (2 << 21) | (1 << 26);
+                               | (2 << 18) | (2 << 21) | (1 << 26)
+                               | (1 << 31);
 
   // Enable transmit DMA
   LPC_SSP0->DMACR = 2;
@@ -332,9 +408,10 @@ char sd_write_block_dma(uint8_t* block, uint32_t block_num,
   //  Source peripheral: memory (default, bits  5:1)
   //  Destination peripheral: SSP0 TX (0, bits  10:6)
   //  Transfer Type: memory-to-peripheral (1, bits 13:11)
-  dma_channel->DMACCConfig = (1 << 0) | (1 << 11);
+  //  Enable terminal count interrupt (bit 15)
+  dma_channel->DMACCConfig = (1 << 0) | (1 << 11) | (1 << 15);
 
-  while (!(dma_channel->DMACCConfig & 1));
+  dma_wait(dma_channel);
 
   // Clean up SSP0 DMA settings
   LPC_SSP0->DMACR = 0;
@@ -344,12 +421,17 @@ char sd_write_block_dma(uint8_t* block, uint32_t block_num,
 
 	// check if the data is accepted
 	if (!((rx & 0xE) >> 1 == 0x2))
+	{
+		LPC_GPIO0->FIOSET = GPIO_SD_CS_m;
 		return 0;
+	}
 
 	// wait for the card to release the busy flag
-	rx = 0;
-	while (rx == 0)
-		spi_txrx(NULL, &rx, 1);
+	if (sd_wait_while(0x00, SD_WRITE_TIMEOUT_MS) == 0x00)
+	{
+		LPC_GPIO0->FIOSET = GPIO_SD_CS_m;
+		return 0;
+	}
 
 	spi_txrx(NULL, NULL, 1); // 8 cycles to prepare the card for the next command
 
@@ -0,0 +1,132 @@
+#include "UMDLPC/system/semihost.h"
+#include "UMDLPC/util/format.h"
+
+#include <stdarg.h>
+
+// Semihosting operations (see the ARM Developer Suite Debug Target
+// Guide, chapter 5)
+#define SYS_OPEN 0x01
+#define SYS_CLOSE 0x02
+#define SYS_WRITE 0x05
+
+// SYS_OPEN mode "w", which opens ":tt" as the console's output, and
+// "wb", for files
+#define OPEN_MODE_W 4
+#define OPEN_MODE_WB 5
+
+static char buffer[SEMIHOST_BUFFER_LEN];
+static uint32_t buffered;
+
+// The console's handle, once opened
+static int32_t handle = -1;
+
+// Makes a semihosting call: the debugger sees the BKPT, does op with
+// the arguments in the block at args, and returns its result in r0
+int32_t static call(uint32_t op, const void *args) {
+  register uint32_t r0 __asm__("r0") = op;
+  register const void *r1 __asm__("r1") = args;
+
+  __asm__ volatile ("bkpt 0xAB" : "+r" (r0) : "r" (r1) : "memory");
+  return r0;
+}
+
+uint_fast8_t semihost_attached(void) {
+  return (CoreDebug->DHCSR & CoreDebug_DHCSR_C_DEBUGEN_Msk) != 0;
+}
+
+// Writes out the buffer; called with interrupts masked
+void static flush(void) {
+  static const char CONSOLE[] = ":tt";
+
+  if (buffered && semihost_attached()) {
+    if (handle < 0) {
+      const uint32_t args[3] = { (uint32_t) CONSOLE, OPEN_MODE_W,
+                                 sizeof(CONSOLE) - 1 };
+
+      handle = call(SYS_OPEN, args);
+    }
+
+    if (handle >= 0) {
+      const uint32_t args[3] = { handle, (uint32_t) buffer, buffered };
+
+      call(SYS_WRITE, args);
+    }
+  }
+
+  buffered = 0;
+}
+
+void semihost_putc(char c) {
+  const uint32_t primask = __get_PRIMASK();
+
+  __disable_irq();
+  if (buffered == SEMIHOST_BUFFER_LEN) {
+    flush();
+  }
+  buffer[buffered++] = c;
+  __set_PRIMASK(primask);
+}
+
+void semihost_puts(const char *s) {
+  while (*s) {
+    semihost_putc(*s++);
+  }
+}
+
+void semihost_write(const char *data, uint32_t length) {
+  while (length--) {
+    semihost_putc(*data++);
+  }
+}
+
+void static put(char c, void *context) {
+  semihost_putc(c);
+}
+
+uint32_t semihost_printf(const char *fmt, ...) {
+  uint32_t count;
+  va_list args;
+
+  va_start(args, fmt);
+  count = format_v(put, 0, fmt, args);
+  va_end(args);
+
+  return count;
+}
+
+void semihost_flush(void) {
+  const uint32_t primask = __get_PRIMASK();
+
+  __disable_irq();
+  flush();
+  __set_PRIMASK(primask);
+}
+
+int32_t semihost_file_open(const char *name) {
+  uint32_t args[3] = { (uint32_t) name, OPEN_MODE_WB, 0 };
+
+  if (!semihost_attached()) {
+    return -1;
+  }
+
+  while (name[args[2]]) {
+    ++args[2];
+  }
+  return call(SYS_OPEN, args);
+}
+
+uint_fast8_t semihost_file_write(int32_t file, const void *data,
+                                 uint32_t length) {
+  const uint32_t args[3] = { file, (uint32_t) data, length };
+
+  // SYS_WRITE returns the bytes it didn't write
+  return file >= 0 && semihost_attached() && !call(SYS_WRITE, args);
+}
+
+void semihost_file_close(int32_t file) {
+  const uint32_t args[1] = { file };
+
+  if (file >= 0 && semihost_attached()) {
+    call(SYS_CLOSE, args);
+  }
+}
@@ -0,0 +1,181 @@
+#include "UMDLPC/system/sleep.h"
+#include "UMDLPC/system/pconp.h"
+
+// RICTRL bits
+#define RIT_INT   (1 << 0)
+#define RIT_ENCLR (1 << 1)
+#define RIT_ENBR  (1 << 2)
+#define RIT_EN    (1 << 3)
+
+static uint_fast8_t sleep_initialized = 0;
+
+static volatile uint32_t slept_cycles_lo, sleeps;
+static uint64_t slept_cycles, total_cycles;
+static uint32_t last_sample;
+
+static Event delay_done;
+
+void RIT_IRQHandler(void) {
+  // Writing 1 clears the match flag
+  LPC_RIT->RICTRL |= RIT_INT;
+
+  event_signal(&delay_done);
+}
+
+void sleep_init(void) {
+  if (sleep_initialized) {
+    return;
+  }
+
+  LPC_SC->PCONP |= PC_RIT;
+
+  // Undivided peripheral clock for the RIT (1 at bits 27:26)
+  LPC_SC->PCLKSEL1 &= ~(3 << 26);
+  LPC_SC->PCLKSEL1 |= (1 << 26);
+
+  // Free run: compare on all bits, don't clear on match, keep counting
+  // while halted in the debugger so the stats stay honest.
+  LPC_RIT->RIMASK = 0;
+  LPC_RIT->RICOMPVAL = 0xFFFFFFFF;
+  LPC_RIT->RICOUNTER = 0;
+  LPC_RIT->RICTRL = RIT_INT | RIT_EN;
+
+  // Peripheral interrupts pending in the NVIC generate WFE wakeups
+  SCB->SCR |= SCB_SCR_SEVONPEND_Msk;
+
+  NVIC_EnableIRQ(RIT_IRQn);
+
+  sleep_initialized = 1;
+  sleep_stats_reset();
+}
+
+uint32_t sleep_counter(void) {
+  return LPC_RIT->RICOUNTER;
+}
+
+void sleep_wfi(void) {
+  uint32_t before;
+
+  if (!sleep_initialized) {
+    __WFI();
+    return;
+  }
+
+  before = LPC_RIT->RICOUNTER;
+  __DSB();
+  __WFI();
+  slept_cycles_lo += LPC_RIT->RICOUNTER - before;
+  ++sleeps;
+}
+
+void sleep_wfe(void) {
+  uint32_t before, primask;
+
+  if (!sleep_initialized) {
+    __WFE();
+    return;
+  }
+
+  before = LPC_RIT->RICOUNTER;
+  __DSB();
+  __WFE();
+
+  // WFE may be woken from thread mode while an interrupt is also
+  // updating the counts, so keep the update short and atomic.
+  primask = __get_PRIMASK();
+  __disable_irq();
+  slept_cycles_lo += LPC_RIT->RICOUNTER - before;
+  ++sleeps;
+  __set_PRIMASK(primask);
+}
+
+void event_signal(Event *e) {
+  *e = 1;
+
+  // Also wake anyone sleeping in WFE on this event
+  __SEV();
+}
+
+void event_wait(Event *e) {
+  const uint32_t primask = __get_PRIMASK();
+
+  // Cleared under the same mask as the test, so a signal landing
+  // after it isn't lost
+  __disable_irq();
+  while (!*e) {
+    sleep_wfi();
+    __enable_irq();
+    __disable_irq();
+  }
+  *e = 0;
+  __set_PRIMASK(primask);
+}
+
+void sleep_delay_cycles(uint32_t cycles) {
+  uint32_t start = LPC_RIT->RICOUNTER;
+
+  if (cycles < SLEEP_MIN_CYCLES) {
+    while ((LPC_RIT->RICOUNTER - start) < cycles)
+      ;
+    return;
+  }
+
+  delay_done = 0;
+  LPC_RIT->RICOMPVAL = start + cycles;
+
+  // If the counter already went past the compare value while we were
+  // setting it up, no match will come; the second test catches that.
+  SLEEP_UNTIL(delay_done
+              || (LPC_RIT->RICOUNTER - start) >= cycles);
+
+  LPC_RIT->RICOMPVAL = 0xFFFFFFFF;
+  delay_done = 0;
+}
+
+void sleep_delay_us(uint32_t us) {
+  const uint32_t cycles_per_us = SystemCoreClock / 1000000;
+
+  // Split up long delays so the cycle count can't overflow
+  while (us > 1000) {
+    sleep_delay_cycles(1000 * cycles_per_us);
+    us -= 1000;
+  }
+
+  sleep_delay_cycles(us * cycles_per_us);
+}
+
+void sleep_delay_ms(uint32_t ms) {
+  while (ms--) {
+    sleep_delay_cycles(SystemCoreClock / 1000);
+  }
+}
+
+void sleep_stats(SleepStats *stats) {
+  const uint32_t primask = __get_PRIMASK();
+  uint32_t now;
+
+  __disable_irq();
+  now = LPC_RIT->RICOUNTER;
+  total_cycles += now - last_sample;
+  last_sample = now;
+
+  slept_cycles += slept_cycles_lo;
+  slept_cycles_lo = 0;
+
+  stats->slept_cycles = slept_cycles;
+  stats->total_cycles = total_cycles;
+  stats->sleeps = sleeps;
+  __set_PRIMASK(primask);
+}
+
+void sleep_stats_reset(void) {
+  const uint32_t primask = __get_PRIMASK();
+
+  __disable_irq();
+  last_sample = LPC_RIT->RICOUNTER;
+  total_cycles = 0;
+  slept_cycles = 0;
+  slept_cycles_lo = 0;
+  sleeps = 0;
+  __set_PRIMASK(primask);
+}
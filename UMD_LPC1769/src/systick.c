@@ -0,0 +1,103 @@
+#include "UMDLPC/system/systick.h"
+#include "UMDLPC/system/clocking.h"
+#include "UMDLPC/assert.h"
+
+#define US_PER_TICK (1000000 / SYSTICK_HZ)
+
+CT_ASSERT(1000000 % SYSTICK_HZ == 0);
+
+// The part of a tick counted down is scaled to microseconds in 32 bits
+CT_ASSERT(PLL_CCLK_MAX_HZ / SYSTICK_HZ * US_PER_TICK <= UINT32_MAX);
+
+static uint_fast8_t systick_initialized = 0;
+
+static volatile uint64_t ticks;
+
+void SysTick_Handler(void) {
+  ++ticks;
+}
+
+// Sets the reload for a new CPU clock. The tick in progress is counted
+// as done and a new one started, so that the time can't run backwards
+// when the clock slows down. Called with interrupts masked: if the
+// counter has already wrapped, that tick's handler is still pending,
+// and is cleared so it isn't counted twice (the sliver since the wrap
+// is dropped instead).
+void static clock_changed(uint32_t cclk_hz) {
+  SysTick->LOAD = cclk_hz / SYSTICK_HZ - 1;
+  SysTick->VAL = 0;
+  SCB->ICSR = SCB_ICSR_PENDSTCLR_Msk;
+  ++ticks;
+}
+
+void systick_init(void) {
+  if (systick_initialized) {
+    return;
+  }
+
+  ticks = 0;
+
+  // Counts down from LOAD on the CPU clock, and interrupts on reaching
+  // 0; SysTick_Config sets the lowest priority
+  SysTick_Config(SystemCoreClock / SYSTICK_HZ);
+  clock_on_change(clock_changed);
+
+  systick_initialized = 1;
+}
+
+uint64_t systick_ticks(void) {
+  const uint32_t primask = __get_PRIMASK();
+  uint64_t count;
+
+  // Reading ticks takes two loads, which the handler mustn't come
+  // between
+  __disable_irq();
+  count = ticks;
+  __set_PRIMASK(primask);
+
+  return count;
+}
+
+uint64_t systick_us(void) {
+  const uint32_t primask = __get_PRIMASK();
+  uint64_t count;
+  uint32_t load, value, elapsed;
+
+  if (!systick_initialized) {
+    return 0;
+  }
+
+  __disable_irq();
+  count = ticks;
+  load = SysTick->LOAD;
+  value = SysTick->VAL;
+
+  // The counter wrapped, but the handler hasn't run yet (interrupts
+  // were masked by the caller, or it wrapped just now): count that
+  // tick, and read the counter again in case it wrapped after the
+  // first read
+  if (SCB->ICSR & SCB_ICSR_PENDSTSET_Msk) {
+    ++count;
+    value = SysTick->VAL;
+  }
+  __set_PRIMASK(primask);
+
+  // The counter runs LOAD down to 1, then wraps to 0 (which pends the
+  // interrupt) and reloads; so 0 starts the next tick, along with LOAD
+  elapsed = value ? load + 1 - value : 0;
+
+  return count * US_PER_TICK + elapsed * US_PER_TICK / (load + 1);
+}
+
+uint64_t systick_deadline_us(uint32_t us) {
+  systick_init();
+  return systick_us() + us;
+}
+
+uint64_t systick_deadline_ms(uint32_t ms) {
+  return systick_deadline_us(0) + (uint64_t) ms * 1000;
+}
+
+uint_fast8_t systick_expired(uint64_t deadline) {
+  return systick_us() >= deadline;
+}
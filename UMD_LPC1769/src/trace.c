@@ -0,0 +1,122 @@
+#include "UMDLPC/system/trace.h"
+#include "UMDLPC/system/clocking.h"
+#include "UMDLPC/assert.h"
+
+#include <string.h>
+
+#define RING_MASK (TRACE_EVENTS - 1)
+
+CT_ASSERT(TRACE_EVENTS > 0 && !(TRACE_EVENTS & RING_MASK));
+
+// Dumped as is, so it mustn't be padded
+CT_ASSERT(sizeof(TraceEvent) == 12);
+CT_ASSERT(sizeof(TraceHeader) == 20);
+
+TraceEvent trace_ring[TRACE_EVENTS];
+uint32_t trace_total;
+volatile uint_fast8_t trace_running;
+
+static struct {
+  uint16_t id;
+  const char *name;
+} names[TRACE_NAMES_MAX];
+static uint_fast8_t name_count;
+
+// The clock a TRACE_CLOCK event switches from
+static uint32_t clock_hz;
+
+void static clock_changed(uint32_t cclk_hz) {
+  trace_event(TRACE_CLOCK, clock_hz);
+  clock_hz = cclk_hz;
+}
+
+void trace_init(void) {
+  delay_init();
+
+  trace_running = 0;
+  trace_total = 0;
+  clock_hz = SystemCoreClock;
+  clock_on_change(clock_changed);
+
+  trace_name(TRACE_CLOCK, "clock");
+  trace_name(TRACE_SD_READ, "sd_read");
+  trace_name(TRACE_SD_WRITE, "sd_write");
+
+  trace_running = 1;
+}
+
+uint_fast8_t trace_name(uint16_t id, const char *name) {
+  uint_fast8_t i;
+
+  id &= TRACE_ID_MASK;
+  for (i = 0; i < name_count; ++i) {
+    if (names[i].id == id) {
+      names[i].name = name;
+      return 1;
+    }
+  }
+
+  if (name_count == TRACE_NAMES_MAX) {
+    return 0;
+  }
+
+  names[name_count].id = id;
+  names[name_count++].name = name;
+  return 1;
+}
+
+void trace_stop(void) {
+  trace_running = 0;
+}
+
+void trace_start(void) {
+  trace_running = 1;
+}
+
+void trace_clear(void) {
+  const uint32_t primask = __get_PRIMASK();
+
+  __disable_irq();
+  trace_total = 0;
+  __set_PRIMASK(primask);
+}
+
+void trace_dump(TraceWriter write) {
+  const uint_fast8_t was_running = trace_running;
+  TraceHeader header;
+  uint32_t first, start;
+  uint_fast8_t i;
+
+  trace_stop();
+
+  header.magic = TRACE_MAGIC;
+  header.version = TRACE_VERSION;
+  header.names = name_count;
+  header.count = (trace_total < TRACE_EVENTS) ? trace_total : TRACE_EVENTS;
+  header.lost = trace_total - header.count;
+  header.clock_hz = SystemCoreClock;
+  write(&header, sizeof(header));
+
+  for (i = 0; i < name_count; ++i) {
+    const uint16_t lengths[2] = { names[i].id, strlen(names[i].name) };
+
+    write(lengths, sizeof(lengths));
+    write(names[i].name, lengths[1]);
+  }
+
+  // The oldest event on, in at most two runs either side of the end of
+  // the ring
+  first = header.lost;
+  start = first & RING_MASK;
+  if (start + header.count > TRACE_EVENTS) {
+    write(&trace_ring[start], (TRACE_EVENTS - start) * sizeof(TraceEvent));
+    write(trace_ring, (start + header.count - TRACE_EVENTS)
+                      * sizeof(TraceEvent));
+  } else {
+    write(&trace_ring[start], header.count * sizeof(TraceEvent));
+  }
+
+  if (was_running) {
+    trace_start();
+  }
+}
@@ -0,0 +1,463 @@
+#include "UMDLPC/system/uart.h"
+#include "UMDLPC/system/clocking.h"
+#include "UMDLPC/system/pconp.h"
+#include "UMDLPC/system/sleep.h"
+
+#include <string.h>
+
+// Interrupt enables, and the interrupt identifications in IIR
+#define IER_RBR (1 << 0)
+#define IER_THRE (1 << 1)
+#define IER_RLS (1 << 2)
+#define IIR_ID 0x0F
+#define IIR_RLS 0x06
+#define IIR_RDA 0x04
+#define IIR_CTI 0x0C
+#define IIR_THRE 0x02
+
+// FIFOs on and reset, DMA mode, 14 byte receive trigger level
+#define FCR_SETUP ((1 << 0) | (1 << 1) | (1 << 2) | (1 << 3) | (3 << 6))
+
+#define LCR_8N1 3
+#define LCR_DLAB (1 << 7)
+
+#define LSR_ERRORS ((1 << 1) | (1 << 2) | (1 << 3) | (1 << 4))
+#define LSR_TEMT (1 << 6)
+
+#define FIFOLVL_RX 0x0F
+
+// DMA control and config bits. Bursts of 8 bytes leave 6 in the FIFO
+// at the trigger level, so it's never empty when the line goes idle,
+// and the character timeout always comes.
+#define DMA_SI (1 << 26)
+#define DMA_DI (1 << 27)
+#define DMA_BURST_8 ((2 << 12) | (2 << 15))
+#define DMA_ENABLE (1 << 0)
+#define DMA_M2P (1 << 11)
+#define DMA_P2M (2 << 11)
+#define DMA_TRANSFER_MAX 4095
+
+typedef struct {
+  LPC_UART_TypeDef *regs;
+  uint32_t power;
+  volatile uint32_t *pclksel;
+  uint8_t pclk_shift;
+  volatile uint32_t *pinsel;
+  uint8_t tx_shift, rx_shift, function;
+  IRQn_Type irq;
+  uint8_t tx_request;    // the RX request is the next one
+} Port;
+
+static const Port ports[4] = {
+  { LPC_UART0, PC_UART0, &LPC_SC->PCLKSEL0, 6,
+    &LPC_PINCON->PINSEL0, 4, 6, 1, UART0_IRQn, 8 },
+  { (LPC_UART_TypeDef *) LPC_UART1, PC_UART1, &LPC_SC->PCLKSEL0, 8,
+    &LPC_PINCON->PINSEL4, 0, 2, 2, UART1_IRQn, 10 },
+  { LPC_UART2, PC_UART2, &LPC_SC->PCLKSEL1, 16,
+    &LPC_PINCON->PINSEL0, 20, 22, 1, UART2_IRQn, 12 },
+  { LPC_UART3, PC_UART3, &LPC_SC->PCLKSEL1, 18,
+    &LPC_PINCON->PINSEL0, 0, 2, 2, UART3_IRQn, 14 }
+};
+
+static Uart *uarts[4];
+
+uint32_t uart_baud_solve(uint32_t pclk_hz, uint32_t baud,
+                         UartDivider *divider) {
+  uint32_t best = 0, best_error = 0xFFFFFFFF;
+  uint_fast8_t mulval, divaddval, i;
+
+  if (!baud) {
+    return 0;
+  }
+
+  for (mulval = 1; mulval <= 15; ++mulval) {
+    for (divaddval = 0; divaddval < mulval; ++divaddval) {
+      // The divisor just below and just above the exact one
+      const uint64_t scale = 16ULL * baud * (mulval + divaddval);
+      const uint32_t low = (uint64_t) pclk_hz * mulval / scale;
+
+      for (i = 0; i < 2; ++i) {
+        const uint32_t divisor = low + i;
+        uint32_t rate, error;
+
+        if (divisor < (divaddval ? 3 : 1) || divisor > 0xFFFF) {
+          continue;
+        }
+
+        rate = ((uint64_t) pclk_hz * mulval
+                + 8ULL * divisor * (mulval + divaddval))
+               / (16ULL * divisor * (mulval + divaddval));
+        error = (rate > baud) ? rate - baud : baud - rate;
+        if (error < best_error) {
+          best = rate;
+          best_error = error;
+          divider->divisor = divisor;
+          divider->divaddval = divaddval;
+          divider->mulval = mulval;
+        }
+      }
+    }
+  }
+
+  return best;
+}
+
+// Sets the rate from an undivided peripheral clock at cclk_hz
+uint32_t static set_divider(Uart *uart, uint32_t baud, uint32_t cclk_hz) {
+  LPC_UART_TypeDef * const regs = uart->regs;
+  UartDivider divider;
+  const uint32_t rate = uart_baud_solve(cclk_hz, baud, &divider);
+
+  if (!rate) {
+    return 0;
+  }
+
+  regs->LCR = LCR_8N1 | LCR_DLAB;
+  regs->DLL = divider.divisor & 0xFF;
+  regs->DLM = divider.divisor >> 8;
+  regs->LCR = LCR_8N1;
+  regs->FDR = (divider.mulval << 4) | divider.divaddval;
+  uart->baud = baud;
+
+  return rate;
+}
+
+void static clock_changed(uint32_t cclk_hz) {
+  uint_fast8_t i;
+
+  for (i = 0; i < 4; ++i) {
+    if (uarts[i]) {
+      set_divider(uarts[i], uarts[i]->baud, cclk_hz);
+    }
+  }
+}
+
+// Retires the chunk being sent, once its channel has finished, and
+// starts the next. Called with interrupts masked.
+void static tx_advance(Uart *uart) {
+  LPC_GPDMACH_TypeDef * const channel = uart->tx_channel;
+  uint32_t start, length;
+
+  if (uart->tx_sending) {
+    if (channel->DMACCConfig & DMA_ENABLE) {
+      return;
+    }
+    uart->tx_tail += uart->tx_sending;
+    uart->tx_sending = 0;
+  }
+
+  length = uart->tx_head - uart->tx_tail;
+  if (!length) {
+    return;
+  }
+
+  // Up to the end of the ring, in one transfer
+  start = uart->tx_tail & (uart->tx_size - 1);
+  if (length > uart->tx_size - start) {
+    length = uart->tx_size - start;
+  }
+  if (length > DMA_TRANSFER_MAX) {
+    length = DMA_TRANSFER_MAX;
+  }
+
+  channel->DMACCSrcAddr = (uint32_t) &uart->tx_ring[start];
+  channel->DMACCDestAddr = (uint32_t) &uart->regs->THR;
+  channel->DMACCLLI = 0;
+  channel->DMACCControl = length | DMA_SI;
+  uart->tx_sending = length;
+  channel->DMACCConfig = DMA_ENABLE | DMA_M2P
+                         | (ports[uart->port].tx_request << 6);
+}
+
+// Where the RX channel will write next
+uint32_t static rx_head(const Uart *uart) {
+  const uint32_t head = uart->rx_channel->DMACCDestAddr
+                        - (uint32_t) uart->rx_ring;
+
+  // Between the last byte and going round again
+  return (head >= uart->rx_size) ? 0 : head;
+}
+
+// Counts what the RX channel has written since last called, and drops
+// the unread bytes if it has gone past the oldest. Called with
+// interrupts masked.
+void static rx_account(Uart *uart) {
+  const uint32_t head = rx_head(uart);
+
+  uart->rx_unread += (head >= uart->rx_seen)
+                     ? head - uart->rx_seen
+                     : uart->rx_size - uart->rx_seen + head;
+  uart->rx_seen = head;
+
+  if (uart->rx_unread > uart->rx_size) {
+    ++uart->rx_overruns;
+    uart->rx_tail = head;
+    uart->rx_unread = 0;
+  }
+}
+
+// Reads the line status, counting errors, which reading clears
+uint32_t static line_status(Uart *uart) {
+  const uint32_t lsr = uart->regs->LSR;
+
+  if (lsr & LSR_ERRORS) {
+    ++uart->rx_errors;
+  }
+  return lsr;
+}
+
+void static uart_irq(Uart *uart) {
+  uint32_t rx_request, left;
+
+  if (!uart) {
+    return;
+  }
+
+  switch (uart->regs->IIR & IIR_ID) {
+    case IIR_RLS:
+      line_status(uart);
+      break;
+
+    case IIR_CTI:
+      // Fewer bytes than the trigger level are left in the FIFO; single
+      // requests have the DMA take them one at a time. Any arriving
+      // meanwhile are left for the next burst or timeout.
+      rx_request = 1 << (ports[uart->port].tx_request + 1);
+      for (left = uart->regs->FIFOLVL & FIFOLVL_RX; left; --left) {
+        LPC_GPDMA->DMACSoftSReq = rx_request;
+        while (LPC_GPDMA->DMACSoftSReq & rx_request)
+          ;
+      }
+      rx_account(uart);
+      if (uart->on_idle) {
+        uart->on_idle(uart);
+      }
+      break;
+
+    case IIR_RDA:
+    case IIR_THRE:
+      break;
+  }
+
+  // The RX trigger level interrupts for every burst, though the DMA has
+  // usually emptied the FIFO by the time IIR is read, which then says
+  // nothing's pending. Either way the ring has moved on, and a chunk
+  // may have finished.
+  rx_account(uart);
+  tx_advance(uart);
+}
+
+void UART0_IRQHandler(void) {
+  uart_irq(uarts[0]);
+}
+
+void UART1_IRQHandler(void) {
+  uart_irq(uarts[1]);
+}
+
+void UART2_IRQHandler(void) {
+  uart_irq(uarts[2]);
+}
+
+void UART3_IRQHandler(void) {
+  uart_irq(uarts[3]);
+}
+
+uint32_t uart_init(Uart *uart, uint32_t baud) {
+  const Port *port;
+  LPC_UART_TypeDef *regs;
+  LPC_GPDMACH_TypeDef *rx_channel;
+  uint32_t rate;
+
+  if (uart->port > 3 || !uart->tx_size
+      || (uart->tx_size & (uart->tx_size - 1))
+      || !uart->rx_size || uart->rx_size > UART_RX_RING_MAX) {
+    return 0;
+  }
+
+  port = &ports[uart->port];
+  regs = uart->regs = port->regs;
+  rx_channel = uart->rx_channel;
+
+  LPC_SC->PCONP |= port->power | PC_GPDMA;
+  LPC_GPDMA->DMACConfig |= 1;
+
+  // Peripheral clock - select undivided clock (1)
+  *port->pclksel &= ~(3 << port->pclk_shift);
+  *port->pclksel |= (1 << port->pclk_shift);
+
+  rate = set_divider(uart, baud, SystemCoreClock);
+  if (!rate) {
+    LPC_SC->PCONP &= ~port->power;
+    return 0;
+  }
+
+  // Select pin functions
+  *port->pinsel &= ~((3 << port->tx_shift) | (3 << port->rx_shift));
+  *port->pinsel |= (port->function << port->tx_shift)
+                   | (port->function << port->rx_shift);
+
+  // Request lines 8-15 go to the UARTs, not the timers' match outputs
+  LPC_SC->DMAREQSEL &= ~(3 << (port->tx_request - 8));
+
+  regs->FCR = FCR_SETUP;
+  uart->tx_head = uart->tx_tail = uart->tx_sending = 0;
+  uart->rx_tail = uart->rx_seen = uart->rx_unread = uart->rx_peeked = 0;
+  uart->rx_errors = uart->rx_overruns = 0;
+
+  // The RX channel fills the ring, then goes round again through a
+  // node linked to itself
+  uart->rx_node.sourceAddr = (uint32_t) &regs->RBR;
+  uart->rx_node.destAddr = (uint32_t) uart->rx_ring;
+  uart->rx_node.nextNode = (uint32_t) &uart->rx_node;
+  uart->rx_node.dmaControl = uart->rx_size | DMA_DI | DMA_BURST_8;
+
+  rx_channel->DMACCConfig = 0;
+  rx_channel->DMACCSrcAddr = uart->rx_node.sourceAddr;
+  rx_channel->DMACCDestAddr = uart->rx_node.destAddr;
+  rx_channel->DMACCLLI = uart->rx_node.nextNode;
+  rx_channel->DMACCControl = uart->rx_node.dmaControl;
+  rx_channel->DMACCConfig = DMA_ENABLE | DMA_P2M
+                            | ((port->tx_request + 1) << 1);
+
+  uarts[uart->port] = uart;
+  clock_on_change(clock_changed);
+
+  // Receive data (only so as to have the character timeout, though it
+  // costs an interrupt per burst), transmit empty and line status
+  regs->IER = IER_RBR | IER_THRE | IER_RLS;
+  NVIC_EnableIRQ(port->irq);
+
+  return rate;
+}
+
+uint32_t uart_set_baud(Uart *uart, uint32_t baud) {
+  uint32_t primask, rate;
+
+  uart_flush(uart);
+
+  primask = __get_PRIMASK();
+  __disable_irq();
+  rate = set_divider(uart, baud, SystemCoreClock);
+  __set_PRIMASK(primask);
+
+  return rate;
+}
+
+uint8_t *uart_reserve(Uart *uart, uint32_t *length) {
+  const uint32_t head = uart->tx_head;
+  const uint32_t start = head & (uart->tx_size - 1);
+  const uint32_t free = uart->tx_size - (head - uart->tx_tail);
+  const uint32_t to_end = uart->tx_size - start;
+
+  *length = (free < to_end) ? free : to_end;
+  return &uart->tx_ring[start];
+}
+
+void uart_commit(Uart *uart, uint32_t length) {
+  const uint32_t primask = __get_PRIMASK();
+
+  __disable_irq();
+  uart->tx_head += length;
+  tx_advance(uart);
+  __set_PRIMASK(primask);
+}
+
+void uart_write(Uart *uart, const void *data, uint32_t length) {
+  const uint8_t *bytes = data;
+  uint32_t space;
+  uint8_t *to;
+
+  while (length) {
+    SLEEP_UNTIL(uart->tx_head - uart->tx_tail < uart->tx_size);
+
+    to = uart_reserve(uart, &space);
+    if (space > length) {
+      space = length;
+    }
+    memcpy(to, bytes, space);
+    uart_commit(uart, space);
+
+    bytes += space;
+    length -= space;
+  }
+}
+
+void uart_flush(Uart *uart) {
+  SLEEP_UNTIL(uart->tx_tail == uart->tx_head);
+
+  // The last byte or so is still shifting out
+  while (!(uart->regs->LSR & LSR_TEMT))
+    ;
+}
+
+uint32_t uart_peek(Uart *uart, const uint8_t **data) {
+  const uint32_t primask = __get_PRIMASK();
+  uint32_t length;
+
+  // Catch up with the channel, in case it has overrun since the last
+  // interrupt
+  __disable_irq();
+  rx_account(uart);
+  uart->rx_peeked = uart->rx_overruns;
+  *data = &uart->rx_ring[uart->rx_tail];
+  length = uart->rx_size - uart->rx_tail;
+  if (length > uart->rx_unread) {
+    length = uart->rx_unread;
+  }
+  __set_PRIMASK(primask);
+
+  return length;
+}
+
+uint_fast8_t uart_consume(Uart *uart, uint32_t length) {
+  const uint32_t primask = __get_PRIMASK();
+  uint_fast8_t intact;
+
+  // An overrun since the peek has dropped these already
+  __disable_irq();
+  intact = (uart->rx_peeked == uart->rx_overruns);
+  if (intact) {
+    uart->rx_unread -= length;
+    uart->rx_tail += length;
+    if (uart->rx_tail >= uart->rx_size) {
+      uart->rx_tail -= uart->rx_size;
+    }
+  }
+  __set_PRIMASK(primask);
+
+  return intact;
+}
+
+uint32_t uart_read(Uart *uart, void *data, uint32_t length) {
+  uint8_t *bytes = data;
+  const uint8_t *from;
+  uint32_t available, total = 0;
+
+  // Twice, for the end of the ring and the start (or again after an
+  // overrun)
+  while (length && (available = uart_peek(uart, &from))) {
+    if (available > length) {
+      available = length;
+    }
+    memcpy(bytes, from, available);
+    if (!uart_consume(uart, available)) {
+      // Overwritten while being copied
+      continue;
+    }
+
+    bytes += available;
+    length -= available;
+    total += available;
+  }
+
+  return total;
+}
+
+uint32_t uart_errors(const Uart *uart) {
+  return uart->rx_errors;
+}
+
+uint32_t uart_overruns(const Uart *uart) {
+  return uart->rx_overruns;
+}